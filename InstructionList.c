@@ -0,0 +1,72 @@
+/*
+ * Instruction List: functions to build the list of parsed instructions
+ *
+ * This file provides the definitions of the functions declared in
+ * InstructionList.h.  The records are kept in one array, which doubles
+ * in size whenever it fills up, the label operands in an interner, and
+ * the data in a DataSegment.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "InstructionList.h"
+#include "printFuncs.h"
+
+/* Capacity of the array when the first instruction is added. */
+#define INITIAL_CAPACITY 256
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+void listInit (InstructionList * list)
+{
+    list->instructions = NULL;
+    list->nbrInstructions = 0;
+    list->capacity = 0;
+    internerInit (&list->labels);
+    dataInit (&list->data);
+}
+
+int addInstruction (InstructionList * list, const Instruction * instruction)
+{
+    Instruction * newArray;
+    int           newCapacity;
+
+    if ( list->nbrInstructions >= list->capacity )
+    {
+        newCapacity = list->capacity > 0 ? list->capacity * 2
+                                         : INITIAL_CAPACITY;
+        newArray = realloc (list->instructions,
+                            (size_t) newCapacity * sizeof(Instruction));
+        if ( newArray == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return 0;
+        }
+        list->instructions = newArray;
+        list->capacity = newCapacity;
+    }
+
+    list->instructions[list->nbrInstructions] = *instruction;
+    if ( hasLabelOperand (instruction) &&
+         (list->instructions[list->nbrInstructions].label =
+              intern (&list->labels, instruction->text)) == -1 )
+        return 0;       /* error message already printed */
+    list->nbrInstructions++;
+    return 1;
+}
+
+void listFree (InstructionList * list)
+{
+    free (list->instructions);
+    internerFree (&list->labels);
+    dataFree (&list->data);
+    listInit (list);
+}
+
+int hasLabelOperand (const Instruction * instruction)
+{
+    return instruction->status == PARSE_OK &&
+           (instruction->instruction->operands == OPS_RS_RT_LABEL ||
+            instruction->instruction->operands == OPS_TARGET);
+}
@@ -0,0 +1,112 @@
+/*
+ * Instruction List: the intermediate representation of a program
+ *
+ * This file provides the data structure for one parsed instruction and
+ * for the list of the instructions in a program, in source order, along
+ * with the functions to build the list.
+ *
+ * Each line containing an instruction is parsed once (see
+ * parseInstruction), while pass1 reads the source: the instruction name
+ * is looked up, the operands are split into tokens, and the registers
+ * and immediate values are converted to numbers.  Every instruction
+ * becomes a fixed-size record, and pass2 resolves labels and encodes
+ * the instructions from the records alone, without looking at the text
+ * again.
+ *
+ * The list also holds the program's data segment (see dataSegment.h),
+ * which pass1 fills in from the data directives, and pass2 writes after
+ * the instructions.  Since lines in the data segment take up no room in
+ * the text segment, each instruction keeps its own address.
+ *
+ * The label operands are interned as the instructions are added (see
+ * interner.h), so that each instruction with a label also holds the
+ * label's id, which pass2 uses to find its address.
+ *
+ * Parsing does not report errors.  A register that is not valid is
+ * stored as -1 and a line that cannot be parsed is marked with its
+ * problem, so that the errors are reported when the instruction is
+ * encoded, in the same order as always (see diagnostics.h).
+ *
+ */
+
+#ifndef _INSTRUCTIONLIST_H
+#define _INSTRUCTIONLIST_H
+
+#include "InstructionTable.h"
+#include "dataSegment.h"
+#include "getToken.h"
+#include "interner.h"
+
+/* THE DATA STRUCTURES */
+
+/* Result of parsing an instruction. */
+typedef enum {
+        PARSE_OK,               /* the record holds the operands */
+        PARSE_BAD_NAME,         /* not an instruction; text is the name */
+        PARSE_BAD_TOKENS        /* wrong number of operands; text is the
+                                 * error message from getNSpanTokens */
+} ParseStatus;
+
+/* One parsed instruction.  The operands are stored by position, in the
+ * order they are written (see OperandShape): reg[i] is the number of
+ * the register written as operand i (-1 if it is not a register),
+ * immediate is the value of the immediate or shamt operand (INT_MIN if
+ * it is not a number or does not fit in an int, which is out of range
+ * for every instruction; see number.h), and text is
+ * the label operand (the first operand, for error messages, if there is
+ * no label).  An instruction with a label operand has no immediate, so
+ * its place holds the id of the label instead: the id given to it by
+ * the interner of the list the instruction is in, or -1 if it is not in
+ * a list.  Fields for operands the instruction does not have are 0.
+ */
+typedef struct {
+        const InstructionInfo * instruction;  /* NULL if PARSE_BAD_NAME */
+        int         lineNum;    /* source line */
+        int         address;    /* the PC: (lineNum-1)*4 unless a data
+                                 * segment came before it */
+        union {
+            int     immediate;  /* immediate value or shamt */
+            int     label;      /* id of the label (see hasLabelOperand) */
+        };
+        signed char reg[3];     /* register operands */
+        signed char status;     /* a ParseStatus */
+        int         column;     /* column of the instruction name, from 1 */
+        Span        text;       /* label operand (or see ParseStatus) */
+        Span        operands;   /* the text of the operands, for the
+                                 * debugging messages of pass2 */
+} Instruction;
+
+typedef struct {
+        Instruction * instructions;
+        int           nbrInstructions;
+        int           capacity;
+        Interner      labels;   /* the label operands, by id */
+        DataSegment   data;     /* the data directives' data */
+} InstructionList;
+
+/* THE FUNCTIONS */
+
+void listInit (InstructionList * list);
+        /* Postcondition: list is initialized to indicate that there
+         *       are no instructions in it.
+         */
+
+int addInstruction (InstructionList * list, const Instruction * instruction);
+        /* Postcondition: a copy of instruction has been added to the end
+         *      of the list, which has been resized if necessary, with
+         *      its label operand (if any) interned in the list's labels.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if memory allocation error.
+         */
+
+void listFree (InstructionList * list);
+        /* Postcondition: the memory holding the instructions (and the
+         *      data) has been released and the list is empty.
+         */
+
+int hasLabelOperand (const Instruction * instruction);
+        /* Returns 1 if instruction was parsed and has a label operand
+         *      (so that its label field is used); 0 otherwise.
+         */
+
+#endif
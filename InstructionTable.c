@@ -0,0 +1,40 @@
+/*
+ * Instruction Table: the table of instruction descriptors
+ *
+ * This file defines the table of instruction descriptors, built from
+ * the rows in instructions.def, and the findInstruction function that
+ * looks an instruction name up in it.
+ *
+ * findInstruction does not compare strings.  It packs the name into an
+ * integer key (instructionKey), hashes the key into a slot of the
+ * collision-free hash table generated at build time (instructionHash.h),
+ * and compares the key of the row in that slot with the name's key.  A
+ * lookup therefore costs one multiplication, one table index, and one
+ * integer comparison, however many instructions there are.
+ *
+ */
+
+#include <stddef.h>
+
+#include "InstructionTable.h"
+#include "instructionHash.h"
+
+/* The descriptors, in the order of the rows of instructions.def. */
+#define INSTRUCTION(name, format, opcode, funct, operands) \
+        { name, format, opcode, funct, operands },
+static const InstructionInfo INSTRUCTIONS[] = {
+#include "instructions.def"
+};
+#undef INSTRUCTION
+
+const InstructionInfo * findInstruction (Span name)
+{
+    uint64_t key = instructionKey(name.text, name.length);
+    unsigned slot = (unsigned) ((key * INSTRUCTION_HASH_MULTIPLIER)
+                                >> INSTRUCTION_HASH_SHIFT);
+    int      row = INSTRUCTION_HASH_ROWS[slot];
+
+    if ( row < 0 || INSTRUCTION_KEYS[row] != key )
+        return NULL;
+    return &INSTRUCTIONS[row];
+}
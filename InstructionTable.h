@@ -0,0 +1,66 @@
+/*
+ * Instruction Table: the instructions the assembler understands
+ *
+ * This file provides the data structure for a descriptor of one
+ * instruction (its name, format, opcode, funct code, and the shape of
+ * its operands) and the function that finds the descriptor for an
+ * instruction name.
+ *
+ * The descriptors themselves are listed, one row per instruction, in
+ * instructions.def.  To add an instruction, add a row there; the hash
+ * table that findInstruction uses (instructionHash.h) is generated from
+ * the same rows by makeInstructionHash when the assembler is built.
+ *
+ */
+
+#ifndef _INSTRUCTIONTABLE_H
+#define _INSTRUCTIONTABLE_H
+
+#include <stdint.h>
+
+#include "getToken.h"
+
+/* THE DATA STRUCTURES */
+
+/* The machine instruction format. */
+typedef enum {
+        R_FORMAT,
+        I_FORMAT,
+        J_FORMAT
+} InstructionFormat;
+
+/* The operands an instruction takes, in the order they are written. */
+typedef enum {
+        OPS_RD_RS_RT,           /* add   $rd, $rs, $rt */
+        OPS_RD_RT_SHAMT,        /* sll   $rd, $rt, shamt */
+        OPS_RS,                 /* jr    $rs */
+        OPS_RT_RS_IMM,          /* addi  $rt, $rs, immediate */
+        OPS_RS_RT_LABEL,        /* beq   $rs, $rt, label */
+        OPS_RT_IMM_RS,          /* lw    $rt, immediate($rs) */
+        OPS_RT_IMM,             /* lui   $rt, immediate */
+        OPS_TARGET              /* j     label */
+} OperandShape;
+
+typedef struct {
+        const char *      name;         /* instruction name, e.g. "add" */
+        InstructionFormat format;
+        int               opcode;       /* 6-bit opcode */
+        int               funct;        /* 6-bit funct code (R-Format) */
+        OperandShape      operands;
+} InstructionInfo;
+
+/* THE FUNCTIONS */
+
+const InstructionInfo * findInstruction (Span name);
+        /* Returns the descriptor of the instruction with the given name;
+         *      NULL if there is no such instruction.
+         */
+
+uint64_t instructionKey (const char * name, int length);
+        /* Returns the instruction name packed into an integer (one byte
+         *      per character, first character in the low byte), or 0 if
+         *      the name is empty or longer than 8 characters.  Two names
+         *      are the same exactly when their keys are equal.
+         */
+
+#endif
@@ -14,6 +14,9 @@
  *   Modified:  5/25/2015    Updated to use printError function.
  *   Modified:  1/28/2020    Programming Project: Label Table
  *   Modified:  1/25/2020    Programming Project: Label Table
+ *   Modified:  10/17/2026   Hashed index for findLabel and addLabel.
+ *   Modified:  10/17/2026   Memory from the assembly's arena.
+ *   Modified:  10/17/2026   Resolving the interned labels of a program.
  * 
  * Detailed modifications for modication date - 1/25/2020:
  * 
@@ -21,6 +24,29 @@
  * following the correct documentation and error handling with the 
  * rubric standard for this programming project - Label Table. 
  *
+ * Detailed modifications for modification date - 10/17/2026:
+ *
+ * findLabel used to compare the label against every entry, which made
+ * building the table in pass1 quadratic in the number of labels.  Each
+ * entry now carries a precomputed hash and the table keeps an
+ * open-addressed (linear probing) index of entry positions, kept at most
+ * half full and doubled as needed, so addLabel and findLabel run in
+ * amortized constant time.  The entries array is unchanged, so
+ * printLabels still lists labels in the order they were added.
+ *
+ * A table created while the thread is using an arena (see arena.h) now
+ * takes the copies of its label names, its entries, and its index from
+ * the arena instead of malloc, so that adding a label no longer calls
+ * strndup, and the whole table is released with the assembly's arena
+ * rather than piece by piece.
+ *
+ * pass2 used to look up the label of every branch and jump by name,
+ * hashing and comparing it again for each reference.  tableResolve now
+ * looks up each distinct label of the program once, with the hash its
+ * interner already computed (the table hashes names with the same
+ * hashIdentifier, see interner.h), and findLabelId finds a reference's
+ * address by indexing the result.
+ *
 */
 
 #include "assembler.h"
@@ -30,8 +56,20 @@ static const char * ERROR0 = "Error: label table is a NULL pointer.\n";
 static const char * ERROR1 = "Error: a duplicate label was found.\n";
 static const char * ERROR2 = "Error: cannot allocate space in memory.\n";
 
-// internal function (visible to this file only)
+// where printMessage prints (NULL: stdout, see tableMessagesTo)
+static FILE * messageFile = NULL;
+
+// initial number of slots in the hashed index (must be a power of 2)
+static const int INITIAL_INDEX_CAPACITY = 16;
+
+// internal functions (visible to this file only)
 static int verifyTableExists(LabelTable * table);
+static int sameLabel(const char * entryLabel, const char * label, int length);
+static int findEntry(LabelTable * table, const char * label, int length,
+                     unsigned hash, unsigned long * probes);
+static int indexResize(LabelTable * table, int newCapacity);
+static void indexInsert(LabelTable * table, int entryPos);
+static void printMessage(const char * message);
 
 void tableInit (LabelTable * table)
   /* Postcondition: table is initialized to indicate that there
@@ -47,6 +85,11 @@ void tableInit (LabelTable * table)
         table->nbrLabels = 0;
         table->capacity = 0;
         table->entries = NULL;
+        table->index = NULL;
+        table->indexCapacity = 0;
+        table->arena = arenaInUse ();
+        table->resolved = NULL;
+        table->nbrResolved = 0;
     }
 }
 
@@ -83,20 +126,28 @@ int findLabel (LabelTable * table, char * label)
   /* Returns the address associated with the label; -1 if label is
    *      not in the table or table doesn't exist
    */
+{
+    return findLabelN (table, label, strlen (label));
+}
+
+int findLabelN (LabelTable * table, const char * label, int length)
+  /* Returns the address associated with the first length characters of
+   *      label; -1 if label is not in the table or table doesn't exist
+   */
 {
     if ( ! verifyTableExists(table))
     {
-        printf("\nInvalid table does not exist..\n");
+        printMessage("\nInvalid table does not exist..\n");
         return -1;
     }
-    int num_labels = table->nbrLabels;
-    int i;
-    for (i = 0; i < num_labels; i++)
+    unsigned long probes;
+    int position = findEntry(table, label, length,
+                             hashIdentifier(label, length), &probes);
+    STATS_COUNT(findLabelCalls, 1);
+    STATS_COUNT(labelProbes, probes);
+    if (position >= 0)
     {
-        if (strcmp (table->entries[i].label, label) == SAME)
-        {
-            return table->entries[i].address;
-        }
+        return table->entries[position].address;
     }
 
     /* Will return -1 if label does not exist in table */
@@ -104,6 +155,70 @@ int findLabel (LabelTable * table, char * label)
 }
 
 
+void tableMessagesTo (FILE * fp)
+  /* Postcondition: the messages that are not fatal are printed to fp. */
+{
+    messageFile = fp;
+}
+
+void reportDuplicateLabel (void)
+  /* Postcondition: the message for a duplicate label has been printed,
+   *      as addLabel prints it.
+   */
+{
+    printMessage(ERROR1);
+}
+
+int tableResolve (LabelTable * table, const Interner * labels)
+  /* Postcondition: the address of each label in labels has been looked
+   *      up, once, for findLabelId.
+   * Returns 1 if everything went OK; 0 if memory allocation error.
+   */
+{
+    const Identifier * label;
+    unsigned long probes, totalProbes = 0;
+    int id, position;
+
+    if ( ! verifyTableExists (table) )
+        return 0;
+    if ( table->arena == NULL )
+        free (table->resolved);
+    table->resolved = NULL;
+    table->nbrResolved = 0;
+    if ( labels->nbrIdentifiers == 0 )
+        return 1;
+
+    table->resolved = table->arena != NULL
+                          ? arenaAlloc (table->arena, labels->nbrIdentifiers
+                                                      * sizeof(int))
+                          : malloc (labels->nbrIdentifiers * sizeof(int));
+    if ( table->resolved == NULL )
+        return 0;           /* labels will be looked up by name */
+    for (id = 0; id < labels->nbrIdentifiers; id++)
+    {
+        label = &labels->identifiers[id];
+        position = findEntry (table, label->name.text, label->name.length,
+                              label->hash, &probes);
+        table->resolved[id] = position >= 0
+                                  ? table->entries[position].address : -1;
+        totalProbes += probes;
+    }
+    table->nbrResolved = labels->nbrIdentifiers;
+    STATS_COUNT(findLabelCalls, labels->nbrIdentifiers);
+    STATS_COUNT(labelProbes, totalProbes);
+    return 1;
+}
+
+int findLabelId (LabelTable * table, int id, Span label)
+  /* Returns the address of label, whose id is id: from the addresses
+   *      found by tableResolve, if it has resolved the id.
+   */
+{
+    if ( table != NULL && id >= 0 && id < table->nbrResolved )
+        return table->resolved[id];
+    return findLabelN (table, label.text, label.length);
+}
+
 int addLabel (LabelTable * table, char * label, int progCounter)
   /* Postcondition: if label was already in table, the table is 
    *      unchanged; otherwise a new entry has been added to the 
@@ -112,6 +227,15 @@ int addLabel (LabelTable * table, char * label, int progCounter)
    * Returns 1 if no fatal errors occurred; 0 if memory allocation error
    *      or table doesn't exist.
    */
+{
+    return addLabelN (table, label, strlen (label), progCounter);
+}
+
+int addLabelN (LabelTable * table, const char * label, int length,
+               int progCounter)
+  /* Postcondition: same as addLabel, for the label consisting of the
+   *      first length characters of label.
+   */
 {
     char * labelDuplicate;
     int currentCapacity;
@@ -124,18 +248,23 @@ int addLabel (LabelTable * table, char * label, int progCounter)
     }
 
     /* Was the label already in the table? */
-    if (findLabel(table, label) != -1)
+    unsigned hash = hashIdentifier(label, length);
+    unsigned long probes;
+    if (findEntry(table, label, length, hash, &probes) != -1)
     {
         /* This is an error (ERROR1), but not a fatal one.
             * Report error; don't add the label to the table again. 
             */
-        printf("%s",ERROR1);
+        printMessage(ERROR1);
         return 1;
     }
 
     /* Create a dynamically allocated version of label that will persist. */
-    /*   NOTE: on some machines you may need to make this _strdup !  */
-    if ((labelDuplicate = strdup (label)) == NULL)
+    /*   NOTE: on some machines you may need to make this _strndup !  */
+    labelDuplicate = table->arena != NULL
+                         ? arenaStrndup (table->arena, label, length)
+                         : strndup (label, length);
+    if (labelDuplicate == NULL)
     {
         printError ("%s", ERROR2);
         return 0;           /* fatal error: couldn't allocate memory */
@@ -162,16 +291,56 @@ int addLabel (LabelTable * table, char * label, int progCounter)
 
     }
 
+    /* Grow the index if adding this label would make it over half full. */
+    if ( (table->nbrLabels + 1) * 2 > table->indexCapacity )
+    {
+        newSize = table->indexCapacity <= 0 ? INITIAL_INDEX_CAPACITY
+                                            : table->indexCapacity * 2;
+        if (indexResize(table, newSize) == 0)
+        {
+            return 0;       /* fatal error: couldn't allocate memory */
+        }
+    }
+
     /* Add the label */
     LabelEntry new_entry;
     new_entry.label = labelDuplicate;
     new_entry.address = progCounter;
+    new_entry.hash = hash;
     table->entries[table->nbrLabels] = new_entry;
+    indexInsert(table, table->nbrLabels);
     table->nbrLabels = table->nbrLabels + 1;
     return 1;               /* everything worked great! */
     
 }
 
+void tableFree (LabelTable * table)
+  /* Postcondition: the memory holding the labels has been released and
+   *      the table is empty.
+   */
+{
+    Arena * arena;
+    int     i;
+
+    if ( ! verifyTableExists (table) )
+    {
+        return;           /* fatal error: table doesn't exist */
+    }
+    arena = table->arena;
+    if ( arena == NULL )
+    {
+        for (i = 0; i < table->nbrLabels; i++)
+        {
+            free (table->entries[i].label);
+        }
+        free (table->entries);
+        free (table->index);
+        free (table->resolved);
+    }
+    tableInit (table);
+    table->arena = arena;
+}
+
 int tableResize (LabelTable * table, int newSize)
   /* Postcondition: table now has the capacity to hold newSize
    *      label entries.  If the new size is smaller than the
@@ -183,13 +352,34 @@ int tableResize (LabelTable * table, int newSize)
 {
         LabelEntry * newEntryList;
         int          smaller;
+        int          truncated = table && table->nbrLabels > newSize;
 
         /* verify that table exists */
         if ( ! verifyTableExists (table) )
             return 0;           /* fatal error: table doesn't exist */
 
+        /* In an arena, the entries grow in place if they can. */
+        if ( table->arena != NULL && newSize >= table->capacity )
+        {
+            newEntryList = arenaGrow (table->arena, table->entries,
+                                      table->capacity * sizeof(LabelEntry),
+                                      newSize * sizeof(LabelEntry));
+            if ( newEntryList == NULL )
+            {
+                printError ("%s", ERROR2);
+                return 0;       /* fatal error: couldn't allocate memory */
+            }
+            table->entries = newEntryList;
+            table->capacity = newSize;
+            return 1;
+        }
+
         /* create a new internal table of the specified size */
-        if ((newEntryList = malloc (newSize * sizeof(LabelEntry))) == NULL)
+        newEntryList = table->arena != NULL
+                           ? arenaAlloc (table->arena,
+                                         newSize * sizeof(LabelEntry))
+                           : malloc (newSize * sizeof(LabelEntry));
+        if (newEntryList == NULL)
         {
             printError ("%s", ERROR2);
             return 0;           /* fatal error: couldn't allocate memory */
@@ -203,12 +393,20 @@ int tableResize (LabelTable * table, int newSize)
                            smaller * sizeof(LabelEntry));
 
             /* free the space taken up by the old internal table */
-            free (table->entries);
+            if ( table->arena == NULL )
+                free (table->entries);
+            else
+                arenaDiscard (table->arena, table->entries,
+                              table->capacity * sizeof(LabelEntry));
             table->nbrLabels = smaller;
         }
 
         table->entries = newEntryList;
         table->capacity = newSize;
+
+        /* Truncated entries must not stay reachable through the index. */
+        if ( table->index && truncated )
+            return indexResize (table, table->indexCapacity);
         return 1;
 }
 
@@ -226,3 +424,123 @@ static int verifyTableExists(LabelTable * table)
 
         return 1;
 }
+
+static void printMessage(const char * message)
+ /* Prints a message that is not fatal to standard output, as always (or
+  * to the file set with tableMessagesTo); but if the calling thread is
+  * holding its error messages (e.g., in the library, see libassembler.h),
+  * holds it with them instead.
+  */
+{
+        if ( errors_are_held () )
+            printError ("%s", message);
+        else
+            fprintf (messageFile != NULL ? messageFile : stdout, "%s",
+                     message);
+}
+
+static int sameLabel(const char * entryLabel, const char * label, int length)
+ /* Returns true if entryLabel (a string) is the first length characters
+  * of label.
+  */
+{
+        return strncmp (entryLabel, label, length) == SAME &&
+               entryLabel[length] == '\0';
+}
+
+static int findEntry(LabelTable * table, const char * label, int length,
+                     unsigned hash, unsigned long * probes)
+ /* Returns the position of label (its first length characters) in
+  * table->entries, or -1 if it is not there.  Uses the hashed index if
+  * the table has one; otherwise falls back to comparing against every
+  * entry.  Sets *probes to the number of entries or slots examined.
+  */
+{
+        int i;
+        int mask;
+        unsigned long count = 0;
+
+        if ( table->index == NULL )
+        {
+            for (i = 0; i < table->nbrLabels; i++)
+            {
+                count++;
+                if (sameLabel (table->entries[i].label, label, length))
+                    break;
+            }
+            *probes = count;
+            return i < table->nbrLabels ? i : -1;
+        }
+
+        /* Probe successive slots until the label or an empty slot is found. */
+        mask = table->indexCapacity - 1;
+        for (i = hash & mask; table->index[i] != -1; i = (i + 1) & mask)
+        {
+            LabelEntry * entry = &table->entries[table->index[i]];
+            count++;
+            if ( entry->hash == hash && sameLabel (entry->label, label, length) )
+            {
+                *probes = count;
+                return table->index[i];
+            }
+        }
+        *probes = count + 1;        /* the empty slot */
+        return -1;
+}
+
+static int indexResize(LabelTable * table, int newCapacity)
+ /* Postcondition: the index has newCapacity slots (a power of 2) and
+  *      holds every entry currently in the table.  Entries that were
+  *      added without an index (e.g., a table built by hand) get their
+  *      hashes computed here.
+  * Returns 1 if everything went OK; 0 if memory allocation error.
+  */
+{
+        int * newIndex;
+        int   hadIndex = table->index != NULL;
+        int   i;
+
+        newIndex = table->arena != NULL
+                       ? arenaAlloc (table->arena, newCapacity * sizeof(int))
+                       : malloc (newCapacity * sizeof(int));
+        if (newIndex == NULL)
+        {
+            printError ("%s", ERROR2);
+            return 0;           /* fatal error: couldn't allocate memory */
+        }
+        for (i = 0; i < newCapacity; i++)
+            newIndex[i] = -1;
+
+        if ( table->arena == NULL )
+            free (table->index);
+        else
+            arenaDiscard (table->arena, table->index,
+                          table->indexCapacity * sizeof(int));
+        table->index = newIndex;
+        table->indexCapacity = newCapacity;
+
+        /* Re-insert existing entries, reusing their stored hashes. */
+        for (i = 0; i < table->nbrLabels; i++)
+        {
+            if ( ! hadIndex )
+                table->entries[i].hash =
+                    hashIdentifier (table->entries[i].label,
+                                    strlen (table->entries[i].label));
+            indexInsert (table, i);
+        }
+        return 1;
+}
+
+static void indexInsert(LabelTable * table, int entryPos)
+ /* Precondition: the index has at least one empty slot.
+  * Postcondition: the entry at entryPos can be found through the index.
+  */
+{
+        int mask = table->indexCapacity - 1;
+        int i;
+
+        for (i = table->entries[entryPos].hash & mask; table->index[i] != -1;
+             i = (i + 1) & mask)
+            ;
+        table->index[i] = entryPos;
+}
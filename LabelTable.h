@@ -10,12 +10,20 @@
  *
  * Creation Date:   2/16/99
  *   Modified:  12/20/2000   Updated postcondition information.
+ *   Modified:  10/17/2026   Added a hashed index for constant-time lookup.
+ *   Modified:  10/17/2026   Tables may take their memory from an arena.
+ *   Modified:  10/17/2026   Labels resolved once per interned id.
  *
 */
 
 #ifndef LABEL_H
 #define LABEL_H
 
+#include <stdio.h>
+
+#include "arena.h"
+#include "interner.h"
+
 /* THE DATA STRUCTURES */
 
 /* The first type definition defines the type for a single entry in the
@@ -25,12 +33,30 @@
 typedef struct {
         char * label;           /* label name */
         int   address;           /* address of label */
+        unsigned hash;          /* precomputed hash of the label name */
 } LabelEntry;
 
+/* The entries array keeps labels in the order they were added (which is
+ * the order printLabels uses).  The index is an open-addressed hash
+ * table of positions in entries; an empty slot holds -1.  A table whose
+ * index is NULL (e.g., one built by hand around a static entries array)
+ * is searched linearly instead.  The label names, entries, and index of
+ * a table with an arena are allocated from the arena, and released with
+ * it (see arena.h).  Once all the labels are in the table, tableResolve
+ * can look up the address of each label of a program, by id (see
+ * interner.h), so that findLabelId finds them without any lookup.
+ */
 typedef struct {
         int capacity;           /* capacity of the table */
         int nbrLabels;          /* actual nbr of entries in table */
         LabelEntry * entries;
+        int * index;            /* hash slots holding entry positions */
+        int indexCapacity;      /* nbr of slots in index (power of 2) */
+        Arena * arena;          /* where its memory comes from (NULL:
+                                 * malloc) */
+        int * resolved;         /* address of each label id (-1: not in
+                                 * the table); NULL if not resolved */
+        int nbrResolved;        /* nbr of ids in resolved */
 } LabelTable;
 
 
@@ -38,7 +64,17 @@ typedef struct {
 
 void tableInit  (LabelTable * table);
         /* Postcondition: table is initialized to indicate that there
-         *       are no label entries in it.
+         *       are no label entries in it, and allocates its memory
+         *       from the calling thread's arena, if it has one (see
+         *       arenaUse).
+         */
+
+void tableFree  (LabelTable * table);
+        /* Postcondition: the memory holding the entries (including the
+         *      label names) has been released and the table is empty.
+         *      Only for tables built with addLabel/addLabelN.  The
+         *      memory of a table with an arena is only released with
+         *      the arena.
          */
 
 int tableResize (LabelTable * table, int newSize);
@@ -64,6 +100,42 @@ int findLabel (LabelTable * table, char * label);
          *      not in the table or if table doesn't exist
          */
 
+int addLabelN   (LabelTable * table, const char * labelName, int length,
+                 int progCounter);
+int findLabelN  (LabelTable * table, const char * label, int length);
+        /* Same as addLabel and findLabel, but the label consists of the
+         *      first length characters of labelName/label, which need
+         *      not be null-terminated.
+         */
+
+void tableMessagesTo (FILE * fp);
+        /* Postcondition: the messages about duplicate labels (which are
+         *      not fatal), printed to the standard output by default,
+         *      are printed to fp instead, unless the calling thread is
+         *      holding its error messages.
+         */
+
+void reportDuplicateLabel (void);
+        /* Postcondition: the message addLabel prints for a label that is
+         *      already in the table has been printed, in the same way
+         *      (for a duplicate found without adding it to a table).
+         */
+
+int tableResolve (LabelTable * table, const Interner * labels);
+        /* Postcondition: the address of each label in labels has been
+         *      looked up, once, for findLabelId.  (Labels added to the
+         *      table afterwards are not seen by findLabelId.)
+         * Returns 1 if everything went OK; 0 if memory allocation error
+         *      (findLabelId then looks labels up by name).
+         */
+
+int findLabelId (LabelTable * table, int id, Span label);
+        /* Precondition: id is the id of label in the labels the table
+         *      was resolved with, or -1.
+         * Returns the same as findLabelN for label, from the addresses
+         *      found by tableResolve if it can (otherwise by name).
+         */
+
 void printLabels (LabelTable * table);
         /* Postcondition: all the labels in the table, with their
          *      associated addresses, have been printed to the standard
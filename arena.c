@@ -0,0 +1,249 @@
+/*
+ * Arena: memory for one assembly, released all at once
+ *
+ * This file provides the definitions of the functions declared in
+ * arena.h.  Each block starts with an ArenaBlock header linking it to the
+ * block before it.  Allocations are taken from the current block; one
+ * that does not fit in what is left of it starts a new current block.
+ * A big allocation (more than a quarter of a block) gets a block of its
+ * own instead, put behind the current block so that the space left in
+ * the current block is not wasted; since nothing else is in its block,
+ * the block can be released as soon as the allocation is discarded.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+struct ArenaBlock {
+        ArenaBlock * older;     /* the block allocated before this one */
+        size_t       size;      /* bytes after the header */
+};
+
+/* Smallest allocation that gets a block of its own. */
+#define BIG_SIZE        (ARENA_BLOCK_SIZE / 4 + 1)
+
+/* Alignment of arenaAlloc's memory, and size of a block's header. */
+#define ALIGNMENT       _Alignof(max_align_t)
+#define HEADER_SIZE     ((sizeof(ArenaBlock) + ALIGNMENT - 1) & \
+                         ~(ALIGNMENT - 1))
+
+/* The arena each thread is using; NULL: none (see arenaUse). */
+static _Thread_local Arena * current = NULL;
+
+static void * allocate (Arena * arena, size_t size, size_t alignment);
+static void * allocateBlock (Arena * arena, size_t size);
+static char * blockData (ArenaBlock * block);
+static void * defaultAllocate (void * context, size_t size);
+static void   defaultRelease (void * context, void * block);
+
+void arenaInit (Arena * arena, const ArenaAllocator * allocator)
+{
+    static const ArenaAllocator MALLOC = { defaultAllocate, defaultRelease,
+                                           NULL };
+
+    arena->blocks = NULL;
+    arena->next = arena->end = arena->last = NULL;
+    arena->size = 0;
+    arena->allocator = allocator != NULL ? *allocator : MALLOC;
+}
+
+void * arenaAlloc (Arena * arena, size_t size)
+{
+    return allocate (arena, size, ALIGNMENT);
+}
+
+void * arenaGrow (Arena * arena, void * memory, size_t oldSize,
+                  size_t newSize)
+{
+    void * newMemory;
+
+    /* The last allocation can grow into the rest of its block, unless
+     * it would become big: arenaDiscard takes a big allocation to be
+     * alone in its block, which this one, sharing its block with what
+     * comes after it, is not.
+     */
+    if ( memory != NULL && memory == arena->last && newSize < BIG_SIZE &&
+         (size_t) (arena->end - arena->last) >= newSize )
+    {
+        arena->next = arena->last + newSize;
+        return memory;
+    }
+    if ( (newMemory = arenaAlloc (arena, newSize)) != NULL && oldSize > 0 )
+    {
+        memcpy (newMemory, memory, oldSize);
+        arenaDiscard (arena, memory, oldSize);
+    }
+    return newMemory;
+}
+
+void arenaDiscard (Arena * arena, void * memory, size_t size)
+{
+    ArenaBlock ** link;
+    ArenaBlock *  block;
+
+    if ( memory == NULL )
+        return;
+    if ( size < BIG_SIZE )
+    {
+        if ( memory == arena->last && arena->last + size == arena->next )
+        {
+            arena->next = arena->last;
+            arena->last = NULL;
+        }
+        return;
+    }
+
+    /* Unlink the big allocation's block and release it. */
+    for ( link = &arena->blocks; (block = *link) != NULL;
+          link = &block->older )
+    {
+        if ( blockData (block) == memory )
+        {
+            if ( block == arena->blocks )
+                arena->next = arena->end = arena->last = NULL;
+            *link = block->older;
+            arena->size -= block->size + HEADER_SIZE;
+            arena->allocator.release (arena->allocator.context, block);
+            return;
+        }
+    }
+}
+
+char * arenaStrndup (Arena * arena, const char * text, size_t length)
+{
+    char * copy = allocate (arena, length + 1, 1);
+
+    if ( copy != NULL )
+    {
+        memcpy (copy, text, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+void arenaReset (Arena * arena)
+{
+    ArenaBlock * block = arena->blocks;
+    ArenaBlock * older;
+
+    if ( block == NULL )
+        return;
+    while ( block->older != NULL )
+    {
+        older = block->older;
+        arena->size -= block->size + HEADER_SIZE;
+        arena->allocator.release (arena->allocator.context, block);
+        block = older;
+    }
+    arena->blocks = block;
+    arena->next = blockData (block);
+    arena->end = arena->next + block->size;
+    arena->last = NULL;
+}
+
+void arenaFree (Arena * arena)
+{
+    arenaReset (arena);
+    if ( arena->blocks != NULL )
+        arena->allocator.release (arena->allocator.context, arena->blocks);
+    arena->blocks = NULL;
+    arena->next = arena->end = arena->last = NULL;
+    arena->size = 0;
+}
+
+Arena * arenaUse (Arena * arena)
+{
+    Arena * previous = current;
+
+    current = arena;
+    return previous;
+}
+
+Arena * arenaInUse (void)
+{
+    return current;
+}
+
+/*
+ * Returns size bytes of memory from arena, aligned to alignment (a power
+ * of 2 no bigger than ALIGNMENT), or NULL if memory allocation error.
+ */
+static void * allocate (Arena * arena, size_t size, size_t alignment)
+{
+    uintptr_t start = ((uintptr_t) arena->next + alignment - 1) &
+                      ~(uintptr_t) (alignment - 1);
+    char *    memory;
+
+    if ( size < BIG_SIZE && arena->next != NULL &&
+         start <= (uintptr_t) arena->end &&
+         size <= (size_t) ((uintptr_t) arena->end - start) )
+    {
+        memory = (char *) start;
+    }
+    else if ( (memory = allocateBlock (arena, size)) == NULL ||
+              memory != arena->next )
+    {
+        return memory;      /* NULL, or a big allocation's own block */
+    }
+    arena->last = memory;
+    arena->next = memory + size;
+    return memory;
+}
+
+/*
+ * Adds a block to arena with room for size bytes: a block of its own,
+ * behind the current one, if size is big; otherwise a new current block.
+ * Returns the start of the block's data, or NULL if memory allocation
+ * error.
+ */
+static void * allocateBlock (Arena * arena, size_t size)
+{
+    int          big = size >= BIG_SIZE;
+    size_t       blockSize = big ? size : ARENA_BLOCK_SIZE;
+    ArenaBlock * block;
+
+    if ( blockSize > SIZE_MAX - HEADER_SIZE ||
+         (block = arena->allocator.allocate (arena->allocator.context,
+                                             HEADER_SIZE + blockSize))
+         == NULL )
+        return NULL;
+    block->size = blockSize;
+    arena->size += HEADER_SIZE + blockSize;
+
+    if ( big && arena->blocks != NULL )
+    {
+        block->older = arena->blocks->older;
+        arena->blocks->older = block;
+        return blockData (block);
+    }
+    block->older = arena->blocks;
+    arena->blocks = block;
+    arena->next = blockData (block);
+    arena->end = arena->next + blockSize;
+    arena->last = NULL;
+    return arena->next;
+}
+
+/*
+ * Returns the start of the memory in block, after its header.
+ */
+static char * blockData (ArenaBlock * block)
+{
+    return (char *) block + HEADER_SIZE;
+}
+
+static void * defaultAllocate (void * context, size_t size)
+{
+    (void) context;
+    return malloc (size);
+}
+
+static void defaultRelease (void * context, void * block)
+{
+    (void) context;
+    free (block);
+}
@@ -0,0 +1,117 @@
+/*
+ * Arena: memory for one assembly, released all at once
+ *
+ * An Arena hands out memory from large blocks by moving a pointer along
+ * the current block, and never frees a piece on its own: everything
+ * allocated from it is released together by arenaFree (or kept for the
+ * next assembly by arenaReset).  This suits memory that lives exactly as
+ * long as one assembly, like the label table: the label names, the
+ * entries, and the hashed index all come from the assembly's arena (see
+ * tableInit), so adding a label costs no malloc, and the table no longer
+ * has to be taken apart to be released.
+ *
+ * The arena gets its blocks from an ArenaAllocator, malloc and free by
+ * default; a program using the library may supply its own (see
+ * assemblerSetAllocator in libassembler.h).  A block is ARENA_BLOCK_SIZE
+ * bytes, except that a big allocation (over a quarter of that) gets a
+ * block of its own, which can be released early with arenaDiscard (or
+ * arenaGrow), so that a table that doubles does not keep its old copies
+ * until the end.  The memory an assembly takes is therefore what it
+ * allocates and has not discarded, plus less than one block, plus less
+ * than a quarter of a block for each small allocation that was grown.
+ *
+ * Each thread has an arena in use, chosen with arenaUse (none at first),
+ * like the collector of diagnostics.h: label tables created by the
+ * thread allocate from it.  A table created while the thread has no
+ * arena allocates its memory with malloc, as it always did.
+ *
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/* Size of an arena's blocks, in bytes. */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Where an arena gets its blocks: allocate returns a block of size bytes
+ * (NULL if there is no memory) and release gives one back; context is
+ * passed to both.
+ */
+typedef struct {
+        void * (*allocate) (void * context, size_t size);
+        void   (*release) (void * context, void * block);
+        void *  context;
+} ArenaAllocator;
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+        ArenaBlock *   blocks;  /* the current block, then older ones */
+        char *         next;    /* first free byte of the current block */
+        char *         end;     /* end of the current block */
+        char *         last;    /* most recent allocation in the current
+                                 * block (see arenaGrow) */
+        size_t         size;    /* bytes in all the blocks */
+        ArenaAllocator allocator;
+} Arena;
+
+void arenaInit (Arena * arena, const ArenaAllocator * allocator);
+        /* Postcondition: arena is empty and gets its blocks from
+         *      allocator (malloc and free if allocator is NULL).
+         */
+
+void * arenaAlloc (Arena * arena, size_t size);
+        /* Returns size bytes of memory from arena, aligned for any type,
+         *      or NULL if memory allocation error.
+         */
+
+void * arenaGrow (Arena * arena, void * memory, size_t oldSize,
+                  size_t newSize);
+        /* Precondition: memory is the oldSize bytes most recently
+         *      returned for it by arenaAlloc or arenaGrow (or NULL if
+         *      oldSize is 0), and newSize >= oldSize.
+         * Returns newSize bytes of memory from arena starting with the
+         *      oldSize bytes at memory (which is extended in place if it
+         *      was the arena's last allocation, there is room, and
+         *      newSize is not big, and is otherwise discarded, see
+         *      arenaDiscard), or NULL if memory allocation error (memory
+         *      is then unchanged).
+         */
+
+void arenaDiscard (Arena * arena, void * memory, size_t size);
+        /* Precondition: memory is the size bytes returned by arenaAlloc
+         *      or arenaGrow, and is no longer used.
+         * Postcondition: if it was a big allocation, its block has been
+         *      released; if it was the arena's last allocation, its
+         *      space will be reused.  (Otherwise it is only released
+         *      with the arena.)
+         */
+
+char * arenaStrndup (Arena * arena, const char * text, size_t length);
+        /* Returns a null-terminated copy of the first length characters
+         *      of text, in arena, or NULL if memory allocation error.
+         */
+
+void arenaReset (Arena * arena);
+        /* Postcondition: everything allocated from arena has been
+         *      released, but its oldest block is kept for reuse.
+         */
+
+void arenaFree (Arena * arena);
+        /* Postcondition: everything allocated from arena has been
+         *      released, and it is empty.
+         */
+
+Arena * arenaUse (Arena * arena);
+        /* Postcondition: the label tables the calling thread creates
+         *      from now on allocate from arena (with malloc if NULL).
+         * Returns the arena the thread was using, so that it can be
+         *      restored.
+         */
+
+Arena * arenaInUse (void);
+        /* Returns the arena the calling thread is using, or NULL. */
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * asmclient: the assembler, as a client of the assembler daemon
+ *
+ * asmclient takes the same command line as the assembler and prints the
+ * same machine code, messages, and errors, with the same exit status,
+ * but has the program assembled by a daemon that is already running
+ * ("assembler --serve=SOCKET", see server.h), so that a program that
+ * assembles many small snippets does not start an assembler for each.
+ * The daemon is the one listening on the Unix domain socket named by the
+ * ASSEMBLER_SOCKET environment variable.
+ *
+ * The program is sent to the daemon as a request (see request.h), and
+ * the daemon's reply holds the machine words, which asmclient writes in
+ * the output format chosen with -f, and the messages, which it prints
+ * as they are.  If ASSEMBLER_SOCKET is not set, or no daemon answers on
+ * it, asmclient makes the same reply itself with assembleRequest, so it
+ * works the same with or without a daemon.
+ *
+ * The program is always assembled as by pass1 and pass2, so options
+ * that only change how the assembler works (--one-pass, --pipeline, -j,
+ * --incremental, --cache, --stats) are accepted but have no effect
+ * (so messages about duplicate labels always come before the machine
+ * code, even with --one-pass; see singlePass.c).  Debugging messages
+ * are not printed, and -o (assembling many files) and -c (object files)
+ * are not supported.
+ *
+ * USAGE:
+ *      ASSEMBLER_SOCKET=socket asmclient [options] [filename] [0|1]
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "request.h"
+
+/* The output of the program, as the assembler writes it. */
+static OutputFile output;
+
+static int askDaemon (const char * socketPath, const RequestHeader * request,
+                      const char * text, Reply * reply);
+static int sendAll (int fd, const void * data, size_t length);
+static int receiveAll (int fd, void * data, size_t length);
+static int printReply (const Reply * reply);
+
+int main (int argc, char * argv[])
+{
+    FILE *        fptr;
+    SourceFile    source;
+    RequestHeader request;
+    Reply         reply;
+    const char *  socketPath;
+    int           status;
+
+    if ( (fptr = process_arguments(argc, argv)) == NULL )
+        return 1;   /* Fatal error when processing arguments */
+    if ( OPTIONS.outputDir != NULL || OPTIONS.object )
+    {
+        printError("Error: %s cannot assemble files with %s.\n", argv[0],
+                   OPTIONS.object ? "-c" : "-o");
+        return 1;
+    }
+    if ( ! sourceOpen(&source, fptr) )
+    {
+        (void) fclose(fptr);
+        return 1;   /* Fatal error when reading the input */
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.magic = REQUEST_MAGIC;
+    request.errorLimit = ERROR_LIMIT;
+    request.diagFormat = OPTIONS.diagFormat;
+    request.length = source.length;
+    replyInit(&reply);
+
+    // Ask the daemon, if there is one; otherwise assemble it here
+    socketPath = getenv("ASSEMBLER_SOCKET");
+    if ( (socketPath == NULL ||
+          ! askDaemon(socketPath, &request, source.text, &reply)) &&
+         ! assembleRequest(&request, source.text, &reply) )
+    {
+        printError("Error: cannot allocate space in memory.\n");
+        status = 1;
+    }
+    else
+        status = printReply(&reply);
+
+    replyFree(&reply);
+    sourceClose(&source);
+    (void) fclose(fptr);
+    return status;
+}
+
+/*
+ * Sends the request and the text of the program to the daemon listening
+ * on socketPath, and receives its reply in reply.
+ * Returns 1 if everything went OK; 0 if there is no daemon or the reply
+ * did not come.
+ */
+static int askDaemon (const char * socketPath, const RequestHeader * request,
+                      const char * text, Reply * reply)
+{
+    struct sockaddr_un address;
+    ReplyHeader        header;
+    size_t             length;
+    int                fd, ok;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if ( strlen(socketPath) >= sizeof(address.sun_path) ||
+         (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 )
+        return 0;
+    strcpy(address.sun_path, socketPath);
+
+    ok = connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0 &&
+         sendAll(fd, request, sizeof(*request)) &&
+         sendAll(fd, text, (size_t) request->length) &&
+         receiveAll(fd, &header, sizeof(header)) &&
+         header.magic == REPLY_MAGIC &&
+         (length = replyLength(&header)) > 0 &&
+         replyReserve(reply, length);
+    if ( ok )
+    {
+        memcpy(reply->data, &header, sizeof(header));
+        reply->length = length;
+        ok = receiveAll(fd, reply->data + sizeof(header),
+                        length - sizeof(header));
+    }
+    (void) close(fd);
+    return ok;
+}
+
+/*
+ * Writes length bytes of data to the socket fd.
+ * Returns 1 if everything went OK; 0 otherwise.
+ */
+static int sendAll (int fd, const void * data, size_t length)
+{
+    const char * next = data;
+    ssize_t      n;
+
+    while ( length > 0 )
+    {
+        if ( (n = send(fd, next, length, MSG_NOSIGNAL)) <= 0 )
+            return 0;
+        next += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+/*
+ * Reads length bytes from the socket fd into data.
+ * Returns 1 if everything went OK; 0 otherwise.
+ */
+static int receiveAll (int fd, void * data, size_t length)
+{
+    char *  next = data;
+    ssize_t n;
+
+    while ( length > 0 )
+    {
+        if ( (n = recv(fd, next, length, 0)) <= 0 )
+            return 0;
+        next += n;
+        length -= (size_t) n;
+    }
+    return 1;
+}
+
+/*
+ * Prints what the reply holds as the assembler would print it: the
+ * messages to stdout (to stderr, unless the output format is ascii),
+ * then the machine words in the output format, with
+ * the errors printed to stderr before the last of the machine code is
+ * written.
+ * Returns the exit status of the assembler: 0 if everything went OK; 1
+ * if the output could not be written or there were too many errors.
+ */
+static int printReply (const Reply * reply)
+{
+    ReplyHeader  header;
+    EncodedWord  encoded;
+    const char * words = reply->data + sizeof(header);
+    const char * messages;
+    const char * errors;
+    uint64_t     i;
+    int          written;
+
+    memcpy(&header, reply->data, sizeof(header));
+    messages = words + header.nbrWords * sizeof(EncodedWord);
+    errors = messages + header.messagesLength;
+    (void) fwrite(messages, 1, (size_t) header.messagesLength,
+                  OPTIONS.format == FORMAT_ASCII ? stdout : stderr);
+
+    outputOpen(&output, stdout, OPTIONS.format);
+    for ( i = 0; i < header.nbrWords; i++ )
+    {
+        memcpy(&encoded, words + i * sizeof(encoded), sizeof(encoded));
+        if ( ! outputWord(&output, encoded.address, encoded.word) )
+            break;      /* error message already printed */
+    }
+    (void) fwrite(errors, 1, (size_t) header.errorsLength, stderr);
+    (void) fflush(stderr);
+
+    written = outputClose(&output);
+    return written && ! header.tooManyErrors ? 0 : 1;
+}
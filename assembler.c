@@ -4,16 +4,77 @@
  * The purpose of this program is to process assembly language to 
  * machine language. It is a compiler (assembler).
  * 
- * IMPORTANT: Please avoid using standard input to pass instructions to this 
- * function. Pass in a file that contains assembly language instructions.
- * 
- * The main(...) function processes instructions using the two pass 
+ * The main(...) function reads the whole file/stdin into memory (a file is
+ * memory-mapped; see sourceFile.h) and processes instructions using the two pass 
  * functions: pass1 and pass2. The pass1 function will read the file/stdin
- * and put associated labels into a label table, thus returning the label table.
- * If no labels are present the function will return an empty label table. The 
- * pass2 function will read the same file and take each instruction of that file, 
- * format it into its specific type and print either the machine code for the given
- * instruction or print the corresponding error. 
+ * and put associated labels into a label table, thus returning the label table,
+ * and parse each instruction into a list of fixed-size records (see
+ * InstructionList.h). If no labels are present the function will return an
+ * empty label table. The pass2 function will take each parsed instruction,
+ * format it into its specific type and output either the machine code for the
+ * given instruction or print the corresponding error. 
+ * 
+ * The label table is allocated from an arena that belongs to the
+ * assembly and is released in one call when it is finished (see
+ * arena.h).
+ * 
+ * The machine code is collected in an output buffer and written to stdout
+ * in large blocks, in the format chosen with the -f option (see
+ * outputFile.h); by default, as 32 ASCII binary digits per instruction.
+ * 
+ * With the -j option, pass1's work is done by parallelPass1, which parses
+ * chunks of the input on several threads, and pass2's by parallelPass2,
+ * which encodes the instructions on several threads; the label table,
+ * the output, and the errors are exactly the same.
+ * 
+ * When the --one-pass option is given, main(...) calls singlePass instead,
+ * which reads the input once and resolves labels that are used before they
+ * are defined by patching the affected instructions.  With --pipeline,
+ * singlePass also runs between a reader thread that reads the input in
+ * blocks and a writer thread that writes the machine code (see
+ * sourceFile.h and outputFile.h), so the three overlap; this is not done
+ * while debugging, to keep the messages in order.
+ * 
+ * With --incremental=FILE, main(...) calls incrementalAssemble instead,
+ * which reassembles only what has changed since the assembly whose state
+ * it kept in FILE, and writes the same output as pass1 and pass2 (see
+ * incremental.h).  This is not done while debugging.
+ * 
+ * With --cache=DIR, main(...) first looks in the cache directory DIR for
+ * the output of the same input assembled with the same options; if it
+ * is there, it is copied to stdout and stderr and nothing is assembled.
+ * Otherwise everything written to stdout and stderr is captured while
+ * the input is assembled as usual, and added to the cache at the end
+ * (see cache.h).  The cache is not used while debugging, and the input
+ * is read in full before assembling, even with --pipeline.
+ * 
+ * With --serve=SOCKET, main(...) does not assemble its input, but runs
+ * as a daemon that assembles the programs sent to it by asmclient on
+ * the Unix domain socket SOCKET, until it is stopped (see server.h).
+ * 
+ * With -c, main(...) writes a relocatable object file of the input
+ * instead of machine code, from what pass1 finds, to be linked with the
+ * objects of other programs (see objectFile.h); --one-pass, --pipeline,
+ * and --incremental are then ignored.
+ * 
+ * With -o DIR, main(...) assembles all the files named on the command
+ * line into the directory DIR, in parallel, instead of one input to
+ * stdout (see batch.h).
+ * 
+ * With --stats, a report of the time taken by each phase and of counts
+ * such as lines, instructions, and label lookups is printed to stderr at
+ * exit (see stats.h).
+ * 
+ * The errors in the program are collected while it is assembled and
+ * printed to stderr together at the end, sorted by line, before the
+ * last of the machine code is written (see diagnostics.h); with
+ * --diag-format=json they are printed as JSON.  Once ERROR_LIMIT errors
+ * have been collected, the rest are only counted, and the program exits
+ * with status 1 after assembling the whole input.  While debugging, the
+ * errors are printed when they are found instead (unless they are
+ * printed as JSON), to keep them next to the debugging messages, and
+ * printError stops the program after ERROR_LIMIT errors as it always
+ * did.
  * 
  * You can find a detailed description of the functions used in this file in their
  * corresponding files.
@@ -27,6 +88,31 @@
  */
 
 #include "assembler.h"
+#include "batch.h"
+#include "cache.h"
+#include "incremental.h"
+#include "objectFile.h"
+#include "server.h"
+
+/* The machine code waiting to be written (see outputFile.h).  It is
+ * also written if printError ends the program early (see writeOutput).
+ */
+static OutputFile output;
+
+/* The errors found so far, and whether they are being collected. */
+static Diagnostics diagnostics;
+static int collecting = 0;
+
+/* The memory of the label table (see arena.h). */
+static Arena arena;
+
+/* The cache the output is being added to, if caching is 1. */
+static Cache cache;
+static int caching = 0;
+
+static int finish(void);
+static int reportErrors(void);
+static void writeOutput(void);
 
 /**
  *  Main for the assembler program, used to process Assembly Language into its
@@ -43,7 +129,12 @@
 int main (int argc, char * argv[])
 {
     FILE * fptr;               /* file pointer */
+    SourceFile source;         /* contents of the file */
+    InstructionList program;   /* the instructions, parsed by pass1 */
     LabelTable table;
+    int pipeline;              /* 1 if reading and writing on threads */
+    int options[5];            /* the options that affect the output */
+    int status;
 
     /* Process command-line arguments (if any) -- input file name
      *    and/or debugging indicator (1 = on; 0 = off).
@@ -53,9 +144,124 @@ int main (int argc, char * argv[])
     {
         return 1;   /* Fatal error when processing arguments */
     }
+    if ( OPTIONS.serveSocket != NULL )
+    {
+        (void) fclose(fptr);
+        return serve(OPTIONS.serveSocket, OPTIONS.jobs);
+    }
+    if ( OPTIONS.outputDir != NULL )
+    {
+        return assembleBatch(OPTIONS.inputs, OPTIONS.nbrInputs,
+                             OPTIONS.outputDir, OPTIONS.jobs);
+    }
+
+    // The messages about duplicate labels are printed to stdout before the
+    // machine code only in the ascii format; in an image or an object file
+    // they would be taken for part of it, so they go to stderr instead
+    if ( OPTIONS.object || OPTIONS.format != FORMAT_ASCII )
+    {
+        tableMessagesTo(stderr);
+    }
+
+    // Read the whole file (or stdin) once; both passes work on this copy.
+    // With --pipeline, a reader thread streams it to singlePass instead.
+    pipeline = OPTIONS.pipeline && OPTIONS.stateFile == NULL &&
+               OPTIONS.cacheDir == NULL && ! OPTIONS.object &&
+               ! debug_is_on();
+    if ( ! (pipeline ? sourceOpenStream(&source, fptr)
+                     : sourceOpen(&source, fptr)) )
+    {
+        (void) fclose(fptr);
+        return 1;   /* Fatal error when reading the input */
+    }
 
-    // Call pass1 to generate the label table, if labels exists in the file/stdin
-    table = pass1(fptr);    // Returns an empty label table if no labels exist
+    // If the cache has the output for this input, there is nothing to do;
+    // if not, the output is captured to be added to it
+    if ( OPTIONS.cacheDir != NULL && ! debug_is_on() )
+    {
+        options[0] = OPTIONS.format;
+        options[1] = OPTIONS.diagFormat;
+        options[2] = ERROR_LIMIT;
+        options[3] = OPTIONS.onePass && OPTIONS.stateFile == NULL;
+        options[4] = OPTIONS.object;
+        switch ( cacheLookup(&cache, OPTIONS.cacheDir,
+                             OPTIONS.cacheSize > 0
+                                 ? OPTIONS.cacheSize
+                                 : (size_t) CACHE_DEFAULT_SIZE << 20,
+                             source.text, source.length, options,
+                             sizeof(options), &status) )
+        {
+            case CACHE_HIT:
+                sourceClose(&source);
+                (void) fclose(fptr);
+                return status;
+            case CACHE_MISS:
+                caching = 1;
+                break;
+            case CACHE_UNUSED:
+                break;
+        }
+    }
+
+    arenaInit(&arena, NULL);
+    (void) arenaUse(&arena);
+    // (an object is written as raw bytes, with no header or trailer)
+    outputOpen(&output, stdout, OPTIONS.object ? FORMAT_RAW_BE
+                                               : OPTIONS.format);
+    (void) atexit(writeOutput);
+    if ( OPTIONS.diagFormat == DIAG_JSON || ! debug_is_on() )
+    {
+        diagInit(&diagnostics, ERROR_LIMIT);
+        diagCollect(&diagnostics);
+        collecting = 1;
+    }
+    if ( pipeline && ! outputStartWriter(&output) )
+    {
+        sourceClose(&source);
+        (void) fclose(fptr);
+        return 1;   /* Fatal error when starting the writer */
+    }
+
+    if ( OPTIONS.stateFile != NULL && ! OPTIONS.object && ! debug_is_on() )
+    {
+        IncrementalState state;
+
+        (void) stateLoad(&state, OPTIONS.stateFile);
+        incrementalAssemble(&source, &state, &output);
+        (void) stateSave(&state, OPTIONS.stateFile);
+        stateFree(&state);
+        sourceClose(&source);
+        (void) fclose(fptr);
+        return finish();
+    }
+
+    if ( OPTIONS.onePass && ! OPTIONS.object )
+    {
+        statsStart(STATS_SINGLE_PASS);
+        table = singlePass(&source, &output);
+        statsStop(STATS_SINGLE_PASS);
+        if ( debug_is_on() )
+        {
+            printLabels (&table);
+        }
+        sourceClose(&source);
+        (void) fclose(fptr);
+        return finish();
+    }
+
+    // Call pass1 to generate the label table, if labels exists in the file/stdin,
+    // and to parse the instructions, with -j threads if asked for
+    listInit(&program);
+    statsStart(STATS_PASS1);
+    if ( OPTIONS.jobs > 1 && ! debug_is_on() )
+    {
+        table = parallelPass1(&source, &program, OPTIONS.jobs);
+    }
+    else
+    {
+        table = pass1(&source, &program);    // Returns an empty label table if no labels exist
+    }
+    statsStop(STATS_PASS1);
 
     /* Print the label table if debugging is turned on. */
     if ( debug_is_on() )
@@ -63,10 +269,88 @@ int main (int argc, char * argv[])
         printLabels (&table);
     }
 
-    // Rewind the file pointer to the beginning of the file, before passing it into pass2
-    rewind(fptr);
-    pass2(fptr,table);
+    // pass2 encodes the parsed instructions (the source is not read again,
+    // but the labels in program still point into it), with -j threads if
+    // asked for (but not while debugging, to keep the messages in order);
+    // with -c, objectWrite encodes them into an object file instead
+    statsStart(STATS_PASS2);
+    if ( OPTIONS.object )
+    {
+        (void) objectWrite(&program, table, &output);
+    }
+    else if ( OPTIONS.jobs > 1 && ! debug_is_on() )
+    {
+        parallelPass2(&program,table,&output,OPTIONS.jobs);
+    }
+    else
+    {
+        pass2(&program,table,&output);
+    }
+    statsStop(STATS_PASS2);
 
+    listFree(&program);
+    sourceClose(&source);
     (void) fclose(fptr);
-    return 0;
+    return finish();
+}
+
+/*
+ * Prints the errors collected and writes whatever machine code is still
+ * in the output buffer, adds the output to the cache if it is being
+ * captured, and releases the memory of the label table.
+ * Returns the exit status of the program: 0 if everything went OK; 1 if
+ * the output could not be written or there were too many errors.
+ */
+static int finish(void)
+{
+    int tooMany = reportErrors();
+    int written = outputClose(&output);
+    int status = written && ! tooMany ? 0 : 1;
+
+    (void) arenaUse(NULL);
+    arenaFree(&arena);
+    if ( caching )
+    {
+        caching = 0;
+        if ( ! cacheFinish(&cache, status, written) )
+            status = 1;
+    }
+    return status;
+}
+
+/*
+ * Prints the errors collected, if they are being collected, and stops
+ * collecting them.
+ * Returns 1 if more than ERROR_LIMIT errors were found; 0 otherwise.
+ */
+static int reportErrors(void)
+{
+    int nbrErrors;
+
+    if ( ! collecting )
+        return 0;
+    collecting = 0;
+    diagCollect(NULL);
+    nbrErrors = diagPrint(&diagnostics, stderr, OPTIONS.diagFormat);
+    diagFree(&diagnostics);
+    return ERROR_LIMIT > 0 && nbrErrors > ERROR_LIMIT;
+}
+
+/*
+ * Writes whatever machine code is still in the output buffer, after the
+ * errors collected so far.  This is registered with atexit so that, if
+ * the program exits early (e.g., printError exits because there are too
+ * many errors), the machine code for the lines before them is not lost
+ * (as it would not have been when it was printed with printf).  What was
+ * captured for the cache is written out, but not added to the cache.
+ */
+static void writeOutput(void)
+{
+    (void) reportErrors();
+    (void) outputClose(&output);
+    if ( caching )
+    {
+        caching = 0;
+        (void) cacheFinish(&cache, 1, 0);   /* not added to the cache */
+    }
 }
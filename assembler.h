@@ -12,26 +12,66 @@
 #include <string.h>	/* Might be memory.h on some machines. */
 #include <ctype.h>
 
+#include "InstructionList.h"
+#include "diagnostics.h"
+#include "InstructionTable.h"
 #include "LabelTable.h"
+#include "outputFile.h"
 #include "getToken.h"
 #include "printFuncs.h"
 #include "process_arguments.h"
 #include "same.h"
+#include "sourceFile.h"
+#include "stats.h"
+
+/* Values returned by assemblerR, assemblerI, assemblerJ, and
+ * encodeInstruction.
+ */
+#define ASM_ERROR   0   /* error already reported; no word was produced */
+#define ASM_OK      1   /* *word holds the encoded instruction */
+#define ASM_FIXUP   2   /* *word is encoded, but its label field must be
+                         * patched once the label is defined (see Fixup) */
+
+/* A forward reference found in single-pass mode: a branch or jump whose
+ * label had not been defined yet when the instruction was read.  The
+ * instruction is encoded with a zero label field, which is patched when
+ * the label appears.
+ */
+typedef struct {
+        Span   label;       /* the label that was not yet defined */
+        int    lineNum;     /* line number of the branch/jump */
+        int    column;      /* column of the branch/jump */
+        int    PC;          /* address of the branch/jump */
+        int    isJump;      /* 1 for j/jal; 0 for beq/bne */
+        int    badRegister; /* 1 if a register was invalid; reported only
+                             * if the label turns out to be valid, as it
+                             * would be if the label had been defined */
+} Fixup;
 
 int getNTokens (char * instructionBuffer, int N, char * results[]);
-LabelTable pass1 (FILE * fp);
-void pass2 (FILE * fp, LabelTable table);
+int getNSpanTokens (Span text, int N, Span results[]);
+LabelTable pass1 (SourceFile * source, InstructionList * program);
+LabelTable parallelPass1 (SourceFile * source, InstructionList * program,
+                          int nbrThreads);
+void pass2 (InstructionList * program, LabelTable table, OutputFile * output);
+void parallelPass2 (InstructionList * program, LabelTable table,
+                    OutputFile * output, int nbrThreads);
+LabelTable singlePass (SourceFile * source, OutputFile * output);
+
+void parseInstruction (Span instName, Span operands, int lineNum,
+                       Instruction * inst);
+int encodeInstruction(const Instruction * inst, LabelTable table,
+                        uint32_t * word, Fixup * fixup);
 
-void assemblerR(char * instName, char * restOfInstruction,
-                        int lineNum);
+int assemblerR(const Instruction * inst, uint32_t * word);
 
-void assemblerI(char * instName, char * restOfInstruction,
-                        int lineNum, LabelTable table);
+int assemblerI(const Instruction * inst, LabelTable table, uint32_t * word,
+                        Fixup * fixup);
 
-void assemblerJ(char * instName, char * restOfInstruction,
-                        int lineNum, LabelTable table);
+int assemblerJ(const Instruction * inst, LabelTable table, uint32_t * word,
+                        Fixup * fixup);
 
 void printBinary(int num, int maxPow);
-int getRegNum(char *reg);
+int getRegNum(Span reg);
 
 #endif
@@ -16,181 +16,135 @@
  * This function is used to process I-Format instructions into 
  * machine language. 
  * 
- * It takes four parameters: instName, restOfInstruction, lineNume, and table.
+ * It takes four parameters: inst (the parsed instruction, see
+ * InstructionList.h, whose operands have already been split into tokens
+ * and converted to numbers), table, word, and fixup.
  * 
- * Will print out the instruction (machine language) to stdout
+ * Will store the instruction (machine language) in *word and return ASM_OK
  * 
- * Will handle errors accordingly and print them to stderr
+ * Will handle errors accordingly, report them with diagError and return
+ * ASM_ERROR
  * 
  * Pre-condition: 
  *      - For BNE and BEQ instructions, the instruction should contain the label 
- *          name in order (i.e. agrugments[2] == "loop")
+ *          name in order (i.e. inst->text == "loop")
+ * 
+ * If fixup is not NULL (single-pass mode), a BNE/BEQ label that is not in
+ * the label table yet is treated as a forward reference: the instruction
+ * is stored in *word with an offset of 0, *fixup describes the label, and
+ * the function returns ASM_FIXUP.
  * 
  */
-void assemblerI(char * instName, char * restOfInstruction,int lineNum, LabelTable table)
+int assemblerI(const Instruction * inst, LabelTable table, uint32_t * word,
+                        Fixup * fixup)
 {
-    char * arguments[3];    /* registers or values after instruction name */
-
-    // lineNum subtracted by 1, because we start from line 1, therefore PC != 0 at line 1
-    // refer to pass2, where in the first loop, the lineNum is initiated to 1
-    int PC = (lineNum-1) * 4;
-
-    // variable to store the opcode integer
-    int * opcode = 0;
-    int i;      // iterator value
+    int lineNum = inst->lineNum;
 
-    // variables to compare later in function
-    char * bne="bne", *beq = "beq", *lui="lui", *lw="lw", *sw="sw";
-
-    // Arrays to hold opcode operations
-    char * opcodeOps [] = 
-    {
-        "beq", "bne", "addi", "addiu", "andi", "ori", "slti", "sltiu",
-        "lui", "lw", "sw"
-    };
-    int opcodeIntOps [] = 
-    {
-        4,5,8,9,12,13,10,11,15,35,43
-    };
+    // the address of the instruction, set by pass1 (see InstructionList.h)
+    int PC = inst->address;
 
-    // determine current opcode function
-    for(i =0; i<11; i++)
-    {
-        if(strcmp(instName, opcodeOps[i])==0)
-        {
-            opcode = &opcodeIntOps[i];
-            break;
-        }
-    }
+    // the opcode integer, from the instruction table
+    uint32_t opcode = (uint32_t) inst->instruction->opcode;
+    int status = ASM_OK;
 
     // I-Format for lui instruction
-    if(strcmp(instName, lui) == 0)
+    if(inst->instruction->operands == OPS_RT_IMM)
     {
-        // lui instruction should have 2 tokens
-        if( ! getNTokens(restOfInstruction, 2, arguments))
-        {
-            printError("\nError on line %d: %s\n", lineNum, arguments[0]);
-            return;
-        }
-
         // rs = 0 for lui instruction
-        char * rs = "00000";
-        // fetch register for rt
-        int rt = getRegNum(arguments[0]);
+        int rt = inst->reg[0];
         // check if register is valid
         if(rt == -1)
         {
-            printError("\nError: Invalid Register at line %d\n",lineNum);
-            return;
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Invalid Register at line %d\n");
+            return ASM_ERROR;
         }
-        int immediate = atoi(arguments[1]);     // convert immediate from char to int
+        int immediate = inst->immediate;
         // check - immediate should be in range 0 <= immediate < 65536
         if(immediate < 0 || immediate > 65535)
         {
-            printError("\nError: Immediate value is out of range at line %d\n", lineNum);
-            return;
+            diagError(DIAG_BAD_IMMEDIATE, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Immediate value is out of range at line %d\n");
+            return ASM_ERROR;
         }
-        // print binary represented instruction to stdout
-        printf("\n");
-        printBinary(*opcode, 5);
-        printf("%s",rs);
-        printBinary(rt,4);
-        printBinary(immediate,15);
-        printf("\n");
+        // encode the instruction
+        *word = opcode << 26 | (uint32_t) rt << 16 |
+                (uint32_t) immediate;
     }
-    else
+    // I-Format instruction for bne and beq
+    else if(inst->instruction->operands == OPS_RS_RT_LABEL)
     {
-        // All other I-Format instructions should have 3 tokens
-        if( ! getNTokens(restOfInstruction, 3, arguments))
+        // Get address of label from label table
+        int address = findLabelId(&table, inst->label, inst->text);
+        uint32_t immediate = 0;
+        // Verify if address exists
+        if(address == -1 && fixup != NULL)
+        {
+            // forward reference: the offset is patched in later
+            fixup->label = inst->text;
+            fixup->lineNum = lineNum;
+            fixup->column = inst->column;
+            fixup->PC = PC;
+            fixup->isJump = 0;
+            status = ASM_FIXUP;
+        }
+        else if(address == -1)
+        {
+            diagError(DIAG_UNDEFINED_LABEL, lineNum, inst->column, inst->text,
+                      "\nError: Invalid label not contained in label table, at line %d\n");
+            return ASM_ERROR;
+        }
+        // immediate = offset = (addrFromLabelTable - PC) / 4
+        else if( ! encodeTarget(address, PC, 0, lineNum, inst->column,
+                                &immediate))
         {
-            printError("\nError on line %d: %s\n", lineNum, arguments[0]);
-            return;
+            return ASM_ERROR;
         }
-        // I-Format instruction for bne and beq
-        if(strcmp(instName,bne)==0 || strcmp(instName,beq)==0)
+        int rs = inst->reg[0];
+        int rt = inst->reg[1];
+        // verify registers (a forward reference reports this later)
+        if(status == ASM_FIXUP)
         {
-            // Get address of label from label table
-            int address = findLabel(&table, arguments[2]);
-            // Verify if address exists
-            if(address == -1)
-            {
-                printError("\nError: Invalid label not contained in label table, at line %d\n",lineNum);
-                return;
-            }
-            // immediate = offset = (addrFromLabelTable - PC) / 4
-            int immediate = (address - PC)/4;
-            // verify bounds for immediate 
-            if(immediate < 0 || immediate > 65535)
-            {
-                printError("\nError: Immediate value is out of range at line %d\n", lineNum);
-                return;
-            }
-            // fetch registers for rs and rt
-            int rs = getRegNum(arguments[0]);
-            int rt = getRegNum(arguments[1]);
-            // verify registers
-            if(rs == -1 || rt == -1)
-            {
-                printError("\nError: Invalid Register at line %d\n",lineNum);
-                return;
-            }
-            // print binary represented instruction to stdout
-            printf("\n");
-            printBinary(*opcode,5);
-            printBinary(rs,4);
-            printBinary(rt,4);
-            printBinary(immediate,15);
-            printf("\n");
+            fixup->badRegister = rs == -1 || rt == -1;
         }
-        // I-Format for lw and sw instructions
-        else if(strcmp(instName,lw)==0 || strcmp(instName,sw)==0)
+        else if(rs == -1 || rt == -1)
         {
-            // fetch registers for rs and rt
-            int rs = getRegNum(arguments[2]);
-            int rt = getRegNum(arguments[0]);
-            if(rs == -1 || rt == -1)
-            {
-                printError("\nError: Invalid Register at line %d\n",lineNum);
-                return;
-            }
-            int immediate = atoi(arguments[1]);
-            if(immediate < 0 || immediate > 65535)
-            {
-                printError("\nError: Immediate value is out of range at line %d\n", lineNum);
-                return;
-            }
-            // print instruction (machine code) to stdout
-            printf("\n");
-            printBinary(*opcode,5);
-            printBinary(rs,4);
-            printBinary(rt,4);
-            printBinary(immediate,15);
-            printf("\n");
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Invalid Register at line %d\n");
+            return ASM_ERROR;
         }
-        else    // all other I-Format instructions
+        // encode the instruction
+        *word = opcode << 26 | (uint32_t) (rs & 31) << 21 |
+                (uint32_t) (rt & 31) << 16 | immediate;
+    }
+    else
+    {
+        // lw and sw have the base register last: lw $rt, immediate($rs)
+        int rs = inst->instruction->operands == OPS_RT_IMM_RS ? inst->reg[2]
+                                                              : inst->reg[1];
+        int rt = inst->reg[0];
+        if(rs == -1 || rt == -1)
+        {
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Invalid Register at line %d\n");
+            return ASM_ERROR;
+        }
+        int immediate = inst->immediate;
+        if(immediate < 0 || immediate > 65535)
         {
-            int rs = getRegNum(arguments[1]);
-            int rt = getRegNum(arguments[0]);
-            if(rs == -1 || rt == -1)
-            {
-                printError("\nError: Invalid Register at line %d\n",lineNum);
-                return;
-            }
-            int immediate = atoi(arguments[2]);
-            if(immediate < 0 || immediate > 65535)
-            {
-                printError("\nError: Immediate value is out of range at line %d\n", lineNum);
-                return;
-            }
-            // print instruction (machine code) to stdout
-            printf("\n");
-            printBinary(*opcode,5);
-            printBinary(rs,4);
-            printBinary(rt,4);
-            printBinary(immediate,15);
-            printf("\n");
+            diagError(DIAG_BAD_IMMEDIATE, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Immediate value is out of range at line %d\n");
+            return ASM_ERROR;
         }
+        // encode the instruction
+        *word = opcode << 26 | (uint32_t) rs << 21 |
+                (uint32_t) rt << 16 | (uint32_t) immediate;
     }
     
-    return;
+    return status;
 }
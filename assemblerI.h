@@ -12,10 +12,10 @@
 
 #include "assembler.h"
 
-void assemblerI(char * instName, char * restOfInstruction,
-                        int lineNum, LabelTable table);
+int assemblerI(const Instruction * inst, LabelTable table, uint32_t * word,
+                        Fixup * fixup);
 
 void printBinary(int num, int maxPow);
-int getRegNum(char *reg);
+int getRegNum(Span reg);
 
 #endif
@@ -14,62 +14,62 @@
  * This function will process J-format instructions into 
  * machine language.
  * 
- * It takes four parameters: instName, restOfInstruction, lineNume, and table.
+ * It takes four parameters: inst (the parsed instruction, see
+ * InstructionList.h), table, word, and fixup.
  * 
- * Will print instruction in machine language to stdout
+ * Will store the instruction in machine language in *word and return ASM_OK
  * 
- * Will handle errors accordingly and print them to stderr
+ * Will handle errors accordingly, report them with diagError and return
+ * ASM_ERROR
  * 
  * Pre-condition:
  *      - The instruction should contain the label of the address,
- *          i.e. arugments[0] == "loop"
+ *          i.e. inst->text == "loop"
+ * 
+ * If fixup is not NULL (single-pass mode), a label that is not in the
+ * label table yet is treated as a forward reference: the instruction is
+ * stored in *word with an address of 0, *fixup describes the label, and
+ * the function returns ASM_FIXUP.
  * 
  */
-void assemblerJ(char * instName, char * restOfInstruction,int lineNum, LabelTable table)
+int assemblerJ(const Instruction * inst, LabelTable table, uint32_t * word,
+                        Fixup * fixup)
 {
-    char * arguments[1];
-
-    // local variable opcode
-    int opcode;
-    // variable to compare opcode type
-    char * j="j";
+    int lineNum = inst->lineNum;
 
-    if(strcmp(instName,j)==0)
-    {
-        opcode = 2;
-    }
-    else    // otherwise, instName == jal
-    {
-        opcode = 3;
-    }
-    // J-Format instructions should have 1 token
-    if( ! getNTokens(restOfInstruction, 1, arguments))
-    {
-        printError("\nError on line %d: %s\n", lineNum, arguments[0]);
-        return;
-    }
+    // opcode, from the instruction table
+    uint32_t opcode = (uint32_t) inst->instruction->opcode;
+    uint32_t target = 0;
+    int status = ASM_OK;
 
     // Get address from label table
-    int address = findLabel(&table, arguments[0]);
+    int address = findLabelId(&table, inst->label, inst->text);
     // Verify if address exists
-    if(address == -1)
+    if(address == -1 && fixup != NULL)
+    {
+        // forward reference: the target address is patched in later
+        fixup->label = inst->text;
+        fixup->lineNum = lineNum;
+        fixup->column = inst->column;
+        fixup->PC = inst->address;
+        fixup->isJump = 1;
+        fixup->badRegister = 0;
+        status = ASM_FIXUP;
+    }
+    else if(address == -1)
     {
-        printError("\nError: Invalid label not contained in label table, at line %d\n",lineNum);
-        return;
+        diagError(DIAG_UNDEFINED_LABEL, lineNum, inst->column, inst->text,
+                  "\nError: Invalid label not contained in label table, at line %d\n");
+        return ASM_ERROR;
     }
     // address = addrFromLabelTable/4
-    address = address/4;
-    // verify address bounds: 0<=address<67108864
-    if(address < 0 || address >67108865)
+    else if( ! encodeTarget(address, inst->address, 1, lineNum,
+                                inst->column, &target))
     {
-        printError("\nError: Address is out of bounds at line %d\n",lineNum);
-        return;
+        return ASM_ERROR;
     }
-    // print binary representation of instruction to stdout
-    printf("\n");
-    printBinary(opcode,5);
-    printBinary(address,25);
-    printf("\n");
+    // encode the instruction
+    *word = opcode << 26 | target;
 
-    return;
+    return status;
 }
@@ -14,137 +14,86 @@
  * This function is used to process R-Format instructions into 
  * machine language.
  * 
- * The function takes in 3 arguments: instName, restOfInstruction, 
- * and lineNum.
+ * The function takes in 2 arguments: inst (the parsed instruction, see
+ * InstructionList.h, whose operands have already been split into tokens
+ * and converted to numbers) and word.
  * 
- * Will print out the instruction (machine language) to stdout
+ * Will store the instruction (machine language) in *word and return
+ * ASM_OK.
  * 
- * Will handle errors accordingly and print them to stderr.
+ * Will handle errors accordingly, report them with diagError and return
+ * ASM_ERROR.
  * 
  * 
  */
-void assemblerR(char * instName, char * restOfInstruction,
-                        int lineNum)
+int assemblerR(const Instruction * inst, uint32_t * word)
 {
-    char * arguments[3];    /* registers or values after instruction name */
+    int lineNum = inst->lineNum;
 
-    // variables to compare instNum with
-    char * jr = "jr", *sll = "sll", *srl = "srl";
     // The opcode for all R-Format Instructions is 0
-    char * opcode = "000000";
+    uint32_t opcode = 0;
 
-    // variable to store decimal value of funct operation.
-    int * functDec = 0;
-    // Arrays for all funct operations
-    char * functOps [] = 
-    {
-        "add", "addu", "sub", "subu", "and", "or", "nor", "slt",
-        "sltu", "sll", "srl", "jr"
-    };
-    int functDecOps [] =
-    {
-        32,33,34,35,36,37,39,42,43,0,2,8
-    };
-    // Used for iteration
-    int i;
-    for(i = 0; i<12; i++)
-    {
-        if(strcmp(functOps[i],instName)== 0)
-        {
-            functDec = &functDecOps[i];
-            break;
-        }
-    }
+    // decimal value of funct operation, from the instruction table
+    uint32_t funct = (uint32_t) inst->instruction->funct;
 
     // R-Format instruction for jr
-    if (strcmp(instName, jr) == 0)
+    if (inst->instruction->operands == OPS_RS)
     {
-        // jr intruction should only have 1 token
-        if( ! getNTokens(restOfInstruction, 1, arguments))
-        {
-            printError("\nError on line %d: %s\n", lineNum, arguments[0]);
-            return;
-        }
-        int rs = getRegNum(arguments[0]);
+        int rs = inst->reg[0];
         if(rs == -1)
         {
-            printError("\nError: Invalid register, at line %d: %s\n", lineNum, arguments[0]);
-            return;
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column, inst->text,
+                      "\nError: Invalid register, at line %d: %.*s\n");
+            return ASM_ERROR;
         }
-        // registers rt and rd are 0 for jr instruction
-        char * rt = "00000";
-        char * rd = "00000";
-        char * shamt = "00000";
-        // print the binary represented instruction to stdout
-        printf("\n%s",opcode);
-        printBinary(rs,4);
-        printf("%s%s%s",rt,rd,shamt);
-        printBinary(*functDec,5);
-        printf("\n");
+        // registers rt and rd, and shamt, are 0 for jr instruction
+        *word = opcode << 26 | (uint32_t) rs << 21 | funct;
     }
-    else
+    // R-Format instruction for sll or srl
+    else if(inst->instruction->operands == OPS_RD_RT_SHAMT)
     {
-        // All other instruction types will have 3 tokens
-        if ( ! getNTokens(restOfInstruction, 3, arguments) )
+        // rs = 0 for both sll and srl
+        int rt = inst->reg[1];
+        int rd = inst->reg[0];
+        // Check for valid registers
+        if(rt == -1 || rd == -1)
         {
-            /* When getNTokens encounters an error, it puts a pointer
-            * to the error message in arguments[0]. */
-            printError("\nError on line %d: %s\n", lineNum, arguments[0]);
-            return;
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError, Invalid register at line %d\n");
+            return ASM_ERROR;
         }
-        // R-Format instruction for sll or srl
-        if(strcmp(instName, sll) == 0 || strcmp(instName, srl) == 0)
-        {
-            // rs = 0 for both sll and srl
-            char * rs = "00000";
-            // Fetch register numbers for rt and rd
-            int rt = getRegNum(arguments[1]);
-            int rd = getRegNum(arguments[0]);
-            // Check for valid registers
-            if(rt == -1 || rd == -1)
-            {
-                printError("\nError, Invalid register at line %d\n", lineNum);
-                return;
-            }
 
-            int shamt = atoi(arguments[2]);     // Convert char to int
-            // shamt has to be in the range 0<= shamt < 32
-            if(shamt < 0 || shamt > 31)
-            {
-                printError("\nError: Shamt out of range at Line %d\n", lineNum);
-                return;
-            }
-            // Print the binary represented instruction to stdout
-            printf("\n%s%s", opcode,rs);
-            printBinary(rt,4);
-            printBinary(rd,4);
-            printBinary(shamt,4);
-            printBinary(*functDec,5);
-            printf("\n");
+        int shamt = inst->immediate;
+        // shamt has to be in the range 0<= shamt < 32
+        if(shamt < 0 || shamt > 31)
+        {
+            diagError(DIAG_BAD_SHAMT, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Shamt out of range at Line %d\n");
+            return ASM_ERROR;
         }
-        else    // All other R-Format Instructions
+        // Encode the instruction
+        *word = opcode << 26 | (uint32_t) rt << 16 | (uint32_t) rd << 11 |
+                (uint32_t) shamt << 6 | funct;
+    }
+    else    // All other R-Format Instructions
+    {
+        // shamt = 0 for all other instructions
+        int rs = inst->reg[1];
+        int rt = inst->reg[2];
+        int rd = inst->reg[0];
+        // verify registers
+        if(rs == -1 || rt == -1 || rd == -1)
         {
-            // shamt = 0 for all other instructions
-            char * shamt = "00000";
-            // Fetch register numbers
-            int rs = getRegNum(arguments[1]);
-            int rt = getRegNum(arguments[2]);
-            int rd = getRegNum(arguments[0]);
-            // verify registers
-            if(rs == -1 || rt == -1 || rd == -1)
-            {
-                printError("\nError: Invalid register at line %d\n", lineNum);
-                return;
-            }
-            // print the binary represented instruction to stdout
-            printf("\n%s", opcode);
-            printBinary(rs,4);
-            printBinary(rt,4);
-            printBinary(rd,4);
-            printf("%s",shamt);
-            printBinary(*functDec,5);
-            printf("\n");
+            diagError(DIAG_BAD_REGISTER, lineNum, inst->column,
+                      DIAG_NO_ARGUMENT,
+                      "\nError: Invalid register at line %d\n");
+            return ASM_ERROR;
         }
+        // Encode the instruction
+        *word = opcode << 26 | (uint32_t) rs << 21 | (uint32_t) rt << 16 |
+                (uint32_t) rd << 11 | funct;
     }
-    return;
+    return ASM_OK;
 }
@@ -12,10 +12,9 @@
 
 #include "assembler.h"
 
-void assemblerR(char * instName, char * restOfInstruction,
-                        int lineNum);
+int assemblerR(const Instruction * inst, uint32_t * word);
 
 void printBinary(int num, int maxPow);
-int getRegNum(char *reg);
+int getRegNum(Span reg);
 
 #endif
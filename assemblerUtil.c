@@ -3,16 +3,21 @@
  * in this file will help the assembler functions process
  * its' instructions correctly.
  * 
- * There are two functions in this file: printBinary(...) and 
- * getRegNum(...) both functions have detailed explainations to
- * how they work in their respective comments.
+ * The functions in this file are: printBinary(...), getRegNum(...),
+ * encodeTarget(...), spanIs(...) and spanToInt(...);
+ * each function has a detailed explaination of how it works in its
+ * respective comments.
  * 
  * Author: Nikhil Sodemba
  * Date Created: Feb, 20th, 2020
  * 
  */
 
+#include <limits.h>
+
 #include "assembler.h"
+#include "assemblerUtil.h"
+#include "number.h"
 
 /**
  * This function will print the binary representation 
@@ -33,8 +38,8 @@ void printBinary(int num, int maxPow)
     // assign n to decimal integer we are trying to convert.
     n = num;
 
-    // Array to hold the binary representation
-    int binary[maxPow];
+    // Array to hold the binary representation (bits 0 through maxPow)
+    int binary[maxPow + 1];
 
     // loop through powers of 2
     for (c = maxPow; c >= 0; c--)
@@ -63,43 +68,164 @@ void printBinary(int num, int maxPow)
  * This function is used to validate whether or not the register
  * is a legitimate one. 
  * 
- * The function takes 1 argument: the register.
+ * The function takes 1 argument: the register (a token span), which may
+ * be named (e.g. "$t0") or numbered ("$0" through "$31").
  *
  * The function will return the register number, if it 
  * exists, else return -1.
  * 
+ * Rather than comparing the span with every register name, the function
+ * switches on the letter after the '$' and computes the number from the
+ * last character, so it takes a few branches for any register.
+ * 
  * Error Handling will be taken care of in the callback.
  */
-int getRegNum(char *reg)
+int getRegNum(Span reg)
 {
-    // iterator value
-    int x;
+    const char * name = reg.text;
+    int digit;
 
-    int regNum = -1;
+    STATS_COUNT(getRegNumCalls, 1);
 
-    // array of all registers
-    char * regArray[] =
+    if(reg.length < 2 || reg.length > 5 || name[0] != '$')
     {
-            "$zero",
-            "$at",
-            "$v0","$v1",
-            "$a0","$a1","$a2","$a3",
-            "$t0", "$t1", "$t2", "$t3", "$t4",
-            "$t5", "$t6", "$t7",
-            "$s0", "$s1", "$s2", "$s3", "$s4",
-            "$s5", "$s6", "$s7",
-            "$t8", "$t9", "$k0", "$k1", "$gp",
-            "$sp", "$fp", "$ra"
-    };
+        return -1;
+    }
 
-    // Loop through regArray to find match
-    for(x = 0; x<32; x++)
+    // numbered registers: $0 - $9 and $10 - $31 (no leading zeros)
+    if(name[1] >= '0' && name[1] <= '9')
     {
-        if(strcmp(regArray[x], reg) == 0)
+        if(reg.length == 2)
         {
-            regNum = x;
-            break;   
+            return name[1] - '0';
         }
+        if(reg.length == 3 && name[1] != '0' &&
+           name[2] >= '0' && name[2] <= '9')
+        {
+            int regNum = (name[1] - '0') * 10 + (name[2] - '0');
+            return regNum < 32 ? regNum : -1;
+        }
+        return -1;
+    }
+
+    if(reg.length == 5)
+    {
+        return (name[1] == 'z' && name[2] == 'e' && name[3] == 'r' &&
+                name[4] == 'o') ? 0 : -1;
+    }
+    if(reg.length != 3)
+    {
+        return -1;
+    }
+
+    // all other names are a letter and a digit or a letter
+    digit = name[2] - '0';
+    switch(name[1])
+    {
+        case 'a':
+            if(name[2] == 't')
+                return 1;
+            return (digit >= 0 && digit <= 3) ? 4 + digit : -1;
+        case 'v':
+            return (digit >= 0 && digit <= 1) ? 2 + digit : -1;
+        case 't':
+            if(digit >= 0 && digit <= 7)
+                return 8 + digit;
+            return (digit >= 8 && digit <= 9) ? 24 + digit - 8 : -1;
+        case 's':
+            if(name[2] == 'p')
+                return 29;
+            return (digit >= 0 && digit <= 7) ? 16 + digit : -1;
+        case 'k':
+            return (digit >= 0 && digit <= 1) ? 26 + digit : -1;
+        case 'g':
+            return name[2] == 'p' ? 28 : -1;
+        case 'f':
+            return name[2] == 'p' ? 30 : -1;
+        case 'r':
+            return name[2] == 'a' ? 31 : -1;
+        default:
+            return -1;
+    }
+}
+
+/**
+ * This function computes the label field of a branch or jump instruction
+ * from the address of its target label.
+ *
+ * The function takes six parameters: address, the address of the target
+ * label; PC, the address of the branch/jump instruction; isJump, 1 for a
+ * J-Format jump (26-bit target address) and 0 for a branch (16-bit offset);
+ * lineNum and column, used in error messages; and field, where the result
+ * is stored.
+ *
+ * Returns 1 and sets *field if the target is in range, else reports an
+ * error (see diagnostics.h) and returns 0.
+ */
+int encodeTarget(int address, int PC, int isJump, int lineNum, int column,
+                        uint32_t * field)
+{
+    if(isJump)
+    {
+        // address = addrFromLabelTable/4
+        address = address/4;
+        // verify address bounds: 0<=address<67108864
+        if(address < 0 || address >67108865)
+        {
+            diagError(DIAG_BAD_ADDRESS, lineNum, column, DIAG_NO_ARGUMENT,
+                      "\nError: Address is out of bounds at line %d\n");
+            return 0;
+        }
+        *field = (unsigned) address & 0x3FFFFFF;
+    }
+    else
+    {
+        // immediate = offset = (addrFromLabelTable - PC) / 4
+        int immediate = (address - PC)/4;
+        // verify bounds for immediate 
+        if(immediate < 0 || immediate > 65535)
+        {
+            diagError(DIAG_BAD_IMMEDIATE, lineNum, column, DIAG_NO_ARGUMENT,
+                      "\nError: Immediate value is out of range at line %d\n");
+            return 0;
+        }
+        *field = (unsigned) immediate;
+    }
+    return 1;
+}
+
+/**
+ * This function compares a token with a string.
+ *
+ * The function takes two parameters: span, the token, and string, a
+ * null-terminated string such as an instruction name.
+ *
+ * Returns 1 if the token consists of exactly the characters in string,
+ * else returns 0.
+ */
+int spanIs(Span span, const char * string)
+{
+    return strncmp(span.text, string, span.length) == SAME &&
+           string[span.length] == '\0';
+}
+
+/**
+ * This function converts a token holding a number to an int: a decimal
+ * or hexadecimal number, or a character literal (see number.h).
+ *
+ * The function takes one parameter: span, the token.
+ *
+ * Returns INT_MIN, which is out of range for every instruction, if the
+ * token is not a number (atoi(...), which this replaces, gave the value
+ * of any digits it started with) or does not fit in an int.
+ */
+int spanToInt(Span span)
+{
+    int64_t value;
+
+    if(!parseNumber(span, &value) || value < INT_MIN || value > INT_MAX)
+    {
+        return INT_MIN;
     }
-    return regNum;;
+    return (int) value;
 }
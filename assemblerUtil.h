@@ -12,7 +12,10 @@
 
 #include "assembler.h"
 
-void printBinary(int num, int maxPow);
-int getRegNum(char *reg);
+/* printBinary and getRegNum are declared in assembler.h. */
+int encodeTarget(int address, int PC, int isJump, int lineNum, int column,
+                        uint32_t * field);
+int spanIs(Span span, const char * string);
+int spanToInt(Span span);
 
 #endif
@@ -0,0 +1,516 @@
+/*
+ * Batch: assembling many programs at once
+ *
+ * This file provides the definition of assembleBatch, declared in
+ * batch.h.  Each worker has a queue of the numbers of the files dealt to
+ * it, biggest first, protected by its own lock: the worker takes files
+ * from the front of its queue, and, once it is empty, steals from the
+ * back of the others' queues, so the workers only contend for a lock
+ * when one of them runs out of work.  No files are added once the batch
+ * has started, so a worker whose own queue and all the others' are
+ * empty is done.  The calling thread only waits for the workers (it
+ * assembles the files itself if no worker can be started).
+ *
+ * A worker holds its error messages (see hold_errors) and collects its
+ * errors in a Diagnostics collector of its own while it assembles a
+ * file, and allocates the file's label table from an arena of its own
+ * (see arena.h), which it empties for the next file.  The messages held
+ * while pass1 runs are those the assembler prints to stdout (about
+ * duplicate labels), and are written at the start of the file's output;
+ * any held after that (e.g., an error writing the output) are written
+ * with the errors.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "batch.h"
+#include "objectFile.h"
+
+/* Most workers assembleBatch starts. */
+#define MAX_WORKERS 256
+
+/* The files dealt to one worker that it has not yet assembled. */
+typedef struct {
+    int *           files;      /* file numbers, biggest file first */
+    int             first;      /* files[first] to files[last - 1] */
+    int             last;       /*      are left */
+    pthread_mutex_t lock;       /* protects first and last */
+} WorkQueue;
+
+/* The state shared by the workers. */
+typedef struct {
+    char * const *  files;
+    int             nbrFiles;
+    char **         names;      /* output name of each file (see batch.h) */
+    const char *    outputDir;
+    WorkQueue *     queues;     /* one for each worker */
+    int             nbrWorkers;
+    int             failed;     /* 1 if any file failed */
+    pthread_mutex_t lock;       /* protects failed and stderr */
+} Batch;
+
+/* What a worker thread is given when it starts. */
+typedef struct {
+    Batch * batch;
+    int     number;             /* the worker's queue in batch->queues */
+} Worker;
+
+static int    prepareBatch (Batch * batch, int nbrFiles);
+static void   freeBatch (Batch * batch);
+static char * outputName (const char * file);
+static int    compareSizes (const void * a, const void * b);
+static int    compareNames (const void * a, const void * b);
+static void * runWorker (void * worker);
+static int    takeFile (Batch * batch, int number);
+static int    assembleFile (Batch * batch, int fileNbr);
+static char * outputPath (Batch * batch, int fileNbr, const char * extension);
+static int    writeErrors (Batch * batch, const char * path,
+                           const char * errors, size_t length);
+static void   report (Batch * batch, const char * format, ...);
+
+/* The sizes and output names of the files, which compareSizes and
+ * compareNames order file numbers by.
+ */
+static off_t * sizes;
+static char ** names;
+
+int assembleBatch (char * const * files, int nbrFiles,
+                   const char * outputDir, int nbrWorkers)
+{
+    Batch      batch;
+    Worker *   workers;
+    pthread_t *threads;
+    Worker     self;
+    int        nbrStarted = 0;
+    int        i;
+
+    if ( nbrWorkers <= 0 )
+        nbrWorkers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if ( nbrWorkers > nbrFiles )
+        nbrWorkers = nbrFiles;
+    if ( nbrWorkers > MAX_WORKERS )
+        nbrWorkers = MAX_WORKERS;
+    if ( nbrWorkers < 1 )
+        nbrWorkers = 1;
+
+    if ( mkdir (outputDir, 0777) != 0 && errno != EEXIST )
+    {
+        printError("Error: Cannot create directory %s.\n", outputDir);
+        return 1;
+    }
+    batch.files = files;
+    batch.nbrFiles = nbrFiles;
+    batch.outputDir = outputDir;
+    batch.nbrWorkers = nbrWorkers;
+    batch.failed = 0;
+    if ( ! prepareBatch (&batch, nbrFiles) )
+        return 1;   /* error message already printed */
+    pthread_mutex_init (&batch.lock, NULL);
+
+    /* If a worker cannot be started, the others steal the files dealt
+     * to it; if none can, the calling thread assembles them all.
+     */
+    workers = malloc ((size_t) nbrWorkers * sizeof(Worker));
+    threads = malloc ((size_t) nbrWorkers * sizeof(pthread_t));
+    if ( workers != NULL && threads != NULL )
+    {
+        for ( i = 0; i < nbrWorkers; i++ )
+        {
+            workers[i].batch = &batch;
+            workers[i].number = i;
+        }
+        while ( nbrStarted < nbrWorkers &&
+                pthread_create (&threads[nbrStarted], NULL, runWorker,
+                                &workers[nbrStarted]) == 0 )
+            nbrStarted++;
+    }
+    if ( nbrStarted == 0 )
+    {
+        self.batch = &batch;
+        self.number = 0;
+        (void) runWorker (&self);
+    }
+    for ( i = 0; i < nbrStarted; i++ )
+        pthread_join (threads[i], NULL);
+    free (workers);
+    free (threads);
+
+    pthread_mutex_destroy (&batch.lock);
+    freeBatch (&batch);
+    return batch.failed;
+}
+
+/*
+ * Finds the output name of each file and deals the files out to the
+ * workers' queues, biggest first.
+ * Returns 1 if everything went OK; 0 (after printing an error) if two
+ * files have the same output name or if memory allocation error.
+ */
+static int prepareBatch (Batch * batch, int nbrFiles)
+{
+    struct stat info;
+    int *       order;
+    int         i, ok = 1;
+
+    batch->names = calloc ((size_t) nbrFiles, sizeof(char *));
+    batch->queues = calloc ((size_t) batch->nbrWorkers, sizeof(WorkQueue));
+    sizes = malloc ((size_t) nbrFiles * sizeof(off_t));
+    order = malloc ((size_t) nbrFiles * sizeof(int));
+    ok = batch->names != NULL && batch->queues != NULL && sizes != NULL &&
+         order != NULL;
+    for ( i = 0; batch->queues != NULL && i < batch->nbrWorkers; i++ )
+    {
+        pthread_mutex_init (&batch->queues[i].lock, NULL);
+        batch->queues[i].files = malloc ((size_t) (nbrFiles /
+                                                   batch->nbrWorkers + 1)
+                                         * sizeof(int));
+        ok = ok && batch->queues[i].files != NULL;
+    }
+    for ( i = 0; ok && i < nbrFiles; i++ )
+    {
+        ok = (batch->names[i] = outputName (batch->files[i])) != NULL;
+        sizes[i] = stat (batch->files[i], &info) == 0 ? info.st_size : 0;
+        order[i] = i;
+    }
+    if ( ! ok )
+    {
+        printError("Error: cannot allocate space in memory.\n");
+        free (order);
+        freeBatch (batch);
+        return 0;
+    }
+
+    /* Two files with the same name would overwrite each other's output. */
+    names = batch->names;
+    qsort (order, (size_t) nbrFiles, sizeof(int), compareNames);
+    for ( i = 1; i < nbrFiles; i++ )
+    {
+        if ( strcmp (batch->names[order[i - 1]], batch->names[order[i]])
+             == SAME )
+        {
+            printError("Error: %s and %s would both be written to %s/%s%s.\n",
+                       batch->files[order[i - 1]], batch->files[order[i]],
+                       batch->outputDir, batch->names[order[i]],
+                       OPTIONS.object ? ".o" : ".out");
+            free (order);
+            freeBatch (batch);
+            return 0;
+        }
+    }
+
+    /* Deal the files out in turn, biggest first. */
+    for ( i = 0; i < nbrFiles; i++ )
+        order[i] = i;
+    qsort (order, (size_t) nbrFiles, sizeof(int), compareSizes);
+    for ( i = 0; i < nbrFiles; i++ )
+    {
+        WorkQueue * queue = &batch->queues[i % batch->nbrWorkers];
+
+        queue->files[queue->last++] = order[i];
+    }
+    free (order);
+    return 1;
+}
+
+/*
+ * Releases the memory of batch->names and batch->queues.
+ */
+static void freeBatch (Batch * batch)
+{
+    int i;
+
+    if ( batch->names != NULL )
+    {
+        for ( i = 0; i < batch->nbrFiles; i++ )
+            free (batch->names[i]);
+        free (batch->names);
+    }
+    if ( batch->queues != NULL )
+    {
+        for ( i = 0; i < batch->nbrWorkers; i++ )
+        {
+            free (batch->queues[i].files);
+            pthread_mutex_destroy (&batch->queues[i].lock);
+        }
+        free (batch->queues);
+    }
+    free (sizes);
+    sizes = NULL;
+    names = NULL;
+    batch->names = NULL;
+    batch->queues = NULL;
+}
+
+/*
+ * Returns the output name of file: its name without its directory and
+ * extension (in newly allocated memory), or NULL if memory allocation
+ * error.
+ */
+static char * outputName (const char * file)
+{
+    const char * start = strrchr (file, '/');
+    const char * end;
+    char *       name;
+
+    start = start != NULL ? start + 1 : file;
+    end = strrchr (start, '.');
+    if ( end == NULL || end == start )
+        end = start + strlen (start);
+    if ( (name = malloc ((size_t) (end - start) + 1)) == NULL )
+        return NULL;
+    memcpy (name, start, (size_t) (end - start));
+    name[end - start] = '\0';
+    return name;
+}
+
+/*
+ * Orders file numbers by the size of the file, biggest first.
+ */
+static int compareSizes (const void * a, const void * b)
+{
+    off_t first = sizes[*(const int *) a];
+    off_t second = sizes[*(const int *) b];
+
+    return first > second ? -1 : first < second ? 1 : 0;
+}
+
+/*
+ * Orders file numbers by output name.
+ */
+static int compareNames (const void * a, const void * b)
+{
+    return strcmp (names[*(const int *) a], names[*(const int *) b]);
+}
+
+/*
+ * Assembles files until there are none left.  This is the function each
+ * worker thread runs.
+ */
+static void * runWorker (void * worker)
+{
+    Worker * self = worker;
+    Arena    arena;
+    Arena *  previousArena;
+    int      fileNbr, failed = 0;
+
+    arenaInit (&arena, NULL);
+    previousArena = arenaUse (&arena);
+    while ( (fileNbr = takeFile (self->batch, self->number)) >= 0 )
+    {
+        if ( assembleFile (self->batch, fileNbr) != 0 )
+            failed = 1;
+        arenaReset (&arena);
+    }
+    (void) arenaUse (previousArena);
+    arenaFree (&arena);
+    if ( failed )
+    {
+        pthread_mutex_lock (&self->batch->lock);
+        self->batch->failed = 1;
+        pthread_mutex_unlock (&self->batch->lock);
+    }
+    statsMergeThread ();
+    return NULL;
+}
+
+/*
+ * Takes the next file for worker number: the biggest file left in its
+ * own queue or, if there is none, the smallest file left in the queue of
+ * the next worker that has one.
+ * Returns the number of the file, or -1 if there are none left.
+ */
+static int takeFile (Batch * batch, int number)
+{
+    WorkQueue * queue;
+    int         fileNbr = -1;
+    int         i;
+
+    for ( i = 0; i < batch->nbrWorkers && fileNbr < 0; i++ )
+    {
+        queue = &batch->queues[(number + i) % batch->nbrWorkers];
+        pthread_mutex_lock (&queue->lock);
+        if ( queue->first < queue->last )
+            fileNbr = i == 0 ? queue->files[queue->first++]
+                             : queue->files[--queue->last];
+        pthread_mutex_unlock (&queue->lock);
+    }
+    return fileNbr;
+}
+
+/*
+ * Assembles one file of the batch into its output files.
+ * Returns 0 if everything went OK; 1 if the file could not be read, its
+ * output could not be written, or it had more errors than the
+ * ERROR_LIMIT.
+ */
+static int assembleFile (Batch * batch, int fileNbr)
+{
+    const char *    file = batch->files[fileNbr];
+    char *          outPath = outputPath (batch, fileNbr,
+                                          OPTIONS.object ? ".o" : ".out");
+    char *          errPath = outputPath (batch, fileNbr, ".err");
+    FILE *          in = NULL;
+    FILE *          out = NULL;
+    FILE *          fp;
+    SourceFile      source;
+    InstructionList program;
+    LabelTable      table;
+    Diagnostics     diagnostics;
+    OutputFile      output;
+    char *          messages;
+    char *          errors = NULL;
+    size_t          errorsLength = 0;
+    int             nbrErrors = 0;
+    int             written = 0;
+
+    if ( outPath == NULL || errPath == NULL )
+        report (batch, "Error: cannot allocate space in memory.\n");
+    else if ( (in = fopen (file, "r")) == NULL )
+        report (batch, "Error: Cannot open file %s.\n", file);
+    else if ( (out = fopen (outPath, "w")) == NULL )
+        report (batch, "Error: Cannot create file %s.\n", outPath);
+    if ( out == NULL )
+    {
+        if ( in != NULL )
+            (void) fclose (in);
+        free (outPath);
+        free (errPath);
+        return 1;
+    }
+
+    diagInit (&diagnostics, ERROR_LIMIT);
+    diagCollect (&diagnostics);
+    debug_off ();
+    hold_errors ();
+    if ( sourceOpen (&source, in) )
+    {
+        listInit (&program);
+        table = pass1 (&source, &program);
+
+        /* The messages printed to stdout come before the machine code in
+         * the ascii format; in an image or an object file, they stay
+         * with the errors.
+         */
+        if ( ! OPTIONS.object && OPTIONS.format == FORMAT_ASCII )
+        {
+            if ( (messages = release_errors ()) != NULL )
+                (void) fputs (messages, out);
+            free (messages);
+            hold_errors ();
+        }
+
+        if ( OPTIONS.object )
+        {
+            outputOpen (&output, out, FORMAT_RAW_BE);
+            (void) objectWrite (&program, table, &output);
+        }
+        else
+        {
+            outputOpen (&output, out, OPTIONS.format);
+            pass2 (&program, table, &output);
+        }
+        written = outputClose (&output);
+        listFree (&program);
+        tableFree (&table);
+        sourceClose (&source);
+    }
+    diagCollect (NULL);
+    messages = release_errors ();
+    debug_restore ();
+    written = fclose (out) == 0 && written;
+    (void) fclose (in);
+
+    /* Write the errors as the assembler would print them to stderr. */
+    if ( (fp = open_memstream (&errors, &errorsLength)) != NULL )
+    {
+        if ( messages != NULL )
+            (void) fputs (messages, fp);
+        nbrErrors = diagPrint (&diagnostics, fp, OPTIONS.diagFormat);
+        if ( fclose (fp) != 0 )
+            written = 0;
+    }
+    else
+        written = 0;
+    diagFree (&diagnostics);
+    free (messages);
+    if ( ! writeErrors (batch, errPath, errors, errorsLength) )
+        written = 0;
+    else if ( nbrErrors > 0 )
+        report (batch, "%s: %d error%s (see %s).\n", file, nbrErrors,
+                nbrErrors == 1 ? "" : "s", errPath);
+    else if ( ! written )
+        report (batch, "%s: could not be assembled (see %s).\n", file,
+                errPath);
+
+    free (errors);
+    free (outPath);
+    free (errPath);
+    return written && ! (ERROR_LIMIT > 0 && nbrErrors > ERROR_LIMIT) ? 0 : 1;
+}
+
+/*
+ * Returns the path of the output file of file number fileNbr with the
+ * given extension (in newly allocated memory), or NULL if memory
+ * allocation error.
+ */
+static char * outputPath (Batch * batch, int fileNbr, const char * extension)
+{
+    size_t length = strlen (batch->outputDir) + strlen (batch->names[fileNbr])
+                    + strlen (extension) + 2;
+    char * path = malloc (length);
+
+    if ( path != NULL )
+        (void) snprintf (path, length, "%s/%s%s", batch->outputDir,
+                         batch->names[fileNbr], extension);
+    return path;
+}
+
+/*
+ * Writes the length bytes of errors to the file path, or removes it (as
+ * left by an earlier batch) if there are none.
+ * Returns 1 if everything went OK; 0 (after reporting an error) if the
+ * file could not be written.
+ */
+static int writeErrors (Batch * batch, const char * path,
+                        const char * errors, size_t length)
+{
+    FILE * fp;
+    int    ok;
+
+    if ( length == 0 )
+    {
+        (void) unlink (path);
+        return 1;
+    }
+    if ( (fp = fopen (path, "w")) == NULL )
+    {
+        report (batch, "Error: Cannot create file %s.\n", path);
+        return 0;
+    }
+    ok = fwrite (errors, 1, length, fp) == length;
+    ok = fclose (fp) == 0 && ok;
+    if ( ! ok )
+        report (batch, "Error: cannot write to file %s.\n", path);
+    return ok;
+}
+
+/*
+ * Prints a message about the batch to stderr, without mixing it with a
+ * message printed by another worker at the same time.
+ */
+static void report (Batch * batch, const char * format, ...)
+{
+    va_list ap;
+
+    va_start (ap, format);
+    pthread_mutex_lock (&batch->lock);
+    (void) vfprintf (stderr, format, ap);
+    pthread_mutex_unlock (&batch->lock);
+    va_end (ap);
+}
@@ -0,0 +1,46 @@
+/*
+ * Batch: assembling many programs at once
+ *
+ * "assembler -o DIR file..." runs assembleBatch, which assembles each
+ * of the files given (or listed in a response file, see
+ * process_arguments.c) into the directory DIR, so that a directory of
+ * programs can be assembled by one process instead of one process each.
+ * The output of each file is what
+ *      assembler [options] file > DIR/name.out 2> DIR/name.err
+ * would write, where name is the file's name without its directory and
+ * extension; DIR/name.err is only kept if something was written to it.
+ * With -c, the object file of each file is written to DIR/name.o
+ * instead (see objectFile.h), so the modules of a program can be
+ * assembled in parallel and then linked.
+ *
+ * The files are assembled in parallel by a pool of worker threads, each
+ * assembling one file at a time with its own label table, instruction
+ * list, and errors (see diagnostics.h and hold_errors).  The files are
+ * dealt out to the workers biggest first, so that a big file is started
+ * early rather than holding up the end of the batch; each worker takes
+ * the biggest file left in its own queue, and one whose queue is empty
+ * steals the smallest file left in another worker's queue.  A file that
+ * cannot be read or assembled does not stop the others.
+ *
+ * Each file is assembled by pass1 and pass2, without debugging messages.
+ * A line is printed to stderr for each file with errors, naming the file
+ * the errors were written to.
+ *
+ */
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+int assembleBatch (char * const * files, int nbrFiles,
+                   const char * outputDir, int nbrWorkers);
+        /* Assembles the nbrFiles files into outputDir (created if it
+         *      does not exist) with nbrWorkers worker threads (one per
+         *      processor if nbrWorkers <= 0).
+         * Returns 0 if everything went OK; 1 if a file could not be
+         *      read or written, if a file had more errors than the
+         *      ERROR_LIMIT, or if two files would be written to the same
+         *      output (after printing an error; in that case nothing is
+         *      assembled).
+         */
+
+#endif
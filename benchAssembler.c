@@ -0,0 +1,150 @@
+/*
+ * This is a driver to measure the throughput of each stage of the
+ * assembler.
+ *
+ *      The program assembles its input the way the assembler does in two
+ *      passes, but runs each stage on its own and measures it:
+ *          read    open the source (see sourceFile.h)
+ *          pass1   build the label table and parse every instruction
+ *          pass2   encode the parsed instructions into machine words
+ *          output  format the machine words and write them to /dev/null
+ *      (In the assembler, pass2 writes each word as soon as it has encoded
+ *      it; here all the words are kept so that encoding and formatting are
+ *      measured separately.)  For each stage it prints the CPU time taken
+ *      and the speed in source lines and source megabytes per second.
+ *      (A file is mapped into memory, so most of the cost of reading it
+ *      shows up in pass1, which is the first to touch its pages.)
+ *
+ *      Large inputs can be generated with makeProgram, and "make bench"
+ *      runs this program over several generated programs.
+ *
+ * USAGE:
+ *          name [ -f format ] [ filename ] [ 0|1 ]
+ *      where the arguments are the same as the assembler's (see
+ *      process_arguments.c).  Debugging should be turned off (0); its
+ *      messages would be counted in the times.
+ *
+ * OUTPUT:
+ *      One line per stage, e.g.
+ *          pass1       0.453 s      2.21 M lines/s     42.47 MB/s
+ *      followed by the same for all the stages together.
+ *
+ * ERROR CONDITIONS:
+ *      Errors in the input are reported as by the assembler, and are
+ *      counted in the times.
+ */
+
+#include <time.h>
+
+#include "assembler.h"
+
+static void printRate (const char * stage, clock_t ticks, long nbrLines,
+                       size_t nbrBytes);
+
+int main (int argc, char * argv[])
+{
+    FILE *          fptr;           /* file pointer */
+    FILE *          sink;           /* where the output is thrown away */
+    SourceFile      source;         /* contents of the file */
+    InstructionList program;        /* the instructions, parsed by pass1 */
+    LabelTable      table;
+    OutputFile      output;
+    uint32_t *      words;          /* machine word of each instruction */
+    unsigned char * encoded;        /* 1 if the instruction has a word */
+    clock_t         start, read, parse, encode, write;
+    long            nbrLines;
+    size_t          i;
+    int             n;
+
+    fptr = process_arguments(argc, argv);
+    if ( fptr == NULL )
+    {
+        return 1;   /* Fatal error when processing arguments */
+    }
+    if ( (sink = fopen("/dev/null", "w")) == NULL )
+    {
+        printError("Error: Cannot open file /dev/null.\n");
+        return 1;
+    }
+
+    start = clock();
+    if ( ! sourceOpen(&source, fptr) )
+    {
+        return 1;   /* Fatal error when reading the input */
+    }
+    read = clock() - start;
+
+    /* Count the lines (not timed), including a last line without a
+     * newline.
+     */
+    nbrLines = 0;
+    for ( i = 0; i < source.length; i++ )
+        nbrLines += source.text[i] == '\n';
+    if ( source.length > 0 && source.text[source.length - 1] != '\n' )
+        nbrLines++;
+
+    start = clock();
+    listInit(&program);
+    table = pass1(&source, &program);
+    parse = clock() - start;
+
+    words = malloc((size_t) program.nbrInstructions * sizeof(uint32_t) + 1);
+    encoded = malloc((size_t) program.nbrInstructions + 1);
+    if ( words == NULL || encoded == NULL )
+    {
+        printError("Error: cannot allocate space in memory.\n");
+        return 1;
+    }
+
+    start = clock();
+    for ( n = 0; n < program.nbrInstructions; n++ )
+        encoded[n] = encodeInstruction(&program.instructions[n], table,
+                                       &words[n], NULL) == ASM_OK;
+    encode = clock() - start;
+
+    start = clock();
+    outputOpen(&output, sink, OPTIONS.format);
+    for ( n = 0; n < program.nbrInstructions; n++ )
+    {
+        if ( encoded[n] &&
+             ! outputWord(&output,
+                          (uint32_t) program.instructions[n].address,
+                          words[n]) )
+            break;
+    }
+    (void) outputClose(&output);
+    write = clock() - start;
+
+    printf("%ld lines, %d instructions, %.2f MB\n", nbrLines,
+           program.nbrInstructions, source.length / 1e6);
+    printRate("read", read, nbrLines, source.length);
+    printRate("pass1", parse, nbrLines, source.length);
+    printRate("pass2", encode, nbrLines, source.length);
+    printRate("output", write, nbrLines, source.length);
+    printRate("total", read + parse + encode + write, nbrLines,
+              source.length);
+
+    free(words);
+    free(encoded);
+    listFree(&program);
+    sourceClose(&source);
+    (void) fclose(sink);
+    (void) fclose(fptr);
+    return 0;
+}
+
+/*
+ * Prints the time taken by a stage and its speed in lines and megabytes
+ * of source per second.
+ */
+static void printRate (const char * stage, clock_t ticks, long nbrLines,
+                       size_t nbrBytes)
+{
+    double seconds = (double) ticks / CLOCKS_PER_SEC;
+
+    if ( seconds <= 0 )
+        printf("%-8s %8.3f s     (too fast to measure)\n", stage, seconds);
+    else
+        printf("%-8s %8.3f s  %8.2f M lines/s  %8.2f MB/s\n", stage,
+               seconds, nbrLines / seconds / 1e6, nbrBytes / seconds / 1e6);
+}
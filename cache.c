@@ -0,0 +1,495 @@
+/*
+ * Cache: a directory of assembled outputs, shared by assembler runs
+ *
+ * This file provides the definitions of the functions declared in
+ * cache.h.  An entry is a CacheHeader followed by what the assembly
+ * wrote to stdout and then what it wrote to stderr.  While a source is
+ * assembled, stdout (file descriptor 1) is redirected with dup2 into a
+ * new temporary entry, just past the room left for its header, and
+ * stderr into a second temporary file, so that everything the assembler
+ * writes is captured, whichever function writes it.  cacheFinish appends
+ * stderr to the entry, fills in the header, and renames the entry to its
+ * name.  Data is copied between files with sendfile, which the kernel
+ * does without copying it into the program; if sendfile cannot be used
+ * (e.g., stdout is a file opened for appending), it is read and written
+ * in blocks instead.
+ *
+ * The hash is xxHash64 (of the text, seeded with the hash of the
+ * options, which is seeded with the size, modification time, and inode
+ * of the assembler's executable, so a rebuilt assembler does not use the
+ * entries of the old one).
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "printFuncs.h"
+#include "stats.h"
+
+#define CACHE_MAGIC "ASMCACHE"
+#define CACHE_VERSION 1
+
+/* Number of hex digits in the name of an entry. */
+#define NAME_LENGTH 16
+
+/* Prefix of the names of temporary files, and the age (in seconds) after
+ * which one is assumed to be left by an assembler that was stopped.
+ */
+#define TEMPORARY_PREFIX "tmp-"
+#define STALE_TEMPORARY 3600
+
+/* Size of the blocks copied when sendfile cannot be used. */
+#define COPY_BLOCK_SIZE 65536
+
+/* The start of an entry. */
+typedef struct {
+        char     magic[8];      /* CACHE_MAGIC */
+        uint32_t version;       /* CACHE_VERSION */
+        int32_t  status;        /* exit status of the assembly */
+        uint64_t key;           /* hash of the source and options */
+        uint64_t outputLength;  /* bytes written to stdout */
+        uint64_t errorsLength;  /* bytes written to stderr */
+} CacheHeader;
+
+/* An entry found when removing old entries. */
+typedef struct {
+        char            name[NAME_LENGTH + 1];
+        struct timespec used;   /* modification time */
+        off_t           size;
+} CacheEntry;
+
+/* xxHash64 primes. */
+static const uint64_t PRIME1 = 11400714785074694791u;
+static const uint64_t PRIME2 = 14029467366897019727u;
+static const uint64_t PRIME3 = 1609587929392839161u;
+static const uint64_t PRIME4 = 9650029242287828579u;
+static const uint64_t PRIME5 = 2870177450012600261u;
+
+static const char * ERROR_WRITE = "Error: cannot write the output.\n";
+
+static int      startCapture (Cache * cache);
+static int      readHeader (int fd, uint64_t key, CacheHeader * header);
+static int      copyRange (int to, int from, off_t offset, uint64_t length);
+static void     removeOldEntries (Cache * cache);
+static int      compareEntries (const void * a, const void * b);
+static int      isEntryName (const char * name);
+static void     release (Cache * cache);
+static uint64_t executableHash (void);
+static uint64_t xxHash64 (const void * data, size_t length, uint64_t seed);
+static uint64_t xxRound (uint64_t accumulator, uint64_t input);
+static uint64_t xxMerge (uint64_t hash, uint64_t accumulator);
+static uint64_t xxRead64 (const unsigned char * p);
+static uint32_t xxRead32 (const unsigned char * p);
+static uint64_t rotateLeft (uint64_t value, int bits);
+
+CacheResult cacheLookup (Cache * cache, const char * directory,
+                         size_t maxSize, const char * text, size_t length,
+                         const void * options, size_t optionsSize,
+                         int * status)
+{
+    CacheHeader header;
+    uint64_t    key;
+    size_t      size = strlen (directory) + NAME_LENGTH + 2;
+    int         fd, ok;
+
+    memset (cache, 0, sizeof(Cache));
+    cache->fd = cache->errorsFd = cache->savedOut = cache->savedErr = -1;
+    cache->maxSize = maxSize;
+
+    cache->key = key = xxHash64 (text, length,
+                                 xxHash64 (options, optionsSize,
+                                           executableHash ()));
+    if ( (mkdir (directory, 0777) != 0 && errno != EEXIST) ||
+         (cache->directory = malloc (strlen (directory) + 1)) == NULL ||
+         (cache->entryPath = malloc (size)) == NULL ||
+         (cache->temporaryPath = malloc (size)) == NULL )
+    {
+        release (cache);
+        return CACHE_UNUSED;
+    }
+    strcpy (cache->directory, directory);
+    sprintf (cache->entryPath, "%s/%016llx", directory,
+             (unsigned long long) key);
+
+    if ( (fd = open (cache->entryPath, O_RDONLY)) >= 0 )
+    {
+        if ( readHeader (fd, key, &header) )
+        {
+            /* A hit: mark the entry as used, and copy it out. */
+            STATS_COUNT(cacheHits, 1);
+            (void) futimens (fd, NULL);
+            ok = copyRange (STDERR_FILENO, fd,
+                            (off_t) (sizeof(header) + header.outputLength),
+                            header.errorsLength) &&
+                 copyRange (STDOUT_FILENO, fd, (off_t) sizeof(header),
+                            header.outputLength);
+            if ( ! ok )
+                printError ("%s", ERROR_WRITE);
+            *status = ok ? header.status : 1;
+            (void) close (fd);
+            release (cache);
+            return CACHE_HIT;
+        }
+        (void) close (fd);
+    }
+
+    STATS_COUNT(cacheMisses, 1);
+    if ( ! startCapture (cache) )
+    {
+        release (cache);
+        return CACHE_UNUSED;
+    }
+    return CACHE_MISS;
+}
+
+int cacheFinish (Cache * cache, int status, int store)
+{
+    CacheHeader header;
+    off_t       outputEnd, errorsEnd;
+    int         ok;
+
+    (void) fflush (stdout);
+    (void) fflush (stderr);
+    outputEnd = lseek (cache->fd, 0, SEEK_CUR);
+    errorsEnd = lseek (cache->errorsFd, 0, SEEK_CUR);
+    (void) dup2 (cache->savedOut, STDOUT_FILENO);
+    (void) dup2 (cache->savedErr, STDERR_FILENO);
+    if ( outputEnd < (off_t) sizeof(header) || errorsEnd < 0 )
+        outputEnd = errorsEnd = 0;
+
+    /* Complete the entry: stderr after stdout, then the header. */
+    memcpy (header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.status = status;
+    header.key = cache->key;
+    header.outputLength = outputEnd > 0 ? (uint64_t) outputEnd
+                                          - sizeof(header) : 0;
+    header.errorsLength = (uint64_t) errorsEnd;
+    store = store && outputEnd > 0 &&
+            copyRange (cache->fd, cache->errorsFd, 0, header.errorsLength) &&
+            pwrite (cache->fd, &header, sizeof(header), 0)
+                == (ssize_t) sizeof(header) &&
+            rename (cache->temporaryPath, cache->entryPath) == 0;
+    if ( ! store )
+        (void) unlink (cache->temporaryPath);
+
+    ok = copyRange (STDERR_FILENO, cache->errorsFd, 0, header.errorsLength) &&
+         copyRange (STDOUT_FILENO, cache->fd, (off_t) sizeof(header),
+                    header.outputLength);
+    if ( store )
+        removeOldEntries (cache);
+    release (cache);
+    if ( ! ok )
+        printError ("%s", ERROR_WRITE);
+    return ok;
+}
+
+/*
+ * Creates the temporary files and redirects stdout and stderr into them.
+ * Returns 1 if everything went OK; 0 if not (leaving stdout and stderr
+ * as they were).
+ */
+static int startCapture (Cache * cache)
+{
+    sprintf (cache->temporaryPath, "%s/" TEMPORARY_PREFIX "XXXXXX",
+             cache->directory);
+    if ( (cache->errorsFd = mkstemp (cache->temporaryPath)) < 0 )
+        return 0;
+    (void) unlink (cache->temporaryPath);
+    sprintf (cache->temporaryPath, "%s/" TEMPORARY_PREFIX "XXXXXX",
+             cache->directory);
+    if ( (cache->fd = mkstemp (cache->temporaryPath)) < 0 )
+        return 0;
+    (void) fchmod (cache->fd, 0644);
+
+    (void) fflush (stdout);
+    (void) fflush (stderr);
+    if ( lseek (cache->fd, (off_t) sizeof(CacheHeader), SEEK_SET) < 0 ||
+         (cache->savedOut = dup (STDOUT_FILENO)) < 0 ||
+         (cache->savedErr = dup (STDERR_FILENO)) < 0 ||
+         dup2 (cache->fd, STDOUT_FILENO) < 0 )
+    {
+        (void) unlink (cache->temporaryPath);
+        return 0;
+    }
+    if ( dup2 (cache->errorsFd, STDERR_FILENO) < 0 )
+    {
+        (void) dup2 (cache->savedOut, STDOUT_FILENO);
+        (void) unlink (cache->temporaryPath);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Reads the header of the entry open as fd into header.
+ * Returns 1 if it is a complete entry for key; 0 otherwise.
+ */
+static int readHeader (int fd, uint64_t key, CacheHeader * header)
+{
+    struct stat status;
+
+    return pread (fd, header, sizeof(*header), 0) == (ssize_t) sizeof(*header)
+           && memcmp (header->magic, CACHE_MAGIC, sizeof(header->magic))
+                  == 0
+           && header->version == CACHE_VERSION && header->key == key
+           && fstat (fd, &status) == 0
+           && (uint64_t) status.st_size == sizeof(*header)
+                  + header->outputLength + header->errorsLength;
+}
+
+/*
+ * Copies length bytes of the file open as from, starting at offset, to
+ * the current position of to.
+ * Returns 1 if everything went OK; 0 otherwise.
+ */
+static int copyRange (int to, int from, off_t offset, uint64_t length)
+{
+    static char block[COPY_BLOCK_SIZE];
+    ssize_t     n = 0, written;
+    size_t      size;
+
+    while ( length > 0 )
+    {
+        size = length < (uint64_t) 1 << 30 ? (size_t) length
+                                           : (size_t) 1 << 30;
+        if ( (n = sendfile (to, from, &offset, size)) <= 0 )
+            break;
+        length -= (uint64_t) n;
+    }
+    if ( length == 0 )
+        return 1;
+    if ( n == 0 || (errno != EINVAL && errno != ENOSYS) )
+        return 0;
+
+    /* sendfile cannot write to this file: copy through a buffer. */
+    while ( length > 0 )
+    {
+        size = length < sizeof(block) ? (size_t) length : sizeof(block);
+        if ( (n = pread (from, block, size, offset)) <= 0 )
+            return 0;
+        offset += n;
+        length -= (uint64_t) n;
+        for ( size = 0; size < (size_t) n; size += (size_t) written )
+            if ( (written = write (to, block + size, (size_t) n - size))
+                 <= 0 )
+                return 0;
+    }
+    return 1;
+}
+
+/*
+ * Removes the least recently used entries until the entries take up at
+ * most the maximum size of the cache, and any temporary files that have
+ * been left behind.
+ */
+static void removeOldEntries (Cache * cache)
+{
+    DIR *           directory;
+    struct dirent * file;
+    struct stat     status;
+    CacheEntry *    entries = NULL;
+    void *          newArray;
+    size_t          nbrEntries = 0, capacity = 0, i;
+    uint64_t        total = 0;
+    time_t          now = time (NULL);
+
+    if ( (directory = opendir (cache->directory)) == NULL )
+        return;
+    while ( (file = readdir (directory)) != NULL )
+    {
+        if ( fstatat (dirfd (directory), file->d_name, &status, 0) != 0 )
+            continue;
+        if ( strncmp (file->d_name, TEMPORARY_PREFIX,
+                      strlen (TEMPORARY_PREFIX)) == 0 )
+        {
+            if ( now - status.st_mtime > STALE_TEMPORARY )
+                (void) unlinkat (dirfd (directory), file->d_name, 0);
+            continue;
+        }
+        if ( ! isEntryName (file->d_name) )
+            continue;
+        if ( nbrEntries >= capacity )
+        {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            if ( (newArray = realloc (entries, capacity * sizeof(CacheEntry)))
+                 == NULL )
+                break;
+            entries = newArray;
+        }
+        strcpy (entries[nbrEntries].name, file->d_name);
+        entries[nbrEntries].used = status.st_mtim;
+        entries[nbrEntries].size = status.st_size;
+        total += (uint64_t) status.st_size;
+        nbrEntries++;
+    }
+
+    if ( total > cache->maxSize )
+    {
+        qsort (entries, nbrEntries, sizeof(CacheEntry), compareEntries);
+        for ( i = 0; i < nbrEntries && total > cache->maxSize; i++ )
+        {
+            if ( unlinkat (dirfd (directory), entries[i].name, 0) == 0 )
+                total -= (uint64_t) entries[i].size;
+        }
+    }
+    (void) closedir (directory);
+    free (entries);
+}
+
+/* Orders entries from the least to the most recently used. */
+static int compareEntries (const void * a, const void * b)
+{
+    const struct timespec * first = &((const CacheEntry *) a)->used;
+    const struct timespec * second = &((const CacheEntry *) b)->used;
+
+    if ( first->tv_sec != second->tv_sec )
+        return first->tv_sec < second->tv_sec ? -1 : 1;
+    return first->tv_nsec < second->tv_nsec ? -1
+                                             : first->tv_nsec > second->tv_nsec;
+}
+
+/* Returns 1 if name is the name of an entry (NAME_LENGTH hex digits). */
+static int isEntryName (const char * name)
+{
+    int i;
+
+    for ( i = 0; i < NAME_LENGTH; i++ )
+        if ( ! ((name[i] >= '0' && name[i] <= '9') ||
+                (name[i] >= 'a' && name[i] <= 'f')) )
+            return 0;
+    return name[NAME_LENGTH] == '\0';
+}
+
+/* Closes the files of the cache and releases its memory. */
+static void release (Cache * cache)
+{
+    if ( cache->fd >= 0 )
+        (void) close (cache->fd);
+    if ( cache->errorsFd >= 0 )
+        (void) close (cache->errorsFd);
+    if ( cache->savedOut >= 0 )
+        (void) close (cache->savedOut);
+    if ( cache->savedErr >= 0 )
+        (void) close (cache->savedErr);
+    free (cache->directory);
+    free (cache->entryPath);
+    free (cache->temporaryPath);
+    memset (cache, 0, sizeof(Cache));
+    cache->fd = cache->errorsFd = cache->savedOut = cache->savedErr = -1;
+}
+
+/*
+ * Returns a hash of the identity of the assembler's executable: its
+ * size, modification time, and inode (0 if it cannot be found).
+ */
+static uint64_t executableHash (void)
+{
+    struct stat status;
+    uint64_t    identity[4];
+
+    if ( stat ("/proc/self/exe", &status) != 0 )
+        return 0;
+    identity[0] = (uint64_t) status.st_size;
+    identity[1] = (uint64_t) status.st_mtim.tv_sec;
+    identity[2] = (uint64_t) status.st_mtim.tv_nsec;
+    identity[3] = (uint64_t) status.st_ino;
+    return xxHash64 (identity, sizeof(identity), CACHE_VERSION);
+}
+
+/* Returns the xxHash64 hash of length bytes of data with the given seed. */
+static uint64_t xxHash64 (const void * data, size_t length, uint64_t seed)
+{
+    const unsigned char * p = data;
+    const unsigned char * end = p + length;
+    uint64_t              v1, v2, v3, v4, hash;
+
+    if ( length >= 32 )
+    {
+        v1 = seed + PRIME1 + PRIME2;
+        v2 = seed + PRIME2;
+        v3 = seed;
+        v4 = seed - PRIME1;
+        do
+        {
+            v1 = xxRound (v1, xxRead64 (p));
+            v2 = xxRound (v2, xxRead64 (p + 8));
+            v3 = xxRound (v3, xxRead64 (p + 16));
+            v4 = xxRound (v4, xxRead64 (p + 24));
+            p += 32;
+        } while ( end - p >= 32 );
+        hash = rotateLeft (v1, 1) + rotateLeft (v2, 7) +
+               rotateLeft (v3, 12) + rotateLeft (v4, 18);
+        hash = xxMerge (hash, v1);
+        hash = xxMerge (hash, v2);
+        hash = xxMerge (hash, v3);
+        hash = xxMerge (hash, v4);
+    }
+    else
+        hash = seed + PRIME5;
+    hash += (uint64_t) length;
+
+    for ( ; end - p >= 8; p += 8 )
+    {
+        hash ^= xxRound (0, xxRead64 (p));
+        hash = rotateLeft (hash, 27) * PRIME1 + PRIME4;
+    }
+    if ( end - p >= 4 )
+    {
+        hash ^= (uint64_t) xxRead32 (p) * PRIME1;
+        hash = rotateLeft (hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for ( ; p < end; p++ )
+    {
+        hash ^= *p * PRIME5;
+        hash = rotateLeft (hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static uint64_t xxRound (uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * PRIME2;
+    return rotateLeft (accumulator, 31) * PRIME1;
+}
+
+static uint64_t xxMerge (uint64_t hash, uint64_t accumulator)
+{
+    hash ^= xxRound (0, accumulator);
+    return hash * PRIME1 + PRIME4;
+}
+
+/* Returns the 8 bytes at p as a little-endian number. */
+static uint64_t xxRead64 (const unsigned char * p)
+{
+    return (uint64_t) xxRead32 (p) | (uint64_t) xxRead32 (p + 4) << 32;
+}
+
+/* Returns the 4 bytes at p as a little-endian number. */
+static uint32_t xxRead32 (const unsigned char * p)
+{
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+           (uint32_t) p[3] << 24;
+}
+
+static uint64_t rotateLeft (uint64_t value, int bits)
+{
+    return value << bits | value >> (64 - bits);
+}
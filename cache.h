@@ -0,0 +1,87 @@
+/*
+ * Cache: a directory of assembled outputs, shared by assembler runs
+ *
+ * Assembling a source that has been assembled before, with the same
+ * options, gives the same machine code and messages, so these can be
+ * kept and written out again instead of assembling the source.  An
+ * entry in the cache directory is named after a 64-bit hash (xxHash64)
+ * of the source text, the options that affect the output, and the
+ * build of the assembler, and holds everything the assembly wrote to
+ * stdout and to stderr and its exit status.
+ *
+ * cacheLookup looks for the entry of a source.  If there is one (a
+ * hit), its output is copied to stdout and stderr with sendfile, without
+ * passing through the program's memory, and the source need not be
+ * assembled.  Otherwise (a miss), stdout and stderr are redirected into
+ * a new entry while the source is assembled as usual, and cacheFinish
+ * copies them to the real stdout and stderr and adds the entry to the
+ * cache.
+ *
+ * Entries are written to a temporary file in the cache directory and
+ * renamed to their names once they are complete, so any number of
+ * assemblers can share a cache: an entry is either there in full or not
+ * at all, and two assemblers that add the same entry at once just
+ * replace one copy with another.  Using an entry updates its
+ * modification time; after an entry is added, the least recently used
+ * entries are removed until the entries take up at most the cache's
+ * maximum size (so the cache only exceeds its size while entries are
+ * being written).
+ *
+ * If the cache directory cannot be created or used, the source is
+ * assembled as usual, without a message: a cache only saves time.  The
+ * hits and misses are counted in the --stats report.
+ *
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum size of the cache if none is given, in megabytes. */
+#define CACHE_DEFAULT_SIZE 256
+
+typedef enum {
+        CACHE_UNUSED,           /* the cache cannot be used */
+        CACHE_HIT,              /* the output was copied from the cache */
+        CACHE_MISS              /* the output is being captured */
+} CacheResult;
+
+typedef struct {
+        char *   directory;
+        uint64_t key;           /* hash of the source and options */
+        char *   entryPath;     /* the entry of the source */
+        char *   temporaryPath; /* the entry while it is written */
+        size_t   maxSize;       /* most bytes the entries may take up */
+        int      fd;            /* the entry being written */
+        int      errorsFd;      /* stderr, while it is captured */
+        int      savedOut;      /* the real stdout, while captured */
+        int      savedErr;      /* the real stderr, while captured */
+} Cache;
+
+CacheResult cacheLookup (Cache * cache, const char * directory,
+                         size_t maxSize, const char * text, size_t length,
+                         const void * options, size_t optionsSize,
+                         int * status);
+        /* Looks in directory (which is created if it does not exist) for
+         *      the entry of the length characters of text assembled with
+         *      the given options, which are compared byte for byte.
+         * Postcondition: on a hit, the entry's output has been written
+         *      to stdout and stderr and *status set to its exit status
+         *      (or 1 if it could not be written); on a miss, stdout and
+         *      stderr are being captured until cacheFinish is called.
+         * Returns CACHE_HIT, CACHE_MISS, or CACHE_UNUSED (nothing done).
+         */
+
+int cacheFinish (Cache * cache, int status, int store);
+        /* Precondition: cacheLookup returned CACHE_MISS.
+         * Postcondition: stdout and stderr are the real ones again and
+         *      what was captured has been written to them; if store is
+         *      true, it has been added to the cache with exit status
+         *      status, and old entries removed if the cache is full.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the output could not be written.
+         */
+
+#endif
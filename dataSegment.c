@@ -0,0 +1,606 @@
+/*
+ * Data Segment: functions to assemble the data directives
+ *
+ * This file provides the definitions of the functions declared in
+ * dataSegment.h.  Each line of data is converted straight into the
+ * segment's array of bytes: room for the most data the line could
+ * hold is reserved first (a value takes at least two characters, with
+ * its separator), so the values are stored without checking the size of
+ * the array each time.  If the line turns out to have an error, the
+ * segment is cut back to its size before the line.
+ *
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dataSegment.h"
+#include "diagnostics.h"
+#include "number.h"
+#include "printFuncs.h"
+#include "sourceFile.h"
+
+/* Capacity of the data, or of the names, when the first is added. */
+#define INITIAL_CAPACITY 4096
+
+/* The directives. */
+typedef enum {
+        DIRECTIVE_TEXT,
+        DIRECTIVE_DATA,
+        DIRECTIVE_VALUES,       /* .word, .half, .byte */
+        DIRECTIVE_SPACE,
+        DIRECTIVE_STRING,       /* .ascii, .asciiz */
+        DIRECTIVE_GLOBAL
+} DirectiveKind;
+
+typedef struct {
+        const char *  name;
+        DirectiveKind kind;
+        int           size;     /* bytes per value (and alignment); for
+                                 * strings, 1 if null-terminated */
+} Directive;
+
+static const Directive DIRECTIVES[] = {
+        { ".text",   DIRECTIVE_TEXT,   0 },
+        { ".data",   DIRECTIVE_DATA,   0 },
+        { ".word",   DIRECTIVE_VALUES, 4 },
+        { ".half",   DIRECTIVE_VALUES, 2 },
+        { ".byte",   DIRECTIVE_VALUES, 1 },
+        { ".space",  DIRECTIVE_SPACE,  1 },
+        { ".ascii",  DIRECTIVE_STRING, 0 },
+        { ".asciiz", DIRECTIVE_STRING, 1 },
+        { ".globl",  DIRECTIVE_GLOBAL, 0 }
+};
+
+/* What assembling the data of a line came to. */
+#define DATA_OK         1       /* the data has been added */
+#define DATA_ERROR      0       /* an error has been reported */
+#define DATA_NO_MEMORY  (-1)    /* an error has been printed */
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+static const Directive * findDirective (Span name);
+static int  addValues (DataSegment * data, int size, Span rest,
+                       int lineNum, int column, Span name);
+static int  addSpace (DataSegment * data, Span rest, int lineNum,
+                      int column, Span name);
+static int  addString (DataSegment * data, int terminated, Span rest,
+                       int lineNum, int column);
+static int  addGlobals (DataSegment * data, Span rest, int lineNum,
+                        int column, Span name);
+static int  addName (DataSegment * data, Span name, size_t * offset);
+static int  isBlank (Span rest);
+static int  reserve (DataSegment * data, size_t length);
+static int  isSeparator (char c);
+
+void dataInit (DataSegment * data)
+{
+    memset (data, 0, sizeof(DataSegment));
+    data->firstLabel = INT_MAX;
+}
+
+void dataFree (DataSegment * data)
+{
+    free (data->bytes);
+    free (data->labels);
+    free (data->names);
+    free (data->globals);
+    dataInit (data);
+}
+
+int isDirective (Span name)
+{
+    return name.length > 0 && name.text[0] == '.';
+}
+
+int checkSegment (const DataSegment * data, Span name, int lineNum,
+                  int column)
+{
+    if ( data->inData )
+    {
+        diagError (DIAG_WRONG_SEGMENT, lineNum, column, name,
+                   "\nError on line %d: instruction '%.*s' is in the data segment.\n");
+        return 0;
+    }
+    return 1;
+}
+
+int dataDirective (DataSegment * data, Span name, Span rest, int lineNum,
+                   int column, uint32_t * offset)
+{
+    const Directive * directive = findDirective (name);
+    size_t            start = data->size;
+    int               status;
+
+    *offset = (uint32_t) data->size;
+    if ( directive == NULL )
+    {
+        diagError (DIAG_BAD_DIRECTIVE, lineNum, column, name,
+                   "\nError on line %d: invalid directive '%.*s'.\n");
+        return 1;
+    }
+
+    /* Labels made global, which have no data. */
+    if ( directive->kind == DIRECTIVE_GLOBAL )
+        return addGlobals (data, rest, lineNum, column, name) != DATA_NO_MEMORY;
+
+    /* A segment switch. */
+    if ( directive->kind == DIRECTIVE_TEXT ||
+         directive->kind == DIRECTIVE_DATA )
+    {
+        if ( ! isBlank (rest) )
+            diagError (DIAG_BAD_OPERANDS, lineNum, column, name,
+                       "\nError on line %d: '%.*s' takes no operands.\n");
+        else
+            data->inData = directive->kind == DIRECTIVE_DATA;
+        return 1;
+    }
+
+    if ( ! data->inData )
+    {
+        diagError (DIAG_WRONG_SEGMENT, lineNum, column, name,
+                   "\nError on line %d: '%.*s' is only allowed in the data segment.\n");
+        return 1;
+    }
+
+    /* Align the data to the size of its values, with zero bytes. */
+    if ( directive->kind == DIRECTIVE_VALUES &&
+         data->size % (size_t) directive->size != 0 )
+    {
+        if ( ! reserve (data, (size_t) directive->size) )
+            return 0;
+        while ( data->size % (size_t) directive->size != 0 )
+            data->bytes[data->size++] = 0;
+    }
+    *offset = (uint32_t) data->size;
+
+    switch ( directive->kind )
+    {
+        case DIRECTIVE_VALUES:
+            status = addValues (data, directive->size, rest, lineNum, column,
+                                name);
+            break;
+        case DIRECTIVE_SPACE:
+            status = addSpace (data, rest, lineNum, column, name);
+            break;
+        default:
+            status = addString (data, directive->size, rest, lineNum,
+                                column);
+            break;
+    }
+    if ( status == DATA_OK && data->size > MAX_DATA_SIZE )
+    {
+        diagError (DIAG_BAD_VALUE, lineNum, column, DIAG_NO_ARGUMENT,
+                   "\nError on line %d: the data segment is too big.\n");
+        status = DATA_ERROR;
+    }
+    if ( status != DATA_OK )
+        data->size = start;     /* the line adds no data */
+    return status != DATA_NO_MEMORY;
+}
+
+int dataAddLabel (DataSegment * data, Span label, uint32_t offset)
+{
+    DataLabel * labels;
+    size_t      capacity;
+
+    if ( data->nbrLabels >= data->labelCapacity )
+    {
+        capacity = data->labelCapacity > 0 ? (size_t) data->labelCapacity * 2
+                                           : 64;
+        if ( (labels = realloc (data->labels, capacity * sizeof(DataLabel)))
+             == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return 0;
+        }
+        data->labels = labels;
+        data->labelCapacity = (int) capacity;
+    }
+    if ( ! addName (data, label, &data->labels[data->nbrLabels].name) )
+        return 0;
+    data->labels[data->nbrLabels].length = label.length;
+    data->labels[data->nbrLabels].offset = offset;
+    data->nbrLabels++;
+    return 1;
+}
+
+int dataPlace (DataSegment * data, LabelTable * table, uint32_t textEnd)
+{
+    int i;
+
+    data->address = (textEnd + 3) & ~(uint32_t) 3;
+    if ( table != NULL )
+        data->firstLabel = table->nbrLabels;
+    for ( i = 0; table != NULL && i < data->nbrLabels; i++ )
+    {
+        if ( ! addLabelN (table, data->names + data->labels[i].name,
+                          data->labels[i].length,
+                          (int) (data->address + data->labels[i].offset)) )
+            return 0;           /* error message already printed */
+    }
+    return 1;
+}
+
+size_t dataNbrWords (const DataSegment * data)
+{
+    return (data->size + 3) / 4;
+}
+
+uint32_t dataWord (const DataSegment * data, size_t i)
+{
+    const unsigned char * bytes = data->bytes + 4 * i;
+
+    if ( 4 * i + 4 <= data->size )
+        return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 |
+               (uint32_t) bytes[2] << 8 | bytes[3];
+
+    /* The last word, padded with zeros. */
+    return (uint32_t) bytes[0] << 24 |
+           (4 * i + 1 < data->size ? (uint32_t) bytes[1] << 16 : 0) |
+           (4 * i + 2 < data->size ? (uint32_t) bytes[2] << 8 : 0);
+}
+
+int dataWrite (const DataSegment * data, OutputFile * output)
+{
+    size_t nbrWords = dataNbrWords (data);
+    size_t i;
+
+    for ( i = 0; i < nbrWords; i++ )
+    {
+        if ( ! outputWord (output, data->address + 4 * (uint32_t) i,
+                           dataWord (data, i)) )
+            return 0;           /* error message already printed */
+    }
+    return 1;
+}
+
+int hasDirectives (const char * text, size_t length)
+{
+    const char * end = text + length;
+    const char * dot;
+    const char * start;
+    const char * newline;
+    Span         line, label, name, operands;
+
+    for ( dot = memchr (text, '.', length); dot != NULL;
+          dot = newline != NULL
+                    ? memchr (newline, '.', (size_t) (end - newline))
+                    : NULL )
+    {
+        for ( start = dot; start > text && start[-1] != '\n'; start-- )
+            ;
+        newline = memchr (dot, '\n', (size_t) (end - dot));
+        line.text = start;
+        line.length = (int) ((newline != NULL ? newline : end) - start);
+        if ( parseLine (line, &label, &name, &operands) &&
+             isDirective (name) )
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns the directive named name; NULL if there is none. */
+static const Directive * findDirective (Span name)
+{
+    int i;
+
+    for ( i = 0; i < (int) (sizeof(DIRECTIVES) / sizeof(DIRECTIVES[0]));
+          i++ )
+    {
+        if ( (int) strlen (DIRECTIVES[i].name) == name.length &&
+             memcmp (DIRECTIVES[i].name, name.text, (size_t) name.length)
+                 == 0 )
+            return &DIRECTIVES[i];
+    }
+    return NULL;
+}
+
+/*
+ * Adds the values in rest, each of size bytes, to the data.
+ * Returns DATA_OK, DATA_ERROR, or DATA_NO_MEMORY.
+ */
+static int addValues (DataSegment * data, int size, Span rest,
+                      int lineNum, int column, Span name)
+{
+    /* The range of the values of each size, signed or unsigned. */
+    static const int64_t MIN_VALUE[] = { 0, -128, -32768, 0, -2147483648LL };
+    static const int64_t MAX_VALUE[] = { 0, 255, 65535, 0, 4294967295LL };
+    const char *    next = rest.text;
+    const char *    end = rest.text + rest.length;
+    unsigned char * bytes;
+    int64_t         value;
+    Span            token;
+    int             length;
+
+    if ( ! reserve (data, (size_t) size * ((size_t) rest.length / 2 + 1)) )
+        return DATA_NO_MEMORY;
+    bytes = data->bytes + data->size;
+
+    for ( ;; )
+    {
+        while ( next < end && isSeparator (*next) )
+            next++;
+        if ( next == end || *next == '#' )
+            break;
+
+        /* The next value: a character literal (which may hold a
+         * separator) or everything up to the next separator.
+         */
+        token.text = next;
+        if ( *next == '\'' )
+        {
+            if ( ++next < end )
+            {
+                (void) parseCharacter (next, end, &length);
+                next += length;
+            }
+            if ( next < end && *next == '\'' )
+                next++;
+        }
+        else
+        {
+            while ( next < end && ! isSeparator (*next) && *next != '#' )
+                next++;
+        }
+        token.length = (int) (next - token.text);
+
+        if ( ! parseNumber (token, &value) || value < MIN_VALUE[size] ||
+             value > MAX_VALUE[size] )
+        {
+            diagError (DIAG_BAD_VALUE, lineNum, column, token,
+                       "\nError on line %d: invalid value '%.*s'.\n");
+            return DATA_ERROR;
+        }
+        switch ( size )
+        {
+            case 4:
+                bytes[0] = (unsigned char) (value >> 24);
+                bytes[1] = (unsigned char) (value >> 16);
+                bytes[2] = (unsigned char) (value >> 8);
+                bytes[3] = (unsigned char) value;
+                break;
+            case 2:
+                bytes[0] = (unsigned char) (value >> 8);
+                bytes[1] = (unsigned char) value;
+                break;
+            default:
+                bytes[0] = (unsigned char) value;
+                break;
+        }
+        bytes += size;
+    }
+
+    if ( bytes == data->bytes + data->size )
+    {
+        diagError (DIAG_BAD_OPERANDS, lineNum, column, name,
+                   "\nError on line %d: '%.*s' needs a value.\n");
+        return DATA_ERROR;
+    }
+    data->size = (size_t) (bytes - data->bytes);
+    return DATA_OK;
+}
+
+/*
+ * Adds the number of zero bytes given in rest to the data.
+ * Returns DATA_OK, DATA_ERROR, or DATA_NO_MEMORY.
+ */
+static int addSpace (DataSegment * data, Span rest, int lineNum,
+                     int column, Span name)
+{
+    const char * end = rest.text + rest.length;
+    int64_t      count;
+    Span         token;
+
+    token = rest;
+    while ( token.text < end && isSeparator (*token.text) &&
+            *token.text != ',' )
+        token.text++;
+    for ( token.length = 0; token.text + token.length < end &&
+                            ! isSeparator (token.text[token.length]) &&
+                            token.text[token.length] != '#';
+          token.length++ )
+        ;
+    if ( token.length == 0 )
+    {
+        diagError (DIAG_BAD_OPERANDS, lineNum, column, name,
+                   "\nError on line %d: '%.*s' needs a value.\n");
+        return DATA_ERROR;
+    }
+    rest.text = token.text + token.length;
+    rest.length = (int) (end - rest.text);
+    if ( ! parseNumber (token, &count) || count < 0 ||
+         (uint64_t) count > MAX_DATA_SIZE - data->size || ! isBlank (rest) )
+    {
+        diagError (DIAG_BAD_VALUE, lineNum, column, token,
+                   "\nError on line %d: invalid value '%.*s'.\n");
+        return DATA_ERROR;
+    }
+
+    if ( ! reserve (data, (size_t) count) )
+        return DATA_NO_MEMORY;
+    memset (data->bytes + data->size, 0, (size_t) count);
+    data->size += (size_t) count;
+    return DATA_OK;
+}
+
+/*
+ * Adds the characters of the string in rest to the data, followed by a
+ * zero byte if terminated is 1.
+ * Returns DATA_OK, DATA_ERROR, or DATA_NO_MEMORY.
+ */
+static int addString (DataSegment * data, int terminated, Span rest,
+                      int lineNum, int column)
+{
+    const char *    next = rest.text;
+    const char *    end = rest.text + rest.length;
+    unsigned char * bytes;
+    Span            after;
+    int             character, length;
+
+    if ( ! reserve (data, (size_t) rest.length + 1) )
+        return DATA_NO_MEMORY;
+    bytes = data->bytes + data->size;
+
+    while ( next < end && isSeparator (*next) && *next != ',' )
+        next++;
+    rest.text = next;
+    rest.length = (int) (end - next);
+    if ( next == end || *next != '"' )
+    {
+        diagError (DIAG_BAD_VALUE, lineNum, column, rest,
+                   "\nError on line %d: invalid string: %.*s\n");
+        return DATA_ERROR;
+    }
+
+    for ( next++; next < end && *next != '"'; next += length )
+    {
+        if ( (character = parseCharacter (next, end, &length)) == -1 )
+            break;
+        *bytes++ = (unsigned char) character;
+    }
+    after.text = next + 1;
+    after.length = (int) (end - after.text);
+    if ( next >= end || *next != '"' || ! isBlank (after) )
+    {
+        diagError (DIAG_BAD_VALUE, lineNum, column, rest,
+                   "\nError on line %d: invalid string: %.*s\n");
+        return DATA_ERROR;
+    }
+
+    if ( terminated )
+        *bytes++ = 0;
+    data->size = (size_t) (bytes - data->bytes);
+    return DATA_OK;
+}
+
+/*
+ * Keeps the names in rest, the operands of a .globl, as global names.
+ * Returns DATA_OK, DATA_ERROR, or DATA_NO_MEMORY.
+ */
+static int addGlobals (DataSegment * data, Span rest, int lineNum,
+                       int column, Span name)
+{
+    const char * next = rest.text;
+    const char * end = rest.text + rest.length;
+    GlobalName * globals;
+    size_t       capacity;
+    Span         token;
+    int          nbrGlobals = data->nbrGlobals;
+
+    for ( ;; )
+    {
+        while ( next < end && isSeparator (*next) )
+            next++;
+        if ( next == end || *next == '#' )
+            break;
+        for ( token.text = next; next < end && ! isSeparator (*next) &&
+                                 *next != '#'; next++ )
+            ;
+        token.length = (int) (next - token.text);
+
+        if ( data->nbrGlobals >= data->globalCapacity )
+        {
+            capacity = data->globalCapacity > 0
+                           ? (size_t) data->globalCapacity * 2 : 64;
+            if ( (globals = realloc (data->globals,
+                                     capacity * sizeof(GlobalName))) == NULL )
+            {
+                printError ("%s", ERROR_MEMORY);
+                return DATA_NO_MEMORY;
+            }
+            data->globals = globals;
+            data->globalCapacity = (int) capacity;
+        }
+        if ( ! addName (data, token, &data->globals[data->nbrGlobals].name) )
+            return DATA_NO_MEMORY;
+        data->globals[data->nbrGlobals].length = token.length;
+        data->globals[data->nbrGlobals].lineNum = lineNum;
+        data->nbrGlobals++;
+    }
+
+    if ( data->nbrGlobals == nbrGlobals )
+    {
+        diagError (DIAG_BAD_OPERANDS, lineNum, column, name,
+                   "\nError on line %d: '%.*s' needs a label.\n");
+        return DATA_ERROR;
+    }
+    return DATA_OK;
+}
+
+/*
+ * Adds a copy of name to the names of data, and sets *offset to where
+ * it starts.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int addName (DataSegment * data, Span name, size_t * offset)
+{
+    char * names;
+    size_t capacity;
+
+    if ( data->namesLength + (size_t) name.length > data->namesCapacity )
+    {
+        capacity = data->namesCapacity > 0 ? data->namesCapacity
+                                           : INITIAL_CAPACITY;
+        while ( capacity < data->namesLength + (size_t) name.length )
+            capacity *= 2;
+        if ( (names = realloc (data->names, capacity)) == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return 0;
+        }
+        data->names = names;
+        data->namesCapacity = capacity;
+    }
+    memcpy (data->names + data->namesLength, name.text, (size_t) name.length);
+    *offset = data->namesLength;
+    data->namesLength += (size_t) name.length;
+    return 1;
+}
+
+/* Returns 1 if rest is only whitespace, maybe followed by a comment. */
+static int isBlank (Span rest)
+{
+    int i;
+
+    for ( i = 0; i < rest.length && rest.text[i] != '#'; i++ )
+    {
+        if ( ! isSeparator (rest.text[i]) || rest.text[i] == ',' )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Makes room for length more bytes of data.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int reserve (DataSegment * data, size_t length)
+{
+    unsigned char * bytes;
+    size_t          capacity;
+
+    if ( data->size + length <= data->capacity )
+        return 1;
+    capacity = data->capacity > 0 ? data->capacity : INITIAL_CAPACITY;
+    while ( capacity < data->size + length )
+        capacity *= 2;
+    if ( (bytes = realloc (data->bytes, capacity)) == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    data->bytes = bytes;
+    data->capacity = capacity;
+    return 1;
+}
+
+/* Returns 1 if c separates values (whitespace or a comma); 0 otherwise. */
+static int isSeparator (char c)
+{
+    return c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n' ||
+           c == '\v' || c == '\f';
+}
@@ -0,0 +1,179 @@
+/*
+ * Data Segment: the data directives and the data they assemble
+ *
+ * A program is made of two segments, each with its own location
+ * counter: the text segment, which holds the instructions, and the data
+ * segment, which holds the data given by data directives.  The program
+ * starts in the text segment; ".data" switches to the data segment and
+ * ".text" back to the text segment.  In the text segment, every line
+ * that is not a directive takes up a word, as it always has (so blank
+ * lines, comments, and label-only lines leave a zero word); in the data
+ * segment, only the data takes up room, and instructions are errors.
+ *
+ * The data directives, which may only be used in the data segment, are
+ *      .word  v1, v2, ...      32-bit words (aligned to 4 bytes)
+ *      .half  v1, v2, ...      16-bit halfwords (aligned to 2 bytes)
+ *      .byte  v1, v2, ...      bytes
+ *      .space n                n zero bytes
+ *      .ascii "string"         the characters of the string
+ *      .asciiz "string"        the characters, then a zero byte
+ * where each value is a number or character literal (see number.h) that
+ * fits in the size of the item, signed or unsigned, and the values are
+ * separated by commas and/or whitespace.  A string may contain the
+ * escape sequences of number.h (and may contain '#', which does not
+ * start a comment there).  A line with an error adds no data.
+ *
+ * The data segment starts at the first word after the text segment, so
+ * the machine code is one contiguous image: the instructions, then the
+ * data, as big-endian words (the byte at the lowest address is the most
+ * significant byte of its word), with the last word padded with zeros.
+ * Since the size of the text segment is only known at the end of the
+ * input, a label in the data segment is kept here with its offset in the
+ * segment, and added to the label table (after all the labels of the
+ * text segment) by dataPlace, once the address of the segment is known.
+ *
+ * ".globl name, ..." (in either segment) makes the labels named global:
+ * they are exported by an object file (see objectFile.h), and, if they
+ * are not defined in the program, imported from other programs.  When
+ * the program is assembled on its own, it has no effect.
+ *
+ * The data is appended to one growing array of bytes as each directive
+ * is read, and values are converted without copying them out of the
+ * line (see number.h), so a table of millions of values is assembled
+ * about as fast as the source can be read.
+ *
+ */
+
+#ifndef _DATASEGMENT_H
+#define _DATASEGMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LabelTable.h"
+#include "getToken.h"
+#include "outputFile.h"
+
+/* Largest size of the data segment, in bytes. */
+#define MAX_DATA_SIZE   ((size_t) 1 << 30)
+
+/* A label in the data segment, waiting for the segment's address. */
+typedef struct {
+        size_t   name;          /* offset of its name in names */
+        int      length;        /* length of the name */
+        uint32_t offset;        /* offset of the label in the segment */
+} DataLabel;
+
+/* A name made global with .globl. */
+typedef struct {
+        size_t   name;          /* offset of the name in names */
+        int      length;        /* length of the name */
+        int      lineNum;       /* line of the .globl */
+} GlobalName;
+
+typedef struct {
+        unsigned char * bytes;  /* the data, in order of address */
+        size_t      size;       /* bytes of data */
+        size_t      capacity;
+        int         inData;     /* 1 in the data segment; 0 in text */
+        uint32_t    address;    /* address of bytes[0], which is also the
+                                 * size of the text segment (see
+                                 * dataPlace) */
+        DataLabel * labels;     /* the labels in the segment, in order */
+        int         nbrLabels;
+        int         labelCapacity;
+        int         firstLabel; /* position in the label table of the
+                                 * first label added by dataPlace
+                                 * (INT_MAX until then) */
+        GlobalName * globals;   /* the names made global, in order */
+        int         nbrGlobals;
+        int         globalCapacity;
+        char *      names;      /* their names, one after another (not
+                                 * null-terminated) */
+        size_t      namesLength;
+        size_t      namesCapacity;
+} DataSegment;
+
+void dataInit (DataSegment * data);
+        /* Postcondition: data is empty, and the text segment is the
+         *      current segment.
+         */
+
+void dataFree (DataSegment * data);
+        /* Postcondition: the memory of data has been released, and it
+         *      is empty (as after dataInit).
+         */
+
+int isDirective (Span name);
+        /* Returns 1 if name, the first word of a statement (after any
+         *      label), is a directive (it starts with '.'); 0 if it is
+         *      an instruction name.
+         */
+
+int checkSegment (const DataSegment * data, Span name, int lineNum,
+                  int column);
+        /* Precondition: name is the name of an instruction (not a
+         *      directive) at the given line and column.
+         * Returns 1 if the current segment is the text segment; 0 (after
+         *      reporting an error) if it is the data segment.
+         */
+
+int dataDirective (DataSegment * data, Span name, Span rest, int lineNum,
+                   int column, uint32_t * offset);
+        /* Precondition: isDirective(name); rest is the rest of the line
+         *      after name, including any comment.
+         * Postcondition: the directive has been carried out: the
+         *      current segment has been switched, or the data has been
+         *      added to the data segment (aligned as needed), or an error
+         *      has been reported (see diagnostics.h) and nothing has
+         *      changed.  *offset is the offset in the data segment at
+         *      which the data starts (the address of a label on the
+         *      line, if it is in the data segment).
+         * Returns 1 if everything went OK (even if an error was
+         *      reported); 0 (after printing an error) if memory
+         *      allocation error.
+         */
+
+int dataAddLabel (DataSegment * data, Span label, uint32_t offset);
+        /* Postcondition: label, at offset in the data segment, has been
+         *      kept (with its own copy of the name) for dataPlace.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if memory allocation error.
+         */
+
+int dataPlace (DataSegment * data, LabelTable * table, uint32_t textEnd);
+        /* Precondition: textEnd is the address after the text segment.
+         * Postcondition: the data segment starts at the first word at or
+         *      after textEnd, and its labels have been added to table,
+         *      in order, with their addresses (duplicates are reported
+         *      as by addLabelN).  table may be NULL to only place the
+         *      segment.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if memory allocation error.
+         */
+
+size_t dataNbrWords (const DataSegment * data);
+        /* Returns the number of words the data takes up. */
+
+uint32_t dataWord (const DataSegment * data, size_t i);
+        /* Precondition: i < dataNbrWords(data).
+         * Returns the i-th word of the data, at data->address + 4 * i.
+         */
+
+int dataWrite (const DataSegment * data, OutputFile * output);
+        /* Precondition: data has been placed (see dataPlace), after the
+         *      last instruction written to output.
+         * Postcondition: the words of the data have been added to
+         *      output at their addresses.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the output could not be written.
+         */
+
+int hasDirectives (const char * text, size_t length);
+        /* Returns 1 if some line of the length characters of text has a
+         *      directive; 0 otherwise.  (Only lines with a '.' are
+         *      looked at, so text without any is checked at the speed
+         *      of memchr.)
+         */
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Diagnostics: collecting the errors found in the source program
+ *
+ * This file provides the definitions of the functions declared in
+ * diagnostics.h.  A collector keeps its errors in a growable array, and
+ * copies their arguments into one growable buffer, since the text they
+ * point to may not outlive the line (see sourceOpenStream).  Errors are
+ * formatted only by diagPrint: the errors are sorted (unless they are
+ * in order already, as they usually are) and each one's message is
+ * printed from its format, or formatted into a buffer to be put in the
+ * JSON output.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "printFuncs.h"
+#include "stats.h"
+
+/* The name of each DiagCode in the JSON output. */
+static const char * DIAG_CODE_NAMES[DIAG_NBR_CODES] = {
+        "invalid-instruction",
+        "operand-count",
+        "invalid-register",
+        "shamt-range",
+        "immediate-range",
+        "undefined-label",
+        "address-range",
+        "invalid-directive",
+        "wrong-segment",
+        "invalid-value"
+};
+
+static const char * ERROR_DROPPED =
+    "\nError: too many errors; %d more were not reported.\n";
+
+/* The collector of each thread; NULL: print errors when they are found. */
+static _Thread_local Diagnostics * collector = NULL;
+
+static void addEntry (Diagnostics * diagnostics, DiagCode code, int lineNum,
+                      int column, Span argument, const char * format);
+static void siftDown (Diagnostics * diagnostics, int i);
+static int  compareEntries (const void * a, const void * b);
+static void printJson (const Diagnostics * diagnostics, FILE * fp);
+static void printJsonString (FILE * fp, const char * text, size_t length);
+
+void diagInit (Diagnostics * diagnostics, int limit)
+{
+    memset (diagnostics, 0, sizeof(Diagnostics));
+    diagnostics->limit = limit;
+}
+
+void diagFree (Diagnostics * diagnostics)
+{
+    free (diagnostics->entries);
+    free (diagnostics->arguments);
+    diagInit (diagnostics, diagnostics->limit);
+}
+
+void diagCollect (Diagnostics * diagnostics)
+{
+    collector = diagnostics;
+}
+
+void diagError (DiagCode code, int lineNum, int column, Span argument,
+                const char * format)
+{
+    STATS_COUNT(errors, 1);
+    if ( collector == NULL )
+        printError (format, lineNum, argument.length, argument.text);
+    else
+        addEntry (collector, code, lineNum, column, argument, format);
+}
+
+void diagReplay (const Diagnostics * from)
+{
+    const Diagnostic * entry;
+    Span               argument;
+    int                i;
+
+    for ( i = 0; i < from->nbrEntries; i++ )
+    {
+        entry = &from->entries[i];
+        argument.text = from->arguments + entry->argument;
+        argument.length = entry->argumentLength;
+        if ( collector == NULL )
+            printError (entry->format, entry->lineNum, argument.length,
+                        argument.text);
+        else
+            addEntry (collector, entry->code, entry->lineNum, entry->column,
+                      argument, entry->format);
+    }
+    if ( collector != NULL )
+        collector->nbrDropped += from->nbrDropped;
+}
+
+int diagPrint (Diagnostics * diagnostics, FILE * fp, DiagFormat format)
+{
+    const Diagnostic * entry;
+    int                nbrFound;
+    int                i;
+
+    /* Sort by line, unless the errors were found in order. */
+    for ( i = 1; i < diagnostics->nbrEntries; i++ )
+    {
+        if ( diagnostics->entries[i].lineNum <
+             diagnostics->entries[i - 1].lineNum )
+        {
+            qsort (diagnostics->entries, (size_t) diagnostics->nbrEntries,
+                   sizeof(Diagnostic), compareEntries);
+            break;
+        }
+    }
+
+    if ( format == DIAG_JSON )
+        printJson (diagnostics, fp);
+    else
+    {
+        for ( i = 0; i < diagnostics->nbrEntries; i++ )
+        {
+            entry = &diagnostics->entries[i];
+            (void) fprintf (fp, entry->format, entry->lineNum,
+                            entry->argumentLength,
+                            diagnostics->arguments + entry->argument);
+        }
+        if ( diagnostics->nbrDropped > 0 )
+            (void) fprintf (fp, ERROR_DROPPED, diagnostics->nbrDropped);
+    }
+    (void) fflush (fp);
+
+    nbrFound = diagnostics->nbrEntries + diagnostics->nbrDropped;
+    diagnostics->nbrEntries = 0;
+    diagnostics->argumentsLength = 0;
+    diagnostics->nbrDropped = 0;
+    return nbrFound;
+}
+
+/*
+ * Adds an error to the end of the collector, with a copy of its
+ * argument.  Once the collector is full, its entries are a max-heap (by
+ * line, and then in the order they were found), so that an error on a
+ * line before the last one kept can take its place: the collector keeps
+ * the errors on the first lines, in whatever order they are found.  The
+ * error dropped (the new one or the one it replaces) is counted.  If
+ * there is no memory to keep an error, it is printed instead.
+ */
+static void addEntry (Diagnostics * diagnostics, DiagCode code, int lineNum,
+                      int column, Span argument, const char * format)
+{
+    Diagnostic * entry;
+    void *       newArray;
+    size_t       newCapacity;
+    int          order = diagnostics->nbrEntries + diagnostics->nbrDropped;
+    int          full = diagnostics->limit > 0 &&
+                        diagnostics->nbrEntries >= diagnostics->limit;
+    int          i;
+
+    if ( full )
+    {
+        diagnostics->nbrDropped++;
+        if ( lineNum >= diagnostics->entries[0].lineNum )
+            return;
+    }
+    else if ( diagnostics->nbrEntries >= diagnostics->capacity )
+    {
+        newCapacity = diagnostics->capacity > 0 ? diagnostics->capacity * 2
+                                                : 32;
+        if ( (newArray = realloc (diagnostics->entries,
+                                  newCapacity * sizeof(Diagnostic))) == NULL )
+        {
+            printError (format, lineNum, argument.length, argument.text);
+            return;
+        }
+        diagnostics->entries = newArray;
+        diagnostics->capacity = (int) newCapacity;
+    }
+    if ( diagnostics->argumentsLength + argument.length >=
+         diagnostics->argumentsCapacity )
+    {
+        newCapacity = diagnostics->argumentsCapacity > 0
+                      ? diagnostics->argumentsCapacity * 2 : 256;
+        while ( diagnostics->argumentsLength + argument.length >= newCapacity )
+            newCapacity *= 2;
+        if ( (newArray = realloc (diagnostics->arguments, newCapacity))
+             == NULL )
+        {
+            printError (format, lineNum, argument.length, argument.text);
+            return;
+        }
+        diagnostics->arguments = newArray;
+        diagnostics->argumentsCapacity = newCapacity;
+    }
+
+    entry = full ? &diagnostics->entries[0]
+                 : &diagnostics->entries[diagnostics->nbrEntries++];
+    entry->lineNum = lineNum;
+    entry->column = column;
+    entry->code = code;
+    entry->order = order;
+    entry->format = format;
+    entry->argument = diagnostics->argumentsLength;
+    entry->argumentLength = argument.length;
+    if ( argument.length > 0 )
+        memcpy (diagnostics->arguments + diagnostics->argumentsLength,
+                argument.text, (size_t) argument.length);
+    diagnostics->argumentsLength += argument.length;
+
+    if ( full )
+        siftDown (diagnostics, 0);
+    else if ( diagnostics->nbrEntries == diagnostics->limit )
+    {
+        for ( i = diagnostics->nbrEntries / 2 - 1; i >= 0; i-- )
+            siftDown (diagnostics, i);
+    }
+}
+
+/*
+ * Moves the entry at position i of the heap down (swapping it with its
+ * greater child) until neither of its children is greater.
+ */
+static void siftDown (Diagnostics * diagnostics, int i)
+{
+    Diagnostic * entries = diagnostics->entries;
+    Diagnostic   entry;
+    int          child;
+
+    while ( (child = 2 * i + 1) < diagnostics->nbrEntries )
+    {
+        if ( child + 1 < diagnostics->nbrEntries &&
+             compareEntries (&entries[child + 1], &entries[child]) > 0 )
+            child++;
+        if ( compareEntries (&entries[child], &entries[i]) <= 0 )
+            break;
+        entry = entries[i];
+        entries[i] = entries[child];
+        entries[child] = entry;
+        i = child;
+    }
+}
+
+/* Orders errors by line, and then in the order they were found. */
+static int compareEntries (const void * a, const void * b)
+{
+    const Diagnostic * first = a;
+    const Diagnostic * second = b;
+
+    if ( first->lineNum != second->lineNum )
+        return first->lineNum < second->lineNum ? -1 : 1;
+    return first->order < second->order ? -1 : first->order > second->order;
+}
+
+/*
+ * Prints the errors as one JSON object (see diagnostics.h).  Each
+ * message is formatted into a buffer, without the newlines around it.
+ */
+static void printJson (const Diagnostics * diagnostics, FILE * fp)
+{
+    const Diagnostic * entry;
+    const char *       argument;
+    char *             message = NULL;
+    char *             newMessage;
+    size_t             capacity = 0;
+    int                length, start;
+    int                i;
+
+    (void) fprintf (fp, "{\"diagnostics\":[");
+    for ( i = 0; i < diagnostics->nbrEntries; i++ )
+    {
+        entry = &diagnostics->entries[i];
+        argument = diagnostics->arguments + entry->argument;
+        length = snprintf (NULL, 0, entry->format, entry->lineNum,
+                           entry->argumentLength, argument);
+        if ( length < 0 )
+            length = 0;
+        if ( (size_t) length + 1 > capacity )
+        {
+            if ( (newMessage = realloc (message, (size_t) length + 1))
+                 == NULL )
+                length = 0;
+            else
+            {
+                message = newMessage;
+                capacity = (size_t) length + 1;
+            }
+        }
+        if ( length > 0 )
+            (void) snprintf (message, (size_t) length + 1, entry->format,
+                             entry->lineNum, entry->argumentLength,
+                             argument);
+        for ( start = 0; start < length && message[start] == '\n'; start++ )
+            ;
+        while ( length > start && message[length - 1] == '\n' )
+            length--;
+
+        (void) fprintf (fp, "%s\n{\"line\":%d,\"column\":%d,\"code\":\"%s\","
+                        "\"message\":", i > 0 ? "," : "", entry->lineNum,
+                        entry->column, DIAG_CODE_NAMES[entry->code]);
+        printJsonString (fp, message != NULL ? message + start : "",
+                         (size_t) (length - start));
+        if ( entry->argumentLength > 0 )
+        {
+            (void) fprintf (fp, ",\"argument\":");
+            printJsonString (fp, argument, (size_t) entry->argumentLength);
+        }
+        (void) fprintf (fp, "}");
+    }
+    (void) fprintf (fp, "%s],\"count\":%d,\"dropped\":%d}\n",
+                    diagnostics->nbrEntries > 0 ? "\n" : "",
+                    diagnostics->nbrEntries, diagnostics->nbrDropped);
+    free (message);
+}
+
+/* Prints length characters of text as a JSON string. */
+static void printJsonString (FILE * fp, const char * text, size_t length)
+{
+    size_t        i;
+    unsigned char c;
+
+    (void) putc ('"', fp);
+    for ( i = 0; i < length; i++ )
+    {
+        c = (unsigned char) text[i];
+        if ( c == '"' || c == '\\' )
+        {
+            (void) putc ('\\', fp);
+            (void) putc (c, fp);
+        }
+        else if ( c == '\n' )
+            (void) fputs ("\\n", fp);
+        else if ( c == '\t' )
+            (void) fputs ("\\t", fp);
+        else if ( c < 0x20 )
+            (void) fprintf (fp, "\\u%04x", c);
+        else
+            (void) putc (c, fp);
+    }
+    (void) putc ('"', fp);
+}
@@ -0,0 +1,134 @@
+/*
+ * Diagnostics: collecting the errors found in the source program
+ *
+ * The errors in the program being assembled (an invalid instruction or
+ * register, a value out of range, an undefined label, and so on) are
+ * reported with diagError.  Rather than printing each one as it is
+ * found, diagError records it in a Diagnostics collector: its line and
+ * column, its code, the printf format of its message, and its argument
+ * (a copy of the text it is about, if any).  Nothing is formatted until
+ * diagPrint prints all of them at once, sorted by line, either as the
+ * messages the assembler has always printed or as JSON for other tools
+ * to read.
+ *
+ * A collector has a limit: once it holds that many errors, it keeps
+ * only the errors on the first lines (an error on an earlier line takes
+ * the place of the one on the last line) and counts the ones it drops,
+ * and the assembly goes on.  The errors printed are therefore the first
+ * ones by line, even though they are not all found in order (pass1
+ * finds the errors in directives before pass2 finds the others, and
+ * singlePass finds undefined labels at the end of the input).
+ *
+ * Each thread reports to its own collector, chosen with diagCollect, so
+ * threads encoding instructions in parallel can each collect the errors
+ * for their instructions and pass them on with diagReplay.  A thread
+ * that has no collector prints each error with printError when it is
+ * found, as the assembler always did (this is what the library, which
+ * holds its error messages, relies on).
+ *
+ * JSON output is one object: "diagnostics" is an array with an object
+ * for each error, with its "line", "column" (of the instruction or
+ * directive, from 1), "code" (see DIAG_CODE_NAMES in diagnostics.c),
+ * "message", and "argument" (only if it has one), followed by the
+ * "count" of errors printed and the number "dropped" over the limit.
+ *
+ */
+
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+
+#include <stdio.h>
+
+#include "getToken.h"
+
+/* The kinds of errors. */
+typedef enum {
+        DIAG_BAD_NAME,          /* not an instruction name */
+        DIAG_BAD_OPERANDS,      /* wrong number of operands */
+        DIAG_BAD_REGISTER,      /* not a register name */
+        DIAG_BAD_SHAMT,         /* shift amount out of range */
+        DIAG_BAD_IMMEDIATE,     /* immediate value or offset out of range */
+        DIAG_UNDEFINED_LABEL,   /* label not in the label table */
+        DIAG_BAD_ADDRESS,       /* jump target out of range */
+        DIAG_BAD_DIRECTIVE,     /* not a directive name */
+        DIAG_WRONG_SEGMENT,     /* instruction or data in the wrong segment */
+        DIAG_BAD_VALUE,         /* data value, count, or string not valid */
+        DIAG_NBR_CODES
+} DiagCode;
+
+/* The argument of an error that has none. */
+#define DIAG_NO_ARGUMENT ((Span) { NULL, 0 })
+
+/* How diagPrint prints the errors. */
+typedef enum {
+        DIAG_TEXT = 0,          /* the assembler's messages (the default) */
+        DIAG_JSON               /* one JSON object (see above) */
+} DiagFormat;
+
+/* One error, not yet formatted. */
+typedef struct {
+        int          lineNum;
+        int          column;    /* column of the instruction or directive;
+                                 * 0 if unknown */
+        int          code;      /* a DiagCode */
+        int          order;     /* position among the errors found */
+        const char * format;    /* printf format of the message */
+        size_t       argument;  /* offset of the argument in arguments */
+        int          argumentLength;
+} Diagnostic;
+
+typedef struct {
+        Diagnostic * entries;
+        int          nbrEntries;
+        int          capacity;
+        char *       arguments;         /* the arguments, one after another */
+        size_t       argumentsLength;
+        size_t       argumentsCapacity;
+        int          limit;             /* most entries kept; <= 0: no limit */
+        int          nbrDropped;        /* errors found over the limit */
+} Diagnostics;
+
+void diagInit (Diagnostics * diagnostics, int limit);
+        /* Postcondition: diagnostics is an empty collector that keeps at
+         *      most limit errors (any number if limit <= 0).
+         */
+
+void diagFree (Diagnostics * diagnostics);
+        /* Postcondition: the memory of the collector has been released
+         *      and it is empty.
+         */
+
+void diagCollect (Diagnostics * diagnostics);
+        /* Postcondition: the errors the calling thread reports from now
+         *      on are collected in diagnostics, or printed when they are
+         *      found if diagnostics is NULL.
+         */
+
+void diagError (DiagCode code, int lineNum, int column, Span argument,
+                const char * format);
+        /* Reports an error at the given line and column.  format is the
+         *      message's printf format, which must be a string constant
+         *      and is given three arguments: lineNum, and the length and
+         *      text of argument (an empty span if there is none).
+         * Postcondition: the error has been collected by the calling
+         *      thread's collector (or counted as dropped if it is full),
+         *      or printed if the thread has none.
+         */
+
+void diagReplay (const Diagnostics * from);
+        /* Precondition: from has no limit (so its errors are in the
+         *      order they were found).
+         * Postcondition: the errors in from, and those it dropped, have
+         *      been reported again by the calling thread, in the order
+         *      they were found.
+         */
+
+int diagPrint (Diagnostics * diagnostics, FILE * fp, DiagFormat format);
+        /* Postcondition: the errors collected have been printed to fp,
+         *      sorted by line (errors on the same line in the order they
+         *      were found), followed by a note of how many were dropped,
+         *      if any; the collector is empty again.
+         * Returns the number of errors found, including those dropped.
+         */
+
+#endif
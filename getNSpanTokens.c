@@ -0,0 +1,82 @@
+/*
+ * This file contains the getNSpanTokens function, a version of
+ * getNTokens for text that is not null-terminated and must not be
+ * modified, such as the operands of an instruction in a source file
+ * mapped read-only into memory.  Tokens are found exactly as getNTokens
+ * finds them, but each one is returned as a Span (a pointer into the
+ * original text plus a length) instead of being turned into a string.
+ *
+ * If the text contains exactly N tokens, getNSpanTokens returns 1 and
+ * fills the given array with N spans, one for each token.  If the text
+ * contains fewer or more than N tokens, getNSpanTokens returns 0 and
+ * puts a span holding the same error message as getNTokens in the first
+ * array element.
+ *
+ * The getNSpanTokens function uses the scanTokens function (see
+ * scanner.h), which finds the same tokens as getSpanToken.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "getToken.h"
+#include "scanner.h"
+
+/* Define error messages (global within this file). */
+static const char * TOO_FEW = "Instruction contains fewer tokens than expected.";
+static const char * TOO_MANY = "Instruction contains more tokens than expected.";
+
+static int setError (Span results[], const char * message);
+
+/**
+ * getNSpanTokens -- read N tokens from text, putting the resulting
+ *                   token spans in results
+ * Parameters:  text -- a span containing tokens
+ *              N -- the expected number of tokens in text
+ *              results -- an array of spans for the tokens
+ * Precondition:
+ *              text.text is a valid pointer to text.length characters &&
+ *              N >= 1 &&
+ *              results is a valid pointer to an array containing space
+ *                  for at least N spans
+ * Postcondition:
+ *              If text contains N tokens, results is filled with spans,
+ *              each referring to one of those tokens, and
+ *              getNSpanTokens returns 1.  If text contains fewer or more
+ *              than N tokens, getNSpanTokens returns 0 and puts a span
+ *              holding an appropriate error message in results[0].
+ */
+int getNSpanTokens (Span text, int N, Span results[])
+{
+    int nbrTokens;
+
+    /* Check the basics of the pre-condition. */
+    if ( text.text == NULL || N < 1 || results == NULL )
+        return 0;
+
+    /* Get the expected tokens, and see whether there are more. */
+    nbrTokens = scanTokens(text, results, N);
+    if ( nbrTokens < N )
+    {
+        /* Token expected, but no token found. */
+        return setError(results, TOO_FEW);
+    }
+    if ( nbrTokens > N )
+    {
+        /* No token expected, but one is found. */
+        return setError(results, TOO_MANY);
+    }
+
+    return 1;
+}
+
+/*
+ * Puts a span holding message in results[0] and returns 0.
+ */
+static int setError (Span results[], const char * message)
+{
+    results[0].text = message;
+    results[0].length = (int) strlen(message);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * This file contains the getSpanToken function, a version of getToken
+ * for text that is not null-terminated and must not be modified, such
+ * as a line in a source file mapped read-only into memory.  Instead of
+ * stopping at a null byte, getSpanToken stops at the end pointer it is
+ * passed.
+ *
+ * See getToken.h for more specific information about how getToken and
+ * getSpanToken behave and for an example.
+ *
+ */
+
+#include <stdio.h>
+#include <ctype.h>
+
+#include "getToken.h"
+
+void getSpanToken (const char ** tokBegin, const char ** tokEnd,
+                   const char * end)
+  /* postcondition: if tokBegin or *tokBegin was NULL when getSpanToken
+   *                    was called, tokBegin and *tokBegin will be
+   *                    unchanged;
+   *                if the text from *tokBegin to end was empty or
+   *                    contained only whitespace, both *tokBegin and
+   *                    *tokEnd will be end;
+   *                otherwise, *tokBegin will point to the first
+   *                    character in the next token and *tokEnd will
+   *                    point to the first character AFTER the token
+   *                    (possibly end)
+   */
+{
+        /* Make sure that we have text to step through. */
+        if ( tokBegin == NULL || *tokBegin == NULL )
+            return;
+
+        /* Skip any leading whitespace. */
+        while (*tokBegin < end && isspace ((unsigned char) **tokBegin))
+            (*tokBegin)++;
+        if ( *tokBegin >= end )
+        {
+            *tokBegin = *tokEnd = end;
+            return;
+        }
+
+        /* Find the end of the first token */
+        *tokEnd = *tokBegin + 1;
+        while (*tokEnd < end && **tokEnd != ',' &&
+               **tokEnd != '(' && **tokEnd != ')' && **tokEnd != ':' &&
+               !isspace ((unsigned char) **tokEnd))
+            (*tokEnd)++;
+
+        /* (*tokBegin) now points to beginning of token;
+         * (*tokEnd) now points to 1st character AFTER token
+         */
+}
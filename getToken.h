@@ -85,12 +85,35 @@
  *
  * Modified:  3/17/2000   added colon as a token delimiter so that
  *                        getToken can be used to find labels.
+ * Modified:  10/17/2026  added getSpanToken, which works on text that
+ *                        is not null-terminated (see below).
+ *
+ * SPANS:
+ *
+ * A Span is a pointer to some text plus its length; the text is not
+ * null-terminated and is never modified.  The assembler uses spans to
+ * refer to lines and tokens inside a source file that is mapped
+ * read-only into memory (see sourceFile.h).
+ *
+ * void getSpanToken (const char ** tokBegin, const char ** tokEnd,
+ *                    const char * end)
+ *   getSpanToken behaves exactly like getToken, except that the text
+ *   ends at end rather than at a null byte: wherever getToken would
+ *   stop at a null byte, getSpanToken stops at end.  For example, if
+ *   *tokBegin == end when it returns, there was no token.
  *
  */
 
 #ifndef _GETTOKEN_H
 #define _GETTOKEN_H
 
+typedef struct {
+        const char * text;      /* first character (not null-terminated) */
+        int          length;    /* number of characters */
+} Span;
+
 void getToken (char ** tokBegin, char ** tokEnd);
+void getSpanToken (const char ** tokBegin, const char ** tokEnd,
+                   const char * end);
 
 #endif
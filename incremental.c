@@ -0,0 +1,1140 @@
+/*
+ * Incremental assembly: reassembling a program after a small edit
+ *
+ * This file provides the definitions of the functions declared in
+ * incremental.h.  The source is read twice: once to hash every line and
+ * note where each one starts, so that the unchanged lines can be found,
+ * and once more (line by line, from those starting points) for only the
+ * lines that must be parsed.  The state is updated in place: the entries
+ * of the prefix are left as they are, those of the suffix are moved (as
+ * one block) to their new positions, and those between them replaced.
+ *
+ * The lines that use the same label are a doubly linked list, through
+ * the previous and next fields of their entries.  These hold distances
+ * between lines rather than line numbers, so that they stay right when
+ * the lines move together; only a link between a line of the prefix and
+ * one of the suffix must be changed when the suffix moves.  The lines to
+ * parse or check again are gathered in a list, and dealt with in order,
+ * so that the errors are found in the same order as by pass2.
+ *
+ * A state file holds a StateHeader, then the lines, the labels, their
+ * addresses, the hashed index of the labels, the lines with errors, and
+ * the label names, as they are in memory; it is only meant to be read
+ * back by the same build of the assembler on the same machine.  The
+ * header holds a checksum of the whole file, and a state whose checksum
+ * does not match is ignored (the program is then assembled in full).
+ *
+ */
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "incremental.h"
+
+#define STATE_VERSION 4
+
+/* Offset in names meaning "no name". */
+#define NO_NAME UINT32_MAX
+
+/* Labels that are no longer defined or used are kept in the state; once
+ * there are more than this many of them, and they are over half of the
+ * labels, the state is thrown away and everything assembled again.
+ */
+#define MAX_UNUSED 1024
+
+/* The start of a state file. */
+typedef struct {
+        char     magic[8];      /* STATE_MAGIC */
+        uint32_t version;       /* STATE_VERSION */
+        uint32_t lineSize;      /* sizeof(LineState) */
+        uint32_t labelSize;     /* sizeof(LabelState) */
+        uint32_t nbrLines;
+        uint32_t nbrLabels;
+        uint32_t indexCapacity;
+        uint32_t nbrErrors;
+        uint32_t duplicates;
+        uint32_t unused;
+        uint32_t reserved;      /* 0 */
+        uint64_t namesLength;
+        uint64_t checksum;      /* stateChecksum of the rest */
+} StateHeader;
+
+/* A list of lines (or of label ids), in the order they are added. */
+typedef struct {
+        int * items;
+        int   nbrItems;
+        int   capacity;
+} ItemList;
+
+static const char STATE_MAGIC[8] = { 'A', 'S', 'M', 'S', 'T', 'A', 'T', 'E' };
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+static const char * ERROR_SAVE = "Error: cannot write the state file %s.\n";
+
+static int      hashLines (SourceFile * source, uint64_t ** hashes,
+                           size_t ** starts, int * nbrLines);
+static uint64_t hashLine (Span line);
+static uint64_t hashBytes (uint64_t hash, const void * bytes, size_t length);
+static uint64_t stateChecksum (const StateHeader * header,
+                               const IncrementalState * state);
+static int      readArray (FILE * fp, void ** array, size_t size,
+                           size_t count);
+static int      writeArray (FILE * fp, const void * array, size_t size,
+                            size_t count);
+static int      matchLines (const LineState * old, int nbrOld,
+                            const uint64_t * hashes, int nbrNew, int * from);
+static int      moveLines (IncrementalState * state, int prefix, int first,
+                           int delta, ItemList * work, ItemList * changed);
+static void     findDefinitions (IncrementalState * state, int first,
+                                 const ItemList * changed);
+static int      encodeLine (SourceFile * source, size_t start, int line,
+                            IncrementalState * state);
+static int      labelId (IncrementalState * state, const char * name,
+                         int length);
+static int      addDefinition (IncrementalState * state, int id, int line,
+                               ItemList * changed);
+static int      removeDefinition (IncrementalState * state, int id,
+                                  int line, ItemList * changed);
+static void     linkLine (IncrementalState * state, int line);
+static void     unlinkLine (IncrementalState * state, int line);
+static void     countUse (IncrementalState * state, int id, int definitions,
+                          int references);
+static int      markChanged (IncrementalState * state, int id,
+                             ItemList * changed);
+static uint32_t addName (IncrementalState * state, const char * name,
+                         size_t length);
+static int      addItem (ItemList * list, int item);
+static int      reserve (void ** array, int * capacity, int needed,
+                         size_t size);
+static int      compareItems (const void * a, const void * b);
+static int      stateIsValid (const IncrementalState * state);
+static void     assembleAll (SourceFile * source, IncrementalState * state,
+                             OutputFile * output);
+
+void stateInit (IncrementalState * state)
+{
+    memset (state, 0, sizeof(IncrementalState));
+}
+
+int stateLoad (IncrementalState * state, const char * path)
+{
+    FILE *      fp;
+    StateHeader header;
+    uint64_t    checksum;
+    int         ok = 0;
+
+    stateInit (state);
+    if ( (fp = fopen (path, "rb")) == NULL )
+        return 0;
+    if ( fread (&header, sizeof(header), 1, fp) == 1 &&
+         memcmp (header.magic, STATE_MAGIC, sizeof(STATE_MAGIC)) == SAME &&
+         header.version == STATE_VERSION &&
+         header.lineSize == sizeof(LineState) &&
+         header.labelSize == sizeof(LabelState) &&
+         header.nbrLines <= INT32_MAX / 4 &&
+         header.nbrLabels <= INT32_MAX / 2 &&
+         header.indexCapacity <= INT32_MAX &&
+         header.nbrErrors <= header.nbrLines &&
+         header.duplicates <= INT32_MAX && header.unused <= INT32_MAX &&
+         header.namesLength < NO_NAME )
+    {
+        state->nbrLines = state->linesCapacity = (int) header.nbrLines;
+        state->nbrLabels = state->labelsCapacity = (int) header.nbrLabels;
+        state->indexCapacity = (int) header.indexCapacity;
+        state->nbrErrors = state->errorsCapacity = (int) header.nbrErrors;
+        state->duplicates = (int) header.duplicates;
+        state->unused = (int) header.unused;
+        state->namesLength = state->namesCapacity =
+            (size_t) header.namesLength;
+        ok = readArray (fp, (void **) &state->lines, sizeof(LineState),
+                        (size_t) state->nbrLines) &&
+             readArray (fp, (void **) &state->labels, sizeof(LabelState),
+                        (size_t) state->nbrLabels) &&
+             readArray (fp, (void **) &state->addresses, sizeof(int32_t),
+                        (size_t) state->nbrLabels) &&
+             readArray (fp, (void **) &state->index, sizeof(int32_t),
+                        (size_t) state->indexCapacity) &&
+             readArray (fp, (void **) &state->errors, sizeof(int32_t),
+                        (size_t) state->nbrErrors) &&
+             readArray (fp, (void **) &state->names, 1, state->namesLength);
+        checksum = header.checksum;
+        header.checksum = 0;
+        ok = ok && stateChecksum (&header, state) == checksum &&
+             stateIsValid (state);
+    }
+    (void) fclose (fp);
+
+    /* Anything that is not a complete state is ignored. */
+    if ( ! ok )
+        stateFree (state);
+    return ok;
+}
+
+int stateSave (const IncrementalState * state, const char * path)
+{
+    FILE *      fp = NULL;
+    StateHeader header;
+    char *      temporary;
+    int         fd, ok;
+
+    /* The state is written to a temporary file of its own, which
+     * replaces the file only once it is complete (so that two
+     * assemblies saving the same state never write to the same file).
+     */
+    if ( (temporary = malloc (strlen (path) + 8)) == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    sprintf (temporary, "%s.XXXXXX", path);
+    if ( (fd = mkstemp (temporary)) < 0 )
+    {
+        printError (ERROR_SAVE, path);
+        free (temporary);
+        return 0;
+    }
+    (void) fchmod (fd, 0644);
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.magic, STATE_MAGIC, sizeof(STATE_MAGIC));
+    header.version = STATE_VERSION;
+    header.lineSize = sizeof(LineState);
+    header.labelSize = sizeof(LabelState);
+    header.nbrLines = (uint32_t) state->nbrLines;
+    header.nbrLabels = (uint32_t) state->nbrLabels;
+    header.indexCapacity = (uint32_t) state->indexCapacity;
+    header.nbrErrors = (uint32_t) state->nbrErrors;
+    header.duplicates = (uint32_t) state->duplicates;
+    header.unused = (uint32_t) state->unused;
+    header.namesLength = (uint64_t) state->namesLength;
+    header.checksum = stateChecksum (&header, state);
+
+    ok = (fp = fdopen (fd, "wb")) != NULL;
+    if ( ok )
+    {
+        ok = fwrite (&header, sizeof(header), 1, fp) == 1 &&
+             writeArray (fp, state->lines, sizeof(LineState),
+                         (size_t) state->nbrLines) &&
+             writeArray (fp, state->labels, sizeof(LabelState),
+                         (size_t) state->nbrLabels) &&
+             writeArray (fp, state->addresses, sizeof(int32_t),
+                         (size_t) state->nbrLabels) &&
+             writeArray (fp, state->index, sizeof(int32_t),
+                         (size_t) state->indexCapacity) &&
+             writeArray (fp, state->errors, sizeof(int32_t),
+                         (size_t) state->nbrErrors) &&
+             writeArray (fp, state->names, 1, state->namesLength);
+        ok = fclose (fp) == 0 && ok;
+    }
+    else
+        (void) close (fd);
+    if ( ok )
+        ok = rename (temporary, path) == 0;
+    if ( ! ok )
+    {
+        (void) unlink (temporary);
+        printError (ERROR_SAVE, path);
+    }
+    free (temporary);
+    return ok;
+}
+
+void stateFree (IncrementalState * state)
+{
+    free (state->lines);
+    free (state->labels);
+    free (state->addresses);
+    free (state->index);
+    free (state->errors);
+    free (state->names);
+    stateInit (state);
+}
+
+void incrementalAssemble (SourceFile * source, IncrementalState * state,
+                          OutputFile * output)
+{
+    uint64_t *   hashes = NULL; /* hash of each line of source */
+    size_t *     starts = NULL; /* offset of each line in source */
+    LineState *  removed = NULL;    /* the old lines between the prefix
+                                     * and the suffix */
+    int *        from = NULL;   /* the removed line with the same text as
+                                 * each new line between them, or -1 */
+    ItemList     work = { NULL, 0, 0 };     /* lines to look at again */
+    ItemList     changed = { NULL, 0, 0 };  /* labels whose address
+                                             * has changed */
+    int          nbrLines;
+    int          prefix;        /* lines unchanged at the start */
+    int          suffix;        /* lines unchanged at the end */
+    int          oldEnd, end;   /* where the suffix starts, before and
+                                 * after the edit */
+    int          delta;         /* lines the suffix has moved */
+    int          address, line, id, steps, ok = 1;
+    int          i, j;
+    size_t       offset;
+    Span         text, label, instName, operands;
+    LineState *  entry;
+
+    /* Data directives move the lines after them, so a program with any
+     * is always assembled in full.
+     */
+    if ( hasDirectives (source->text, source->length) )
+    {
+        assembleAll (source, state, output);
+        return;
+    }
+
+    /* Start afresh rather than keep more and more labels that are no
+     * longer there.
+     */
+    if ( state->unused > MAX_UNUSED && state->unused > state->nbrLabels / 2 )
+        stateFree (state);
+
+    statsStart (STATS_PASS1);
+    if ( ! hashLines (source, &hashes, &starts, &nbrLines) )
+    {
+        printError ("%s", ERROR_MEMORY);
+        free (hashes);
+        free (starts);
+        statsStop (STATS_PASS1);
+        stateFree (state);
+        return;
+    }
+
+    /* Find the lines that have not changed, at the start and the end,
+     * and the old lines with the same text as the lines between them.
+     */
+    for ( prefix = 0; prefix < nbrLines && prefix < state->nbrLines &&
+                      hashes[prefix] == state->lines[prefix].hash; prefix++ )
+        ;
+    for ( suffix = 0; suffix < nbrLines - prefix &&
+                      suffix < state->nbrLines - prefix &&
+                      hashes[nbrLines - 1 - suffix] ==
+                          state->lines[state->nbrLines - 1 - suffix].hash;
+          suffix++ )
+        ;
+    oldEnd = state->nbrLines - suffix;
+    end = nbrLines - suffix;
+    delta = end - oldEnd;
+    if ( (removed = malloc ((size_t) (oldEnd - prefix) * sizeof(LineState)
+                            + 1)) == NULL ||
+         (from = malloc ((size_t) (end - prefix) * sizeof(int) + 1)) == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        ok = 0;
+    }
+    else
+    {
+        if ( oldEnd > prefix )
+            memcpy (removed, state->lines + prefix,
+                    (size_t) (oldEnd - prefix) * sizeof(LineState));
+        ok = matchLines (removed, oldEnd - prefix, hashes + prefix,
+                         end - prefix, from);
+    }
+
+    /* Take the labels of the old lines between the prefix and the suffix
+     * out of the label table, and their branches and jumps out of the
+     * lists of the lines that use each label.
+     */
+    for ( i = prefix; i < oldEnd && ok; i++ )
+    {
+        entry = &state->lines[i];
+        if ( entry->label != NO_LABEL )
+            ok = removeDefinition (state, entry->label, i, &changed);
+        if ( entry->kind == LINE_BRANCH || entry->kind == LINE_JUMP )
+            unlinkLine (state, i);
+    }
+
+    /* Move the suffix to where it is now, with its labels. */
+    if ( ok )
+        ok = reserve ((void **) &state->lines, &state->linesCapacity,
+                      nbrLines, sizeof(LineState));
+    if ( ok )
+    {
+        if ( suffix > 0 )
+            memmove (state->lines + end, state->lines + oldEnd,
+                     (size_t) suffix * sizeof(LineState));
+        state->nbrLines = nbrLines;
+        if ( delta != 0 )
+            ok = moveLines (state, prefix, end, delta, &work, &changed);
+    }
+
+    /* Put in the new lines between the prefix and the suffix: the entry
+     * of the old line with the same text, if there is one (only its
+     * branch or jump, if any, has to be checked), and otherwise an edited
+     * line, parsed for its label.
+     */
+    for ( i = prefix; i < end && ok; i++ )
+    {
+        entry = &state->lines[i];
+        if ( from[i - prefix] != -1 )
+        {
+            *entry = removed[from[i - prefix]];
+            if ( entry->kind == LINE_BRANCH || entry->kind == LINE_JUMP )
+                linkLine (state, i);
+        }
+        else
+        {
+            offset = starts[i];
+            (void) sourceNextLine (source, &offset, &text);
+            (void) parseLine (text, &label, &instName, &operands);
+            memset (entry, 0, sizeof(LineState));
+            entry->hash = hashes[i];
+            entry->kind = LINE_EDITED;
+            entry->reference = NO_LABEL;
+            entry->label = label.length > 0
+                           ? labelId (state, label.text, label.length)
+                           : NO_LABEL;
+            if ( label.length > 0 && entry->label == NO_LABEL )
+                ok = 0;     /* error message already printed */
+        }
+        if ( ok && entry->label != NO_LABEL )
+            ok = addDefinition (state, entry->label, i, &changed);
+        if ( ok && entry->kind != LINE_EMPTY && entry->kind != LINE_WORD )
+            ok = addItem (&work, i);
+    }
+    if ( ok )
+        findDefinitions (state, end, &changed);
+
+    /* The lines that had errors are encoded again, to report them (the
+     * ones between the prefix and the suffix are in the work already),
+     * and so are the branches and jumps that use a label that moved,
+     * if their offset or target has changed.
+     */
+    for ( i = 0; i < state->nbrErrors && ok; i++ )
+    {
+        line = state->errors[i];
+        if ( line < prefix || line >= oldEnd )
+            ok = addItem (&work, line < prefix ? line : line + delta);
+    }
+    state->nbrErrors = 0;
+    for ( i = 0; i < changed.nbrItems; i++ )
+    {
+        id = changed.items[i];
+        state->labels[id].changed = 0;
+        steps = state->labels[id].references;
+        for ( line = state->labels[id].first; line != -1 && steps-- > 0 && ok;
+              line = state->lines[line].next != 0
+                     ? line + state->lines[line].next : -1 )
+            ok = addItem (&work, line);
+    }
+    if ( work.nbrItems > 1 )
+        qsort (work.items, (size_t) work.nbrItems, sizeof(int),
+               compareItems);
+    statsStop (STATS_PASS1);
+
+    /* pass1 reports each definition of a label that is already defined. */
+    for ( i = 0; i < state->duplicates && ok; i++ )
+        reportDuplicateLabel ();
+
+    /* Encode the lines that need it, in order, and write every line's
+     * word.
+     */
+    statsStart (STATS_PASS2);
+    for ( j = 0; j < work.nbrItems && ok; j++ )
+    {
+        i = work.items[j];
+        if ( j > 0 && i == work.items[j - 1] )
+            continue;
+        entry = &state->lines[i];
+        if ( entry->kind == LINE_BRANCH || entry->kind == LINE_JUMP )
+        {
+            /* A branch's offset is unchanged if its label moved as far
+             * as it did; a jump's target only if its label stayed put.
+             */
+            address = state->addresses[entry->reference];
+            if ( address != -1 &&
+                 address - (entry->kind == LINE_BRANCH ? i * 4 : 0) ==
+                     entry->target )
+                continue;
+            unlinkLine (state, i);
+            entry->kind = LINE_EDITED;
+        }
+        if ( entry->kind == LINE_EDITED || entry->kind == LINE_ERROR )
+            ok = encodeLine (source, starts[i], i, state);
+    }
+    for ( i = 0; i < nbrLines && ok; i++ )
+    {
+        entry = &state->lines[i];
+        if ( entry->kind != LINE_EMPTY && entry->kind != LINE_ERROR &&
+             ! outputWord (output, (uint32_t) i * 4, entry->word) )
+            break;      /* error message already printed */
+    }
+    statsStop (STATS_PASS2);
+
+    free (hashes);
+    free (starts);
+    free (removed);
+    free (from);
+    free (work.items);
+    free (changed.items);
+    if ( ! ok )
+        stateFree (state);  /* start afresh next time */
+}
+
+/*
+ * Sets from[i], for each of the nbrNew new lines (whose hashes are
+ * given), to the index of an old line with the same hash, or to -1 if
+ * there is none.  The old lines are found through a hash table of their
+ * positions, with room for twice as many.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int matchLines (const LineState * old, int nbrOld,
+                       const uint64_t * hashes, int nbrNew, int * from)
+{
+    int *    index;
+    size_t   capacity = 16;
+    size_t   mask, slot;
+    int      i;
+
+    for ( i = 0; i < nbrNew; i++ )
+        from[i] = -1;
+    if ( nbrOld == 0 || nbrNew == 0 )
+        return 1;
+
+    while ( capacity < (size_t) nbrOld * 2 )
+        capacity *= 2;
+    if ( (index = malloc (capacity * sizeof(int))) == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    memset (index, -1, capacity * sizeof(int));
+    mask = capacity - 1;
+
+    for ( i = 0; i < nbrOld; i++ )
+    {
+        for ( slot = old[i].hash & mask; index[slot] != -1;
+              slot = (slot + 1) & mask )
+        {
+            if ( old[index[slot]].hash == old[i].hash )
+                break;      /* keep the first line with this text */
+        }
+        if ( index[slot] == -1 )
+            index[slot] = i;
+    }
+    for ( i = 0; i < nbrNew; i++ )
+    {
+        for ( slot = hashes[i] & mask; index[slot] != -1;
+              slot = (slot + 1) & mask )
+        {
+            if ( old[index[slot]].hash == hashes[i] )
+            {
+                from[i] = index[slot];
+                break;
+            }
+        }
+    }
+
+    free (index);
+    return 1;
+}
+
+/*
+ * Brings the lines from first to the end, which have just been moved
+ * there from delta lines further up (or down, if delta is negative), up
+ * to date: the labels they define first move with them, a link from
+ * one of them to a line before prefix (which has not moved) is
+ * lengthened, and their branches and jumps are added to work.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int moveLines (IncrementalState * state, int prefix, int first,
+                      int delta, ItemList * work, ItemList * changed)
+{
+    LineState * entry;
+    int         i, old;
+
+    for ( i = first; i < state->nbrLines; i++ )
+    {
+        entry = &state->lines[i];
+        old = i - delta;
+
+        /* (A label already moved is not moved again, if a duplicate
+         * definition lands where its first one was.)
+         */
+        if ( entry->label != NO_LABEL &&
+             ! state->labels[entry->label].changed &&
+             state->addresses[entry->label] == old * 4 )
+        {
+            state->addresses[entry->label] = i * 4;
+            if ( ! markChanged (state, entry->label, changed) )
+                return 0;
+        }
+        if ( entry->kind != LINE_BRANCH && entry->kind != LINE_JUMP )
+            continue;
+
+        if ( entry->previous != 0 && old + entry->previous < prefix )
+        {
+            state->lines[old + entry->previous].next += delta;
+            entry->previous -= delta;
+        }
+        if ( entry->next != 0 && old + entry->next < prefix )
+        {
+            state->lines[old + entry->next].previous += delta;
+            entry->next -= delta;
+        }
+        if ( entry->previous == 0 )
+            state->labels[entry->reference].first = i;
+        if ( ! addItem (work, i) )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Gives each changed label that is still defined, but has lost its
+ * first definition, its new first one: the first line from first on
+ * that defines it.  (Only a line after the one it lost can define it,
+ * and the lines between the prefix and the suffix have been looked at.)
+ */
+static void findDefinitions (IncrementalState * state, int first,
+                            const ItemList * changed)
+{
+    int lost = 0;
+    int i, id;
+
+    for ( i = 0; i < changed->nbrItems; i++ )
+    {
+        id = changed->items[i];
+        if ( state->addresses[id] == -1 && state->labels[id].definitions > 0 )
+            lost++;
+    }
+    for ( i = first; i < state->nbrLines && lost > 0; i++ )
+    {
+        id = state->lines[i].label;
+        if ( id != NO_LABEL && state->addresses[id] == -1 )
+        {
+            state->addresses[id] = i * 4;
+            lost--;
+        }
+    }
+}
+
+/*
+ * Hashes every line of source, and notes where each one starts.
+ * Returns 1 if everything went OK; 0 if memory allocation error.
+ */
+static int hashLines (SourceFile * source, uint64_t ** hashes,
+                      size_t ** starts, int * nbrLines)
+{
+    size_t offset = 0, start = 0;
+    size_t capacity = 0;
+    Span   line;
+    void * newArray;
+    int    n = 0;
+
+    *hashes = NULL;
+    *starts = NULL;
+    while ( sourceNextLine (source, &offset, &line) )
+    {
+        if ( (size_t) n >= capacity )
+        {
+            capacity = capacity > 0 ? capacity * 2 : 1024;
+            if ( (newArray = realloc (*hashes, capacity * sizeof(uint64_t)))
+                 == NULL )
+                return 0;
+            *hashes = newArray;
+            if ( (newArray = realloc (*starts, capacity * sizeof(size_t)))
+                 == NULL )
+                return 0;
+            *starts = newArray;
+        }
+        (*hashes)[n] = hashLine (line);
+        (*starts)[n++] = start;
+        start = offset;
+    }
+    STATS_COUNT(lines, n);
+    *nbrLines = n;
+    return 1;
+}
+
+/*
+ * Returns a 64-bit hash of the text of a line.  It is FNV-1a taken eight
+ * bytes at a time rather than one (see hashBytes), since hashing every
+ * line of the source is most of the work of an assembly that changes
+ * few lines.
+ */
+static uint64_t hashLine (Span line)
+{
+    return hashBytes (14695981039346656037u ^ (uint64_t) line.length,
+                      line.text, (size_t) line.length);
+}
+
+/*
+ * Returns hash, updated with the given bytes: FNV-1a taken eight bytes at
+ * a time (with the high bits folded back in after each step), and one at
+ * a time for the last few.
+ */
+static uint64_t hashBytes (uint64_t hash, const void * bytes, size_t length)
+{
+    const char * text = bytes;
+    uint64_t     chunk;
+    size_t       i;
+
+    for ( i = 0; i + 8 <= length; i += 8 )
+    {
+        memcpy (&chunk, text + i, sizeof(chunk));
+        hash = (hash ^ chunk) * 1099511628211u;
+        hash ^= hash >> 29;
+    }
+    for ( ; i < length; i++ )
+    {
+        hash ^= (unsigned char) text[i];
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+/*
+ * Returns the checksum of a state file: the hash of its header (whose
+ * checksum must be 0) and of the arrays of state that follow it.  Since
+ * each step of the hash is a bijection, a change to any one word of the
+ * file always changes the checksum.
+ */
+static uint64_t stateChecksum (const StateHeader * header,
+                               const IncrementalState * state)
+{
+    uint64_t hash = 14695981039346656037u;
+
+    hash = hashBytes (hash, header, sizeof(StateHeader));
+    if ( state->nbrLines > 0 )
+        hash = hashBytes (hash, state->lines,
+                          (size_t) state->nbrLines * sizeof(LineState));
+    if ( state->nbrLabels > 0 )
+    {
+        hash = hashBytes (hash, state->labels,
+                          (size_t) state->nbrLabels * sizeof(LabelState));
+        hash = hashBytes (hash, state->addresses,
+                          (size_t) state->nbrLabels * sizeof(int32_t));
+    }
+    if ( state->indexCapacity > 0 )
+        hash = hashBytes (hash, state->index,
+                          (size_t) state->indexCapacity * sizeof(int32_t));
+    if ( state->nbrErrors > 0 )
+        hash = hashBytes (hash, state->errors,
+                          (size_t) state->nbrErrors * sizeof(int32_t));
+    if ( state->namesLength > 0 )
+        hash = hashBytes (hash, state->names, state->namesLength);
+    return hash;
+}
+
+/*
+ * Allocates an array of count elements of the given size (with room for
+ * at least one byte), and reads them from fp into it.
+ * Returns 1 if everything went OK; 0 if memory allocation error or the
+ * elements could not all be read.
+ */
+static int readArray (FILE * fp, void ** array, size_t size, size_t count)
+{
+    if ( (*array = malloc (count * size + 1)) == NULL )
+        return 0;
+    return count == 0 || fread (*array, size, count, fp) == count;
+}
+
+/*
+ * Writes the count elements of the given size of array to fp (nothing,
+ * if count is 0, in which case array may be NULL).
+ * Returns 1 if everything went OK; 0 if write error.
+ */
+static int writeArray (FILE * fp, const void * array, size_t size,
+                       size_t count)
+{
+    return count == 0 || fwrite (array, size, count, fp) == count;
+}
+
+/*
+ * Parses and encodes the given line (whose text starts at start), as
+ * pass2 would, reporting its errors, and records the result in its
+ * entry: a branch or jump is linked with the other lines that use its
+ * label, and a line with an error added to the errors of state.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int encodeLine (SourceFile * source, size_t start, int line,
+                       IncrementalState * state)
+{
+    Span        text, label, instName, operands;
+    Instruction inst;
+    LabelTable  table;
+    LineState * entry = &state->lines[line];
+    size_t      offset = start;
+    int         id = NO_LABEL;
+
+    entry->reference = NO_LABEL;
+    (void) sourceNextLine (source, &offset, &text);
+    if ( ! parseLine (text, &label, &instName, &operands) )
+    {
+        entry->kind = LINE_EMPTY;
+        return 1;
+    }
+    parseInstruction (instName, operands, line + 1, &inst);
+    inst.column = (int) (instName.text - text.text) + 1;
+    if ( hasLabelOperand (&inst) &&
+         (inst.label = id = labelId (state, inst.text.text,
+                                     inst.text.length)) == NO_LABEL )
+        return 0;   /* error message already printed */
+
+    /* The labels' addresses are looked up by id, as after tableResolve. */
+    tableInit (&table);
+    table.resolved = state->addresses;
+    table.nbrResolved = state->nbrLabels;
+    if ( encodeInstruction (&inst, table, &entry->word, NULL) != ASM_OK )
+        entry->kind = LINE_ERROR;
+    else if ( inst.instruction->operands == OPS_RS_RT_LABEL )
+        entry->kind = LINE_BRANCH;
+    else if ( inst.instruction->operands == OPS_TARGET )
+        entry->kind = LINE_JUMP;
+    else
+        entry->kind = LINE_WORD;
+
+    if ( entry->kind == LINE_ERROR )
+    {
+        if ( ! reserve ((void **) &state->errors, &state->errorsCapacity,
+                        state->nbrErrors + 1, sizeof(int32_t)) )
+            return 0;
+        state->errors[state->nbrErrors++] = line;
+    }
+    else if ( entry->kind == LINE_BRANCH || entry->kind == LINE_JUMP )
+    {
+        /* Remember where its label was, to tell whether it moves. */
+        entry->reference = id;
+        entry->target = state->addresses[id] -
+                        (entry->kind == LINE_BRANCH ? inst.address : 0);
+        linkLine (state, line);
+    }
+    return 1;
+}
+
+/*
+ * Returns the id of the label name (of the given length) in state,
+ * adding it (neither defined nor used yet) if it is not there; NO_LABEL
+ * (after printing an error) if memory allocation error.  The ids are
+ * found through the hashed index, which is kept at most half full.
+ */
+static int labelId (IncrementalState * state, const char * name, int length)
+{
+    const LabelState * label;
+    unsigned           hash = hashIdentifier (name, length);
+    int32_t *          newIndex;
+    int                newCapacity, capacity;
+    int                id;
+    size_t             slot, mask;
+
+    if ( (state->nbrLabels + 1) * 2 > state->indexCapacity )
+    {
+        newCapacity = state->indexCapacity > 0 ? state->indexCapacity * 2
+                                               : 1024;
+        if ( (newIndex = malloc ((size_t) newCapacity * sizeof(int32_t)))
+             == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return NO_LABEL;
+        }
+        memset (newIndex, -1, (size_t) newCapacity * sizeof(int32_t));
+        mask = (size_t) newCapacity - 1;
+        for ( id = 0; id < state->nbrLabels; id++ )
+        {
+            for ( slot = state->labels[id].hash & mask; newIndex[slot] != -1;
+                  slot = (slot + 1) & mask )
+                ;
+            newIndex[slot] = id;
+        }
+        free (state->index);
+        state->index = newIndex;
+        state->indexCapacity = newCapacity;
+    }
+
+    mask = (size_t) state->indexCapacity - 1;
+    for ( slot = hash & mask; state->index[slot] != -1;
+          slot = (slot + 1) & mask )
+    {
+        label = &state->labels[state->index[slot]];
+        if ( label->hash == hash &&
+             strncmp (state->names + label->name, name, (size_t) length)
+                 == SAME &&
+             state->names[label->name + length] == '\0' )
+            return state->index[slot];
+    }
+
+    capacity = state->labelsCapacity;
+    if ( ! reserve ((void **) &state->labels, &capacity,
+                    state->nbrLabels + 1, sizeof(LabelState)) ||
+         ! reserve ((void **) &state->addresses, &state->labelsCapacity,
+                    state->nbrLabels + 1, sizeof(int32_t)) )
+        return NO_LABEL;
+    id = state->nbrLabels;
+    if ( (state->labels[id].name = addName (state, name, (size_t) length))
+         == NO_NAME )
+        return NO_LABEL;
+    state->labels[id].hash = hash;
+    state->labels[id].definitions = 0;
+    state->labels[id].references = 0;
+    state->labels[id].first = -1;
+    state->labels[id].changed = 0;
+    state->addresses[id] = -1;
+    state->index[slot] = id;
+    state->nbrLabels++;
+    state->unused++;
+    return id;
+}
+
+/*
+ * Records that the given line defines the label id: it is the label's
+ * first definition if no line before it defines it; otherwise it is a
+ * duplicate.
+ * Returns 1 if everything went OK; 0 if memory allocation error.
+ */
+static int addDefinition (IncrementalState * state, int id, int line,
+                          ItemList * changed)
+{
+    if ( state->labels[id].definitions > 0 )
+        state->duplicates++;
+    countUse (state, id, 1, 0);
+    if ( state->addresses[id] != -1 && state->addresses[id] < line * 4 )
+        return 1;
+    state->addresses[id] = line * 4;
+    return markChanged (state, id, changed);
+}
+
+/*
+ * Records that the given line no longer defines the label id.  If it was
+ * its first definition, the label is left undefined (findDefinitions
+ * finds the next one, if there is one).
+ * Returns 1 if everything went OK; 0 if memory allocation error.
+ */
+static int removeDefinition (IncrementalState * state, int id, int line,
+                             ItemList * changed)
+{
+    countUse (state, id, -1, 0);
+    if ( state->labels[id].definitions > 0 )
+        state->duplicates--;
+    if ( state->addresses[id] != line * 4 )
+        return 1;
+    state->addresses[id] = -1;
+    return markChanged (state, id, changed);
+}
+
+/*
+ * Adds the given line (a branch or a jump) to the front of the list of
+ * the lines that use its label.
+ */
+static void linkLine (IncrementalState * state, int line)
+{
+    LineState *  entry = &state->lines[line];
+    LabelState * label = &state->labels[entry->reference];
+
+    entry->previous = 0;
+    entry->next = label->first != -1 ? label->first - line : 0;
+    if ( label->first != -1 )
+        state->lines[label->first].previous = line - label->first;
+    label->first = line;
+    countUse (state, entry->reference, 0, 1);
+}
+
+/*
+ * Takes the given line (a branch or a jump) out of the list of the lines
+ * that use its label.
+ */
+static void unlinkLine (IncrementalState * state, int line)
+{
+    LineState * entry = &state->lines[line];
+    int         previous = entry->previous != 0 ? line + entry->previous
+                                                : -1;
+    int         next = entry->next != 0 ? line + entry->next : -1;
+
+    if ( previous != -1 )
+        state->lines[previous].next = next != -1 ? next - previous : 0;
+    else
+        state->labels[entry->reference].first = next;
+    if ( next != -1 )
+        state->lines[next].previous = previous != -1 ? previous - next : 0;
+    entry->previous = entry->next = 0;
+    countUse (state, entry->reference, 0, -1);
+}
+
+/*
+ * Adds definitions and references to the counts of the label id,
+ * keeping count of the labels that are neither defined nor used.
+ */
+static void countUse (IncrementalState * state, int id, int definitions,
+                      int references)
+{
+    LabelState * label = &state->labels[id];
+    int          wasUnused = label->definitions == 0 &&
+                             label->references == 0;
+
+    label->definitions += definitions;
+    label->references += references;
+    state->unused += (label->definitions == 0 && label->references == 0) -
+                     wasUnused;
+}
+
+/*
+ * Adds the label id to the changed labels, unless it is there already.
+ * Returns 1 if everything went OK; 0 if memory allocation error.
+ */
+static int markChanged (IncrementalState * state, int id, ItemList * changed)
+{
+    if ( state->labels[id].changed )
+        return 1;
+    state->labels[id].changed = 1;
+    return addItem (changed, id);
+}
+
+/*
+ * Adds a label name (of the given length) to the names of state.
+ * Returns its offset in the names; NO_NAME (after printing an error)
+ * if memory allocation error.
+ */
+static uint32_t addName (IncrementalState * state, const char * name,
+                         size_t length)
+{
+    size_t   newCapacity;
+    char *   newNames;
+    uint32_t offset;
+
+    if ( state->namesLength + length + 1 > state->namesCapacity )
+    {
+        newCapacity = state->namesCapacity > 0 ? state->namesCapacity * 2
+                                               : 4096;
+        while ( state->namesLength + length + 1 > newCapacity )
+            newCapacity *= 2;
+        if ( state->namesLength + length + 1 >= NO_NAME ||
+             (newNames = realloc (state->names, newCapacity)) == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return NO_NAME;
+        }
+        state->names = newNames;
+        state->namesCapacity = newCapacity;
+    }
+
+    offset = (uint32_t) state->namesLength;
+    memcpy (state->names + offset, name, length);
+    state->names[offset + length] = '\0';
+    state->namesLength += length + 1;
+    return offset;
+}
+
+/*
+ * Adds an item to the end of a list.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int addItem (ItemList * list, int item)
+{
+    if ( ! reserve ((void **) &list->items, &list->capacity,
+                    list->nbrItems + 1, sizeof(int)) )
+        return 0;
+    list->items[list->nbrItems++] = item;
+    return 1;
+}
+
+/*
+ * Makes sure that an array (of elements of the given size, with room
+ * for capacity of them) has room for needed elements, by doubling its
+ * capacity as many times as it takes.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int reserve (void ** array, int * capacity, int needed, size_t size)
+{
+    size_t newCapacity;
+    void * newArray;
+
+    if ( needed <= *capacity )
+        return 1;
+    newCapacity = *capacity > 0 ? (size_t) *capacity : 1024;
+    while ( newCapacity < (size_t) needed )
+        newCapacity *= 2;
+    if ( newCapacity > INT32_MAX ||
+         (newArray = realloc (*array, newCapacity * size)) == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    *array = newArray;
+    *capacity = (int) newCapacity;
+    return 1;
+}
+
+/* Orders items (lines) in increasing order. */
+static int compareItems (const void * a, const void * b)
+{
+    int first = *(const int *) a;
+    int second = *(const int *) b;
+
+    return first < second ? -1 : first > second;
+}
+
+/*
+ * Assembles source with pass1 and pass2, and empties state, so that the
+ * next assembly is a full one as well.
+ */
+static void assembleAll (SourceFile * source, IncrementalState * state,
+                         OutputFile * output)
+{
+    InstructionList program;
+    LabelTable      table;
+
+    stateFree (state);
+    listInit (&program);
+    statsStart (STATS_PASS1);
+    table = pass1 (source, &program);
+    statsStop (STATS_PASS1);
+    statsStart (STATS_PASS2);
+    pass2 (&program, table, output);
+    statsStop (STATS_PASS2);
+    listFree (&program);
+}
+
+/*
+ * Returns 1 if every line, label id, offset in the names, and link in
+ * state is within bounds (so that a damaged state file cannot be read
+ * past the end of an array); 0 otherwise.
+ */
+static int stateIsValid (const IncrementalState * state)
+{
+    const LineState *  entry;
+    const LabelState * label;
+    int                i;
+
+    if ( state->namesLength > 0 &&
+         state->names[state->namesLength - 1] != '\0' )
+        return 0;
+    if ( (state->indexCapacity & (state->indexCapacity - 1)) != 0 ||
+         state->indexCapacity < state->nbrLabels * 2 )
+        return 0;
+    for ( i = 0; i < state->indexCapacity; i++ )
+        if ( state->index[i] < -1 || state->index[i] >= state->nbrLabels )
+            return 0;
+    for ( i = 0; i < state->nbrLabels; i++ )
+    {
+        label = &state->labels[i];
+        if ( label->name >= state->namesLength || label->changed != 0 ||
+             label->definitions < 0 || label->references < 0 ||
+             label->first < -1 || label->first >= state->nbrLines ||
+             state->addresses[i] < -1 ||
+             state->addresses[i] >= state->nbrLines * 4 )
+            return 0;
+    }
+    for ( i = 0; i < state->nbrErrors; i++ )
+        if ( state->errors[i] < 0 || state->errors[i] >= state->nbrLines )
+            return 0;
+    for ( i = 0; i < state->nbrLines; i++ )
+    {
+        entry = &state->lines[i];
+        if ( entry->kind < LINE_EMPTY || entry->kind >= LINE_EDITED ||
+             entry->label < NO_LABEL || entry->label >= state->nbrLabels )
+            return 0;
+        if ( (entry->kind == LINE_BRANCH || entry->kind == LINE_JUMP) &&
+             (entry->reference < 0 || entry->reference >= state->nbrLabels ||
+              entry->previous < -i || entry->previous >= state->nbrLines - i ||
+              entry->next < -i || entry->next >= state->nbrLines - i) )
+            return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,155 @@
+/*
+ * Incremental assembly: reassembling a program after a small edit
+ *
+ * An IncrementalState is what one assembly of a program leaves for the
+ * next one: for each line of the source, a hash of its text, its label
+ * (if any), and what it assembled to -- nothing, a machine word, a
+ * branch or jump word and the label it uses, or an error -- and for
+ * each label, its name, its address, and how many lines define and use
+ * it.  The lines that use a label (with a branch or a jump) are linked
+ * together, so that they can be found from the label.  The state is kept
+ * in a file between runs of the assembler (see stateLoad and stateSave).
+ *
+ * incrementalAssemble compares the new source with the state line by
+ * line, by their hashes.  The lines in the longest common prefix and
+ * suffix of the two are unchanged; each line between them is matched
+ * with an old line between them that has the same text, if there is
+ * one, and is otherwise an edited line.  The lines of the prefix keep
+ * their state as it is.  Since the address of a line is given by its
+ * line number, the lines of the suffix (and their labels) move when
+ * lines before them are inserted or deleted; only then are their labels
+ * given their new addresses.  The labels of the lines between the prefix
+ * and the suffix are taken out of the label table, and those of the new
+ * lines between them put in (only the edited lines are parsed for
+ * theirs).  Then only these lines are parsed and encoded again:
+ *      - the edited lines
+ *      - lines that had errors (so that the errors are reported again,
+ *        with their new line numbers)
+ *      - branches whose offset to their label has changed, because the
+ *        branch moved or its label moved (or is no longer defined)
+ *      - jumps whose label has moved (or is no longer defined)
+ * and only the branches and jumps that moved, or that use a label that
+ * moved, are looked at to find them.  Every other line keeps the word it
+ * had, so the time taken depends on the size of the edit and on how far
+ * its effects reach, apart from reading and hashing the source, reading
+ * and writing the state, and writing the output.  The output (machine
+ * code, errors, and duplicate label messages) is exactly the same as a
+ * full assembly with pass1 and pass2.
+ *
+ * A program with data directives (see dataSegment.h) is always
+ * assembled in full, with pass1 and pass2, and leaves an empty state:
+ * a directive changes the addresses of the lines after it.
+ *
+ */
+
+#ifndef _INCREMENTAL_H
+#define _INCREMENTAL_H
+
+#include <stdint.h>
+
+#include "LabelTable.h"
+#include "outputFile.h"
+#include "sourceFile.h"
+
+/* What a line assembled to. */
+typedef enum {
+        LINE_EMPTY,             /* no instruction (maybe a label) */
+        LINE_WORD,              /* a word that does not use a label */
+        LINE_BRANCH,            /* a word with an offset to a label */
+        LINE_JUMP,              /* a word with the address of a label */
+        LINE_ERROR,             /* an instruction with an error */
+        LINE_EDITED             /* not assembled yet (while assembling) */
+} LineKind;
+
+/* Label id meaning "no label". */
+#define NO_LABEL (-1)
+
+/* The state of one line. */
+typedef struct {
+        uint64_t hash;          /* hash of the text of the line */
+        uint32_t word;          /* the machine word, unless LINE_EMPTY or
+                                 * LINE_ERROR */
+        int32_t  kind;          /* a LineKind */
+        int32_t  target;        /* LINE_BRANCH: address of its label minus
+                                 * its own address; LINE_JUMP: address of
+                                 * its label (when the line was encoded) */
+        int32_t  label;         /* id of the line's label, or NO_LABEL */
+        int32_t  reference;     /* LINE_BRANCH, LINE_JUMP: id of the label
+                                 * it uses */
+        int32_t  previous;      /* LINE_BRANCH, LINE_JUMP: the number of
+                                 * the previous line in the list of lines
+                                 * that use the same label, minus its
+                                 * own; 0 if none */
+        int32_t  next;          /* the same, for the next one */
+} LineState;
+
+/* The state of one label (defined, used, or both). */
+typedef struct {
+        uint32_t name;          /* offset of its name in names */
+        uint32_t hash;          /* hashIdentifier of the name */
+        int32_t  definitions;   /* nbr of lines that define it */
+        int32_t  references;    /* nbr of branches and jumps that use it */
+        int32_t  first;         /* one of these (the first of the list),
+                                 * or -1 */
+        int32_t  changed;       /* 1 if its address has changed (only
+                                 * while assembling) */
+} LabelState;
+
+typedef struct {
+        LineState *  lines;
+        int          nbrLines;
+        int          linesCapacity;
+        LabelState * labels;    /* by id */
+        int32_t *    addresses; /* address of each label id (its first
+                                 * definition), or -1; for findLabelId */
+        int          nbrLabels;
+        int          labelsCapacity;
+        int32_t *    index;     /* hash slots holding label ids; -1 is an
+                                 * empty slot */
+        int          indexCapacity;     /* nbr of slots (power of 2) */
+        int32_t *    errors;    /* the lines with errors, in order */
+        int          nbrErrors;
+        int          errorsCapacity;
+        char *       names;     /* label names, each null-terminated */
+        size_t       namesLength;
+        size_t       namesCapacity;
+        int          duplicates;    /* nbr of definitions of labels that
+                                     * were already defined */
+        int          unused;        /* nbr of labels that are neither
+                                     * defined nor used */
+} IncrementalState;
+
+void stateInit (IncrementalState * state);
+        /* Postcondition: state is empty, as if no program had been
+         *      assembled before (so everything will be assembled).
+         */
+
+int stateLoad (IncrementalState * state, const char * path);
+        /* Postcondition: state holds the state saved in the file path,
+         *      or is empty if there is no such file or it is not a state
+         *      file of this version of the assembler.
+         * Returns 1 if the state was loaded; 0 if it is empty.
+         */
+
+int stateSave (const IncrementalState * state, const char * path);
+        /* Postcondition: the file path holds state.  The file is
+         *      replaced only once the new state has been written in
+         *      full, so it is never left half written.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the file could not be written.
+         */
+
+void stateFree (IncrementalState * state);
+        /* Postcondition: the memory of state has been released and it
+         *      is empty.
+         */
+
+void incrementalAssemble (SourceFile * source, IncrementalState * state,
+                          OutputFile * output);
+        /* Precondition: source is not streamed (see sourceOpenStream).
+         * Postcondition: the machine code of source has been added to
+         *      output, and its errors reported, as by pass1 and pass2;
+         *      state is the state of source.
+         */
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * This file contains the instructionKey function, which packs an
+ * instruction name into a 64-bit integer so that instruction names can
+ * be hashed and compared without string comparisons.  It is used both
+ * by findInstruction (InstructionTable.c) and by makeInstructionHash,
+ * which generates the hash table at build time, so both always agree.
+ *
+ * See InstructionTable.h for more information.
+ *
+ */
+
+#include "InstructionTable.h"
+
+uint64_t instructionKey (const char * name, int length)
+{
+    uint64_t key = 0;
+    int      i;
+
+    if ( length <= 0 || length > 8 )
+        return 0;
+
+    for ( i = 0; i < length; i++ )
+        key |= (uint64_t) (unsigned char) name[i] << (8 * i);
+    return key;
+}
@@ -0,0 +1,162 @@
+/*
+ * Interner: a dense integer id for each distinct identifier
+ *
+ * This file provides the definitions of the functions declared in
+ * interner.h.  The identifiers are kept in one array, indexed by id,
+ * which doubles in size whenever it fills up; the index doubles whenever
+ * it would become more than half full.
+ *
+ * hashIdentifier takes the identifier 8 characters at a time, mixing
+ * each group into the hash with a multiplication, and folds the high
+ * bits into the low ones (which choose the slot).  Labels are often
+ * long (e.g., generated or mangled names), so this is several times
+ * faster than hashing one character at a time.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interner.h"
+#include "printFuncs.h"
+
+/* Capacity of the array when the first identifier is added. */
+#define INITIAL_CAPACITY 64
+
+/* Constants of hashIdentifier: any odd 64-bit numbers with well-mixed
+ * bits will do.
+ */
+#define HASH_SEED       0x9E3779B97F4A7C15u
+#define HASH_MULTIPLIER 0xFF51AFD7ED558CCDu
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+static int  findSlot (const Interner * interner, Span name, unsigned hash);
+static int  resizeIndex (Interner * interner, int newCapacity);
+
+void internerInit (Interner * interner)
+{
+    interner->identifiers = NULL;
+    interner->nbrIdentifiers = 0;
+    interner->capacity = 0;
+    interner->index = NULL;
+    interner->indexCapacity = 0;
+}
+
+int intern (Interner * interner, Span name)
+{
+    return internHashed (interner, name, hashIdentifier (name.text,
+                                                         name.length));
+}
+
+int internHashed (Interner * interner, Span name, unsigned hash)
+{
+    Identifier * newArray;
+    int          newCapacity;
+    int          slot, id;
+
+    if ( interner->index != NULL &&
+         interner->index[slot = findSlot (interner, name, hash)] != -1 )
+        return interner->index[slot];
+
+    /* A new identifier: make room for it, then add it. */
+    if ( interner->nbrIdentifiers >= interner->capacity )
+    {
+        newCapacity = interner->capacity > 0 ? interner->capacity * 2
+                                             : INITIAL_CAPACITY;
+        newArray = realloc (interner->identifiers,
+                            (size_t) newCapacity * sizeof(Identifier));
+        if ( newArray == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return -1;
+        }
+        interner->identifiers = newArray;
+        interner->capacity = newCapacity;
+    }
+    if ( (interner->nbrIdentifiers + 1) * 2 > interner->indexCapacity &&
+         ! resizeIndex (interner, interner->indexCapacity > 0
+                                      ? interner->indexCapacity * 2
+                                      : INITIAL_CAPACITY * 2) )
+        return -1;
+
+    id = interner->nbrIdentifiers++;
+    interner->identifiers[id].name = name;
+    interner->identifiers[id].hash = hash;
+    interner->index[findSlot (interner, name, hash)] = id;
+    return id;
+}
+
+void internerFree (Interner * interner)
+{
+    free (interner->identifiers);
+    free (interner->index);
+    internerInit (interner);
+}
+
+unsigned hashIdentifier (const char * name, int length)
+{
+    uint64_t hash = HASH_SEED ^ (uint64_t) length;
+    uint64_t word;
+    int      i;
+
+    for ( i = 0; i < length; i += 8 )
+    {
+        word = 0;
+        memcpy (&word, name + i, length - i < 8 ? (size_t) (length - i) : 8);
+        hash = (hash ^ word) * HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    return (unsigned) (hash ^ (hash >> 29));
+}
+
+/*
+ * Returns the slot of the index holding the id of name, or the empty
+ * slot where it would go if it is not there.
+ */
+static int findSlot (const Interner * interner, Span name, unsigned hash)
+{
+    int          mask = interner->indexCapacity - 1;
+    int          slot;
+    Identifier * identifier;
+
+    for ( slot = (int) (hash & (unsigned) mask); interner->index[slot] != -1;
+          slot = (slot + 1) & mask )
+    {
+        identifier = &interner->identifiers[interner->index[slot]];
+        if ( identifier->hash == hash &&
+             identifier->name.length == name.length &&
+             memcmp (identifier->name.text, name.text,
+                     (size_t) name.length) == 0 )
+            break;
+    }
+    return slot;
+}
+
+/*
+ * Postcondition: the index has newCapacity slots (a power of 2) and
+ *      holds every identifier.
+ * Returns 1 if everything went OK; 0 (after printing an error) if memory
+ *      allocation error.
+ */
+static int resizeIndex (Interner * interner, int newCapacity)
+{
+    int * newIndex = malloc ((size_t) newCapacity * sizeof(int));
+    int   id;
+
+    if ( newIndex == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    memset (newIndex, -1, (size_t) newCapacity * sizeof(int));
+    free (interner->index);
+    interner->index = newIndex;
+    interner->indexCapacity = newCapacity;
+
+    for ( id = 0; id < interner->nbrIdentifiers; id++ )
+        interner->index[findSlot (interner, interner->identifiers[id].name,
+                                  interner->identifiers[id].hash)] = id;
+    return 1;
+}
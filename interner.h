@@ -0,0 +1,66 @@
+/*
+ * Interner: a dense integer id for each distinct identifier
+ *
+ * An Interner gives each distinct identifier it is shown an id: 0 for
+ * the first one, 1 for the next new one, and so on.  Showing it an
+ * identifier it has already seen gives back the same id, so once
+ * identifiers have been interned they can be compared by id and used to
+ * index arrays.  The interner keeps each identifier's hash and length
+ * along with it, so the identifier never needs to be hashed again.
+ *
+ * The assembler interns the label operands of the instructions as they
+ * are added to the program (see InstructionList.h).  At the end of pass1
+ * the label table looks up the address of each id once (see
+ * tableResolve in LabelTable.h), and pass2 finds the target of each
+ * branch and jump by indexing that array with the id, instead of
+ * hashing and comparing the label's name again for every reference.
+ *
+ * The identifiers are not copied: each is a span into the text it was
+ * found in, which must stay valid as long as the interner is used.
+ * Ids are found with an open-addressed (linear probing) hash index, kept
+ * at most half full, like the label table's.
+ *
+ */
+
+#ifndef _INTERNER_H
+#define _INTERNER_H
+
+#include "getToken.h"
+
+typedef struct {
+        Span     name;          /* the identifier (and its length) */
+        unsigned hash;          /* hashIdentifier of the name */
+} Identifier;
+
+typedef struct {
+        Identifier * identifiers;       /* by id */
+        int          nbrIdentifiers;
+        int          capacity;
+        int *        index;             /* hash slots holding ids; -1 is
+                                         * an empty slot */
+        int          indexCapacity;     /* nbr of slots (power of 2) */
+} Interner;
+
+void internerInit (Interner * interner);
+        /* Postcondition: interner has no identifiers. */
+
+int intern (Interner * interner, Span name);
+int internHashed (Interner * interner, Span name, unsigned hash);
+        /* Precondition: for internHashed, hash is hashIdentifier of name.
+         * Postcondition: name has an id in interner (a new one, the
+         *      number of identifiers it had, if it was not there).
+         * Returns the id of name; -1 (after printing an error) if memory
+         *      allocation error.
+         */
+
+void internerFree (Interner * interner);
+        /* Postcondition: the memory of the interner has been released
+         *      and it has no identifiers.
+         */
+
+unsigned hashIdentifier (const char * name, int length);
+        /* Returns a 32-bit hash of the first length characters of name
+         *      (the hash the label table uses, too).
+         */
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * libassembler: the assembler as a library
+ *
+ * This file provides the definitions of the functions declared in
+ * libassembler.h.  An assembly does what the assembler does in two
+ * passes, on text in memory (see sourceOpenText): pass1 builds the label
+ * table, parses the instructions, and assembles the data, and then each
+ * instruction is encoded and stored in the caller's words, followed by
+ * the words of the data.
+ *
+ * The functions the assembler shares with the library keep no global
+ * state of their own: the label table and the instructions are in the
+ * context (the label table allocates from the context's arena, which is
+ * emptied for each assembly; see arena.h), and the per-thread state
+ * they use is in printError.c and printDebug.c.  While it assembles,
+ * the calling thread holds its error messages (see hold_errors), so that
+ * they are collected instead of printed, are not counted toward
+ * ERROR_LIMIT, and cannot make printError exit; and it turns debugging
+ * off, so nothing is printed to stdout.
+ *
+ */
+
+#include "assembler.h"
+#include "libassembler.h"
+
+struct Assembler {
+        Arena           arena;      /* memory of the label table */
+        LabelTable      table;      /* labels of the last program */
+        InstructionList program;    /* instructions of the last program */
+        char *          errors;     /* its error messages, or NULL */
+        int             nbrErrors;
+        int             errorLimit; /* stop after more errors; <= 0: never */
+};
+
+static const char * ERROR_TOO_BIG =
+    "\nError: the program does not fit in %lu words, at line %d\n";
+static const char * ERROR_DATA_TOO_BIG =
+    "\nError: the data of the program does not fit in %lu words\n";
+
+static int tooManyErrors (const Assembler * assembler);
+
+Assembler * assemblerNew (void)
+{
+    Assembler * assembler;
+
+    if ( (assembler = malloc(sizeof(Assembler))) == NULL )
+        return NULL;
+    arenaInit(&assembler->arena, NULL);
+    tableInit(&assembler->table);
+    assembler->table.arena = &assembler->arena;
+    listInit(&assembler->program);
+    assembler->errors = NULL;
+    assembler->nbrErrors = 0;
+    assembler->errorLimit = ASSEMBLER_ERROR_LIMIT;
+    return assembler;
+}
+
+void assemblerFree (Assembler * assembler)
+{
+    if ( assembler == NULL )
+        return;
+    tableFree(&assembler->table);
+    arenaFree(&assembler->arena);
+    listFree(&assembler->program);
+    free(assembler->errors);
+    free(assembler);
+}
+
+void assemblerSetAllocator (Assembler * assembler,
+                            void * (*allocate) (void * context, size_t size),
+                            void (*release) (void * context, void * block),
+                            void * context)
+{
+    ArenaAllocator allocator = { allocate, release, context };
+
+    tableFree(&assembler->table);
+    arenaFree(&assembler->arena);
+    arenaInit(&assembler->arena, allocate != NULL ? &allocator : NULL);
+}
+
+void assemblerSetErrorLimit (Assembler * assembler, int limit)
+{
+    assembler->errorLimit = limit;
+}
+
+int assembleText (Assembler * assembler, const char * text, size_t length,
+                  uint32_t * words, size_t maxWords, size_t * nbrWords)
+{
+    SourceFile    source;
+    Instruction * inst;
+    uint32_t      word;
+    size_t        address;      /* word address of the instruction */
+    size_t        used = 0;     /* size of the image so far */
+    Arena *       previousArena;
+    int           i;
+    size_t        j;
+
+    /* Forget the last program, but keep the space for its instructions
+     * and the first block of its labels.  (Its interned label operands
+     * and data go, since they point into, or came from, its text.)
+     */
+    tableFree(&assembler->table);
+    arenaReset(&assembler->arena);
+    assembler->program.nbrInstructions = 0;
+    internerFree(&assembler->program.labels);
+    internerInit(&assembler->program.labels);
+    dataFree(&assembler->program.data);
+    free(assembler->errors);
+    assembler->errors = NULL;
+
+    debug_off();
+    hold_errors();
+    previousArena = arenaUse(&assembler->arena);
+
+    sourceOpenText(&source, text, length);
+    assembler->table = pass1(&source, &assembler->program);
+
+    for ( i = 0; i < assembler->program.nbrInstructions &&
+                 ! tooManyErrors(assembler); i++ )
+    {
+        inst = &assembler->program.instructions[i];
+        if ( encodeInstruction(inst, assembler->table, &word, NULL) != ASM_OK )
+            continue;
+
+        address = (size_t) inst->address / 4;
+        if ( address >= maxWords )
+        {
+            printError(ERROR_TOO_BIG, (unsigned long) maxWords,
+                       inst->lineNum);
+            break;
+        }
+        /* Zero the words skipped since the last instruction. */
+        while ( used < address )
+            words[used++] = 0;
+        words[used++] = word;
+    }
+
+    /* The data follows the instructions (see dataSegment.h). */
+    for ( j = 0; j < dataNbrWords(&assembler->program.data); j++ )
+    {
+        address = assembler->program.data.address / 4 + j;
+        if ( address >= maxWords )
+        {
+            printError(ERROR_DATA_TOO_BIG, (unsigned long) maxWords);
+            break;
+        }
+        while ( used < address )
+            words[used++] = 0;
+        words[used++] = dataWord(&assembler->program.data, j);
+    }
+    *nbrWords = used;
+
+    sourceClose(&source);
+    (void) arenaUse(previousArena);
+    assembler->nbrErrors = held_error_count();
+    assembler->errors = release_errors();
+    debug_restore();
+    return assembler->nbrErrors == 0;
+}
+
+const char * assemblerErrors (const Assembler * assembler)
+{
+    return assembler->errors != NULL ? assembler->errors : "";
+}
+
+int assemblerErrorCount (const Assembler * assembler)
+{
+    return assembler->nbrErrors;
+}
+
+int assemblerLabelAddress (Assembler * assembler, const char * label)
+{
+    return findLabelN(&assembler->table, label, (int) strlen(label));
+}
+
+/*
+ * Returns 1 if the assembly has found more errors than its limit (so
+ * that the assembler would have stopped); 0 otherwise.
+ */
+static int tooManyErrors (const Assembler * assembler)
+{
+    return assembler->errorLimit > 0 &&
+           held_error_count() > assembler->errorLimit;
+}
@@ -0,0 +1,106 @@
+/*
+ * libassembler: the assembler as a library
+ *
+ * This file provides the interface of libassembler.a, which assembles a
+ * program held in memory into machine words in memory, for programs that
+ * embed the assembler rather than run it.
+ *
+ * All the state of an assembly is kept in an Assembler context: the
+ * label table, the parsed instructions, and the error messages.  The
+ * library has no process-global state, never exits, and never writes to
+ * stdout or stderr; error messages (the same ones the assembler prints)
+ * are collected in the context for the caller to read.  Any number of
+ * threads may assemble at once, each with its own context; a context
+ * must not be used by two threads at the same time.
+ *
+ * A context can be used for any number of programs, one after another;
+ * each assembly starts afresh, but reuses the memory of the last one.
+ * The labels of a program are kept in blocks of memory that belong to
+ * the context, which come from malloc unless the caller supplies its
+ * own allocator with assemblerSetAllocator.
+ *
+ * Usage:
+ *      Assembler * assembler = assemblerNew();
+ *      size_t      nbrWords;
+ *      if ( ! assembleText(assembler, text, length, words, MAX_WORDS,
+ *                          &nbrWords) )
+ *          fputs(assemblerErrors(assembler), stderr);
+ *      assemblerFree(assembler);
+ *
+ */
+
+#ifndef _LIBASSEMBLER_H
+#define _LIBASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The state of the assembler (see libassembler.c). */
+typedef struct Assembler Assembler;
+
+/* Number of errors after which an assembly stops, unless changed with
+ * assemblerSetErrorLimit (the same as the assembler's ERROR_LIMIT).
+ */
+#define ASSEMBLER_ERROR_LIMIT 20
+
+Assembler * assemblerNew (void);
+        /* Returns a new context, or NULL if memory allocation error. */
+
+void assemblerFree (Assembler * assembler);
+        /* Postcondition: the context and everything in it have been
+         *      released.
+         */
+
+void assemblerSetAllocator (Assembler * assembler,
+                            void * (*allocate) (void * context, size_t size),
+                            void (*release) (void * context, void * block),
+                            void * context);
+        /* Postcondition: the context gets the blocks of memory for the
+         *      labels of the programs it assembles from now on with
+         *      allocate(context, size), which returns a block of size
+         *      bytes aligned for any type (or NULL if there is no
+         *      memory), and gives each one back with release(context,
+         *      block) (by the time assemblerFree returns, at the
+         *      latest); if allocate is NULL, it uses malloc and free.
+         *      The labels of the last program are forgotten.
+         */
+
+void assemblerSetErrorLimit (Assembler * assembler, int limit);
+        /* Postcondition: assemblies stop once more than limit errors
+         *      have been found (as the assembler exits once it has
+         *      printed more than ERROR_LIMIT errors); a limit <= 0 means
+         *      no limit.
+         */
+
+int assembleText (Assembler * assembler, const char * text, size_t length,
+                  uint32_t * words, size_t maxWords, size_t * nbrWords);
+        /* Assembles the length characters of text (which need not be
+         *      null-terminated), a program in the assembler's source
+         *      format.
+         * Postcondition: words holds the memory image of the program:
+         *      words[i] is the instruction at address 4 * i, or 0 if no
+         *      instruction was encoded there (a blank line, a comment, or
+         *      an instruction with an error), and the data segment
+         *      follows the instructions (see dataSegment.h).  *nbrWords
+         *      is the size of the image (up to the last word encoded),
+         *      which may not be more than maxWords.  The labels and error messages
+         *      of the program are kept in the context.
+         * Returns 1 if the program was assembled without errors; 0 if
+         *      there were errors (see assemblerErrors).
+         */
+
+const char * assemblerErrors (const Assembler * assembler);
+        /* Returns the error messages of the last assembly, in the order
+         *      the assembler would print them ("" if there were none).
+         *      The string is valid until the context is used again.
+         */
+
+int assemblerErrorCount (const Assembler * assembler);
+        /* Returns the number of error messages of the last assembly. */
+
+int assemblerLabelAddress (Assembler * assembler, const char * label);
+        /* Returns the address of the label in the last program
+         *      assembled; -1 if there is no such label.
+         */
+
+#endif
@@ -0,0 +1,597 @@
+/**
+ * linker: links object files into one program image
+ *
+ * The linker combines the object files written by "assembler -c" (see
+ * objectFile.h) into one image, as the assembler writes the image of a
+ * single program, in the output format chosen with -f.  The text
+ * sections of the objects are placed one after another from the base
+ * address (0 unless --base is given), in the order of the arguments,
+ * and then their data sections, so the image holds all the instructions
+ * of the program followed by all its data.
+ *
+ * The global symbols of all the objects make up one global symbol
+ * table: a label table for the whole program, holding the labels that
+ * each object exports, with each name interned once (see interner.h)
+ * so that it is hashed once however many objects import it.  Each
+ * object's symbols are then given their final addresses, its local
+ * symbols from its own sections and its undefined ones from the global
+ * table.  A symbol that is exported by two objects, or that is imported
+ * and exported by none, is an error.
+ *
+ * Once every symbol has its address, the relocations of each object
+ * patch only words of its own text section, so the objects are
+ * relocated in parallel by a pool of -j threads (one per processor by
+ * default), each relocating one object at a time into a copy of its
+ * text section.  Meanwhile the calling thread writes the text sections,
+ * in order, as soon as each has been relocated, and then the data
+ * sections, which have no relocations, straight from the objects, so
+ * the image is written in one pass.  The objects are mapped into memory
+ * (see objectOpen), so nothing is read that is not used and a text
+ * section without relocations is never copied.
+ *
+ * Errors are printed to stderr, up to the ERROR_LIMIT, as by the
+ * assembler.  An object that cannot be read stops the link; otherwise
+ * the image is still written, with the field of each relocation that
+ * could not be applied (its symbol is not defined, or is out of its
+ * reach) left as 0, and the exit status is 1.
+ *
+ * USAGE:
+ *      linker [--base=ADDRESS] [--error-limit=N] [-j N] [-f format]
+ *             object... > image
+ * An argument "@list" stands for the objects named in the file list,
+ * one per line.
+ *
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "objectFile.h"
+
+/* Most threads -j starts. */
+#define MAX_JOBS 256
+
+/* The address of a symbol that is not defined.  (A defined symbol
+ * could only have it if it labelled the end of a program that filled
+ * memory to its last byte, which layOut does not allow.)
+ */
+#define UNRESOLVED 0xFFFFFFFF
+
+static const char * USAGE =
+    "Usage:  %s [--base=ADDRESS] [--error-limit=N] [-j threads]"
+    " [-f ascii|raw-be|raw-le|ihex|readmemh|logisim] object...\n";
+
+/* One of the objects being linked. */
+typedef struct {
+    ObjectFile object;
+    uint32_t   textAddress;     /* where its sections are placed */
+    uint32_t   dataAddress;
+    uint32_t * symbolAddress;   /* final address of each symbol, or
+                                 * UNRESOLVED */
+    uint32_t * words;           /* its relocated text section (NULL if
+                                 * it has no relocations) */
+    int        nbrOutOfRange;   /* relocations out of reach */
+    int        done;            /* 1 once it has been relocated */
+} Module;
+
+/* A global symbol, by id. */
+typedef struct {
+    uint32_t address;
+    int      module;            /* the module that defines it; -1 if none */
+} GlobalSymbol;
+
+/* The global symbol table. */
+typedef struct {
+    Interner       names;       /* the symbols' names, by id */
+    GlobalSymbol * symbols;     /* by id */
+    int            nbrSymbols;
+    int            capacity;
+} GlobalTable;
+
+/* The state shared by the relocating threads. */
+typedef struct {
+    Module *        modules;
+    int             nbrModules;
+    int             nextModule;     /* next module nobody has taken */
+    int             failed;         /* 1 if a module could not be
+                                     * relocated */
+    pthread_mutex_t lock;           /* protects nextModule, failed, and
+                                     * done */
+    pthread_cond_t  moduleDone;     /* signalled when a module is done */
+} RelocationPool;
+
+static int    nbrErrors = 0;
+
+static int    layOut (Module * modules, int nbrModules, uint32_t base);
+static int    defineGlobals (GlobalTable * globals, Module * modules,
+                             int nbrModules);
+static int    resolveSymbols (GlobalTable * globals, Module * modules,
+                              int nbrModules);
+static int    findGlobal (GlobalTable * globals, const char * name);
+static int    linkModules (Module * modules, int nbrModules, int nbrThreads,
+                           OutputFile * output);
+static void * relocateModules (void * pool);
+static int    relocateModule (Module * module);
+static void   reportOutOfRange (const Module * module);
+static int    writeModule (const Module * module, OutputFile * output);
+
+int main (int argc, char * argv[])
+{
+    OutputFormat  format = FORMAT_ASCII;
+    OutputFile *  output;
+    GlobalTable   globals;
+    Module *      modules;
+    unsigned long base = 0;
+    long          value;
+    char *        end;
+    int           nbrThreads = 0;
+    int           nbrModules, ok = 1;
+    int           i;
+
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strncmp(argv[i], "--base=", 7) == SAME )
+        {
+            base = strtoul(argv[i] + 7, &end, 0);
+            if ( end == argv[i] + 7 || *end != '\0' || base % 4 != 0 ||
+                 base > 0xFFFFFFFCUL )
+                ok = 0;
+        }
+        else if ( strncmp(argv[i], "--error-limit=", 14) == SAME )
+        {
+            value = strtol(argv[i] + 14, &end, 10);
+            if ( end == argv[i] + 14 || *end != '\0' || value < 0 ||
+                 value > 1000000000 )
+                ok = 0;
+            ERROR_LIMIT = (int) value;
+        }
+        else if ( strcmp(argv[i], "-j") == SAME )
+        {
+            if ( i + 1 >= argc || (nbrThreads = atoi(argv[++i])) < 1 ||
+                 nbrThreads > MAX_JOBS )
+                ok = 0;
+        }
+        else if ( strcmp(argv[i], "-f") == SAME )
+        {
+            if ( i + 1 >= argc || ! outputFormatNamed(argv[++i], &format) )
+                ok = 0;
+        }
+        else if ( argv[i][0] == '-' && argv[i][1] != '\0' )
+            ok = 0;
+        else if ( argv[i][0] == '@' )
+        {
+            if ( ! read_input_list(argv[i] + 1) )
+                return 1;   /* error message already printed */
+        }
+        else if ( ! add_input(argv[i]) )
+            return 1;
+    }
+    if ( ! ok || OPTIONS.nbrInputs == 0 )
+    {
+        printError(USAGE, argv[0]);
+        return 1;
+    }
+    if ( nbrThreads == 0 )
+        nbrThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    nbrModules = OPTIONS.nbrInputs;
+    modules = calloc((size_t) nbrModules, sizeof(Module));
+    output = malloc(sizeof(OutputFile));
+    if ( modules == NULL || output == NULL )
+    {
+        printError("Error: cannot allocate space in memory.\n");
+        return 1;
+    }
+
+    // Map every object, so that all the unreadable ones are reported
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        if ( ! objectOpen(&modules[i].object, OPTIONS.inputs[i]) )
+            ok = 0;
+    }
+
+    // Place the sections, and give every symbol its address
+    memset(&globals, 0, sizeof(globals));
+    internerInit(&globals.names);
+    ok = ok && layOut(modules, nbrModules, (uint32_t) base) &&
+         defineGlobals(&globals, modules, nbrModules) &&
+         resolveSymbols(&globals, modules, nbrModules);
+
+    // Relocate the objects on nbrThreads threads, writing the image as
+    // they are done
+    if ( ok )
+    {
+        outputOpen(output, stdout, format);
+        outputOrigin(output, (uint32_t) base);
+        ok = linkModules(modules, nbrModules, nbrThreads, output);
+        ok = outputClose(output) && ok;
+    }
+
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        objectClose(&modules[i].object);
+        free(modules[i].symbolAddress);
+    }
+    free(modules);
+    free(output);
+    free(globals.symbols);
+    internerFree(&globals.names);
+    return ok && nbrErrors == 0 ? 0 : 1;
+}
+
+/*
+ * Places the text sections of the modules one after another from base,
+ * and their data sections after them.
+ * Returns 1 if everything went OK; 0 (after printing an error) if they
+ * do not fit in memory.
+ */
+static int layOut (Module * modules, int nbrModules, uint32_t base)
+{
+    uint64_t address = base;
+    int      i;
+
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        modules[i].textAddress = (uint32_t) address;
+        address += (uint64_t) modules[i].object.header->nbrTextWords * 4;
+        if ( address > 0xFFFFFFFFULL )
+            break;
+    }
+    for ( i = 0; address <= 0xFFFFFFFFULL && i < nbrModules; i++ )
+    {
+        modules[i].dataAddress = (uint32_t) address;
+        address += (uint64_t) modules[i].object.header->nbrDataWords * 4;
+    }
+    if ( address > 0xFFFFFFFFULL )
+    {
+        printError("Error: the program does not fit in memory from address "
+                   "0x%08x.\n", (unsigned) base);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Adds the global symbols each module defines to the global table,
+ * reporting those that more than one module defines (the first one is
+ * kept).
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int defineGlobals (GlobalTable * globals, Module * modules,
+                          int nbrModules)
+{
+    const ObjectFile *   object;
+    const ObjectSymbol * symbol;
+    GlobalSymbol *       global;
+    const char *         name;
+    uint32_t             j;
+    int                  i, id;
+
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        object = &modules[i].object;
+        for ( j = 0; j < object->header->nbrSymbols; j++ )
+        {
+            symbol = &object->symbols[j];
+            if ( ! symbol->global || symbol->section == SECTION_UNDEFINED )
+                continue;
+            name = object->names + symbol->name;
+            if ( (id = findGlobal(globals, name)) == -1 )
+                return 0;   /* error message already printed */
+            global = &globals->symbols[id];
+            if ( global->module != -1 )
+            {
+                printError("Error: '%s' is defined in both %s and %s.\n",
+                           name, modules[global->module].object.path,
+                           object->path);
+                nbrErrors++;
+                continue;
+            }
+            global->module = i;
+            global->address = symbol->value +
+                              (symbol->section == SECTION_TEXT
+                                   ? modules[i].textAddress
+                                   : modules[i].dataAddress);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Gives every symbol of each module its final address: from the
+ * module's sections if it is defined there, and from the global table
+ * otherwise, reporting those that no module defines.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int resolveSymbols (GlobalTable * globals, Module * modules,
+                           int nbrModules)
+{
+    const ObjectFile *   object;
+    const ObjectSymbol * symbol;
+    const char *         name;
+    uint32_t *           address;
+    uint32_t             j;
+    int                  i, id;
+
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        object = &modules[i].object;
+        address = malloc((object->header->nbrSymbols > 0
+                              ? object->header->nbrSymbols : 1) *
+                         sizeof(uint32_t));
+        if ( (modules[i].symbolAddress = address) == NULL )
+        {
+            printError("Error: cannot allocate space in memory.\n");
+            return 0;
+        }
+        for ( j = 0; j < object->header->nbrSymbols; j++ )
+        {
+            symbol = &object->symbols[j];
+            if ( symbol->section == SECTION_TEXT )
+                address[j] = modules[i].textAddress + symbol->value;
+            else if ( symbol->section == SECTION_DATA )
+                address[j] = modules[i].dataAddress + symbol->value;
+            else
+            {
+                name = object->names + symbol->name;
+                if ( (id = findGlobal(globals, name)) == -1 )
+                    return 0;   /* error message already printed */
+                address[j] = globals->symbols[id].address;
+                if ( globals->symbols[id].module == -1 )
+                {
+                    printError("Error: '%s', used in %s, is not defined.\n",
+                               name, object->path);
+                    nbrErrors++;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Finds the global symbol named name, adding it (not defined) if there
+ * is none.
+ * Returns its id; -1 (after printing an error) if memory allocation
+ * error.
+ */
+static int findGlobal (GlobalTable * globals, const char * name)
+{
+    GlobalSymbol * grown;
+    Span           span;
+    int            capacity, id;
+
+    span.text = name;
+    span.length = (int) strlen(name);
+    if ( (id = intern(&globals->names, span)) == -1 )
+        return -1;          /* error message already printed */
+    if ( id < globals->nbrSymbols )
+        return id;
+
+    if ( id >= globals->capacity )
+    {
+        capacity = globals->capacity > 0 ? globals->capacity * 2 : 1024;
+        grown = realloc(globals->symbols,
+                        (size_t) capacity * sizeof(GlobalSymbol));
+        if ( grown == NULL )
+        {
+            printError("Error: cannot allocate space in memory.\n");
+            return -1;
+        }
+        globals->symbols = grown;
+        globals->capacity = capacity;
+    }
+    globals->symbols[id].address = UNRESOLVED;
+    globals->symbols[id].module = -1;
+    globals->nbrSymbols++;
+    return id;
+}
+
+/*
+ * Relocates the modules on nbrThreads threads (or on the calling thread
+ * if they cannot be started), and writes their text sections to output
+ * in order, as soon as each has been relocated, and then their data
+ * sections.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error or if the output could not be written.
+ */
+static int linkModules (Module * modules, int nbrModules, int nbrThreads,
+                        OutputFile * output)
+{
+    RelocationPool pool;
+    pthread_t *    threads;
+    int            nbrStarted = 0;
+    int            i, ok = 1;
+
+    pool.modules = modules;
+    pool.nbrModules = nbrModules;
+    pool.nextModule = 0;
+    pool.failed = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.moduleDone, NULL);
+
+    if ( nbrThreads > nbrModules )
+        nbrThreads = nbrModules;
+    if ( nbrThreads > 1 &&
+         (threads = malloc((size_t) nbrThreads * sizeof(pthread_t))) != NULL )
+    {
+        while ( nbrStarted < nbrThreads &&
+                pthread_create(&threads[nbrStarted], NULL, relocateModules,
+                               &pool) == 0 )
+            nbrStarted++;
+    }
+    else
+        threads = NULL;
+
+    /* Write the text section of each module, in order, as soon as it has
+     * been relocated.
+     */
+    for ( i = 0; ok && i < nbrModules; i++ )
+    {
+        if ( nbrStarted == 0 )
+            ok = relocateModule(&modules[i]);
+        else
+        {
+            pthread_mutex_lock(&pool.lock);
+            while ( ! modules[i].done )
+                pthread_cond_wait(&pool.moduleDone, &pool.lock);
+            ok = ! pool.failed;
+            pthread_mutex_unlock(&pool.lock);
+        }
+        if ( ! ok )
+            break;          /* error message already printed */
+        if ( modules[i].nbrOutOfRange > 0 )
+            reportOutOfRange(&modules[i]);
+        ok = writeModule(&modules[i], output);
+        free(modules[i].words);
+        modules[i].words = NULL;
+    }
+
+    /* Stop the threads from taking new modules and wait for them. */
+    pthread_mutex_lock(&pool.lock);
+    pool.nextModule = pool.nbrModules;
+    pthread_mutex_unlock(&pool.lock);
+    for ( i = 0; i < nbrStarted; i++ )
+        pthread_join(threads[i], NULL);
+    for ( i = 0; i < nbrModules; i++ )
+    {
+        free(modules[i].words);
+        modules[i].words = NULL;
+    }
+
+    /* The data sections follow all the text sections. */
+    for ( i = 0; ok && i < nbrModules; i++ )
+    {
+        const ObjectFile * object = &modules[i].object;
+        uint32_t           j;
+
+        for ( j = 0; ok && j < object->header->nbrDataWords; j++ )
+            ok = outputWord(output, modules[i].dataAddress + j * 4,
+                            object->data[j]);
+    }
+
+    pthread_cond_destroy(&pool.moduleDone);
+    pthread_mutex_destroy(&pool.lock);
+    free(threads);
+    return ok;
+}
+
+/*
+ * The work of each thread: relocate modules until there are none left.
+ */
+static void * relocateModules (void * arg)
+{
+    RelocationPool * pool = arg;
+    int              moduleNbr;
+    int              ok;
+
+    for ( ;; )
+    {
+        pthread_mutex_lock(&pool->lock);
+        moduleNbr = pool->nextModule < pool->nbrModules ? pool->nextModule++
+                                                        : -1;
+        pthread_mutex_unlock(&pool->lock);
+        if ( moduleNbr == -1 )
+            return NULL;
+
+        ok = relocateModule(&pool->modules[moduleNbr]);
+
+        pthread_mutex_lock(&pool->lock);
+        if ( ! ok )
+            pool->failed = 1;
+        pool->modules[moduleNbr].done = 1;
+        pthread_cond_broadcast(&pool->moduleDone);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/*
+ * Applies the relocations of a module to a copy of its text section,
+ * counting those whose field cannot hold their symbol's address; those
+ * whose symbol is not defined are left as they are.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int relocateModule (Module * module)
+{
+    const ObjectFile *       object = &module->object;
+    const ObjectRelocation * relocation;
+    uint32_t                 address, j;
+
+    if ( object->header->nbrRelocations == 0 )
+        return 1;           /* written as it is */
+    module->words = malloc((size_t) object->header->nbrTextWords *
+                           sizeof(uint32_t));
+    if ( module->words == NULL )
+    {
+        printError("Error: cannot allocate space in memory.\n");
+        return 0;
+    }
+    memcpy(module->words, object->text,
+           (size_t) object->header->nbrTextWords * sizeof(uint32_t));
+
+    for ( j = 0; j < object->header->nbrRelocations; j++ )
+    {
+        relocation = &object->relocations[j];
+        address = module->symbolAddress[relocation->symbol];
+        if ( address != UNRESOLVED &&
+             ! objectRelocate(&module->words[relocation->offset / 4],
+                              relocation->type, address,
+                              module->textAddress + relocation->offset) )
+            module->nbrOutOfRange++;
+    }
+    return 1;
+}
+
+/*
+ * Reports each relocation of a module whose field cannot hold its
+ * symbol's address.
+ */
+static void reportOutOfRange (const Module * module)
+{
+    const ObjectFile *       object = &module->object;
+    const ObjectRelocation * relocation;
+    uint32_t                 address, word, j;
+
+    for ( j = 0; j < object->header->nbrRelocations; j++ )
+    {
+        relocation = &object->relocations[j];
+        address = module->symbolAddress[relocation->symbol];
+        word = 0;
+        if ( address != UNRESOLVED &&
+             ! objectRelocate(&word, relocation->type, address,
+                              module->textAddress + relocation->offset) )
+        {
+            printError("Error: %s: '%s' is out of reach of the %s at "
+                       "address 0x%08x.\n", object->path,
+                       object->names +
+                           object->symbols[relocation->symbol].name,
+                       relocation->type == RELOC_JUMP ? "jump" : "branch",
+                       (unsigned) (module->textAddress +
+                                   relocation->offset));
+            nbrErrors++;
+        }
+    }
+}
+
+/*
+ * Adds the (relocated) text section of a module to output.
+ * Returns 1 if everything went OK; 0 (after printing an error) if the
+ * output could not be written.
+ */
+static int writeModule (const Module * module, OutputFile * output)
+{
+    const uint32_t * words = module->words != NULL ? module->words
+                                                   : module->object.text;
+    uint32_t         j;
+
+    for ( j = 0; j < module->object.header->nbrTextWords; j++ )
+    {
+        if ( ! outputWord(output, module->textAddress + j * 4, words[j]) )
+            return 0;       /* error message already printed */
+    }
+    return 1;
+}
@@ -0,0 +1,150 @@
+/*
+ * makeInstructionHash: generates instructionHash.h at build time
+ *
+ * This program reads the instruction rows in instructions.def and
+ * searches for a multiplicative hash that maps the key of every
+ * instruction name (see instructionKey) to a different slot of a small
+ * table:
+ *      slot = (key * INSTRUCTION_HASH_MULTIPLIER) >> INSTRUCTION_HASH_SHIFT
+ * It starts with the smallest power-of-2 table that can hold all the
+ * instructions and tries more multipliers, then larger tables, until it
+ * finds one without collisions.  It then writes a header to standard
+ * output containing the hash constants, the row stored in each slot
+ * (-1 for an empty slot), and the key of each row, which findInstruction
+ * compares against to reject names that are not instructions.
+ *
+ * Usage:
+ *      makeInstructionHash > instructionHash.h
+ *
+ * The program exits with status 1 (and writes nothing) if two rows have
+ * the same name or a name is not 1 to 8 characters long.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "InstructionTable.h"
+
+/* The instruction names, in the same order as the rows of the table. */
+#define INSTRUCTION(name, format, opcode, funct, operands) name,
+static const char * NAMES[] = {
+#include "instructions.def"
+};
+#undef INSTRUCTION
+
+#define NBR_INSTRUCTIONS ((int) (sizeof(NAMES) / sizeof(NAMES[0])))
+
+/* Largest table (2^MAX_BITS slots) and number of multipliers to try. */
+#define MAX_BITS    12
+#define MAX_TRIES   1000000
+
+static int tryMultiplier (const uint64_t keys[], uint64_t multiplier,
+                          int bits, signed short rows[]);
+static uint64_t nextRandom (uint64_t * state);
+
+int main (void)
+{
+    uint64_t       keys[NBR_INSTRUCTIONS];
+    signed short   rows[1 << MAX_BITS];
+    uint64_t       state = 0x9E3779B97F4A7C15ULL;
+    uint64_t       multiplier;
+    int            bits, tries, i, j;
+
+    /* Compute the keys, checking for bad or duplicate names. */
+    for ( i = 0; i < NBR_INSTRUCTIONS; i++ )
+    {
+        keys[i] = instructionKey(NAMES[i], (int) strlen(NAMES[i]));
+        if ( keys[i] == 0 )
+        {
+            fprintf(stderr, "Error: bad instruction name '%s'.\n", NAMES[i]);
+            return 1;
+        }
+        for ( j = 0; j < i; j++ )
+        {
+            if ( keys[j] == keys[i] )
+            {
+                fprintf(stderr, "Error: duplicate instruction '%s'.\n",
+                        NAMES[i]);
+                return 1;
+            }
+        }
+    }
+
+    /* Smallest table that can hold every instruction. */
+    for ( bits = 1; (1 << bits) < NBR_INSTRUCTIONS; bits++ )
+        ;
+
+    for ( ; bits <= MAX_BITS; bits++ )
+    {
+        for ( tries = 0; tries < MAX_TRIES; tries++ )
+        {
+            multiplier = nextRandom(&state) | 1;
+            if ( tryMultiplier(keys, multiplier, bits, rows) )
+            {
+                printf("/*\n * instructionHash.h -- GENERATED by "
+                       "makeInstructionHash from instructions.def.\n"
+                       " * Do not edit; add instructions to "
+                       "instructions.def instead.\n */\n\n");
+                printf("#define INSTRUCTION_HASH_MULTIPLIER 0x%016llXULL\n",
+                       (unsigned long long) multiplier);
+                printf("#define INSTRUCTION_HASH_SHIFT      %d\n", 64 - bits);
+                printf("#define INSTRUCTION_HASH_SIZE       %d\n\n", 1 << bits);
+
+                printf("/* Row of the table in each slot; -1 if empty. */\n");
+                printf("static const signed short INSTRUCTION_HASH_ROWS[] = {");
+                for ( i = 0; i < (1 << bits); i++ )
+                    printf("%s%d%s", i % 16 == 0 ? "\n    " : "", rows[i],
+                           i < (1 << bits) - 1 ? ", " : "\n");
+                printf("};\n\n");
+
+                printf("/* Key (see instructionKey) of each row. */\n");
+                printf("static const uint64_t INSTRUCTION_KEYS[] = {\n");
+                for ( i = 0; i < NBR_INSTRUCTIONS; i++ )
+                    printf("    0x%016llXULL,   /* %s */\n",
+                           (unsigned long long) keys[i], NAMES[i]);
+                printf("};\n");
+                return 0;
+            }
+        }
+    }
+
+    fprintf(stderr, "Error: no collision-free hash found.\n");
+    return 1;
+}
+
+/*
+ * Fills rows with the row that hashes to each slot of a table of 2^bits
+ * slots (-1 for empty slots).  Returns 1 if no two keys hash to the same
+ * slot; 0 otherwise.
+ */
+static int tryMultiplier (const uint64_t keys[], uint64_t multiplier,
+                          int bits, signed short rows[])
+{
+    int i;
+    unsigned slot;
+
+    for ( i = 0; i < (1 << bits); i++ )
+        rows[i] = -1;
+
+    for ( i = 0; i < NBR_INSTRUCTIONS; i++ )
+    {
+        slot = (unsigned) ((keys[i] * multiplier) >> (64 - bits));
+        if ( rows[slot] != -1 )
+            return 0;
+        rows[slot] = (signed short) i;
+    }
+    return 1;
+}
+
+/*
+ * Returns the next number of a fixed pseudo-random (xorshift64)
+ * sequence, so the generated header is the same on every build.
+ */
+static uint64_t nextRandom (uint64_t * state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
@@ -0,0 +1,246 @@
+/*
+ * makeProgram: generates a large, valid assembly program for benchmarks
+ *
+ * This program writes an assembly source of the requested number of
+ * lines to standard output.  Every instruction in instructions.def can
+ * appear, chosen with a weight for its operand shape that gives a mix
+ * like that of compiled code: mostly arithmetic, loads and stores, and
+ * branches, with fewer shifts, jumps, and lui instructions.  One line in
+ * LABEL_SPACING starts with a label (some on a line of their own).  The
+ * assembler only accepts branches to the same line or later, so beq/bne
+ * branch forward to a nearby label; j and jal jump to any label, before
+ * or after them (in the first 2^26 words, so that the target fits in its
+ * 26 bits), so there are both backward and forward references.  Some
+ * lines have a trailing comment and a few are blank or contain only a
+ * comment.
+ *
+ * The same arguments always produce the same program, and the program
+ * assembles without errors.
+ *
+ * Usage:
+ *      makeProgram lines [seed] > program.txt
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "InstructionTable.h"
+
+/* The instructions, in the same order as the rows of the table. */
+#define INSTRUCTION(name, format, opcode, funct, operands) \
+        { name, format, opcode, funct, operands },
+static const InstructionInfo INSTRUCTIONS[] = {
+#include "instructions.def"
+};
+#undef INSTRUCTION
+
+#define NBR_INSTRUCTIONS \
+        ((int) (sizeof(INSTRUCTIONS) / sizeof(INSTRUCTIONS[0])))
+
+/* How often each operand shape is chosen (shared by its instructions),
+ * in the order of OperandShape.
+ */
+static const int SHAPE_WEIGHTS[] = {
+        30,     /* OPS_RD_RS_RT    */
+        6,      /* OPS_RD_RT_SHAMT */
+        2,      /* OPS_RS          */
+        22,     /* OPS_RT_RS_IMM   */
+        12,     /* OPS_RS_RT_LABEL */
+        18,     /* OPS_RT_IMM_RS   */
+        3,      /* OPS_RT_IMM      */
+        7       /* OPS_TARGET      */
+};
+#define NBR_SHAPES ((int) (sizeof(SHAPE_WEIGHTS) / sizeof(SHAPE_WEIGHTS[0])))
+
+/* Line k * LABEL_SPACING defines label k; branches go at most
+ * BRANCH_REACH labels forward, and jumps to labels below MAX_JUMP_LABEL.
+ */
+#define LABEL_SPACING   8
+#define BRANCH_REACH    16
+#define MAX_JUMP_LABEL  ((1L << 26) / LABEL_SPACING)
+
+/* Chances (in percent) of a comment after an instruction, of a line with
+ * only a comment, and of a blank line.
+ */
+#define TRAILING_COMMENTS   10
+#define COMMENT_LINES       3
+#define BLANK_LINES         2
+
+#define MAX_LINES 100000000L
+
+static const char * REGISTERS[] = {
+        "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+        "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+        "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+        "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+static void writeInstruction (long lineNbr, long nbrLabels, uint64_t * state);
+static const InstructionInfo * chooseInstruction (uint64_t * state);
+static const char * reg (uint64_t * state);
+static unsigned immediate (uint64_t * state);
+static uint64_t nextRandom (uint64_t * state);
+static unsigned randomBelow (uint64_t * state, unsigned limit);
+
+int main (int argc, char * argv[])
+{
+    long     nbrLines, nbrLabels, i;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    if ( argc < 2 || argc > 3 ||
+         (nbrLines = atol(argv[1])) < 1 || nbrLines > MAX_LINES )
+    {
+        fprintf(stderr, "Usage:  %s lines [seed] > program.txt\n"
+                        "        (1 <= lines <= %ld)\n", argv[0], MAX_LINES);
+        return 1;
+    }
+    if ( argc == 3 )
+        state += strtoull(argv[2], NULL, 10) * 0xD1B54A32D192ED03ULL;
+
+    nbrLabels = (nbrLines + LABEL_SPACING - 1) / LABEL_SPACING;
+    for ( i = 0; i < nbrLines; i++ )
+    {
+        if ( i % LABEL_SPACING == 0 )
+        {
+            printf("L%ld:", i / LABEL_SPACING);
+            if ( randomBelow(&state, 100) < 5 )
+            {
+                printf("\n");       /* a label on a line of its own */
+                continue;
+            }
+            printf(" ");
+        }
+        else if ( randomBelow(&state, 100) < COMMENT_LINES )
+        {
+            printf("# line %ld\n", i + 1);
+            continue;
+        }
+        else if ( randomBelow(&state, 100) < BLANK_LINES )
+        {
+            printf("\n");
+            continue;
+        }
+
+        writeInstruction(i, nbrLabels, &state);
+        if ( randomBelow(&state, 100) < TRAILING_COMMENTS )
+            printf("    # %ld", i);
+        printf("\n");
+    }
+
+    if ( fflush(stdout) != 0 )
+    {
+        fprintf(stderr, "Error: cannot write the program.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Writes a random instruction (without a newline) for the given line,
+ * in a program with nbrLabels labels.
+ */
+static void writeInstruction (long lineNbr, long nbrLabels, uint64_t * state)
+{
+    const InstructionInfo * inst;
+    long  nextLabel = (lineNbr + LABEL_SPACING - 1) / LABEL_SPACING;
+    long  label;
+
+    /* There is nowhere to branch to after the last label. */
+    do
+        inst = chooseInstruction(state);
+    while ( inst->operands == OPS_RS_RT_LABEL && nextLabel >= nbrLabels );
+
+    printf("%s ", inst->name);
+    switch ( inst->operands )
+    {
+        case OPS_RD_RS_RT:
+            printf("%s, %s, %s", reg(state), reg(state), reg(state));
+            break;
+        case OPS_RD_RT_SHAMT:
+            printf("%s, %s, %u", reg(state), reg(state),
+                   randomBelow(state, 32));
+            break;
+        case OPS_RS:
+            printf("%s", reg(state));
+            break;
+        case OPS_RT_RS_IMM:
+            printf("%s, %s, %u", reg(state), reg(state), immediate(state));
+            break;
+        case OPS_RS_RT_LABEL:
+            /* A nearby label: the one on this line or one after it. */
+            label = nextLabel + (long) randomBelow(state, BRANCH_REACH);
+            if ( label >= nbrLabels )
+                label = nbrLabels - 1;
+            printf("%s, %s, L%ld", reg(state), reg(state), label);
+            break;
+        case OPS_RT_IMM_RS:
+            printf("%s, %u(%s)", reg(state), 4 * randomBelow(state, 64),
+                   reg(state));
+            break;
+        case OPS_RT_IMM:
+            printf("%s, %u", reg(state), immediate(state));
+            break;
+        case OPS_TARGET:
+            label = nbrLabels < MAX_JUMP_LABEL ? nbrLabels : MAX_JUMP_LABEL;
+            printf("L%ld", (long) (nextRandom(state) % (uint64_t) label));
+            break;
+    }
+}
+
+/*
+ * Returns a random instruction, choosing its operand shape by
+ * SHAPE_WEIGHTS and then one of the instructions with that shape.
+ */
+static const InstructionInfo * chooseInstruction (uint64_t * state)
+{
+    int total = 0, pick, shape, count, i;
+
+    for ( shape = 0; shape < NBR_SHAPES; shape++ )
+        total += SHAPE_WEIGHTS[shape];
+    pick = (int) randomBelow(state, (unsigned) total);
+    for ( shape = 0; pick >= SHAPE_WEIGHTS[shape]; shape++ )
+        pick -= SHAPE_WEIGHTS[shape];
+
+    count = 0;
+    for ( i = 0; i < NBR_INSTRUCTIONS; i++ )
+        count += INSTRUCTIONS[i].operands == (OperandShape) shape;
+    pick = count > 0 ? (int) randomBelow(state, (unsigned) count) : 0;
+    for ( i = 0; i < NBR_INSTRUCTIONS; i++ )
+    {
+        if ( INSTRUCTIONS[i].operands == (OperandShape) shape &&
+             pick-- == 0 )
+            return &INSTRUCTIONS[i];
+    }
+    return &INSTRUCTIONS[0];     /* no instruction has this shape */
+}
+
+/* Returns the name of a random register. */
+static const char * reg (uint64_t * state)
+{
+    return REGISTERS[randomBelow(state, 32)];
+}
+
+/* Returns a random immediate value: usually small, sometimes any 16-bit
+ * value.
+ */
+static unsigned immediate (uint64_t * state)
+{
+    return randomBelow(state, 4) != 0 ? randomBelow(state, 256)
+                                      : randomBelow(state, 65536);
+}
+
+/* Returns the next number of a pseudo-random (xorshift64) sequence. */
+static uint64_t nextRandom (uint64_t * state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Returns a pseudo-random number from 0 to limit - 1. */
+static unsigned randomBelow (uint64_t * state, unsigned limit)
+{
+    return (unsigned) ((nextRandom(state) >> 32) * limit >> 32);
+}
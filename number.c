@@ -0,0 +1,164 @@
+/*
+ * Number: functions to convert the text of a number to its value
+ *
+ * This file provides the definitions of the functions declared in
+ * number.h.  The value is accumulated in 64 bits and checked against
+ * 2^32 - 1 after each step, so a number with any number of digits is
+ * rejected as soon as it is too big, without overflowing.
+ *
+ * The conversion of 8 decimal digits at a time relies on the first
+ * character being the lowest byte of the word it is loaded into, so it
+ * is only done on little-endian machines; elsewhere every digit is
+ * converted on its own, with the same result.
+ *
+ */
+
+#include <string.h>
+
+#include "number.h"
+
+/* Largest magnitude of a number. */
+#define MAX_MAGNITUDE   0xFFFFFFFFu
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_DIGITS     1
+#endif
+
+static int      hexDigit (char c);
+#ifdef SWAR_DIGITS
+static int      eightDigits (const char * text, uint64_t * value);
+#endif
+
+int parseNumber (Span text, int64_t * value)
+{
+    const char * next = text.text;
+    const char * end = text.text + text.length;
+    uint64_t     magnitude = 0;
+    int          negative = 0;
+    int          length, digit;
+    int64_t      character;
+
+    /* A character literal. */
+    if ( next < end && *next == '\'' )
+    {
+        if ( end - next < 3 ||
+             (character = parseCharacter (next + 1, end, &length)) == -1 ||
+             end - next != length + 2 || end[-1] != '\'' )
+            return 0;
+        *value = character;
+        return 1;
+    }
+
+    if ( next < end && (*next == '-' || *next == '+') )
+        negative = *next++ == '-';
+    if ( next == end )
+        return 0;
+
+    if ( end - next > 2 && next[0] == '0' && (next[1] == 'x' ||
+                                              next[1] == 'X') )
+    {
+        /* Hexadecimal: 4 bits per digit. */
+        for ( next += 2; next < end; next++ )
+        {
+            if ( (digit = hexDigit (*next)) == -1 )
+                return 0;
+            magnitude = magnitude << 4 | (uint64_t) digit;
+            if ( magnitude > MAX_MAGNITUDE )
+                return 0;
+        }
+    }
+    else
+    {
+        /* Decimal: 8 digits at a time while there are that many, then
+         * the rest one at a time.
+         */
+#ifdef SWAR_DIGITS
+        uint64_t eight;
+
+        for ( ; end - next >= 8 && eightDigits (next, &eight); next += 8 )
+        {
+            magnitude = magnitude * 100000000u + eight;
+            if ( magnitude > MAX_MAGNITUDE )
+                return 0;
+        }
+#endif
+        for ( ; next < end; next++ )
+        {
+            if ( *next < '0' || *next > '9' )
+                return 0;
+            magnitude = magnitude * 10 + (uint64_t) (*next - '0');
+            if ( magnitude > MAX_MAGNITUDE )
+                return 0;
+        }
+    }
+
+    *value = negative ? -(int64_t) magnitude : (int64_t) magnitude;
+    return 1;
+}
+
+int parseCharacter (const char * text, const char * end, int * length)
+{
+    if ( *text != '\\' )
+    {
+        *length = 1;
+        return (unsigned char) *text;
+    }
+
+    *length = 2;
+    if ( text + 1 == end )
+        return -1;
+    switch ( text[1] )
+    {
+        case 'n':   return '\n';
+        case 't':   return '\t';
+        case 'r':   return '\r';
+        case '0':   return '\0';
+        case '\\':  return '\\';
+        case '\'':  return '\'';
+        case '"':   return '"';
+        default:    return -1;
+    }
+}
+
+/* Returns the value of the hexadecimal digit c; -1 if it is not one. */
+static int hexDigit (char c)
+{
+    if ( c >= '0' && c <= '9' )
+        return c - '0';
+    if ( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    if ( c >= 'A' && c <= 'F' )
+        return c - 'A' + 10;
+    return -1;
+}
+
+#ifdef SWAR_DIGITS
+
+/*
+ * If the 8 characters at text are all decimal digits, sets *value to
+ * the number they make and returns 1; otherwise returns 0.
+ *
+ * A character is a digit if adding 0x46 does not carry into its high
+ * bit (it is below 0x3A) and subtracting 0x30 does not borrow (it is at
+ * least 0x30); the check is done for all 8 at once.  The digits are
+ * then combined in pairs (10 * first + second), the pairs in fours, and
+ * the fours into one number.
+ */
+static int eightDigits (const char * text, uint64_t * value)
+{
+    uint64_t word;
+
+    memcpy (&word, text, 8);
+    if ( ((word + 0x4646464646464646u) | (word - 0x3030303030303030u)) &
+         0x8080808080808080u )
+        return 0;
+
+    word -= 0x3030303030303030u;
+    word = word * 10 + (word >> 8);
+    *value = ((word & 0x000000FF000000FFu) * (100 + (1000000ull << 32)) +
+              ((word >> 16) & 0x000000FF000000FFu) *
+                  (1 + (10000ull << 32))) >> 32;
+    return 1;
+}
+
+#endif
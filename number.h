@@ -0,0 +1,47 @@
+/*
+ * Number: converting the text of a number to its value
+ *
+ * The numbers in a program (immediate values, shift amounts, and the
+ * values of data directives) may be written in decimal ("-42"), in
+ * hexadecimal ("0x2A" or "0X2a"), or as a character literal in single
+ * quotes ("'*'", or an escape sequence such as "'\n'").  Decimal and
+ * hexadecimal numbers may have a sign.  A number is only valid if the
+ * whole token is a number (unlike atoi, which stops at the first
+ * character that is not a digit and gives 0 if there is none) and its
+ * magnitude fits in 32 bits.
+ *
+ * Long tables of data are mostly decimal numbers, so decimal digits are
+ * converted 8 at a time: 8 characters are loaded as one 64-bit word,
+ * checked to all be digits with a few word-wide operations, and turned
+ * into their value with three multiplications (SWAR, "SIMD within a
+ * register"), rather than with 8 multiplications and additions.
+ *
+ * The escape sequences of character literals (and of the strings of
+ * .ascii and .asciiz; see dataSegment.h) are \n, \t, \r, \0, \\, \',
+ * and \".
+ *
+ */
+
+#ifndef _NUMBER_H
+#define _NUMBER_H
+
+#include <stdint.h>
+
+#include "getToken.h"
+
+int parseNumber (Span text, int64_t * value);
+        /* Postcondition: if text is a number (see above), *value is its
+         *      value, from -(2^32 - 1) to 2^32 - 1.
+         * Returns 1 if text is a number; 0 if it is not, or if it does
+         *      not fit in 32 bits.
+         */
+
+int parseCharacter (const char * text, const char * end, int * length);
+        /* Precondition: text is before end.
+         * Postcondition: *length is the number of characters (1, or 2
+         *      for an escape sequence) of the character at text.
+         * Returns the value of the character at text (see above); -1 if
+         *      it is an unknown escape sequence or a backslash at end.
+         */
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ * Object File: functions to write a relocatable program
+ *
+ * This file provides the definitions of the functions declared in
+ * objectFile.h.  The symbols are numbered with an interner (see
+ * interner.h): the labels of the table are interned first, in order, so
+ * that each one's id is its position in the symbol table, and then the
+ * global names and the labels the instructions use, each of which gets
+ * a new id, and a new (undefined) symbol, if it is not defined.
+ *
+ * An instruction that needs a relocation is encoded as single-pass mode
+ * encodes a forward reference (see Fixup in assembler.h): against a
+ * table in which no label is defined, so that it is encoded with a label
+ * field of 0 and its other errors are still reported.
+ *
+ * objectOpen maps an object read-only (so it is shared with the page
+ * cache and never copied) and checks it once, with sizes computed in 64
+ * bits so that no field, however big, can make a part seem to fit.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "objectFile.h"
+
+/* Number of data words converted at a time for the output. */
+#define DATA_BLOCK 1024
+
+/* The symbols of an object as it is built. */
+typedef struct {
+        ObjectSymbol * symbols;
+        int            nbrSymbols;
+        int            capacity;
+        Interner       ids;             /* the symbols' names, by number */
+        char *         names;           /* the names, null-terminated */
+        size_t         namesLength;
+        size_t         namesCapacity;
+} SymbolTable;
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+static int  findSymbol (SymbolTable * symbols, Span name, int section,
+                        uint32_t value);
+static int  addRelocation (ObjectRelocation ** relocations, int * number,
+                           int * capacity, uint32_t offset, int symbol,
+                           int type);
+static int  checkObject (const ObjectFile * object);
+static int  writeObject (const InstructionList * program,
+                         const SymbolTable * symbols, const uint32_t * text,
+                         uint32_t nbrTextWords,
+                         const ObjectRelocation * relocations,
+                         int nbrRelocations, OutputFile * output);
+
+int objectWrite (const InstructionList * program, LabelTable table,
+                 OutputFile * output)
+{
+    const DataSegment * data = &program->data;
+    const Instruction * inst;
+    SymbolTable       symbols;
+    LabelTable        undefined;    /* a table with no label defined */
+    ObjectRelocation * relocations = NULL;
+    int               nbrRelocations = 0, relocationCapacity = 0;
+    uint32_t *        text;
+    uint32_t          nbrTextWords = data->address / 4;
+    uint32_t          word;
+    int *             symbolOfId;   /* the symbol of each label id */
+    int               nbrIds = program->labels.nbrIdentifiers;
+    int               symbol, isJump, status, ok = 1;
+    int               i;
+    Fixup             fixup;
+    Span              name;
+
+    memset (&symbols, 0, sizeof(symbols));
+    internerInit (&symbols.ids);
+    memset (&undefined, 0, sizeof(undefined));
+    text = calloc (nbrTextWords > 0 ? nbrTextWords : 1, sizeof(uint32_t));
+    symbolOfId = malloc ((size_t) (nbrIds > 0 ? nbrIds : 1) * sizeof(int));
+    undefined.resolved = malloc ((size_t) (nbrIds > 0 ? nbrIds : 1) *
+                                 sizeof(int));
+    if ( text == NULL || symbolOfId == NULL || undefined.resolved == NULL )
+    {
+        printError ("%s", ERROR_MEMORY);
+        ok = 0;
+    }
+
+    /* The symbols: the labels defined, the global names, and the labels
+     * used but not defined.
+     */
+    for ( i = 0; ok && i < table.nbrLabels; i++ )
+    {
+        name.text = table.entries[i].label;
+        name.length = (int) strlen (name.text);
+        ok = findSymbol (&symbols, name,
+                         i < data->firstLabel ? SECTION_TEXT : SECTION_DATA,
+                         (uint32_t) table.entries[i].address -
+                             (i < data->firstLabel ? 0 : data->address))
+             != -1;
+    }
+    for ( i = 0; ok && i < data->nbrGlobals; i++ )
+    {
+        name.text = data->names + data->globals[i].name;
+        name.length = data->globals[i].length;
+        if ( (symbol = findSymbol (&symbols, name, SECTION_UNDEFINED, 0))
+             == -1 )
+            ok = 0;
+        else
+            symbols.symbols[symbol].global = 1;
+    }
+    for ( i = 0; ok && i < nbrIds; i++ )
+    {
+        symbolOfId[i] = findSymbol (&symbols,
+                                    program->labels.identifiers[i].name,
+                                    SECTION_UNDEFINED, 0);
+        ok = symbolOfId[i] != -1;
+        undefined.resolved[i] = -1;
+    }
+    undefined.nbrResolved = nbrIds;
+
+    /* The text section, and its relocations. */
+    for ( i = 0; ok && i < program->nbrInstructions; i++ )
+    {
+        inst = &program->instructions[i];
+        symbol = hasLabelOperand (inst) ? symbolOfId[inst->label] : -1;
+        isJump = symbol != -1 &&
+                 inst->instruction->operands == OPS_TARGET;
+        if ( symbol == -1 ||
+             (! isJump && symbols.symbols[symbol].section == SECTION_TEXT) )
+        {
+            /* Encoded as usual, with no relocation. */
+            if ( encodeInstruction (inst, table, &word, NULL) == ASM_OK )
+                text[inst->address / 4] = word;
+            continue;
+        }
+
+        status = encodeInstruction (inst, undefined, &word, &fixup);
+        if ( status != ASM_FIXUP )
+            continue;       /* error already reported */
+        if ( ! isJump && fixup.badRegister )
+        {
+            /* same message as assemblerI */
+            diagError (DIAG_BAD_REGISTER, fixup.lineNum, fixup.column,
+                       DIAG_NO_ARGUMENT,
+                       "\nError: Invalid Register at line %d\n");
+            continue;
+        }
+        text[inst->address / 4] = word;
+        ok = addRelocation (&relocations, &nbrRelocations,
+                            &relocationCapacity, (uint32_t) inst->address,
+                            symbol, isJump ? RELOC_JUMP : RELOC_BRANCH);
+    }
+
+    if ( ok )
+        ok = writeObject (program, &symbols, text, nbrTextWords, relocations,
+                          nbrRelocations, output);
+
+    free (text);
+    free (symbolOfId);
+    free (undefined.resolved);
+    free (relocations);
+    free (symbols.symbols);
+    free (symbols.names);
+    internerFree (&symbols.ids);
+    return ok;
+}
+
+int objectRelocate (uint32_t * word, uint32_t type, uint32_t symbolAddress,
+                    uint32_t address)
+{
+    int64_t offset;
+
+    switch ( type )
+    {
+        case RELOC_JUMP:
+            if ( symbolAddress / 4 > 0x3FFFFFF )
+                return 0;
+            *word = (*word & ~(uint32_t) 0x3FFFFFF) | symbolAddress / 4;
+            return 1;
+        case RELOC_BRANCH:
+            /* as encodeTarget computes it */
+            offset = ((int64_t) symbolAddress - (int64_t) address) / 4;
+            if ( offset < 0 || offset > 65535 )
+                return 0;
+            *word = (*word & ~(uint32_t) 0xFFFF) | (uint32_t) offset;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int objectOpen (ObjectFile * object, const char * path)
+{
+    const ObjectHeader * header;
+    struct stat          info;
+    const char *         next;
+    int                  fd;
+
+    memset (object, 0, sizeof(*object));
+    object->path = path;
+    if ( (fd = open (path, O_RDONLY)) == -1 )
+    {
+        printError ("Error: Cannot open file %s.\n", path);
+        return 0;
+    }
+    if ( fstat (fd, &info) != 0 || ! S_ISREG(info.st_mode) ||
+         (size_t) info.st_size < sizeof(ObjectHeader) ||
+         (object->map = mmap (NULL, (size_t) info.st_size, PROT_READ,
+                              MAP_PRIVATE, fd, 0)) == MAP_FAILED )
+    {
+        object->map = NULL;
+        (void) close (fd);
+        printError ("Error: %s is not an object file.\n", path);
+        return 0;
+    }
+    (void) close (fd);
+    object->length = (size_t) info.st_size;
+
+    header = object->header = object->map;
+    if ( memcmp (header->magic, OBJECT_MAGIC, sizeof(header->magic)) != SAME ||
+         header->version != OBJECT_VERSION )
+    {
+        printError ("Error: %s is not an object file.\n", path);
+        objectClose (object);
+        return 0;
+    }
+    if ( (uint64_t) object->length !=
+         (uint64_t) sizeof(ObjectHeader) +
+         ((uint64_t) header->nbrTextWords + header->nbrDataWords) *
+             sizeof(uint32_t) +
+         (uint64_t) header->nbrSymbols * sizeof(ObjectSymbol) +
+         (uint64_t) header->nbrRelocations * sizeof(ObjectRelocation) +
+         header->namesLength )
+    {
+        printError ("Error: the object file %s is damaged.\n", path);
+        objectClose (object);
+        return 0;
+    }
+
+    next = (const char *) object->map + sizeof(ObjectHeader);
+    object->text = (const uint32_t *) next;
+    next += (size_t) header->nbrTextWords * sizeof(uint32_t);
+    object->data = (const uint32_t *) next;
+    next += (size_t) header->nbrDataWords * sizeof(uint32_t);
+    object->symbols = (const ObjectSymbol *) next;
+    next += (size_t) header->nbrSymbols * sizeof(ObjectSymbol);
+    object->relocations = (const ObjectRelocation *) next;
+    next += (size_t) header->nbrRelocations * sizeof(ObjectRelocation);
+    object->names = next;
+
+    if ( ! checkObject (object) )
+    {
+        printError ("Error: the object file %s is damaged.\n", path);
+        objectClose (object);
+        return 0;
+    }
+    return 1;
+}
+
+void objectClose (ObjectFile * object)
+{
+    if ( object->map != NULL )
+        (void) munmap (object->map, object->length);
+    object->map = NULL;
+    object->header = NULL;
+}
+
+/*
+ * Checks the symbols, relocations and names of an object whose parts
+ * fit in its file.
+ * Returns 1 if they are consistent (see objectOpen); 0 otherwise.
+ */
+static int checkObject (const ObjectFile * object)
+{
+    const ObjectHeader *     header = object->header;
+    const ObjectSymbol *     symbol;
+    const ObjectRelocation * relocation;
+    uint64_t                 size;
+    uint32_t                 i;
+
+    for ( i = 0; i < header->nbrSymbols; i++ )
+    {
+        /* Its name ends before the end of the names. */
+        symbol = &object->symbols[i];
+        if ( symbol->name >= header->namesLength ||
+             memchr (object->names + symbol->name, '\0',
+                     header->namesLength - symbol->name) == NULL )
+            return 0;
+        switch ( symbol->section )
+        {
+            case SECTION_TEXT:      size = header->nbrTextWords;  break;
+            case SECTION_DATA:      size = header->nbrDataWords;  break;
+            case SECTION_UNDEFINED: size = 0;                     break;
+            default:                return 0;
+        }
+        if ( symbol->value > size * sizeof(uint32_t) || symbol->global > 1 )
+            return 0;
+    }
+    for ( i = 0; i < header->nbrRelocations; i++ )
+    {
+        relocation = &object->relocations[i];
+        if ( relocation->offset % 4 != 0 ||
+             relocation->offset / 4 >= header->nbrTextWords ||
+             relocation->symbol >= header->nbrSymbols ||
+             relocation->type > RELOC_BRANCH )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Finds the symbol named name, adding it (in section, with value) if
+ * there is none.
+ * Returns the number of the symbol; -1 (after printing an error) if
+ * memory allocation error.
+ */
+static int findSymbol (SymbolTable * symbols, Span name, int section,
+                       uint32_t value)
+{
+    ObjectSymbol * grown;
+    char *         names;
+    size_t         capacity;
+    int            symbol;
+
+    if ( (symbol = intern (&symbols->ids, name)) == -1 )
+        return -1;          /* error message already printed */
+    if ( symbol < symbols->nbrSymbols )
+        return symbol;
+
+    if ( symbols->nbrSymbols >= symbols->capacity )
+    {
+        capacity = symbols->capacity > 0 ? (size_t) symbols->capacity * 2
+                                         : 64;
+        if ( (grown = realloc (symbols->symbols,
+                               capacity * sizeof(ObjectSymbol))) == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return -1;
+        }
+        symbols->symbols = grown;
+        symbols->capacity = (int) capacity;
+    }
+    if ( symbols->namesLength + (size_t) name.length + 1 >
+         symbols->namesCapacity )
+    {
+        capacity = symbols->namesCapacity > 0 ? symbols->namesCapacity : 4096;
+        while ( capacity < symbols->namesLength + (size_t) name.length + 1 )
+            capacity *= 2;
+        if ( (names = realloc (symbols->names, capacity)) == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return -1;
+        }
+        symbols->names = names;
+        symbols->namesCapacity = capacity;
+    }
+
+    symbols->symbols[symbol].name = (uint32_t) symbols->namesLength;
+    symbols->symbols[symbol].value = value;
+    symbols->symbols[symbol].section = (uint16_t) section;
+    symbols->symbols[symbol].global = section == SECTION_UNDEFINED;
+    memcpy (symbols->names + symbols->namesLength, name.text,
+            (size_t) name.length);
+    symbols->namesLength += (size_t) name.length;
+    symbols->names[symbols->namesLength++] = '\0';
+    symbols->nbrSymbols++;
+    return symbol;
+}
+
+/*
+ * Adds a relocation of the given type, for the word at offset in the
+ * text section, to the number relocations, growing them if needed.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int addRelocation (ObjectRelocation ** relocations, int * number,
+                          int * capacity, uint32_t offset, int symbol,
+                          int type)
+{
+    ObjectRelocation * grown;
+    size_t             newCapacity;
+
+    if ( *number >= *capacity )
+    {
+        newCapacity = *capacity > 0 ? (size_t) *capacity * 2 : 256;
+        if ( (grown = realloc (*relocations,
+                               newCapacity * sizeof(ObjectRelocation)))
+             == NULL )
+        {
+            printError ("%s", ERROR_MEMORY);
+            return 0;
+        }
+        *relocations = grown;
+        *capacity = (int) newCapacity;
+    }
+    (*relocations)[*number].offset = offset;
+    (*relocations)[*number].symbol = (uint32_t) symbol;
+    (*relocations)[*number].type = (uint32_t) type;
+    (*number)++;
+    return 1;
+}
+
+/*
+ * Adds the parts of the object file, in order, to output.
+ * Returns 1 if everything went OK; 0 (after printing an error) if the
+ * output could not be written.
+ */
+static int writeObject (const InstructionList * program,
+                        const SymbolTable * symbols, const uint32_t * text,
+                        uint32_t nbrTextWords,
+                        const ObjectRelocation * relocations,
+                        int nbrRelocations, OutputFile * output)
+{
+    static const char PADDING[4] = { 0, 0, 0, 0 };
+    ObjectHeader header;
+    uint32_t     block[DATA_BLOCK];
+    size_t       nbrDataWords = dataNbrWords (&program->data);
+    size_t       i, n;
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.magic, OBJECT_MAGIC, sizeof(header.magic));
+    header.version = OBJECT_VERSION;
+    header.nbrTextWords = nbrTextWords;
+    header.nbrDataWords = (uint32_t) nbrDataWords;
+    header.nbrSymbols = (uint32_t) symbols->nbrSymbols;
+    header.nbrRelocations = (uint32_t) nbrRelocations;
+    header.namesLength = (uint32_t) ((symbols->namesLength + 3) & ~(size_t) 3);
+
+    if ( ! outputBytes (output, &header, sizeof(header)) ||
+         ! outputBytes (output, text, nbrTextWords * sizeof(uint32_t)) )
+        return 0;       /* error message already printed */
+    for ( i = 0; i < nbrDataWords; i += n )
+    {
+        for ( n = 0; n < DATA_BLOCK && i + n < nbrDataWords; n++ )
+            block[n] = dataWord (&program->data, i + n);
+        if ( ! outputBytes (output, block, n * sizeof(uint32_t)) )
+            return 0;
+    }
+    return outputBytes (output, symbols->symbols,
+                        (size_t) symbols->nbrSymbols * sizeof(ObjectSymbol)) &&
+           outputBytes (output, relocations,
+                        (size_t) nbrRelocations * sizeof(ObjectRelocation)) &&
+           outputBytes (output, symbols->names, symbols->namesLength) &&
+           outputBytes (output, PADDING,
+                        header.namesLength - symbols->namesLength);
+}
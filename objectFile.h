@@ -0,0 +1,151 @@
+/*
+ * Object File: a relocatable program, to be linked with others
+ *
+ * With -c, the assembler writes an object file instead of machine code,
+ * so that the modules of a program can be assembled on their own (and
+ * at the same time) and linked into one image afterwards.  An object
+ * holds the program's two sections, its symbols, and the relocations
+ * that say which words must be patched once the sections have been
+ * given their final addresses:
+ *
+ *      ObjectHeader
+ *      the text section    nbrTextWords words, as in the image formats
+ *                          (a word for every line of the text segment)
+ *      the data section    nbrDataWords words (see dataSegment.h)
+ *      the symbols         nbrSymbols ObjectSymbols
+ *      the relocations     nbrRelocations ObjectRelocations, in order
+ *                          of offset
+ *      the names           namesLength bytes: the symbols' names, each
+ *                          null-terminated (padded with zeros to a
+ *                          multiple of 4 bytes)
+ *
+ * Every field is a 32- or 16-bit integer in the byte order of the
+ * machine that wrote the object, so an object can be used where it is
+ * mapped into memory, and every part starts on a 4-byte boundary.  (An
+ * object written on a machine with the other byte order does not have
+ * the right version, and is rejected.)
+ *
+ * Each section starts at address 0 in the object.  The symbols are the
+ * program's labels, with their offsets in their sections: first those
+ * of the text section and then those of the data section, in the order
+ * they are defined, and then the labels the program uses but does not
+ * define, which are imported from other objects.  A label named by
+ * .globl is global (exported, or imported if it is not defined); the
+ * others are local to the object.
+ *
+ * Every jump, and every branch to a label that is not in the text
+ * section, has a relocation, and its label field is 0 in the text
+ * section; a branch within the text section does not move relative to
+ * its label, so it is encoded as usual.  A line with an error leaves a
+ * zero word, as in the image formats.
+ *
+ * The linker (see linker.c) reads objects with objectOpen, which maps
+ * the file into memory and checks that every part of it is consistent,
+ * so that the parts can then be used where they are without further
+ * checks.
+ *
+ */
+
+#ifndef _OBJECTFILE_H
+#define _OBJECTFILE_H
+
+#include <stdint.h>
+
+#include "InstructionList.h"
+#include "LabelTable.h"
+#include "outputFile.h"
+
+/* The first bytes of an object file. */
+#define OBJECT_MAGIC    "ASMOBJ\r\n"
+
+/* Version of the object format. */
+#define OBJECT_VERSION  1
+
+/* The section a symbol is in. */
+typedef enum {
+        SECTION_TEXT = 0,
+        SECTION_DATA,
+        SECTION_UNDEFINED       /* imported from another object */
+} ObjectSection;
+
+/* How a relocation patches its word, once S (the address of its symbol)
+ * and P (the address of the word) are known.  The fields are as the
+ * assembler encodes them (see encodeTarget in assemblerUtil.h).
+ */
+typedef enum {
+        RELOC_JUMP = 0,         /* j, jal: bits 0-25 are S / 4 */
+        RELOC_BRANCH            /* beq, bne: bits 0-15 are (S - P) / 4,
+                                 * which must be from 0 to 65535 */
+} RelocationType;
+
+typedef struct {
+        char     magic[8];      /* OBJECT_MAGIC (not null-terminated) */
+        uint32_t version;       /* OBJECT_VERSION */
+        uint32_t nbrTextWords;
+        uint32_t nbrDataWords;
+        uint32_t nbrSymbols;
+        uint32_t nbrRelocations;
+        uint32_t namesLength;
+} ObjectHeader;
+
+typedef struct {
+        uint32_t name;          /* offset of its name in the names */
+        uint32_t value;         /* offset in its section (0 if undefined) */
+        uint16_t section;       /* an ObjectSection */
+        uint16_t global;        /* 1 if global; 0 if local */
+} ObjectSymbol;
+
+typedef struct {
+        uint32_t offset;        /* offset of the word in the text section */
+        uint32_t symbol;        /* the symbol it refers to */
+        uint32_t type;          /* a RelocationType */
+} ObjectRelocation;
+
+/* An object file mapped into memory by objectOpen. */
+typedef struct {
+        const char *             path;
+        const ObjectHeader *     header;
+        const uint32_t *         text;          /* header->nbrTextWords */
+        const uint32_t *         data;          /* header->nbrDataWords */
+        const ObjectSymbol *     symbols;       /* header->nbrSymbols */
+        const ObjectRelocation * relocations;   /* header->nbrRelocations */
+        const char *             names;         /* header->namesLength */
+        void *                   map;           /* the whole file */
+        size_t                   length;
+} ObjectFile;
+
+int objectWrite (const InstructionList * program, LabelTable table,
+                 OutputFile * output);
+        /* Precondition: program and table are as pass1 left them.
+         * Postcondition: the object file of program has been added to
+         *      output (see outputBytes), and the errors in its
+         *      instructions have been reported as by pass2.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if memory allocation error, or if the output could not be
+         *      written.
+         */
+
+int objectRelocate (uint32_t * word, uint32_t type, uint32_t symbolAddress,
+                    uint32_t address);
+        /* Postcondition: the field of *word, the word at address, that
+         *      the relocation type patches holds symbolAddress.
+         * Returns 1 if everything went OK; 0 if the field cannot hold
+         *      it (or type is not a RelocationType), in which case *word
+         *      is unchanged.
+         */
+
+int objectOpen (ObjectFile * object, const char * path);
+        /* Postcondition: the object file at path has been mapped into
+         *      object, whose parts point into it.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the file could not be read, is not an object file, or
+         *      is not consistent: a part does not fit in the file, a
+         *      name is not null-terminated, a symbol's section or value
+         *      is not valid, or a relocation's offset, symbol, or type
+         *      is not valid.
+         */
+
+void objectClose (ObjectFile * object);
+        /* Postcondition: the memory of object has been released. */
+
+#endif
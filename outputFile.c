@@ -0,0 +1,476 @@
+/*
+ * Output File: functions to write the assembled machine code
+ *
+ * This file provides the definitions of the functions declared in
+ * outputFile.h.  Words are formatted directly into the output buffer
+ * (without printf; the ASCII binary digits come from a 256-entry table,
+ * a byte at a time), and the buffer is written with a single fwrite
+ * whenever there might not be room for another word.
+ *
+ * The only exception is that, while debugging is on, the buffer is
+ * written after every word so that the machine code stays next to the
+ * debugging messages (which printDebug writes to stdout) for its line.
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outputFile.h"
+#include "printFuncs.h"
+#include "same.h"
+#include "spscQueue.h"
+#include "stats.h"
+
+/* Most bytes that adding one word can append to the buffer. */
+#define MAX_WORD_OUTPUT 128
+
+/* Number of words on each line of a Logisim image. */
+#define LOGISIM_WORDS_PER_LINE 8
+
+/* One buffer used with a writer thread. */
+typedef struct {
+        char   data[OUTPUT_BUFFER_SIZE];
+        size_t length;              /* bytes to write */
+} OutputBlock;
+
+struct OutputWriter {
+        pthread_t     thread;
+        SpscQueue     empty;        /* buffers to fill */
+        SpscQueue     filled;       /* buffers to write; NULL to stop */
+        OutputBlock * blocks;       /* all OUTPUT_BLOCKS buffers */
+        OutputBlock * current;      /* the buffer being filled */
+        atomic_int    failed;       /* 1 after a write error */
+};
+
+static const char * ERROR_WRITE = "Error: cannot write the output.\n";
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+/* BYTE_DIGITS[b] holds the 8 ASCII binary digits of the byte b, most
+ * significant bit first (not null-terminated), so the ASCII format
+ * copies 8 digits at a time instead of formatting one bit at a time.
+ */
+#define DIGIT(b, bit)   ((b) & (bit) ? '1' : '0')
+#define BYTE_ROW(b)     { DIGIT(b, 128), DIGIT(b, 64), DIGIT(b, 32), \
+                          DIGIT(b, 16), DIGIT(b, 8), DIGIT(b, 4), \
+                          DIGIT(b, 2), DIGIT(b, 1) }
+#define ROWS_4(b)       BYTE_ROW(b), BYTE_ROW(b + 1), BYTE_ROW(b + 2), \
+                        BYTE_ROW(b + 3)
+#define ROWS_16(b)      ROWS_4(b), ROWS_4(b + 4), ROWS_4(b + 8), \
+                        ROWS_4(b + 12)
+#define ROWS_64(b)      ROWS_16(b), ROWS_16(b + 16), ROWS_16(b + 32), \
+                        ROWS_16(b + 48)
+static const char BYTE_DIGITS[256][8] =
+{
+    ROWS_64(0), ROWS_64(64), ROWS_64(128), ROWS_64(192)
+};
+#undef DIGIT
+#undef BYTE_ROW
+#undef ROWS_4
+#undef ROWS_16
+#undef ROWS_64
+
+static const char * LOWER_HEX = "0123456789abcdef";
+static const char * UPPER_HEX = "0123456789ABCDEF";
+
+/* The name of each output format, in the order of OutputFormat. */
+static const char * FORMAT_NAMES[] =
+{
+    "ascii", "raw-be", "raw-le", "ihex", "readmemh", "logisim"
+};
+
+static void addWord (OutputFile * out, uint32_t word);
+static void addIhexRecord (OutputFile * out, int type, uint32_t address,
+                           const unsigned char data[], int length);
+static void endIhexRecord (OutputFile * out);
+static void addHex (OutputFile * out, uint32_t value, int digits,
+                    const char * hexDigits);
+static int  writeBuffer (OutputFile * out);
+static void * writeBlocks (void * out);
+static int  stopWriter (OutputFile * out);
+
+int outputFormatNamed (const char * name, OutputFormat * format)
+{
+    int i;
+
+    for ( i = 0; i < (int) (sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0]));
+          i++ )
+    {
+        if ( strcmp(name, FORMAT_NAMES[i]) == SAME )
+        {
+            *format = (OutputFormat) i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void outputOpen (OutputFile * out, FILE * fp, OutputFormat format)
+{
+    out->fp = fp;
+    out->format = format;
+    out->nextAddress = 0;
+    out->upperAddress = 0;
+    out->nbrWords = 0;
+    out->failed = 0;
+    out->used = 0;
+    out->recordLength = 0;
+    out->buffer = out->block;
+    out->writer = NULL;
+
+    if ( format == FORMAT_LOGISIM )
+    {
+        memcpy(out->buffer, "v2.0 raw\n", 9);
+        out->used = 9;
+    }
+}
+
+void outputOrigin (OutputFile * out, uint32_t address)
+{
+    out->nextAddress = address;
+}
+
+int outputStartWriter (OutputFile * out)
+{
+    OutputWriter * writer;
+    int            i;
+
+    if ( (writer = calloc(1, sizeof(OutputWriter))) == NULL ||
+         (writer->blocks = malloc(OUTPUT_BLOCKS * sizeof(OutputBlock)))
+             == NULL ||
+         ! spscInit(&writer->empty, OUTPUT_BLOCKS) ||
+         ! spscInit(&writer->filled, OUTPUT_BLOCKS + 1) )
+    {
+        if ( writer != NULL )
+        {
+            spscFree(&writer->empty);
+            free(writer->blocks);
+            free(writer);
+        }
+        printError("%s", ERROR_MEMORY);
+        return 0;
+    }
+    atomic_init(&writer->failed, 0);
+
+    /* Continue in the first block with what has been buffered so far
+     * (e.g., a header); the others start out empty.
+     */
+    writer->current = &writer->blocks[0];
+    memcpy(writer->current->data, out->buffer, out->used);
+    for ( i = 1; i < OUTPUT_BLOCKS; i++ )
+        (void) spscTryPush(&writer->empty, &writer->blocks[i]);
+
+    out->writer = writer;
+    if ( pthread_create(&writer->thread, NULL, writeBlocks, out) != 0 )
+    {
+        out->writer = NULL;
+        spscFree(&writer->empty);
+        spscFree(&writer->filled);
+        free(writer->blocks);
+        free(writer);
+        printError("Error: cannot start the output thread.\n");
+        return 0;
+    }
+    out->buffer = writer->current->data;
+    return 1;
+}
+
+int outputWord (OutputFile * out, uint32_t address, uint32_t word)
+{
+    /* The image formats put the word at its address, filling any gap
+     * with zero words; Intel HEX starts a new record instead.
+     */
+    if ( out->format == FORMAT_IHEX )
+    {
+        if ( out->recordLength > 0 &&
+             address != out->recordAddress + (uint32_t) out->recordLength )
+            endIhexRecord(out);
+    }
+    else if ( out->format != FORMAT_ASCII )
+    {
+        while ( out->nextAddress < address )
+        {
+            if ( out->used + MAX_WORD_OUTPUT > OUTPUT_BUFFER_SIZE &&
+                 ! writeBuffer(out) )
+                return 0;
+            addWord(out, 0);
+            out->nextAddress += 4;
+        }
+    }
+
+    if ( out->used + MAX_WORD_OUTPUT > OUTPUT_BUFFER_SIZE &&
+         ! writeBuffer(out) )
+        return 0;
+    if ( out->format == FORMAT_IHEX && out->recordLength == 0 )
+        out->recordAddress = address;
+    addWord(out, word);
+    out->nextAddress = address + 4;
+
+    if ( debug_is_on() )
+        return writeBuffer(out);
+    return 1;
+}
+
+int outputBytes (OutputFile * out, const void * data, size_t length)
+{
+    const char * next = data;
+    size_t       room;
+
+    while ( length > 0 )
+    {
+        if ( out->used == OUTPUT_BUFFER_SIZE && ! writeBuffer(out) )
+            return 0;
+        room = OUTPUT_BUFFER_SIZE - out->used;
+        if ( room > length )
+            room = length;
+        memcpy(out->buffer + out->used, next, room);
+        out->used += room;
+        next += room;
+        length -= room;
+    }
+    return 1;
+}
+
+int outputClose (OutputFile * out)
+{
+    static const unsigned char NO_DATA[1] = { 0 };
+    FILE * fp = out->fp;
+    int    ok = 1;
+
+    if ( fp == NULL )
+        return ! out->failed;
+    statsStart(STATS_OUTPUT);
+    if ( out->used + MAX_WORD_OUTPUT > OUTPUT_BUFFER_SIZE )
+        ok = writeBuffer(out);
+
+    if ( ok && out->format == FORMAT_IHEX )
+    {
+        if ( out->recordLength > 0 )
+            endIhexRecord(out);
+        addIhexRecord(out, 1, 0, NO_DATA, 0);      /* end of file */
+    }
+    else if ( ok && out->format == FORMAT_LOGISIM && out->nbrWords > 0 )
+        out->buffer[out->used++] = '\n';
+
+    if ( ok )
+        ok = writeBuffer(out);
+    if ( ! stopWriter(out) )
+        ok = 0;
+    out->fp = NULL;
+    if ( ok && fflush(fp) != 0 )
+    {
+        printError("%s", ERROR_WRITE);
+        out->failed = 1;
+        ok = 0;
+    }
+    statsStop(STATS_OUTPUT);
+    return ok;
+}
+
+/*
+ * Formats one word into the buffer, which must have room for
+ * MAX_WORD_OUTPUT more bytes.
+ */
+static void addWord (OutputFile * out, uint32_t word)
+{
+    char * next = out->buffer + out->used;
+
+    switch ( out->format )
+    {
+        case FORMAT_ASCII:
+            next[0] = '\n';
+            memcpy(next + 1, BYTE_DIGITS[word >> 24], 8);
+            memcpy(next + 9, BYTE_DIGITS[(word >> 16) & 0xFF], 8);
+            memcpy(next + 17, BYTE_DIGITS[(word >> 8) & 0xFF], 8);
+            memcpy(next + 25, BYTE_DIGITS[word & 0xFF], 8);
+            next[33] = '\n';
+            out->used += 34;
+            break;
+        case FORMAT_RAW_BE:
+            next[0] = (char) (word >> 24);
+            next[1] = (char) (word >> 16);
+            next[2] = (char) (word >> 8);
+            next[3] = (char) word;
+            out->used += 4;
+            break;
+        case FORMAT_RAW_LE:
+            next[0] = (char) word;
+            next[1] = (char) (word >> 8);
+            next[2] = (char) (word >> 16);
+            next[3] = (char) (word >> 24);
+            out->used += 4;
+            break;
+        case FORMAT_IHEX:
+            out->record[out->recordLength++] = (unsigned char) (word >> 24);
+            out->record[out->recordLength++] = (unsigned char) (word >> 16);
+            out->record[out->recordLength++] = (unsigned char) (word >> 8);
+            out->record[out->recordLength++] = (unsigned char) word;
+            if ( out->recordLength == OUTPUT_RECORD_SIZE )
+                endIhexRecord(out);
+            break;
+        case FORMAT_READMEMH:
+            addHex(out, word, 8, LOWER_HEX);
+            out->buffer[out->used++] = '\n';
+            break;
+        case FORMAT_LOGISIM:
+            if ( out->nbrWords > 0 )
+                out->buffer[out->used++] =
+                    out->nbrWords % LOGISIM_WORDS_PER_LINE == 0 ? '\n' : ' ';
+            addHex(out, word, 8, LOWER_HEX);
+            break;
+    }
+    out->nbrWords++;
+}
+
+/*
+ * Writes the Intel HEX data waiting in out->record as one data record,
+ * preceded by an extended linear address record if the upper 16 bits
+ * of its address are not the ones currently in effect.
+ */
+static void endIhexRecord (OutputFile * out)
+{
+    unsigned char upper[2];
+
+    if ( (out->recordAddress >> 16) != out->upperAddress )
+    {
+        out->upperAddress = out->recordAddress >> 16;
+        upper[0] = (unsigned char) (out->upperAddress >> 8);
+        upper[1] = (unsigned char) out->upperAddress;
+        addIhexRecord(out, 4, 0, upper, 2);
+    }
+    addIhexRecord(out, 0, out->recordAddress & 0xFFFF, out->record,
+                  out->recordLength);
+    out->recordAddress += (uint32_t) out->recordLength;
+    out->recordLength = 0;
+}
+
+/*
+ * Formats one Intel HEX record: ":", the byte count, the 16-bit
+ * address, the record type, the data, and the checksum (the two's
+ * complement of the sum of all the other bytes).
+ */
+static void addIhexRecord (OutputFile * out, int type, uint32_t address,
+                           const unsigned char data[], int length)
+{
+    unsigned sum = (unsigned) length + (address >> 8) + (address & 0xFF) +
+                   (unsigned) type;
+    int      i;
+
+    out->buffer[out->used++] = ':';
+    addHex(out, (uint32_t) length, 2, UPPER_HEX);
+    addHex(out, address, 4, UPPER_HEX);
+    addHex(out, (uint32_t) type, 2, UPPER_HEX);
+    for ( i = 0; i < length; i++ )
+    {
+        addHex(out, data[i], 2, UPPER_HEX);
+        sum += data[i];
+    }
+    addHex(out, (0x100 - (sum & 0xFF)) & 0xFF, 2, UPPER_HEX);
+    out->buffer[out->used++] = '\n';
+}
+
+/* Formats the low digits hex digits of value into the buffer. */
+static void addHex (OutputFile * out, uint32_t value, int digits,
+                    const char * hexDigits)
+{
+    int i;
+
+    for ( i = digits - 1; i >= 0; i-- )
+        out->buffer[out->used++] = hexDigits[(value >> (4 * i)) & 0xF];
+}
+
+/*
+ * Writes everything in the buffer with one fwrite and empties it; or,
+ * with a writer thread, passes the buffer to the writer and takes an
+ * empty one (waiting for the writer to free one, if necessary).
+ * Returns 1 if everything went OK; 0 (after printing an error, only
+ * once) if the output could not be written.
+ */
+static int writeBuffer (OutputFile * out)
+{
+    OutputWriter * writer = out->writer;
+
+    if ( out->failed )
+        return 0;
+    if ( writer != NULL && atomic_load(&writer->failed) )
+    {
+        printError("%s", ERROR_WRITE);
+        out->failed = 1;
+        return 0;
+    }
+    if ( out->used == 0 )
+        return 1;
+
+    statsStart(STATS_OUTPUT);
+    if ( writer != NULL )
+    {
+        writer->current->length = out->used;
+        spscPush(&writer->filled, writer->current);
+        writer->current = spscPop(&writer->empty);
+        out->buffer = writer->current->data;
+    }
+    else if ( fwrite(out->buffer, 1, out->used, out->fp) != out->used )
+    {
+        statsStop(STATS_OUTPUT);
+        printError("%s", ERROR_WRITE);
+        out->failed = 1;
+        return 0;
+    }
+    statsStop(STATS_OUTPUT);
+    STATS_COUNT(bytesWritten, out->used);
+    out->used = 0;
+    return 1;
+}
+
+/*
+ * The writer thread: writes each full buffer it is passed, in order,
+ * and passes it back empty, until it is passed NULL.
+ */
+static void * writeBlocks (void * arg)
+{
+    OutputFile *   out = arg;
+    OutputWriter * writer = out->writer;
+    OutputBlock *  block;
+
+    while ( (block = spscPop(&writer->filled)) != NULL )
+    {
+        if ( ! atomic_load(&writer->failed) &&
+             fwrite(block->data, 1, block->length, out->fp)
+                 != block->length )
+            atomic_store(&writer->failed, 1);
+        spscPush(&writer->empty, block);
+    }
+    return NULL;
+}
+
+/*
+ * Waits for the writer thread, if any, to write everything it has been
+ * passed, and releases its state.
+ * Returns 1 if everything went OK; 0 (after printing an error, only
+ * once) if the output could not be written.
+ */
+static int stopWriter (OutputFile * out)
+{
+    OutputWriter * writer = out->writer;
+    int            ok;
+
+    if ( writer == NULL )
+        return 1;
+    spscPush(&writer->filled, NULL);
+    (void) pthread_join(writer->thread, NULL);
+    ok = ! atomic_load(&writer->failed);
+    if ( ! ok && ! out->failed )
+    {
+        printError("%s", ERROR_WRITE);
+        out->failed = 1;
+    }
+
+    out->buffer = out->block;
+    out->writer = NULL;
+    spscFree(&writer->empty);
+    spscFree(&writer->filled);
+    free(writer->blocks);
+    free(writer);
+    return ok;
+}
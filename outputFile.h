@@ -0,0 +1,138 @@
+/*
+ * Output File: buffered output of the assembled machine code
+ *
+ * An OutputFile collects the 32-bit machine words produced by the
+ * encoders in a large buffer, formatted in one of the output formats
+ * below, and writes the buffer with one fwrite whenever it fills up
+ * (and when the output file is closed).  No other output function is
+ * called per instruction.
+ *
+ * Each word is given with the address (PC) of its instruction.  The
+ * ASCII format lists the words one after another, as the assembler has
+ * always done.  The image formats place each word at its address: the
+ * raw, $readmemh and Logisim formats fill addresses that have no word
+ * (blank lines, label-only lines, and lines with errors) with zero
+ * words, which are no-ops (sll $zero, $zero, 0), and Intel HEX gives
+ * the address in each record.
+ *
+ *      ascii       each word as 32 ASCII '0'/'1' characters, preceded
+ *                  and followed by a newline (the default)
+ *      raw-be      raw binary, 4 bytes per word, most significant first
+ *      raw-le      raw binary, 4 bytes per word, least significant first
+ *      ihex        Intel HEX records, 16 bytes (big-endian words) each
+ *      readmemh    one 8-digit hex word per line, for Verilog $readmemh
+ *      logisim     a Logisim "v2.0 raw" ROM image, 8 hex words per line
+ *
+ * After outputStartWriter, the buffer is not written by the thread that
+ * adds the words but by a separate writer thread, so that encoding
+ * continues while earlier output is being written (e.g., to a pipe).
+ * Full buffers go to the writer, and empty ones come back, through
+ * bounded queues (see spscQueue.h): with OUTPUT_BLOCKS buffers in all,
+ * the memory used stays fixed, and if the output is slower than the
+ * encoding, adding words waits for the writer to free a buffer.
+ *
+ */
+
+#ifndef _OUTPUTFILE_H
+#define _OUTPUTFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+        FORMAT_ASCII = 0,
+        FORMAT_RAW_BE,
+        FORMAT_RAW_LE,
+        FORMAT_IHEX,
+        FORMAT_READMEMH,
+        FORMAT_LOGISIM
+} OutputFormat;
+
+/* Size of the output buffer; it is written whenever it is this full. */
+#define OUTPUT_BUFFER_SIZE 65536
+
+/* Number of buffers used with a writer thread. */
+#define OUTPUT_BLOCKS 8
+
+/* Number of bytes in an Intel HEX data record. */
+#define OUTPUT_RECORD_SIZE 16
+
+/* The state of the writer thread (see outputFile.c). */
+typedef struct OutputWriter OutputWriter;
+
+typedef struct {
+        FILE *        fp;           /* where the output is written;
+                                     * NULL once closed */
+        OutputFormat  format;
+        uint32_t      nextAddress;  /* address after the last word */
+        uint32_t      upperAddress; /* ihex: current upper 16 bits */
+        int           nbrWords;     /* words (and fill words) so far */
+        int           failed;       /* 1 after a write error */
+        unsigned char record[OUTPUT_RECORD_SIZE];
+                                    /* ihex: data of the next record */
+        int           recordLength; /* ihex: bytes in record */
+        uint32_t      recordAddress;/* ihex: address of record[0] */
+        size_t        used;         /* bytes in buffer */
+        char *        buffer;       /* the buffer being filled */
+        OutputWriter * writer;      /* writer thread state, or NULL */
+        char          block[OUTPUT_BUFFER_SIZE];
+                                    /* the buffer, if no writer thread */
+} OutputFile;
+
+int outputFormatNamed (const char * name, OutputFormat * format);
+        /* Postcondition: if name is the name of an output format (see
+         *      above), *format is set to it.
+         * Returns 1 if name is an output format; 0 otherwise.
+         */
+
+void outputOpen (OutputFile * out, FILE * fp, OutputFormat format);
+        /* Postcondition: out is ready to collect words to be written to
+         *      fp in the given format (any header has been buffered).
+         */
+
+void outputOrigin (OutputFile * out, uint32_t address);
+        /* Precondition: no word has been added to out yet, and address
+         *      is a multiple of 4.
+         * Postcondition: the raw, $readmemh and Logisim images start at
+         *      address rather than at 0, with no zero words for the
+         *      addresses before it (for a program placed at address; see
+         *      linker.c).  Intel HEX records hold their own addresses.
+         */
+
+int outputStartWriter (OutputFile * out);
+        /* Postcondition: a writer thread has been started to write the
+         *      output from now on.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the thread could not be started, in which case the
+         *      output is written as usual.
+         */
+
+int outputWord (OutputFile * out, uint32_t address, uint32_t word);
+        /* Postcondition: word, the instruction at address, has been
+         *      added to the output.  Addresses must be given in
+         *      increasing order and be multiples of 4.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the output could not be written.
+         */
+
+int outputBytes (OutputFile * out, const void * data, size_t length);
+        /* Postcondition: the length bytes at data have been added to the
+         *      output as they are, for output that is not a list of
+         *      words in one of the formats above (an object file; see
+         *      objectFile.h).  Words and bytes should not be mixed.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the output could not be written.
+         */
+
+int outputClose (OutputFile * out);
+        /* Postcondition: any trailer has been added and everything in
+         *      the buffer has been written to the output file, which
+         *      has been flushed (but not closed), and the writer thread,
+         *      if any, has finished.  Calling outputClose again has no
+         *      effect.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the output could not be written.
+         */
+
+#endif
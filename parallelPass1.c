@@ -0,0 +1,453 @@
+/**
+ * LabelTable parallelPass1 (SourceFile * source, InstructionList * program,
+ *                           int nbrThreads)
+ *      @param  source  the assembly source code (see sourceFile.h), which
+ *                  is read from the beginning
+ *      @param  program  an empty list to which every instruction is
+ *                  added, parsed; or NULL to only collect the labels
+ *      @param  nbrThreads  the number of threads that parse the source
+ *      @return a newly-created table containing the labels found in the
+ *              input, each with the address of the instruction
+ *              containing it
+ *
+ * The parallelPass1 function does the same work as pass1, with the lines
+ * parsed by a pool of threads.  Parsing a line does not depend on any
+ * other line; only its address does, and that is known once the lines
+ * before it have been counted.
+ *
+ * The source is split at line boundaries into chunks (CHUNKS_PER_THREAD
+ * for each thread, of at least MIN_CHUNK_LENGTH characters), and each
+ * thread repeatedly takes the next chunk nobody has taken yet and parses
+ * its lines, numbering them from 1 within the chunk: the chunk keeps its
+ * instructions and its labels, with their chunk line numbers, and its
+ * number of lines.  Once every chunk has been parsed, a prefix sum of
+ * the chunks' numbers of lines and instructions gives the line where
+ * each chunk starts and where its instructions go in program.  Each
+ * chunk's instructions have interned their label operands in the
+ * chunk's own list (see InstructionList.h), so the chunks' labels are
+ * interned again in program's list, one chunk after another, giving each
+ * chunk a map from its ids to program's ids (the same ids pass1 would
+ * have given).  The threads then copy each chunk's instructions into
+ * place, correcting their line numbers and label ids, while the calling
+ * thread adds the labels to the label table one chunk after another, in
+ * source order, so the label table and its duplicate-label errors are
+ * exactly the same as pass1's.
+ *
+ * A streamed source, which can only be read in order, and a source too
+ * small to split are given to pass1 instead, as is everything if the
+ * threads cannot be started.  So is a program with directives (see
+ * dataSegment.h): the address of a line then depends on the segments
+ * of the lines before it, so the chunks cannot be parsed on their own.
+ *
+ */
+
+#include <pthread.h>
+
+#include "assembler.h"
+
+/* Number of chunks for each thread, so that a thread that finishes
+ * early can take another chunk.
+ */
+#define CHUNKS_PER_THREAD 4
+
+/* Smallest number of characters in a chunk. */
+#define MIN_CHUNK_LENGTH (256 * 1024)
+
+/* A label found in a chunk. */
+typedef struct {
+    Span label;
+    int  lineNum;               /* line in the chunk, from 1 */
+} ChunkLabel;
+
+/* The lines of one chunk of the source, and what was found in them. */
+typedef struct {
+    size_t          start;      /* offset of the first line */
+    size_t          end;        /* offset after the last line */
+    int             nbrLines;
+    InstructionList program;    /* instructions, with chunk line numbers */
+    ChunkLabel *    labels;
+    int             nbrLabels;
+    int             labelCapacity;
+    int             firstLine;  /* lines before the chunk */
+    int             firstInstruction;  /* instructions before the chunk */
+    int *           labelIds;   /* program's id of each of the chunk's
+                                 * label ids */
+} Chunk;
+
+/* The state shared by the threads. */
+typedef struct {
+    SourceFile *      source;
+    InstructionList * program;
+    Chunk *           chunks;
+    int               nbrChunks;
+    int               nextChunk;    /* next chunk nobody has taken */
+    int               failed;       /* 1 if a chunk could not be parsed */
+    pthread_mutex_t   lock;         /* protects nextChunk and failed */
+} ParsingPool;
+
+static void   splitSource (ParsingPool * pool, size_t chunkLength);
+static int    startThreads (pthread_t threads[], int nbrThreads,
+                            void * (*work) (void *), ParsingPool * pool);
+static int    takeChunk (ParsingPool * pool);
+static void * parseChunks (void * pool);
+static int    parseChunk (ParsingPool * pool, Chunk * chunk);
+static int    addChunkLabel (Chunk * chunk, Span label, int lineNum);
+static int    mapLabelIds (ParsingPool * pool, Chunk * chunk);
+static void * placeChunks (void * pool);
+static void   addLabels (ParsingPool * pool, LabelTable * table);
+
+LabelTable parallelPass1 (SourceFile * source, InstructionList * program,
+                          int nbrThreads)
+{
+    ParsingPool pool;
+    LabelTable  table;
+    pthread_t * threads;
+    size_t      chunkLength;
+    int         nbrStarted;
+    int         chunkNbr, nbrLines, nbrInstructions;
+
+    /* Split the source into chunks, unless it is too small. */
+    chunkLength = source->length / ((size_t) nbrThreads * CHUNKS_PER_THREAD);
+    if ( chunkLength < MIN_CHUNK_LENGTH )
+        chunkLength = MIN_CHUNK_LENGTH;
+    pool.nbrChunks = (int) ((source->length + chunkLength - 1) / chunkLength);
+    if ( source->stream != NULL || nbrThreads <= 1 || pool.nbrChunks <= 1 ||
+         hasDirectives (source->text, source->length) )
+        return pass1 (source, program);
+    if ( nbrThreads > pool.nbrChunks )
+        nbrThreads = pool.nbrChunks;
+
+    pool.source = source;
+    pool.program = program;
+    pool.nextChunk = 0;
+    pool.failed = 0;
+    pool.chunks = calloc ((size_t) pool.nbrChunks, sizeof(Chunk));
+    threads = malloc ((size_t) nbrThreads * sizeof(pthread_t));
+    if ( pool.chunks == NULL || threads == NULL )
+    {
+        free (pool.chunks);
+        free (threads);
+        return pass1 (source, program);
+    }
+    splitSource (&pool, chunkLength);
+    pthread_mutex_init (&pool.lock, NULL);
+
+    /* Parse the chunks. */
+    nbrStarted = startThreads (threads, nbrThreads, parseChunks, &pool);
+    if ( nbrStarted == 0 )
+    {
+        pthread_mutex_destroy (&pool.lock);
+        free (pool.chunks);
+        free (threads);
+        return pass1 (source, program);
+    }
+    while ( nbrStarted > 0 )
+        pthread_join (threads[--nbrStarted], NULL);
+
+    /* Find where each chunk starts: the prefix sums of the numbers of
+     * lines and instructions in the chunks before it.
+     */
+    nbrLines = nbrInstructions = 0;
+    for ( chunkNbr = 0; chunkNbr < pool.nbrChunks; chunkNbr++ )
+    {
+        pool.chunks[chunkNbr].firstLine = nbrLines;
+        pool.chunks[chunkNbr].firstInstruction = nbrInstructions;
+        nbrLines += pool.chunks[chunkNbr].nbrLines;
+        nbrInstructions += pool.chunks[chunkNbr].program.nbrInstructions;
+    }
+    STATS_COUNT(lines, nbrLines);
+
+    /* The data segment (empty, with no directives) follows the text, as
+     * in pass1.
+     */
+    if ( program != NULL )
+        (void) dataPlace (&program->data, NULL, (uint32_t) nbrLines * 4);
+
+    if ( program != NULL && nbrInstructions > 0 && ! pool.failed )
+    {
+        program->instructions = malloc ((size_t) nbrInstructions *
+                                        sizeof(Instruction));
+        if ( program->instructions == NULL )
+        {
+            printError ("Error: cannot allocate space in memory.\n");
+            pool.failed = 1;
+        }
+        else
+            program->nbrInstructions = program->capacity = nbrInstructions;
+        for ( chunkNbr = 0; chunkNbr < pool.nbrChunks && ! pool.failed;
+              chunkNbr++ )
+            pool.failed = ! mapLabelIds (&pool, &pool.chunks[chunkNbr]);
+    }
+
+    /* Put the instructions in place on the threads (or here, if they
+     * cannot be started) while the labels are added to the table here.
+     */
+    tableInit (&table);
+    if ( ! pool.failed )
+    {
+        pool.nextChunk = 0;
+        nbrStarted = startThreads (threads, nbrThreads, placeChunks, &pool);
+        if ( nbrStarted == 0 )
+            (void) placeChunks (&pool);
+        if ( tableResize (&table, 10) != 0 )
+        {
+            statsStart (STATS_LABELS);
+            addLabels (&pool, &table);
+            statsStop (STATS_LABELS);
+        }
+        while ( nbrStarted > 0 )
+            pthread_join (threads[--nbrStarted], NULL);
+        if ( program != NULL )
+            (void) tableResolve (&table, &program->labels);
+    }
+
+    for ( chunkNbr = 0; chunkNbr < pool.nbrChunks; chunkNbr++ )
+    {
+        listFree (&pool.chunks[chunkNbr].program);
+        free (pool.chunks[chunkNbr].labels);
+        free (pool.chunks[chunkNbr].labelIds);
+    }
+    pthread_mutex_destroy (&pool.lock);
+    free (pool.chunks);
+    free (threads);
+    return table;
+}
+
+/*
+ * Sets the start and end of each chunk: each chunk starts at the first
+ * line that starts at least chunkLength characters after the start of
+ * the chunk before it (so a chunk may be empty if a line is very long).
+ */
+static void splitSource (ParsingPool * pool, size_t chunkLength)
+{
+    const char * text = pool->source->text;
+    size_t       length = pool->source->length;
+    size_t       start = 0;
+    const char * newline;
+    int          chunkNbr;
+
+    for ( chunkNbr = 0; chunkNbr < pool->nbrChunks; chunkNbr++ )
+    {
+        pool->chunks[chunkNbr].start = start;
+        if ( chunkNbr == pool->nbrChunks - 1 )
+            start = length;
+        else if ( start < (size_t) (chunkNbr + 1) * chunkLength )
+        {
+            start = (size_t) (chunkNbr + 1) * chunkLength;
+            newline = start <= length
+                          ? memchr (text + start - 1, '\n',
+                                    length - start + 1)
+                          : NULL;
+            start = newline != NULL ? (size_t) (newline - text) + 1
+                                    : length;
+        }
+        pool->chunks[chunkNbr].end = start;
+    }
+}
+
+/*
+ * Starts up to nbrThreads threads doing work for the pool.
+ * Returns the number of threads started.
+ */
+static int startThreads (pthread_t threads[], int nbrThreads,
+                         void * (*work) (void *), ParsingPool * pool)
+{
+    int nbrStarted;
+
+    for ( nbrStarted = 0; nbrStarted < nbrThreads; nbrStarted++ )
+    {
+        if ( pthread_create (&threads[nbrStarted], NULL, work, pool) != 0 )
+            break;
+    }
+    return nbrStarted;
+}
+
+/*
+ * Returns the number of the next chunk nobody has taken, or -1 if there
+ * is none (or a chunk could not be parsed).
+ */
+static int takeChunk (ParsingPool * pool)
+{
+    int chunkNbr;
+
+    pthread_mutex_lock (&pool->lock);
+    chunkNbr = pool->nextChunk < pool->nbrChunks && ! pool->failed
+                   ? pool->nextChunk++ : -1;
+    pthread_mutex_unlock (&pool->lock);
+    return chunkNbr;
+}
+
+/*
+ * The work of each thread in the first phase: parse chunks until there
+ * are none left.
+ */
+static void * parseChunks (void * arg)
+{
+    ParsingPool * pool = arg;
+    int           chunkNbr;
+
+    while ( (chunkNbr = takeChunk (pool)) != -1 )
+    {
+        if ( ! parseChunk (pool, &pool->chunks[chunkNbr]) )
+        {
+            pthread_mutex_lock (&pool->lock);
+            pool->failed = 1;
+            pthread_mutex_unlock (&pool->lock);
+        }
+    }
+    statsMergeThread ();
+    return NULL;
+}
+
+/*
+ * Parses the lines of one chunk as pass1 does, keeping the labels and
+ * instructions in the chunk, numbered by their line in the chunk.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int parseChunk (ParsingPool * pool, Chunk * chunk)
+{
+    Span        inst;                       /* the current line */
+    Span        label, instName, operands;  /* parts of the line */
+    size_t      offset;                     /* offset of next line */
+    int         lineNum;                    /* line number in the chunk */
+    int         hasInstruction;
+    Instruction parsed;                     /* the current instruction */
+
+    listInit (&chunk->program);
+    for ( offset = chunk->start, lineNum = 1;
+          offset < chunk->end && sourceNextLine (pool->source, &offset,
+                                                 &inst);
+          lineNum++ )
+    {
+        hasInstruction = parseLine (inst, &label, &instName, &operands);
+        if ( label.length > 0 && ! addChunkLabel (chunk, label, lineNum) )
+            return 0;
+
+        if ( hasInstruction && pool->program != NULL )
+        {
+            parseInstruction (instName, operands, lineNum, &parsed);
+            parsed.column = (int) (instName.text - inst.text) + 1;
+            if ( addInstruction (&chunk->program, &parsed) == 0 )
+                return 0;   /* error message already printed */
+        }
+    }
+    chunk->nbrLines = lineNum - 1;
+    return 1;
+}
+
+/*
+ * Adds a label found on the given line of the chunk to its labels.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int addChunkLabel (Chunk * chunk, Span label, int lineNum)
+{
+    ChunkLabel * newLabels;
+    int          newCapacity;
+
+    if ( chunk->nbrLabels >= chunk->labelCapacity )
+    {
+        newCapacity = chunk->labelCapacity > 0 ? chunk->labelCapacity * 2
+                                               : 64;
+        newLabels = realloc (chunk->labels,
+                             (size_t) newCapacity * sizeof(ChunkLabel));
+        if ( newLabels == NULL )
+        {
+            printError ("Error: cannot allocate space in memory.\n");
+            return 0;
+        }
+        chunk->labels = newLabels;
+        chunk->labelCapacity = newCapacity;
+    }
+    chunk->labels[chunk->nbrLabels].label = label;
+    chunk->labels[chunk->nbrLabels].lineNum = lineNum;
+    chunk->nbrLabels++;
+    return 1;
+}
+
+/*
+ * Interns the labels the chunk's instructions use in the program's list,
+ * setting the chunk's map from its label ids to the program's.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int mapLabelIds (ParsingPool * pool, Chunk * chunk)
+{
+    const Interner * labels = &chunk->program.labels;
+    int              id;
+
+    if ( labels->nbrIdentifiers == 0 )
+        return 1;
+    chunk->labelIds = malloc ((size_t) labels->nbrIdentifiers * sizeof(int));
+    if ( chunk->labelIds == NULL )
+    {
+        printError ("Error: cannot allocate space in memory.\n");
+        return 0;
+    }
+    for ( id = 0; id < labels->nbrIdentifiers; id++ )
+    {
+        chunk->labelIds[id] = internHashed (&pool->program->labels,
+                                            labels->identifiers[id].name,
+                                            labels->identifiers[id].hash);
+        if ( chunk->labelIds[id] == -1 )
+            return 0;       /* error message already printed */
+    }
+    return 1;
+}
+
+/*
+ * The work of each thread in the second phase: copy the instructions of
+ * chunks into their place in the program, with their line numbers in
+ * the source and their labels' ids in the program, until there are no
+ * chunks left.
+ */
+static void * placeChunks (void * arg)
+{
+    ParsingPool * pool = arg;
+    Chunk *       chunk;
+    Instruction * place;
+    int           chunkNbr, i;
+
+    if ( pool->program == NULL )
+        return NULL;
+    while ( (chunkNbr = takeChunk (pool)) != -1 )
+    {
+        chunk = &pool->chunks[chunkNbr];
+        place = &pool->program->instructions[chunk->firstInstruction];
+        for ( i = 0; i < chunk->program.nbrInstructions; i++ )
+        {
+            place[i] = chunk->program.instructions[i];
+            place[i].lineNum += chunk->firstLine;
+            place[i].address = (place[i].lineNum - 1) * 4;
+            if ( hasLabelOperand (&place[i]) )
+                place[i].label = chunk->labelIds[place[i].label];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Adds the labels of every chunk to the table, in source order, each
+ * with the address of its line in the source.
+ */
+static void addLabels (ParsingPool * pool, LabelTable * table)
+{
+    Chunk * chunk;
+    int     chunkNbr, i;
+
+    for ( chunkNbr = 0; chunkNbr < pool->nbrChunks; chunkNbr++ )
+    {
+        chunk = &pool->chunks[chunkNbr];
+        for ( i = 0; i < chunk->nbrLabels; i++ )
+        {
+            /* (If this fails, the error message has already been
+             * printed.)
+             */
+            (void) addLabelN (table, chunk->labels[i].label.text,
+                              chunk->labels[i].label.length,
+                              (chunk->firstLine + chunk->labels[i].lineNum
+                               - 1) * 4);
+        }
+    }
+}
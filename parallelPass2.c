@@ -0,0 +1,243 @@
+/**
+ * void parallelPass2 (InstructionList * program, LabelTable table,
+ *                     OutputFile * output, int nbrThreads)
+ *      @param  program  the instructions parsed by pass1, in source order
+ *      @param  table  the Label Table built by pass1
+ *      @param  output  where the machine code is written (see outputFile.h)
+ *      @param  nbrThreads  the number of threads that encode instructions
+ *
+ * The parallelPass2 function does the same work as pass2, with the
+ * instructions encoded by a pool of threads.  Once pass1 has finished,
+ * encoding an instruction depends only on its own record and on the
+ * label table, which is no longer modified, so the instructions can be
+ * encoded in any order.
+ *
+ * The instructions are split into chunks of CHUNK_SIZE instructions.
+ * Each thread repeatedly takes the next chunk nobody has taken yet and
+ * encodes it, keeping the machine words and the errors (collected in
+ * the chunk's own Diagnostics, see diagnostics.h) in the chunk.
+ * Meanwhile the calling thread waits for the chunks in source order and
+ * reports each one's errors (with diagReplay) and writes its machine
+ * words, so the output and the errors collected are exactly the same as
+ * pass2's.  The data segment is written last, as by pass2.
+ *
+ * If the threads cannot be started, pass2 is called instead.
+ *
+ */
+
+#include <pthread.h>
+
+#include "assembler.h"
+
+/* Number of instructions in each chunk. */
+#define CHUNK_SIZE 16384
+
+/* The results of encoding one chunk of instructions. */
+typedef struct {
+    uint32_t *      words;      /* machine word of each instruction */
+    unsigned char * encoded;    /* 1 if the instruction has a word */
+    Diagnostics     errors;     /* errors found in the chunk */
+    int             done;       /* 1 once the chunk has been encoded */
+} Chunk;
+
+/* The state shared by the threads. */
+typedef struct {
+    InstructionList * program;
+    LabelTable        table;
+    Chunk *           chunks;
+    int               nbrChunks;
+    int               nextChunk;    /* next chunk nobody has taken */
+    int               failed;       /* 1 if a chunk could not be encoded */
+    pthread_mutex_t   lock;         /* protects nextChunk, failed, and
+                                     * done */
+    pthread_cond_t    chunkDone;    /* signalled when a chunk is done */
+} EncodingPool;
+
+static void * encodeChunks (void * pool);
+static int    encodeChunk (EncodingPool * pool, int chunkNbr);
+static int    chunkSize (EncodingPool * pool, int chunkNbr);
+static void   freeChunk (Chunk * chunk);
+
+void parallelPass2 (InstructionList * program, LabelTable table,
+                    OutputFile * output, int nbrThreads)
+{
+    EncodingPool pool;
+    pthread_t *  threads;
+    int          nbrStarted;
+    int          chunkNbr, i, first, size, failed;
+
+    pool.program = program;
+    pool.table = table;
+    pool.nbrChunks = (program->nbrInstructions + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    pool.nextChunk = 0;
+    pool.failed = 0;
+    if ( nbrThreads > pool.nbrChunks )
+        nbrThreads = pool.nbrChunks;
+    if ( nbrThreads <= 1 )
+    {
+        pass2 (program, table, output);
+        return;
+    }
+
+    pool.chunks = calloc ((size_t) pool.nbrChunks, sizeof(Chunk));
+    threads = malloc ((size_t) nbrThreads * sizeof(pthread_t));
+    if ( pool.chunks == NULL || threads == NULL )
+    {
+        free (pool.chunks);
+        free (threads);
+        pass2 (program, table, output);
+        return;
+    }
+    pthread_mutex_init (&pool.lock, NULL);
+    pthread_cond_init (&pool.chunkDone, NULL);
+
+    for ( nbrStarted = 0; nbrStarted < nbrThreads; nbrStarted++ )
+    {
+        if ( pthread_create (&threads[nbrStarted], NULL, encodeChunks,
+                             &pool) != 0 )
+            break;
+    }
+    if ( nbrStarted == 0 )
+    {
+        pthread_cond_destroy (&pool.chunkDone);
+        pthread_mutex_destroy (&pool.lock);
+        free (pool.chunks);
+        free (threads);
+        pass2 (program, table, output);
+        return;
+    }
+
+    /* Write the results of each chunk, in source order, as soon as it
+     * has been encoded.
+     */
+    for ( chunkNbr = 0; chunkNbr < pool.nbrChunks; chunkNbr++ )
+    {
+        Chunk * chunk = &pool.chunks[chunkNbr];
+
+        pthread_mutex_lock (&pool.lock);
+        while ( ! chunk->done )
+            pthread_cond_wait (&pool.chunkDone, &pool.lock);
+        failed = pool.failed;
+        pthread_mutex_unlock (&pool.lock);
+        if ( failed )
+            break;          /* error message already printed */
+
+        first = chunkNbr * CHUNK_SIZE;
+        size = chunkSize (&pool, chunkNbr);
+        diagReplay (&chunk->errors);
+        for ( i = 0; i < size; i++ )
+        {
+            if ( chunk->encoded[i] &&
+                 ! outputWord (output, (uint32_t)
+                                   program->instructions[first + i].address,
+                               chunk->words[i]) )
+                break;      /* error message already printed */
+        }
+        if ( i < size )
+            break;
+        freeChunk (chunk);
+    }
+
+    /* Stop the threads from taking new chunks and wait for them. */
+    pthread_mutex_lock (&pool.lock);
+    pool.nextChunk = pool.nbrChunks;
+    pthread_mutex_unlock (&pool.lock);
+    for ( i = 0; i < nbrStarted; i++ )
+        pthread_join (threads[i], NULL);
+
+    /* The data segment follows the instructions, as in pass2. */
+    if ( chunkNbr == pool.nbrChunks )
+        (void) dataWrite (&program->data, output);
+
+    for ( ; chunkNbr < pool.nbrChunks; chunkNbr++ )
+        freeChunk (&pool.chunks[chunkNbr]);
+    pthread_cond_destroy (&pool.chunkDone);
+    pthread_mutex_destroy (&pool.lock);
+    free (pool.chunks);
+    free (threads);
+}
+
+/*
+ * The work of each thread: encode chunks until there are none left.
+ */
+static void * encodeChunks (void * arg)
+{
+    EncodingPool * pool = arg;
+    int            chunkNbr;
+    int            ok;
+
+    for ( ;; )
+    {
+        pthread_mutex_lock (&pool->lock);
+        chunkNbr = pool->nextChunk < pool->nbrChunks ? pool->nextChunk++ : -1;
+        pthread_mutex_unlock (&pool->lock);
+        if ( chunkNbr == -1 )
+        {
+            statsMergeThread ();
+            return NULL;
+        }
+
+        ok = encodeChunk (pool, chunkNbr);
+
+        pthread_mutex_lock (&pool->lock);
+        if ( ! ok )
+            pool->failed = 1;
+        pool->chunks[chunkNbr].done = 1;
+        pthread_cond_broadcast (&pool->chunkDone);
+        pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+/*
+ * Encodes the instructions of one chunk, keeping their words and errors
+ * in the chunk.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+static int encodeChunk (EncodingPool * pool, int chunkNbr)
+{
+    Chunk *       chunk = &pool->chunks[chunkNbr];
+    Instruction * first = &pool->program->instructions[chunkNbr * CHUNK_SIZE];
+    int           size = chunkSize (pool, chunkNbr);
+    int           i;
+
+    chunk->words = malloc ((size_t) size * sizeof(uint32_t));
+    chunk->encoded = malloc ((size_t) size);
+    if ( chunk->words == NULL || chunk->encoded == NULL )
+    {
+        printError ("Error: cannot allocate space in memory.\n");
+        return 0;
+    }
+
+    diagInit (&chunk->errors, 0);
+    diagCollect (&chunk->errors);
+    for ( i = 0; i < size; i++ )
+    {
+        chunk->encoded[i] = encodeInstruction (&first[i], pool->table,
+                                               &chunk->words[i], NULL)
+                            == ASM_OK;
+    }
+    diagCollect (NULL);
+    return 1;
+}
+
+/* Returns the number of instructions in the given chunk. */
+static int chunkSize (EncodingPool * pool, int chunkNbr)
+{
+    int remaining = pool->program->nbrInstructions - chunkNbr * CHUNK_SIZE;
+
+    return remaining < CHUNK_SIZE ? remaining : CHUNK_SIZE;
+}
+
+/*
+ * Releases the memory of a chunk whose results have been written or are
+ * no longer needed.
+ */
+static void freeChunk (Chunk * chunk)
+{
+    free (chunk->words);
+    free (chunk->encoded);
+    diagFree (&chunk->errors);
+    chunk->words = NULL;
+    chunk->encoded = NULL;
+}
@@ -0,0 +1,101 @@
+/*
+ * This file contains the parseInstruction function, which turns one
+ * line's instruction name and operands into an Instruction record (see
+ * InstructionList.h): the name is looked up in the instruction table,
+ * the operands are split into tokens, and each operand is converted
+ * according to the instruction's operand shape -- registers with
+ * getRegNum, immediate values with spanToInt, and labels kept as spans
+ * into the source.
+ *
+ * parseInstruction does not print anything.  Problems are recorded in
+ * the record and reported by the assembler functions when the
+ * instruction is encoded.
+ *
+ */
+
+#include "assembler.h"
+#include "assemblerUtil.h"
+
+/* What each operand of an instruction is, for each OperandShape:
+ * 'r' for a register, 'i' for an immediate value (or shamt), and 'l'
+ * for a label.
+ */
+static const struct {
+        int  nbrOperands;
+        char kinds[4];
+} SHAPES[] = {
+        [OPS_RD_RS_RT]    = { 3, "rrr" },
+        [OPS_RD_RT_SHAMT] = { 3, "rri" },
+        [OPS_RS]          = { 1, "r" },
+        [OPS_RT_RS_IMM]   = { 3, "rri" },
+        [OPS_RS_RT_LABEL] = { 3, "rrl" },
+        [OPS_RT_IMM_RS]   = { 3, "rir" },
+        [OPS_RT_IMM]      = { 2, "ri" },
+        [OPS_TARGET]      = { 1, "l" }
+};
+
+/**
+ * parseInstruction -- parse one instruction into a record
+ * Parameters:  instName -- the instruction name (e.g., "add")
+ *              operands -- the rest of the instruction after the name
+ *              lineNum -- the line number of the instruction
+ *              inst -- the record to fill in
+ * Postcondition:
+ *              inst holds the parsed instruction; inst->status is
+ *              PARSE_OK unless the name is not an instruction or the
+ *              number of operands is wrong (see InstructionList.h).
+ *              Its address is that of line lineNum, (lineNum-1)*4,
+ *              for the caller to change if a data segment came before.
+ */
+void parseInstruction (Span instName, Span operands, int lineNum,
+                       Instruction * inst)
+{
+    Span tokens[3];
+    int  nbrOperands;
+    int  i;
+
+    memset (inst, 0, sizeof(Instruction));
+    inst->lineNum = lineNum;
+    inst->address = (lineNum - 1) * 4;
+    inst->status = PARSE_OK;
+    inst->operands = operands;
+
+    inst->instruction = findInstruction (instName);
+    if ( inst->instruction == NULL )
+    {
+        inst->status = PARSE_BAD_NAME;
+        inst->text = instName;
+        return;
+    }
+
+    STATS_COUNT(instructions[inst->instruction->format], 1);
+    nbrOperands = SHAPES[inst->instruction->operands].nbrOperands;
+    if ( ! getNSpanTokens (operands, nbrOperands, tokens) )
+    {
+        /* getNSpanTokens put its error message in tokens[0]. */
+        inst->status = PARSE_BAD_TOKENS;
+        inst->text = tokens[0];
+        return;
+    }
+
+    /* Keep the first operand for error messages (e.g., an invalid
+     * register for jr); a label operand replaces it below.
+     */
+    inst->text = tokens[0];
+    for ( i = 0; i < nbrOperands; i++ )
+    {
+        switch ( SHAPES[inst->instruction->operands].kinds[i] )
+        {
+            case 'r':
+                inst->reg[i] = (signed char) getRegNum (tokens[i]);
+                break;
+            case 'i':
+                inst->immediate = spanToInt (tokens[i]);
+                break;
+            default:
+                inst->text = tokens[i];
+                inst->label = -1;       /* not interned yet */
+                break;
+        }
+    }
+}
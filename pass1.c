@@ -1,14 +1,21 @@
 /**
- * LabelTable pass1 (FILE * fp)
- *      @param  fp  pointer to an open file (stdin or other file pointer)
- *                  from which to read lines of assembly source code
+ * LabelTable pass1 (SourceFile * source, InstructionList * program)
+ *      @param  source  the assembly source code (see sourceFile.h),
+ *                  which is read from the beginning
+ *      @param  program  an initialized list to which every instruction
+ *                  is added, parsed (see InstructionList.h); or NULL to
+ *                  only collect the labels
  *      @return a newly-created table containing labels found in the
  *              input file, each with the address of the instruction
  *              containing it (assuming the first line of input
- *              corresponds to address 0)
+ *              corresponds to address 0), or of its data
+ *              (see dataSegment.h)
  *
  * This function reads the lines in an assembly source file and looks
- * for labeled statements.  It builds a table of labels and addresses.
+ * for labeled statements.  It builds a table of labels and addresses,
+ * and parses each instruction into the program list for pass2.  Data
+ * directives are assembled into the program's data segment as they are
+ * read.
  * It returns a copy of the table it created.  If an error occurs, the
  * function prints an error message and returns the table as it exists
  * at that point (possibly empty).
@@ -18,23 +25,37 @@
  *
  * Modified by:  Alyce Brady, 6/10/2014
  *      Take open file pointer as parameter, rather than filename.
+ * Modified:  10/17/2026
+ *      Read lines from a memory-mapped SourceFile instead of using
+ *      fgets, so lines may be any length and are never copied.
+ *      Parse each instruction once, into the list used by pass2.
+ *      Resolve the labels the instructions use, by id, for pass2.
+ *      Assemble the data directives into a separate data segment.
  *
  */
 
 #include "assembler.h"
 
-LabelTable pass1 (FILE * fp)
+LabelTable pass1 (SourceFile * source, InstructionList * program)
   /* returns a copy of the label table that was constructed */
 {
     LabelTable table;              /* the table of labels & addresses */
     int    PC = 0;                 /* the program counter */
-    char * tokBegin, * tokEnd;     /* used to step thru inst */
-    char   inst[BUFSIZ];           /* will hold instruction; BUFSIZ
-                                      is max size of I/O buffer
-                                      (defined in stdio.h) */
+    Span   inst;                   /* the current line */
+    Span   label, instName, operands;  /* parts of the line */
+    Span   rest;                   /* the line after a directive's name */
+    size_t offset = 0;             /* offset of next line in source */
+    int    lineNum;                /* line number */
+    int    column;                 /* column of the instruction name */
+    int    isData;                 /* 1 if the line is a directive */
+    uint32_t dataOffset;           /* offset of the line's data */
+    Instruction parsed;            /* the current instruction, parsed */
+    DataSegment labelsOnly;        /* the data, if program is NULL */
+    DataSegment * data = program != NULL ? &program->data : &labelsOnly;
 
     /* create a small label table to begin with */
     tableInit (&table);
+    dataInit (&labelsOnly);
     if ( tableResize (&table, 10) == 0)
     {
         /* error message already printed */
@@ -45,40 +66,78 @@ LabelTable pass1 (FILE * fp)
      * Check each line to see if it has a label; if it does, add it
      * to the label table.
      */
-    for (PC = 0; fgets (inst, BUFSIZ, fp); PC += 4)
+    for (PC = 0, lineNum = 1; sourceNextLine (source, &offset, &inst);
+         lineNum++)
     {
-        /* If the line starts with a comment, move on to next line.
-         * If there's a comment later in the line, strip it off
-         *  (replace the '#' with a null byte).
+        /* Check each line to see if it has a label (ignoring any
+         * comment); if it does, add it to the label table.
          */
-        if ( *inst == '#' ) continue;
-        (void) strtok (inst, "#");
+        int hasInstruction = parseLine (inst, &label, &instName, &operands);
+        column = hasInstruction ? (int) (instName.text - inst.text) + 1 : 0;
 
-        /* Read the first token, skipping any leading whitespace. */
-        tokBegin = inst;
-        getToken (&tokBegin, &tokEnd);
-            /* tokBegin now points to 1st non-whitespace character
-             * in the token and tokEnd points to 1st punctuation mark
-             * or whitespace after the end of the token.
-             */
-
-        /* Check each line to see if it has a label; if it does,
-         * process it.
+        /* A directive is carried out first, since a label on its line
+         * is the address of its data.  (Its operands go on to the end
+         * of the line, since a string may hold a '#'.)
          */
-        if ( *(tokEnd) == ':' )
+        isData = hasInstruction && isDirective (instName);
+        dataOffset = (uint32_t) data->size;
+        if ( isData )
+        {
+            rest.text = operands.text;
+            rest.length = (int) (inst.text + inst.length - operands.text);
+            if ( ! dataDirective (data, instName, rest, lineNum, column,
+                                  &dataOffset) )
+            {
+                /* error message already printed */
+                break;
+            }
+        }
+
+        if ( label.length > 0 )
         {
-            /* Line has a label! */
-            *tokEnd = '\0';      /* truncate everything after label */
+            /* (If this fails, the error message has already been
+             * printed.)  A label in the data segment is added once the
+             * address of the segment is known, after the last line.
+             */
+            statsStart (STATS_LABELS);
+            if ( data->inData )
+                (void) dataAddLabel (data, label, dataOffset);
+            else
+                (void) addLabelN (&table, label.text, label.length, PC);
+            statsStop (STATS_LABELS);
+        }
 
-            /* Add label to table */
-            if (addLabel (&table, tokBegin, PC) == 0)
+        /* Parse the instruction, if any, for pass2. */
+        if ( hasInstruction && ! isData && program != NULL &&
+             checkSegment (data, instName, lineNum, column) )
+        {
+            parseInstruction (instName, operands, lineNum, &parsed);
+            parsed.column = column;
+            parsed.address = PC;
+            if ( addInstruction (program, &parsed) == 0 )
             {
                 /* error message already printed */
-                continue;
+                break;
             }
         }
+
+        /* Every line of the text segment takes up a word. */
+        if ( ! data->inData && ! isData )
+            PC += 4;
     }
 
-    /* EOF, but don't close the file here. */
+    STATS_COUNT(lines, lineNum - 1);
+
+    /* The data segment follows the text segment. */
+    (void) dataPlace (data, &table, (uint32_t) PC);
+    dataFree (&labelsOnly);
+
+    /* Look up each label the instructions use, once, for pass2.  (If
+     * this fails, pass2 looks them up by name instead.)
+     */
+    if ( program != NULL )
+        (void) tableResolve (&table, &program->labels);
+
+    /* EOF, but don't close the source here. */
     return table;
 }
@@ -1,21 +1,21 @@
 /**
- * LabelTable pass2 (FILE * fp, LabelTable table)
- *      @param  fp  pointer to an open file (stdin or other file pointer)
- *                  from which to read lines of assembly source code
+ * void pass2 (InstructionList * program, LabelTable table, OutputFile * output)
+ *      @param  program  the instructions parsed by pass1 (see
+ *                  InstructionList.h), in source order
  *      @param  table  an existing Label Table
- *      @return a newly-created table containing labels found in the
- *              input file, each with the address of the instruction
- *              containing it (assuming the first line of input
- *              corresponds to address 0)
+ *      @param  output  where the machine code is written (see outputFile.h)
  *
- * The pass2 function will read each line of instruction, determine its format
- * type and then print either its corresponding machine code or error, using one
- * of the 3 assembler functions for: R-Format, I-Format, or J-Format.
- * 
- * The processFormat(...) function will determine which format the instruction
- * belongs to and pass the format type back to processInstruction(...) which
- * will pass the correct parameters into one of the assembler format type
- * functions/will return an error if instruction doesn't belong to any 
+ * The pass2 function will go through each parsed instruction, determine its
+ * format type and then either add its corresponding machine code to the
+ * output or print an error, using one of the 3 assembler functions for:
+ * R-Format, I-Format, or J-Format.  The source text is not read again: the
+ * instructions were parsed once, by pass1, into records that hold their
+ * register numbers, immediate values, and labels.  The data that pass1
+ * assembled from the data directives is written after the instructions
+ * (see dataSegment.h).
+ *
+ * The encodeInstruction(...) function reports instructions that could not be
+ * parsed, and passes the others into the assembler function for their
  * format type.
  *
  * Author: Nikhil Sodemba
@@ -24,178 +24,104 @@
  */
 
 #include "assembler.h"
-
-/* Declaration of helper function - processInstruction, defined later in this file. */
-void processInstruction(char * instName, char * restOfInstruction,
-                        int lineNum, LabelTable table);
-
-/* Declaration of helper function - processFormat, defined later in thie file */
-int processFormat(char * instName);
+#include "assemblerUtil.h"
 
 /**
  * Main for the pass2 function.
- * 
- * Takes in the file pointer and the lable table (generated from pass1) as arguments
- * in the parameters.
+ *
+ * Takes in the parsed instructions and the lable table (both generated from
+ * pass1), and the output file as arguments in the parameters.
  */
-void pass2 (FILE * fp, LabelTable table)
-  /* returns a copy of the label table that was constructed */
+void pass2 (InstructionList * program, LabelTable table, OutputFile * output)
 {
-    int    lineNum;                /* line number */
-    int    PC;                     /* program counter */
-    char * tokBegin, * tokEnd;     /* used to step thru inst */
-    char   inst[BUFSIZ];           /* will hold instruction; BUFSIZ
-                                      is max size of I/O buffer
-                                      (defined in stdio.h) */
-    char * instrName;              /* instruction name (e.g., "add") */
+    int      i;
+    uint32_t word;                 /* the encoded instruction */
 
-    /* Continuously read next line of input until EOF is encountered.
-     */
-    for (lineNum = 1, PC = 0; fgets (inst, BUFSIZ, fp); lineNum++, PC += 4)
+    /* Encode the instructions in source order. */
+    for (i = 0; i < program->nbrInstructions; i++)
     {
-        /* If the line starts with a comment, move on to next line.
-         * If there's a comment later in the line, strip it off
-         *  (replace the '#' with a null byte).
-         */
-        if ( *inst == '#' ) continue;
-        (void) strtok (inst, "#");
+        const Instruction * inst = &program->instructions[i];
 
-        /* Read the first token, skipping any leading whitespace. */
-        tokBegin = inst;
-        getToken (&tokBegin, &tokEnd);
-            /* tokBegin now points to 1st non-whitespace character
-             * in the token and tokEnd points to 1st punctuation mark
-             * or whitespace after the end of the token.
-             */
+        // print current instruction (the source is still there, so the
+        // operands can be printed from it as singlePass does)
+        if (inst->instruction != NULL)
+            printDebug("\nLine #%d: %s, %.*s\n", inst->lineNum,
+                       inst->instruction->name, inst->operands.length,
+                       inst->operands.text);
+        else
+            printDebug("\nLine #%d: %.*s, %.*s\n", inst->lineNum,
+                       inst->text.length, inst->text.text,
+                       inst->operands.length, inst->operands.text);
 
-        /* Skip label, if any */
-        if ( *(tokEnd) == ':' )
+        if (encodeInstruction(inst, table, &word, NULL) == ASM_OK &&
+            ! outputWord(output, (uint32_t) inst->address, word))
         {
-            /* Line has a label!  Get new token! */
-            tokBegin = tokEnd + 1;
-            getToken (&tokBegin, &tokEnd);
+            return;     /* error message already printed */
         }
-
-        /* If empty line or line containing only a label, get next line */
-        if ( *tokBegin == '\0' )
-            continue;
-
-        /* We have a valid token; turn it into a string and set
-         * tokBegin to point to the character after the end.
-         */
-        *tokEnd = '\0';
-        instrName = tokBegin;
-        tokBegin = tokEnd + 1;
-
-        // print current instruction
-        printDebug("\nLine #%d: %s, %s\n", lineNum, instrName, tokBegin);
-
-        processInstruction(instrName, tokBegin, lineNum, table);
     }
 
+    // the data segment follows the instructions
+    (void) dataWrite(&program->data, output);
     return;
 }
 
 /**
- * This function will process the given instruction and determine 
- * which format type the instruction belongs to (using processFormat(...)).
+ * This function will process the given parsed instruction and determine
+ * which format type the instruction belongs to (from its descriptor in the
+ * instruction table).
  * Once the function determines which format type the instruction belongs to,
- * it will call the appropiate function to process the instruction into 
+ * it will call the appropiate function to process the instruction into
  * its binary representation (Machine Code).
- * 
- * The function takes 4 arguments: instName, restOfInstruction, lineNum, and table.
- * 
- * Will print error to stderr, if the given instruction doesn't belong to any
- * legitimate format type.
- * 
+ *
+ * The function takes 4 arguments: inst, table, word, and fixup.  The encoded
+ * instruction is stored in *word; fixup is NULL unless forward references are
+ * allowed (see assemblerI/assemblerJ).
+ *
+ * Will report an error (see diagnostics.h), if the given instruction doesn't
+ * belong to any legitimate format type or has the wrong number of operands.
+ *
+ * Returns ASM_OK, ASM_FIXUP, or ASM_ERROR, as returned by the assembler
+ * format functions.
+ *
  */
-void processInstruction(char * instName, char * restOfInstruction,
-                        int lineNum, LabelTable table)
+int encodeInstruction(const Instruction * inst, LabelTable table,
+                        uint32_t * word, Fixup * fixup)
 {
-    // Call processFormat function to identify format type.
-    int formatResult = processFormat(instName);
-    if(formatResult == 0)
+    if(inst->status == PARSE_BAD_NAME)
+    {
+        diagError(DIAG_BAD_NAME, inst->lineNum, inst->column, inst->text,
+                  "\nError on line: %d. Invalid instruction: '%.*s'.\n");
+        return ASM_ERROR;
+    }
+
+    if(inst->instruction->format == R_FORMAT)
     {
         printDebug("\tThe instruction is of R-Format.\n");
-        assemblerR(instName, restOfInstruction, lineNum);
     }
-    else if(formatResult == 1)
+    else if(inst->instruction->format == I_FORMAT)
     {
         printDebug("\tThe instruction is of I-Format.\n");
-        assemblerI(instName, restOfInstruction, lineNum, table);
     }
-    else if(formatResult == 2)
+    else
     {
         printDebug("\tThe instruction is of J-Format.\n");
-        assemblerJ(instName, restOfInstruction, lineNum, table);
     }
-    else if(formatResult == -1)
+
+    if(inst->status == PARSE_BAD_TOKENS)
     {
-        printError("\nError on line: %d. Invalid instruction: '%s'.\n", lineNum, instName);
+        /* The error message came from getNSpanTokens. */
+        diagError(DIAG_BAD_OPERANDS, inst->lineNum, inst->column, inst->text,
+                  "\nError on line %d: %.*s\n");
+        return ASM_ERROR;
     }
-    return;
-}
 
-/**
- * This function will return the format type for the given instruction,
- * can be one of the following: R-Format, I-Format, J-Format, and invalid Format.
- * 
- * The function takes in one argument as a parameter, the given instruction 
- * name for the given instruction line. I.e. instName = "add"
- * 
- * Returns 0 for R-Format, 1 for I-Format, 2 for J-Format 
- * and -1 for an invalid instruction name, not beloning to any of the 3
- * valid format types. 
- * 
- */
-int processFormat(char * instName)
-{
-    // Local Variables for the posible format types
-    // R-Format options array
-    char * rFormat [] = 
-    {
-        "add", "addu", "sub", "subu", "and", "or", "nor", "slt",
-        "sltu", "sll", "srl", "jr"
-    };
-    // I-Format options array
-    char * iFormat [] = 
+    if(inst->instruction->format == R_FORMAT)
     {
-        "beq", "bne", "addi", "addiu", "andi", "ori", "slti", "sltiu",
-        "lui", "lw", "sw"
-    };
-    // J-Format options array
-    char * jFormat [] =
-    {
-        "j", "jal"
-    };
-    int i; // constant to loop through the arrays
-
-    // Loop through the arrays
-    for(i = 0; i < 12; i++)
+        return assemblerR(inst, word);
+    }
+    else if(inst->instruction->format == I_FORMAT)
     {
-        // R-Format array
-        if(strcmp(rFormat[i], instName) == 0)
-        {
-            return 0;
-        }
-        // I-Format array
-        if(i < 11)
-        {
-            if(strcmp(iFormat[i], instName) == 0)
-            {
-                return 1;
-            }
-        }
-        // J-Format array
-        if(i < 2)
-        {
-            if(strcmp(jFormat[i], instName) == 0)
-            {
-                return 2;
-            }
-        }
+        return assemblerI(inst, table, word, fixup);
     }
-    // Invalid-Instruction name, proper error handling will be dealt 
-    // in processInstruction function.
-    return -1;
+    return assemblerJ(inst, table, word, fixup);
 }
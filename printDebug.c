@@ -12,7 +12,10 @@
  *                      debugging state in its current state
  *
  * The file also defines a number of internal data values and helper
- * functions to support the six functions described above.
+ * functions to support the six functions described above.  The
+ * debugging state is kept per thread, so a thread that turns debugging
+ * on or off (or overrides changes) affects only its own messages; every
+ * thread starts with debugging off.
  */
 
 #include <stdarg.h>
@@ -23,13 +26,13 @@
 
 /* Define the internal DEBUG variable shared by functions in this file. */
 static const char DEBUG_DEFAULT_VALUE = 0;
-static char OVERRIDE_DEBUG_CHANGES = 0;
-static char DEBUG = 0; /* Not all compilers will accept DEBUG_DEFAULT_VALUE. */
+static _Thread_local char OVERRIDE_DEBUG_CHANGES = 0;
+static _Thread_local char DEBUG = 0; /* Not all compilers will accept DEBUG_DEFAULT_VALUE. */
 
 /* Define the internal DEBUG stack and the functions that operate on it. */
-static char * debugStack = NULL;
-static unsigned debugStackCapacity = 0;
-static unsigned debugStackNumEntries = 0;
+static _Thread_local char * debugStack = NULL;
+static _Thread_local unsigned debugStackCapacity = 0;
+static _Thread_local unsigned debugStackNumEntries = 0;
 static void debug_push(void);
 static char debug_pop(void);
 static int resizeDebugStack (void);
@@ -146,7 +149,7 @@ void override_debug_changes(void)
  */
 static void debug_push(void)
 {
-    if ( debugStack == NULL || debugStackNumEntries <= debugStackCapacity )
+    if ( debugStack == NULL || debugStackNumEntries >= debugStackCapacity )
         resizeDebugStack();
 
     debugStack[debugStackNumEntries++] = DEBUG;
@@ -155,14 +158,27 @@ static void debug_push(void)
 /**
  * void debug_pop(void)
  *
- * Pops and returns the most recent debug state from the stack.  If
- * there was no value on the stack, returns the DEBUG_DEFAULT_VALUE.
+ * Pops and returns the most recent debug state from the stack, which is
+ * released once it is empty.  If there was no value on the stack,
+ * returns the DEBUG_DEFAULT_VALUE.
  *
  */
 static char debug_pop(void)
 {
+    char state;
+
     if ( debugStackNumEntries > 0 )
-        return debugStack[--debugStackNumEntries];
+    {
+        state = debugStack[--debugStackNumEntries];
+        if ( debugStackNumEntries == 0 )
+        {
+            /* Release an empty stack (e.g., before the thread ends). */
+            free (debugStack);
+            debugStack = NULL;
+            debugStackCapacity = 0;
+        }
+        return state;
+    }
 
     return DEBUG_DEFAULT_VALUE;
 }
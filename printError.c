@@ -6,6 +6,21 @@
 /** Define the global ERROR_LIMIT variable. **/
 int ERROR_LIMIT = 20;
 
+/* Number of error messages printed so far. */
+static int error_count = 0;
+
+/* Internal state for holding error messages (see hold_errors).  Each
+ * thread holds its own messages, so threads encoding instructions in
+ * parallel can each collect the errors for their instructions.
+ */
+static _Thread_local int holding = 0;
+static _Thread_local char * heldErrors = NULL;
+static _Thread_local size_t heldLength = 0;
+static _Thread_local size_t heldCapacity = 0;
+static _Thread_local int heldCount = 0;
+
+static void holdError(const char * restrict_format, va_list ap);
+
 /**
  * printError(const char * restrict_format, ...)
  *
@@ -31,13 +46,18 @@ int ERROR_LIMIT = 20;
  */
 void printError(const char * restrict_format, ...)
 {
-    static int error_count = 0;
-
     /* The following code allows us to call fprintf with the variable
      * parameters that were passed to printError.
      */
     va_list ap;
     va_start(ap, restrict_format);
+    if ( holding )
+    {
+        /* Save the message for later; it isn't counted until reported. */
+        holdError(restrict_format, ap);
+        va_end(ap);
+        return;
+    }
     (void) vfprintf(stderr, restrict_format, ap);
     va_end(ap);
 
@@ -49,3 +69,91 @@ void printError(const char * restrict_format, ...)
     }
 
 }
+
+/**
+ * void hold_errors(void)
+ *
+ * Makes printError save error messages in memory, without printing or
+ * counting them, until release_errors is called.
+ */
+void hold_errors(void)
+{
+    holding = 1;
+}
+
+/**
+ * char * release_errors(void)
+ *
+ * Stops holding error messages.  Returns the messages held since the
+ * call to hold_errors as a single dynamically allocated string, which
+ * the caller is responsible for freeing, or NULL if no messages were
+ * held.
+ */
+char * release_errors(void)
+{
+    char * messages = heldErrors;
+
+    holding = 0;
+    heldErrors = NULL;
+    heldLength = heldCapacity = 0;
+    heldCount = 0;
+    return messages;
+}
+
+/**
+ * int errors_are_held(void)
+ *
+ * Returns 1 if the calling thread is holding error messages (see
+ * hold_errors); 0 otherwise.
+ */
+int errors_are_held(void)
+{
+    return holding;
+}
+
+/**
+ * int held_error_count(void)
+ *
+ * Returns the number of error messages the calling thread has held
+ * since it called hold_errors.
+ */
+int held_error_count(void)
+{
+    return heldCount;
+}
+
+/*
+ * Appends one formatted message to the held error messages.
+ */
+static void holdError(const char * restrict_format, va_list ap)
+{
+    va_list copy;
+    int     length;
+    char *  newBuffer;
+
+    va_copy(copy, ap);
+    length = vsnprintf(NULL, 0, restrict_format, copy);
+    va_end(copy);
+    if ( length <= 0 )
+        return;
+    heldCount++;
+
+    /* Grow the buffer if the message (plus its null byte) doesn't fit. */
+    if ( heldLength + length + 1 > heldCapacity )
+    {
+        size_t newCapacity = heldCapacity ? heldCapacity * 2 : 128;
+        while ( heldLength + length + 1 > newCapacity )
+            newCapacity *= 2;
+        if ( (newBuffer = realloc(heldErrors, newCapacity)) == NULL )
+        {
+            /* Can't save it; print it now rather than lose it. */
+            (void) vfprintf(stderr, restrict_format, ap);
+            return;
+        }
+        heldErrors = newBuffer;
+        heldCapacity = newCapacity;
+    }
+
+    (void) vsnprintf(heldErrors + heldLength, length + 1, restrict_format, ap);
+    heldLength += length;
+}
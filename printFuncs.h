@@ -12,6 +12,19 @@
  *      to change the number of errors that get printed before the
  *      programs stops execution.
  *
+ * hold_errors makes printError save error messages in memory instead
+ *      of printing them.  Held messages are not counted toward
+ *      ERROR_LIMIT.  Holding applies only to the calling thread.
+ *
+ * release_errors stops holding error messages and returns the messages
+ *      held since the call to hold_errors as one dynamically allocated
+ *      string (which the caller should free), or NULL if there were
+ *      none.  The caller can report them later with printError("%s", ...).
+ *
+ * errors_are_held returns 1 if the calling thread is holding error
+ *      messages, and held_error_count returns how many it has held
+ *      since it called hold_errors.
+ *
  * printDebug will print a debugging message to stdout, but only if
  *      debugging has been turned on.
  *      printDebug takes a variable number of arguments, the first of
@@ -42,12 +55,20 @@
  * override_debug_changes "freezes" the debugging state in its current
  *      state, whether on or off, nulling the effect of any future calls
  *      to debug_on, debug_off, or debug_restore.
+ *
+ * The debugging state is kept separately for each thread; a new thread
+ *      starts with debugging off.
  */
 
 void printError(const char * restrict_format, ...);
 
 extern int ERROR_LIMIT;
 
+void hold_errors(void);
+char * release_errors(void);
+int errors_are_held(void);
+int held_error_count(void);
+
 void printDebug(const char * restrict_format, ...);
 
 void debug_on(void);
@@ -6,10 +6,57 @@
  * encounters a fatal error.
  *
  * Usage:
- *      programName  [filename] [0|1]
+ *      programName  [options] [-j N] [-f format | -c] [filename] [0|1]
+ *      programName  [options] [-j N] [-f format | -c] -o dir filename...
  * If both a filename and a debugging choice are provided, they may
  * be in either order.
  *
+ * Options start with "--" and may appear anywhere on the command line.
+ * They are recorded in the global OPTIONS structure:
+ *      --one-pass      assemble the input in a single pass, resolving
+ *                      forward references by backpatching
+ *      --pipeline      like --one-pass, but read the input and write the
+ *                      output on their own threads, so that reading,
+ *                      assembling, and writing overlap
+ *      --stats         print the time taken by each phase and counts of
+ *                      lines, instructions, lookups, and output to
+ *                      stderr at exit (see stats.h)
+ *      --diag-format=text|json
+ *                      print the errors in the program as the usual
+ *                      messages (the default) or as JSON (see
+ *                      diagnostics.h)
+ *      --error-limit=N report at most N errors (the ERROR_LIMIT,
+ *                      20 by default); 0 means no limit
+ *      --incremental=FILE
+ *                      reassemble only what an edit has changed since
+ *                      the last assembly, whose state is kept in FILE
+ *                      (see incremental.h)
+ *      --cache=DIR     copy the output from the cache in directory DIR
+ *                      if the same input was assembled before with the
+ *                      same options, and add it otherwise (see cache.h)
+ *      --cache-size=MB the most the cache may take up, in megabytes
+ *                      (256 by default)
+ *      --serve=SOCKET  run as a daemon that assembles programs sent by
+ *                      asmclient on the Unix domain socket SOCKET, with
+ *                      -j worker threads (see server.h)
+ *
+ * The "-f format" option (which may also appear anywhere) chooses the
+ * output format, recorded in OPTIONS.format: ascii (the default),
+ * raw-be, raw-le, ihex, readmemh, or logisim (see outputFile.h).
+ * The "-c" option (which may also appear anywhere) sets OPTIONS.object,
+ * to write a relocatable object file instead of machine code in any
+ * format (see objectFile.h).
+ * The "-j N" option sets OPTIONS.jobs, the number of threads that
+ * encode instructions in parallel (1 to MAX_JOBS).
+ *
+ * The "-o dir" option assembles any number of files into the directory
+ * dir, recorded in OPTIONS.outputDir (see batch.h).  All the arguments
+ * left are then the files to assemble, recorded in OPTIONS.inputs,
+ * except that an argument "@list" stands for the files named in the
+ * file list, one per line (blank lines are skipped), and that a 0 or 1
+ * is still taken as the debugging choice.  process_arguments returns
+ * stdin without reading it.
+ *
  * The optional filename indicates the input file; if it is provided,
  * process_arguments opens the file and returns it after also processing
  * the debugging option.  If it is not provided, the program reads its
@@ -25,10 +72,31 @@
  * debug_off, and debug_restore functions.
  */
 
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "process_arguments.h"
 
 /* SAME is defined in disUtil.c and should be defined in other main files also. */
 
+/* Define the global OPTIONS variable. */
+AssemblerOptions OPTIONS;
+
+/* Largest number of threads that -j accepts. */
+#define MAX_JOBS 256
+
+static const char * USAGE =
+    "Usage:  %s [--one-pass] [--pipeline] [--stats]"
+    " [--diag-format=text|json] [--error-limit=N] [--incremental=FILE]"
+    " [--cache=DIR] [--cache-size=MB] [--serve=SOCKET]"
+    " [-j threads]"
+    " [-f ascii|raw-be|raw-le|ihex|readmemh|logisim | -c]"
+    " [filename | -o dir filename...] [0|1]\n";
+
+static int process_option(char * option);
+static int add_inputs(int argc, char * argv[]);
+
 FILE * process_arguments(int argc, char * argv[])
 {
     FILE * fptr;               /* file pointer */
@@ -55,6 +123,71 @@ FILE * process_arguments(int argc, char * argv[])
      *                         one argument, filename
      */
 
+    /* Process the options first and "erase" them by shifting the
+     * remaining arguments down, so that only the filename and debugging
+     * choice are left.
+     */
+    int i, nbrArgs = 1;
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strncmp(argv[i], "--", 2) == SAME )
+        {
+            if ( ! process_option(argv[i]) )
+            {
+                printError(USAGE, argv[0]);
+                return NULL;
+            }
+        }
+        else if ( strcmp(argv[i], "-j") == SAME )
+        {
+            if ( i + 1 >= argc ||
+                 (OPTIONS.jobs = atoi(argv[i + 1])) < 1 ||
+                 OPTIONS.jobs > MAX_JOBS )
+            {
+                printError(USAGE, argv[0]);
+                return NULL;
+            }
+            i++;
+        }
+        else if ( strcmp(argv[i], "-f") == SAME )
+        {
+            if ( i + 1 >= argc ||
+                 ! outputFormatNamed(argv[i + 1], &OPTIONS.format) )
+            {
+                printError(USAGE, argv[0]);
+                return NULL;
+            }
+            i++;
+        }
+        else if ( strcmp(argv[i], "-c") == SAME )
+            OPTIONS.object = 1;
+        else if ( strcmp(argv[i], "-o") == SAME )
+        {
+            if ( i + 1 >= argc || argv[i + 1][0] == '\0' )
+            {
+                printError(USAGE, argv[0]);
+                return NULL;
+            }
+            OPTIONS.outputDir = argv[++i];
+        }
+        else
+            argv[nbrArgs++] = argv[i];
+    }
+    argc = nbrArgs;
+
+    /* With -o, the arguments left are the files to assemble. */
+    if ( OPTIONS.outputDir != NULL )
+    {
+        if ( ! add_inputs(argc, argv) )
+            return NULL;    /* error message already printed */
+        if ( OPTIONS.nbrInputs == 0 )
+        {
+            printError(USAGE, argv[0]);
+            return NULL;
+        }
+        return stdin;
+    }
+
     /* Process debugging choice and then "erase" this argument by
      * shifting the filename into its place or just by reducing the
      * argument count, argc, whichever is appropriate (see above for details).
@@ -94,7 +227,7 @@ FILE * process_arguments(int argc, char * argv[])
      */
     if ( argc > 2 )
     {
-        printError("Usage:  %s [filename] [0|1]\n", argv[0]);
+        printError(USAGE, argv[0]);
         return 0;
     }
 
@@ -113,3 +246,153 @@ FILE * process_arguments(int argc, char * argv[])
 
     return fptr;   /* Everything was OK! */
 }
+
+/*
+ * Records one command-line option in OPTIONS.
+ * Returns 1 if the option is valid; 0 otherwise.
+ */
+static int process_option(char * option)
+{
+    char * end;
+    long   limit;
+    unsigned long long size;
+
+    if ( strcmp(option, "--one-pass") == SAME )
+        OPTIONS.onePass = 1;
+    else if ( strcmp(option, "--pipeline") == SAME )
+        OPTIONS.pipeline = OPTIONS.onePass = 1;
+    else if ( strcmp(option, "--stats") == SAME )
+    {
+        OPTIONS.stats = 1;
+        statsEnable();
+    }
+    else if ( strcmp(option, "--diag-format=text") == SAME )
+        OPTIONS.diagFormat = DIAG_TEXT;
+    else if ( strcmp(option, "--diag-format=json") == SAME )
+        OPTIONS.diagFormat = DIAG_JSON;
+    else if ( strncmp(option, "--incremental=", 14) == SAME &&
+              option[14] != '\0' )
+        OPTIONS.stateFile = option + 14;
+    else if ( strncmp(option, "--cache=", 8) == SAME && option[8] != '\0' )
+        OPTIONS.cacheDir = option + 8;
+    else if ( strncmp(option, "--serve=", 8) == SAME && option[8] != '\0' )
+        OPTIONS.serveSocket = option + 8;
+    else if ( strncmp(option, "--cache-size=", 13) == SAME )
+    {
+        size = strtoull(option + 13, &end, 10);
+        if ( end == option + 13 || *end != '\0' || size < 1 ||
+             size > SIZE_MAX >> 20 )
+            return 0;
+        OPTIONS.cacheSize = (size_t) size << 20;
+    }
+    else if ( strncmp(option, "--error-limit=", 14) == SAME )
+    {
+        limit = strtol(option + 14, &end, 10);
+        if ( end == option + 14 || *end != '\0' || limit < 0 ||
+             limit > 1000000000 )
+            return 0;
+        ERROR_LIMIT = (int) limit;
+    }
+    else
+        return 0;
+
+    return 1;
+}
+
+/*
+ * Records the files named by the arguments left after the options (but
+ * not the debugging choice, which it processes) in OPTIONS.inputs.
+ * Returns 1 if everything went OK; 0 (after printing an error) if a
+ * list of files could not be read or memory allocation error.
+ */
+static int add_inputs(int argc, char * argv[])
+{
+    int i;
+
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strcmp(argv[i], "0") == SAME )
+        {
+            debug_off();  override_debug_changes();
+        }
+        else if ( strcmp(argv[i], "1") == SAME )
+        {
+            debug_on();  override_debug_changes();
+        }
+        else if ( argv[i][0] == '@' )
+        {
+            if ( ! read_input_list(argv[i] + 1) )
+                return 0;
+        }
+        else if ( ! add_input(argv[i]) )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Adds filename to OPTIONS.inputs.
+ * Returns 1 if everything went OK; 0 (after printing an error) if
+ * memory allocation error.
+ */
+int add_input(char * filename)
+{
+    static int capacity = 0;
+    char **    inputs;
+
+    if ( OPTIONS.nbrInputs == capacity )
+    {
+        capacity = capacity > 0 ? capacity * 2 : 64;
+        inputs = realloc(OPTIONS.inputs, (size_t) capacity * sizeof(char *));
+        if ( inputs == NULL )
+        {
+            printError("Error: cannot allocate space in memory.\n");
+            return 0;
+        }
+        OPTIONS.inputs = inputs;
+    }
+    OPTIONS.inputs[OPTIONS.nbrInputs++] = filename;
+    return 1;
+}
+
+/*
+ * Adds the files named in the file listName, one per line, to
+ * OPTIONS.inputs.  Trailing white space is not part of a name, and
+ * blank lines are skipped.
+ * Returns 1 if everything went OK; 0 (after printing an error) if the
+ * list could not be read or memory allocation error.
+ */
+int read_input_list(const char * listName)
+{
+    FILE *  fptr;
+    char *  line = NULL;
+    size_t  size = 0;
+    ssize_t length;
+    int     ok = 1;
+
+    if ( (fptr = fopen(listName, "r")) == NULL )
+    {
+        printError("Error: Cannot open file %s.\n", listName);
+        return 0;
+    }
+    while ( ok && (length = getline(&line, &size, fptr)) >= 0 )
+    {
+        while ( length > 0 && isspace((unsigned char) line[length - 1]) )
+            line[--length] = '\0';
+        if ( length > 0 )
+        {
+            /* The name is kept until the program exits. */
+            ok = add_input(line);
+            line = NULL;
+            size = 0;
+        }
+    }
+    if ( ok && ferror(fptr) )
+    {
+        printError("Error: Cannot read file %s.\n", listName);
+        ok = 0;
+    }
+    free(line);
+    (void) fclose(fptr);
+    return ok;
+}
@@ -8,9 +8,54 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "diagnostics.h"
+#include "outputFile.h"
 #include "printFuncs.h"
 #include "same.h"
+#include "stats.h"
+
+/* Options that can be set on the command line (see process_arguments.c).
+ * OPTIONS holds the choices made by the most recent call to
+ * process_arguments; fields not set on the command line are 0.
+ */
+typedef struct {
+        int onePass;            /* --one-pass: read the input only once */
+        OutputFormat format;    /* -f: format of the machine code */
+        int object;             /* -c: write an object file instead (see
+                                 * objectFile.h) */
+        int jobs;               /* -j: threads encoding instructions */
+        int pipeline;           /* --pipeline: read, assemble, and write
+                                 * on separate threads (implies
+                                 * onePass) */
+        int stats;              /* --stats: report timing and counts */
+        DiagFormat diagFormat;  /* --diag-format: how errors are printed */
+        const char * stateFile; /* --incremental: the state of the last
+                                 * assembly (NULL: assemble it all) */
+        const char * cacheDir;  /* --cache: directory of cached outputs
+                                 * (NULL: no cache) */
+        size_t cacheSize;       /* --cache-size: most bytes the cache
+                                 * may take up */
+        const char * serveSocket; /* --serve: run as a daemon on this
+                                 * socket (NULL: assemble the input) */
+        const char * outputDir; /* -o: assemble the inputs into this
+                                 * directory (NULL: assemble one input
+                                 * to stdout) */
+        char ** inputs;         /* with -o, the files to assemble (the
+                                 * linker's objects, for the linker) */
+        int nbrInputs;
+} AssemblerOptions;
+
+extern AssemblerOptions OPTIONS;
 
 FILE * process_arguments(int argc, char * argv[]);
 
+/* add_input adds filename to OPTIONS.inputs, and read_input_list adds
+ * the files named in the file listName, one per line (as an argument
+ * "@listName" does with -o).  Each returns 1 if everything went OK; 0
+ * (after printing an error) if the list could not be read or memory
+ * allocation error.
+ */
+int add_input(char * filename);
+int read_input_list(const char * listName);
+
 #endif
@@ -0,0 +1,168 @@
+/*
+ * Request: assembling one program for a client of the assembler daemon
+ *
+ * This file provides the definitions of the functions declared in
+ * request.h.  An assembly runs pass1 and then encodes each instruction
+ * as pass2 does, but appends the words (and then those of the data
+ * segment) to the reply instead of writing them.  While it assembles,
+ * the calling thread collects its errors in a Diagnostics collector of
+ * its own, and holds any other messages (see hold_errors), which are the
+ * messages the assembler prints to stdout about duplicate labels;
+ * debugging is turned off.  The label table is allocated from an arena
+ * of the assembly's own.
+ *
+ */
+
+#include "assembler.h"
+#include "request.h"
+
+static int appendReply (Reply * reply, const void * data, size_t length);
+
+void replyInit (Reply * reply)
+{
+    reply->data = NULL;
+    reply->length = reply->capacity = 0;
+}
+
+void replyFree (Reply * reply)
+{
+    free (reply->data);
+    replyInit (reply);
+}
+
+int replyReserve (Reply * reply, size_t length)
+{
+    size_t capacity = reply->capacity > 0 ? reply->capacity : 4096;
+    char * data;
+
+    if ( length <= reply->capacity )
+        return 1;
+    while ( capacity < length )
+        capacity *= 2;
+    if ( (data = realloc (reply->data, capacity)) == NULL )
+        return 0;
+    reply->data = data;
+    reply->capacity = capacity;
+    return 1;
+}
+
+int assembleRequest (const RequestHeader * request, const char * text,
+                     Reply * reply)
+{
+    SourceFile        source;
+    InstructionList   program;
+    LabelTable        table;
+    Diagnostics       diagnostics;
+    Arena             arena;
+    Arena *           previousArena;
+    ReplyHeader       header;
+    EncodedWord       encoded;
+    const Instruction * inst;
+    char *            messages;
+    char *            errors = NULL;
+    size_t            errorsLength = 0;
+    FILE *            fp;
+    int               nbrErrors = 0;
+    int               ok;
+    int               i;
+    size_t            j;
+
+    memset (&header, 0, sizeof(header));
+    reply->length = sizeof(header);
+    ok = replyReserve (reply, sizeof(header));
+
+    /* Assemble, collecting the errors and holding the other messages. */
+    listInit (&program);
+    arenaInit (&arena, NULL);
+    previousArena = arenaUse (&arena);
+    diagInit (&diagnostics, request->errorLimit);
+    debug_off ();
+    hold_errors ();
+    diagCollect (&diagnostics);
+    sourceOpenText (&source, text, (size_t) request->length);
+    table = pass1 (&source, &program);
+    for ( i = 0; i < program.nbrInstructions && ok; i++ )
+    {
+        inst = &program.instructions[i];
+        if ( encodeInstruction (inst, table, &encoded.word, NULL) == ASM_OK )
+        {
+            encoded.address = (uint32_t) inst->address;
+            ok = appendReply (reply, &encoded, sizeof(encoded));
+            header.nbrWords++;
+        }
+    }
+    for ( j = 0; j < dataNbrWords (&program.data) && ok; j++ )
+    {
+        encoded.address = program.data.address + 4 * (uint32_t) j;
+        encoded.word = dataWord (&program.data, j);
+        ok = appendReply (reply, &encoded, sizeof(encoded));
+        header.nbrWords++;
+    }
+    diagCollect (NULL);
+    messages = release_errors ();
+    debug_restore ();
+    sourceClose (&source);
+    listFree (&program);
+    tableFree (&table);
+    (void) arenaUse (previousArena);
+    arenaFree (&arena);
+
+    /* Format the errors as the assembler would print them. */
+    if ( (fp = open_memstream (&errors, &errorsLength)) != NULL )
+    {
+        nbrErrors = diagPrint (&diagnostics, fp, request->diagFormat);
+        ok = fclose (fp) == 0 && ok;
+    }
+    else
+        ok = 0;
+    diagFree (&diagnostics);
+
+    header.magic = REPLY_MAGIC;
+    header.tooManyErrors = request->errorLimit > 0 &&
+                           nbrErrors > request->errorLimit;
+    header.messagesLength = messages != NULL ? strlen (messages) : 0;
+    header.errorsLength = errorsLength;
+    ok = ok && appendReply (reply, messages, header.messagesLength) &&
+         appendReply (reply, errors, errorsLength);
+    if ( ok )
+        memcpy (reply->data, &header, sizeof(header));
+    free (messages);
+    free (errors);
+    return ok;
+}
+
+int replyIsValid (const Reply * reply)
+{
+    ReplyHeader header;
+
+    if ( reply->length < sizeof(header) )
+        return 0;
+    memcpy (&header, reply->data, sizeof(header));
+    return header.magic == REPLY_MAGIC &&
+           replyLength (&header) == reply->length;
+}
+
+size_t replyLength (const ReplyHeader * header)
+{
+    if ( header->nbrWords > MAX_REQUEST_LENGTH ||
+         header->messagesLength > MAX_REQUEST_LENGTH ||
+         header->errorsLength > MAX_REQUEST_LENGTH )
+        return 0;
+    return sizeof(ReplyHeader) + header->nbrWords * sizeof(EncodedWord) +
+           header->messagesLength + header->errorsLength;
+}
+
+/*
+ * Adds length bytes of data to the end of reply.
+ * Returns 1 if everything went OK; 0 if memory allocation error.
+ */
+static int appendReply (Reply * reply, const void * data, size_t length)
+{
+    if ( length == 0 )
+        return 1;
+    if ( ! replyReserve (reply, reply->length + length) )
+        return 0;
+    memcpy (reply->data + reply->length, data, length);
+    reply->length += length;
+    return 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Request: assembling one program for a client of the assembler daemon
+ *
+ * A client (asmclient) sends the daemon (assembler --serve=SOCKET, see
+ * server.h) a request: a RequestHeader followed by the text of the
+ * program.  The daemon assembles it with assembleRequest and sends back
+ * a reply, which holds everything the client needs to print exactly
+ * what the assembler would have printed: a ReplyHeader, followed by
+ *      - the machine words encoded (an EncodedWord for each, in order
+ *        of address), which the client writes in its output format
+ *      - the messages the assembler prints to stdout (duplicate labels)
+ *      - the errors, as the assembler prints them to stderr (as text or
+ *        JSON, with the request's error limit; see diagnostics.h)
+ * The program is assembled as by pass1 and pass2.
+ *
+ * Requests and replies are sent in the byte order of the machine, since
+ * the client and the daemon run on the same machine.  A client that
+ * cannot reach the daemon calls assembleRequest itself.
+ *
+ */
+
+#ifndef _REQUEST_H
+#define _REQUEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REQUEST_MAGIC   0x51534d41u     /* "ASMQ" */
+#define REPLY_MAGIC     0x52534d41u     /* "ASMR" */
+
+/* Largest program the daemon accepts, in bytes. */
+#define MAX_REQUEST_LENGTH ((uint64_t) 1 << 30)
+
+typedef struct {
+        uint32_t magic;         /* REQUEST_MAGIC */
+        int32_t  errorLimit;    /* as ERROR_LIMIT */
+        int32_t  diagFormat;    /* a DiagFormat */
+        uint32_t reserved;      /* 0 */
+        uint64_t length;        /* bytes of program text that follow */
+} RequestHeader;
+
+typedef struct {
+        uint32_t magic;         /* REPLY_MAGIC */
+        int32_t  tooManyErrors; /* 1 if more errors than the limit */
+        uint64_t nbrWords;      /* number of EncodedWords */
+        uint64_t messagesLength;
+        uint64_t errorsLength;
+} ReplyHeader;
+
+typedef struct {
+        uint32_t address;
+        uint32_t word;
+} EncodedWord;
+
+/* A reply being built or received. */
+typedef struct {
+        char * data;            /* the ReplyHeader and what follows */
+        size_t length;
+        size_t capacity;
+} Reply;
+
+void replyInit (Reply * reply);
+        /* Postcondition: reply is empty. */
+
+void replyFree (Reply * reply);
+        /* Postcondition: the memory of reply has been released and it is
+         *      empty.
+         */
+
+int replyReserve (Reply * reply, size_t length);
+        /* Postcondition: reply has room for length bytes.
+         * Returns 1 if everything went OK; 0 if memory allocation error.
+         */
+
+int assembleRequest (const RequestHeader * request, const char * text,
+                     Reply * reply);
+        /* Assembles the request->length characters of text, using the
+         *      calling thread's error and debugging state (so that any
+         *      number of threads can assemble at once).
+         * Postcondition: reply holds the reply to the request.
+         * Returns 1 if everything went OK; 0 if memory allocation error.
+         */
+
+int replyIsValid (const Reply * reply);
+        /* Returns 1 if reply holds a complete reply; 0 otherwise. */
+
+size_t replyLength (const ReplyHeader * header);
+        /* Returns the length of the reply that starts with header, or 0
+         *      if it is too long to be a reply.
+         */
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * Scanner: finding the tokens of a line many characters at a time
+ *
+ * This file provides the definitions of the functions declared in
+ * scanner.h.  The text is scanned in chunks of CHUNK characters; each
+ * chunk is classified into Masks by the classifier in use, and the
+ * tokens are then found by shifting the masks and counting trailing
+ * zeros.  A token that goes on past the end of a chunk is finished in
+ * the next one.
+ *
+ * The vector classifiers always read a whole chunk.  At the end of the
+ * text that may be past the last character, which is harmless as long
+ * as the chunk does not cross into the next page of memory (memory is
+ * only ever mapped a page at a time), and the bits for those characters
+ * are cleared afterwards.  A short chunk that would cross into the next
+ * page is copied first.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define VECTOR_SCAN     1
+#endif
+
+#include "scanner.h"
+
+/* Characters classified at a time: one bit of a mask each. */
+#define CHUNK           64
+
+/* Smallest size of a page of memory. */
+#define PAGE_SIZE       4096
+
+/* The classes of a character, in CLASSES. */
+#define SPACE           1       /* whitespace */
+#define STOP            2       /* ends a token */
+
+typedef struct {
+        uint64_t spaces;        /* bit i: character i is whitespace */
+        uint64_t stops;         /* bit i: character i ends a token */
+} Masks;
+
+/* Classifies the first length characters of text (all CHUNK of them, for
+ * a vector classifier); the bits for the others are undefined.
+ */
+typedef void (*Classifier) (const char * text, size_t length, Masks * masks);
+
+static const unsigned char CLASSES[256] = {
+        ['\t'] = SPACE | STOP,  ['\n'] = SPACE | STOP,
+        ['\v'] = SPACE | STOP,  ['\f'] = SPACE | STOP,
+        ['\r'] = SPACE | STOP,  [' '] = SPACE | STOP,
+        [','] = STOP,           [':'] = STOP,
+        ['('] = STOP,           [')'] = STOP
+};
+
+static void classifyScalar (const char * text, size_t length, Masks * masks);
+#ifdef VECTOR_SCAN
+static void classifySSE2 (const char * text, size_t length, Masks * masks);
+static void classifyAVX2 (const char * text, size_t length, Masks * masks);
+static void chooseMethod (void);
+#endif
+static void classifyChunk (const char * text, size_t length, Masks * masks);
+
+/* The classifier in use, and its method (see scanUse). */
+static Classifier classify = classifyScalar;
+static ScanMethod method = SCAN_SCALAR;
+
+int scanTokens (Span text, Span tokens[], int maxTokens)
+{
+    size_t   length = (size_t) text.length;
+    size_t   base, n;
+    size_t   from = 0;          /* where the search goes on */
+    size_t   begin = 0, end;    /* of the token being found */
+    int      inToken = 0;
+    int      count = 0;
+    uint64_t found;
+    Masks    masks;
+
+    for ( base = 0; base < length; base += n, from = base )
+    {
+        n = length - base < CHUNK ? length - base : CHUNK;
+        classifyChunk(text.text + base, n, &masks);
+
+        while ( from < base + n )
+        {
+            if ( ! inToken )
+            {
+                /* Skip the whitespace before the next token. */
+                if ( (found = ~masks.spaces >> (from - base)) == 0 )
+                    break;
+                begin = from + (size_t) __builtin_ctzll(found);
+                inToken = 1;
+                from = begin + 1;
+                continue;
+            }
+
+            /* Find the end of the token. */
+            if ( (found = masks.stops >> (from - base)) == 0 )
+                break;
+            end = from + (size_t) __builtin_ctzll(found);
+            if ( count < maxTokens )
+            {
+                tokens[count].text = text.text + begin;
+                tokens[count].length = (int) (end - begin);
+            }
+            if ( ++count > maxTokens )
+                return count;
+            inToken = 0;
+            from = end + 1;
+        }
+    }
+
+    /* A token that goes on to the end of the text. */
+    if ( inToken )
+    {
+        if ( count < maxTokens )
+        {
+            tokens[count].text = text.text + begin;
+            tokens[count].length = (int) (length - begin);
+        }
+        count++;
+    }
+    return count;
+}
+
+int scanUse (ScanMethod newMethod)
+{
+    switch ( newMethod )
+    {
+      case SCAN_SCALAR:
+        classify = classifyScalar;
+        break;
+#ifdef VECTOR_SCAN
+      case SCAN_SSE2:
+        classify = classifySSE2;
+        break;
+      case SCAN_AVX2:
+        __builtin_cpu_init();
+        if ( ! __builtin_cpu_supports("avx2") )
+            return 0;
+        classify = classifyAVX2;
+        break;
+#endif
+      default:
+        return 0;
+    }
+    method = newMethod;
+    return 1;
+}
+
+ScanMethod scanInUse (void)
+{
+    return method;
+}
+
+/*
+ * Classifies the length (at most CHUNK) characters of text into masks,
+ * with the classifier in use; the bits after the end of the text are
+ * neither whitespace nor the end of a token.
+ */
+static void classifyChunk (const char * text, size_t length, Masks * masks)
+{
+    char     copy[CHUNK];
+    uint64_t beyond;
+
+    if ( length < CHUNK && classify != classifyScalar &&
+         ((uintptr_t) text & (PAGE_SIZE - 1)) > PAGE_SIZE - CHUNK )
+    {
+        memcpy(copy, text, length);
+        memset(copy + length, 0, CHUNK - length);
+        text = copy;
+    }
+    classify(text, length, masks);
+
+    /* Whitespace, so that it has no tokens, and no stops. */
+    beyond = length < CHUNK ? ~(uint64_t) 0 << length : 0;
+    masks->spaces |= beyond;
+    masks->stops &= ~beyond;
+}
+
+static void classifyScalar (const char * text, size_t length, Masks * masks)
+{
+    const unsigned char * next = (const unsigned char *) text;
+    uint64_t              bit;
+    size_t                i;
+    unsigned              class;
+
+    masks->spaces = masks->stops = 0;
+    for ( i = 0; i < length; i++ )
+    {
+        class = CLASSES[next[i]];
+        bit = (uint64_t) 1 << i;
+        if ( class & SPACE )
+            masks->spaces |= bit;
+        if ( class & STOP )
+            masks->stops |= bit;
+    }
+}
+
+#ifdef VECTOR_SCAN
+
+/*
+ * Classifies 16 characters at a time.  Whitespace is a space or a
+ * character from tab to carriage return; "(" and ")" differ only in the
+ * lowest bit.  (The reads may go past the end of the text: see the top
+ * of this file.)
+ */
+__attribute__((no_sanitize_address))
+static void classifySSE2 (const char * text, size_t length, Masks * masks)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i parenthesis = _mm_set1_epi8('(' | 1);
+    const __m128i lowBit = _mm_set1_epi8(1);
+    __m128i       x, spaces, stops;
+    size_t        i;
+
+    (void) length;
+    masks->spaces = masks->stops = 0;
+    for ( i = 0; i < CHUNK; i += 16 )
+    {
+        x = _mm_loadu_si128((const __m128i *) (text + i));
+        spaces = _mm_or_si128(_mm_cmpeq_epi8(x, space),
+                   _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, tab), x),
+                     _mm_cmpeq_epi8(_mm_min_epu8(x, carriageReturn), x)));
+        stops = _mm_or_si128(spaces,
+                  _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, comma),
+                                            _mm_cmpeq_epi8(x, colon)),
+                    _mm_cmpeq_epi8(_mm_or_si128(x, lowBit), parenthesis)));
+        masks->spaces |= (uint64_t) (uint16_t) _mm_movemask_epi8(spaces) << i;
+        masks->stops |= (uint64_t) (uint16_t) _mm_movemask_epi8(stops) << i;
+    }
+}
+
+/*
+ * Classifies 32 characters at a time, as classifySSE2 does.
+ */
+__attribute__((target("avx2"), no_sanitize_address))
+static void classifyAVX2 (const char * text, size_t length, Masks * masks)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i parenthesis = _mm256_set1_epi8('(' | 1);
+    const __m256i lowBit = _mm256_set1_epi8(1);
+    __m256i       x, spaces, stops;
+    size_t        i;
+
+    (void) length;
+    masks->spaces = masks->stops = 0;
+    for ( i = 0; i < CHUNK; i += 32 )
+    {
+        x = _mm256_loadu_si256((const __m256i *) (text + i));
+        spaces = _mm256_or_si256(_mm256_cmpeq_epi8(x, space),
+                   _mm256_and_si256(
+                     _mm256_cmpeq_epi8(_mm256_max_epu8(x, tab), x),
+                     _mm256_cmpeq_epi8(_mm256_min_epu8(x, carriageReturn),
+                                       x)));
+        stops = _mm256_or_si256(spaces,
+                  _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x, comma),
+                                    _mm256_cmpeq_epi8(x, colon)),
+                    _mm256_cmpeq_epi8(_mm256_or_si256(x, lowBit),
+                                      parenthesis)));
+        masks->spaces |=
+            (uint64_t) (uint32_t) _mm256_movemask_epi8(spaces) << i;
+        masks->stops |=
+            (uint64_t) (uint32_t) _mm256_movemask_epi8(stops) << i;
+    }
+}
+
+/*
+ * Chooses the fastest method this processor has, before main starts.
+ */
+__attribute__((constructor))
+static void chooseMethod (void)
+{
+    if ( ! scanUse(SCAN_AVX2) )
+        (void) scanUse(SCAN_SSE2);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Scanner: finding the tokens of a line many characters at a time
+ *
+ * getSpanToken finds a token by looking at one character after another,
+ * asking of each whether it is whitespace and then whether it ends the
+ * token.  scanTokens finds the same tokens, but looks at the text 64
+ * characters at a time: it first classifies them all at once into two
+ * bit masks, one bit per character (whitespace, and the characters that
+ * end a token: whitespace, comma, colon, and parentheses), and then
+ * finds the start and end of each token with a bit scan.  A line is
+ * almost always shorter than 64 characters, so the classes of a whole
+ * line are found in one step, and all its tokens are read off the masks.
+ *
+ * The classes are found with SSE2 (16 characters per instruction) or,
+ * on processors that have it, AVX2 (32 characters per instruction);
+ * which one is chosen when the program starts.  On other processors
+ * they are found one character at a time with a table, which gives
+ * exactly the same masks.  Whitespace is what isspace means in the "C"
+ * locale (space, tab, newline, vertical tab, form feed, carriage
+ * return), whatever the locale.
+ *
+ * parseLine (see sourceFile.h) and getNSpanTokens use scanTokens; the
+ * search for the end of a line and for a comment is left to memchr,
+ * which the C library already does many characters at a time.
+ *
+ */
+
+#ifndef _SCANNER_H
+#define _SCANNER_H
+
+#include "getToken.h"
+
+/* The ways the scanner can classify characters. */
+typedef enum {
+        SCAN_SCALAR,            /* one at a time, with a table */
+        SCAN_SSE2,              /* 16 at a time */
+        SCAN_AVX2               /* 32 at a time */
+} ScanMethod;
+
+int scanTokens (Span text, Span tokens[], int maxTokens);
+        /* Precondition: text.text is a valid pointer to text.length
+         *      characters, and tokens has room for maxTokens spans.
+         * Postcondition: tokens holds the first maxTokens tokens of text
+         *      (or all of them if there are fewer), found as getSpanToken
+         *      finds them one after another, each search starting after
+         *      the character that ended the token before.
+         * Returns the number of tokens in text, counting no further than
+         *      maxTokens + 1.
+         */
+
+int scanUse (ScanMethod method);
+        /* Postcondition: if this processor can use method, scanTokens
+         *      classifies characters with it from now on.  (Meant for
+         *      tests comparing the methods; not to be called while
+         *      another thread is scanning.)
+         * Returns 1 if method is now in use; 0 if it cannot be used.
+         */
+
+ScanMethod scanInUse (void);
+        /* Returns the method scanTokens is using. */
+
+#endif
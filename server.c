@@ -0,0 +1,611 @@
+/*
+ * Server: the assembler as a daemon, serving requests on a socket
+ *
+ * This file provides the definition of the serve function declared in
+ * server.h.  Every file descriptor the event thread waits on is in one
+ * epoll set: the listening socket, the connections that are reading a
+ * request or writing a reply, an eventfd that the workers signal when a
+ * reply is ready, and a signalfd that receives SIGINT, SIGTERM, and
+ * SIGUSR1 (which are blocked in every thread, so they are only received
+ * there).  A connection whose request is being assembled is taken out
+ * of the set until its reply is ready, so that a client that hangs up
+ * meanwhile does not wake the event thread over and over.
+ *
+ * Connections are only created, read, written, and freed by the event
+ * thread; a worker only has a connection between taking its request from
+ * the pending queue and putting it on the finished queue, both of which
+ * are protected by the queue's lock.
+ *
+ */
+
+#define _GNU_SOURCE     /* accept4 */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "printFuncs.h"
+#include "request.h"
+#include "server.h"
+
+/* Most events handled per epoll_wait, and most worker threads. */
+#define MAX_EVENTS      64
+#define MAX_WORKERS     256
+
+/* Number of recent requests whose latency is kept. */
+#define LATENCY_SAMPLES 65536
+
+typedef enum {
+        READING,                /* reading a request */
+        WORKING,                /* the request is being assembled */
+        WRITING                 /* writing the reply */
+} ConnectionState;
+
+typedef struct Connection {
+        int           fd;
+        int           state;        /* a ConnectionState */
+        int           watched;      /* 1 if fd is in the epoll set */
+        int           failed;       /* 1 if the request could not be
+                                     * assembled */
+        RequestHeader header;
+        size_t        received;     /* bytes of the request so far */
+        char *        text;         /* the program in the request */
+        size_t        textCapacity;
+        Reply         reply;
+        size_t        sent;         /* bytes of the reply so far */
+        double        started;      /* when the request started coming */
+        struct Connection * next;   /* in the pending or finished queue */
+        struct Connection * previousOpen, * nextOpen;
+                                    /* in the list of open connections */
+} Connection;
+
+/* The queues between the event thread and the workers. */
+typedef struct {
+        Connection *    pending;        /* requests to assemble */
+        Connection *    pendingTail;
+        Connection *    finished;       /* replies ready to be sent */
+        int             stopping;       /* 1 when the workers must stop */
+        int             eventFd;        /* signalled when a reply is ready */
+        pthread_mutex_t lock;
+        pthread_cond_t  requestReady;
+} WorkQueue;
+
+/* The state of the event thread. */
+typedef struct {
+        int          epollFd;
+        WorkQueue    queue;
+        Connection * open;              /* all the open connections */
+        double *     latencies;         /* the most recent latencies, in
+                                         * seconds (a ring) */
+        unsigned long nbrServed;        /* requests served */
+} Server;
+
+/* What the special file descriptors are in the epoll set. */
+static char LISTENER, REPLIES, SIGNALS;
+
+static const char * ERROR_START =
+    "Error: cannot serve on %s: %s.\n";
+static const char * ERROR_IN_USE =
+    "Error: another assembler is already serving on %s.\n";
+
+static int    openSocket (const char * socketPath);
+static int    watch (Server * server, int fd, void * data, uint32_t events);
+static void   acceptConnections (Server * server, int listenFd);
+static void   readRequest (Server * server, Connection * connection);
+static void   sendReply (Server * server, Connection * connection);
+static void   setWatched (Server * server, Connection * connection,
+                          uint32_t events);
+static void   closeConnection (Server * server, Connection * connection);
+static void * workOnRequests (void * queue);
+static void   printLatency (const Server * server);
+static int    compareLatencies (const void * a, const void * b);
+static double now (void);
+
+int serve (const char * socketPath, int nbrWorkers)
+{
+    Server                  server;
+    struct epoll_event      events[MAX_EVENTS];
+    struct signalfd_siginfo info;
+    pthread_t               workers[MAX_WORKERS];
+    sigset_t                signals;
+    uint64_t                count;
+    Connection *            connection;
+    int                     listenFd, signalFd = -1;
+    int                     nbrStarted = 0, running = 1;
+    int                     n, i;
+
+    if ( nbrWorkers <= 0 )
+        nbrWorkers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if ( nbrWorkers < 1 )
+        nbrWorkers = 1;
+    if ( nbrWorkers > MAX_WORKERS )
+        nbrWorkers = MAX_WORKERS;
+
+    memset(&server, 0, sizeof(server));
+    server.epollFd = server.queue.eventFd = -1;
+    pthread_mutex_init(&server.queue.lock, NULL);
+    pthread_cond_init(&server.queue.requestReady, NULL);
+    if ( (listenFd = openSocket(socketPath)) < 0 )
+        return 1;   /* error message already printed */
+
+    /* Receive the signals that stop the daemon through a signalfd;
+     * blocking them first means the workers inherit the mask.
+     */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    if ( pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0 ||
+         (signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC))
+             < 0 ||
+         (server.queue.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+             < 0 ||
+         (server.epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+         (server.latencies = malloc(LATENCY_SAMPLES * sizeof(double)))
+             == NULL ||
+         ! watch(&server, listenFd, &LISTENER, EPOLLIN) ||
+         ! watch(&server, server.queue.eventFd, &REPLIES, EPOLLIN) ||
+         ! watch(&server, signalFd, &SIGNALS, EPOLLIN) )
+    {
+        printError(ERROR_START, socketPath, strerror(errno));
+        running = 0;
+    }
+    for ( i = 0; running && i < nbrWorkers; i++ )
+    {
+        if ( pthread_create(&workers[i], NULL, workOnRequests,
+                            &server.queue) != 0 )
+            break;
+        nbrStarted++;
+    }
+    if ( running && nbrStarted == 0 )
+    {
+        printError("Error: cannot start the worker threads.\n");
+        running = 0;
+    }
+    if ( running )
+        fprintf(stderr, "Serving on %s with %d workers.\n", socketPath,
+                nbrStarted);
+
+    while ( running )
+    {
+        if ( (n = epoll_wait(server.epollFd, events, MAX_EVENTS, -1)) < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            break;
+        }
+        for ( i = 0; i < n; i++ )
+        {
+            if ( events[i].data.ptr == &LISTENER )
+                acceptConnections(&server, listenFd);
+            else if ( events[i].data.ptr == &REPLIES )
+            {
+                /* Send the replies the workers have finished. */
+                (void) read(server.queue.eventFd, &count, sizeof(count));
+                pthread_mutex_lock(&server.queue.lock);
+                connection = server.queue.finished;
+                server.queue.finished = NULL;
+                pthread_mutex_unlock(&server.queue.lock);
+                while ( connection != NULL )
+                {
+                    Connection * next = connection->next;
+
+                    sendReply(&server, connection);
+                    connection = next;
+                }
+            }
+            else if ( events[i].data.ptr == &SIGNALS )
+            {
+                while ( read(signalFd, &info, sizeof(info))
+                        == (ssize_t) sizeof(info) )
+                {
+                    if ( info.ssi_signo == SIGUSR1 )
+                        printLatency(&server);
+                    else
+                        running = 0;
+                }
+            }
+            else
+            {
+                connection = events[i].data.ptr;
+                if ( connection->state == READING )
+                    readRequest(&server, connection);
+                else if ( connection->state == WRITING )
+                    sendReply(&server, connection);
+            }
+        }
+    }
+
+    /* Stop the workers (requests not started are dropped), and close
+     * every connection.
+     */
+    pthread_mutex_lock(&server.queue.lock);
+    server.queue.stopping = 1;
+    pthread_cond_broadcast(&server.queue.requestReady);
+    pthread_mutex_unlock(&server.queue.lock);
+    for ( i = 0; i < nbrStarted; i++ )
+        pthread_join(workers[i], NULL);
+    while ( server.open != NULL )
+        closeConnection(&server, server.open);
+
+    (void) close(listenFd);
+    (void) unlink(socketPath);
+    if ( signalFd >= 0 )
+        (void) close(signalFd);
+    if ( server.queue.eventFd >= 0 )
+        (void) close(server.queue.eventFd);
+    if ( server.epollFd >= 0 )
+        (void) close(server.epollFd);
+    if ( server.latencies != NULL )
+        printLatency(&server);
+    free(server.latencies);
+    pthread_mutex_destroy(&server.queue.lock);
+    pthread_cond_destroy(&server.queue.requestReady);
+    return nbrStarted > 0 ? 0 : 1;
+}
+
+/*
+ * Creates the listening socket at socketPath.  A socket file left by a
+ * daemon that is no longer running is replaced.
+ * Returns the socket; -1 (after printing an error) if it could not be
+ * created.
+ */
+static int openSocket (const char * socketPath)
+{
+    struct sockaddr_un address;
+    int                fd, probe, inUse, bound;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if ( strlen(socketPath) >= sizeof(address.sun_path) )
+    {
+        printError(ERROR_START, socketPath, "the name is too long");
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      0)) < 0 )
+    {
+        printError(ERROR_START, socketPath, strerror(errno));
+        return -1;
+    }
+    bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+    if ( ! bound && errno == EADDRINUSE )
+    {
+        /* Replace the socket file, unless a daemon still answers on it. */
+        inUse = (probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0
+                && connect(probe, (struct sockaddr *) &address,
+                           sizeof(address)) == 0;
+        if ( probe >= 0 )
+            (void) close(probe);
+        if ( inUse )
+        {
+            printError(ERROR_IN_USE, socketPath);
+            (void) close(fd);
+            return -1;
+        }
+        (void) unlink(socketPath);
+        bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+    }
+    if ( ! bound || listen(fd, SOMAXCONN) != 0 )
+    {
+        printError(ERROR_START, socketPath, strerror(errno));
+        (void) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Adds fd to the epoll set, to wait for the given events.
+ * Returns 1 if everything went OK; 0 otherwise.
+ */
+static int watch (Server * server, int fd, void * data, uint32_t events)
+{
+    struct epoll_event event;
+
+    event.events = events;
+    event.data.ptr = data;
+    return epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+/* Accepts every connection waiting on the listening socket. */
+static void acceptConnections (Server * server, int listenFd)
+{
+    Connection * connection;
+    int          fd;
+
+    while ( (fd = accept4(listenFd, NULL, NULL,
+                          SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0 )
+    {
+        if ( (connection = calloc(1, sizeof(Connection))) == NULL )
+        {
+            (void) close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->state = READING;
+        replyInit(&connection->reply);
+        connection->nextOpen = server->open;
+        if ( server->open != NULL )
+            server->open->previousOpen = connection;
+        server->open = connection;
+        setWatched(server, connection, EPOLLIN);
+        if ( ! connection->watched )
+            closeConnection(server, connection);
+    }
+}
+
+/*
+ * Reads as much of the connection's request as has arrived, and hands
+ * the request to the workers once it is complete.  The connection is
+ * closed if the client has hung up or sent something that is not a
+ * request.
+ */
+static void readRequest (Server * server, Connection * connection)
+{
+    const size_t headerSize = sizeof(RequestHeader);
+    size_t       wanted;
+    char *       into;
+    ssize_t      n;
+
+    for ( ;; )
+    {
+        if ( connection->received < headerSize )
+        {
+            into = (char *) &connection->header + connection->received;
+            wanted = headerSize - connection->received;
+        }
+        else
+        {
+            into = connection->text + (connection->received - headerSize);
+            wanted = headerSize + connection->header.length
+                     - connection->received;
+        }
+
+        if ( wanted > 0 )
+        {
+            if ( (n = recv(connection->fd, into, wanted, 0)) < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                if ( errno != EAGAIN && errno != EWOULDBLOCK )
+                    closeConnection(server, connection);
+                return;
+            }
+            if ( n == 0 )
+            {
+                closeConnection(server, connection);    /* hung up */
+                return;
+            }
+            if ( connection->received == 0 )
+                connection->started = now();
+            connection->received += (size_t) n;
+            if ( connection->received < headerSize )
+                continue;
+        }
+
+        /* Header reads stop at its end, so received is exactly
+         * headerSize once, when the header is complete: make room for
+         * the program.
+         */
+        if ( connection->received == headerSize && wanted > 0 )
+        {
+            if ( connection->header.magic != REQUEST_MAGIC ||
+                 connection->header.length > MAX_REQUEST_LENGTH )
+            {
+                closeConnection(server, connection);
+                return;
+            }
+            if ( connection->header.length + 1 > connection->textCapacity )
+            {
+                free(connection->text);
+                connection->textCapacity = connection->header.length + 1;
+                if ( (connection->text = malloc(connection->textCapacity))
+                     == NULL )
+                {
+                    connection->textCapacity = 0;
+                    closeConnection(server, connection);
+                    return;
+                }
+            }
+        }
+
+        if ( connection->received == headerSize + connection->header.length )
+        {
+            /* The request is complete: hand it to the workers. */
+            connection->state = WORKING;
+            setWatched(server, connection, 0);
+            connection->next = NULL;
+            pthread_mutex_lock(&server->queue.lock);
+            if ( server->queue.pending == NULL )
+                server->queue.pending = connection;
+            else
+                server->queue.pendingTail->next = connection;
+            server->queue.pendingTail = connection;
+            pthread_cond_signal(&server->queue.requestReady);
+            pthread_mutex_unlock(&server->queue.lock);
+            return;
+        }
+    }
+}
+
+/*
+ * Writes as much of the connection's reply as the socket takes.  Once
+ * it is all written, the latency of the request is recorded and the
+ * connection waits for the next request.
+ */
+static void sendReply (Server * server, Connection * connection)
+{
+    ssize_t n;
+
+    if ( connection->state == WORKING )
+    {
+        if ( connection->failed )
+        {
+            closeConnection(server, connection);
+            return;
+        }
+        connection->state = WRITING;
+        connection->sent = 0;
+    }
+
+    while ( connection->sent < connection->reply.length )
+    {
+        n = send(connection->fd, connection->reply.data + connection->sent,
+                 connection->reply.length - connection->sent, MSG_NOSIGNAL);
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+        {
+            setWatched(server, connection, EPOLLOUT);
+            if ( ! connection->watched )
+                closeConnection(server, connection);
+            return;
+        }
+        if ( n <= 0 )
+        {
+            closeConnection(server, connection);
+            return;
+        }
+        connection->sent += (size_t) n;
+    }
+
+    server->latencies[server->nbrServed++ % LATENCY_SAMPLES] =
+        now() - connection->started;
+    connection->state = READING;
+    connection->received = 0;
+    setWatched(server, connection, EPOLLIN);
+    if ( ! connection->watched )
+        closeConnection(server, connection);
+}
+
+/*
+ * Makes the epoll set wait for the given events on the connection (and
+ * takes it out of the set if events is 0).  connection->watched is 0
+ * afterwards if it is not in the set.
+ */
+static void setWatched (Server * server, Connection * connection,
+                        uint32_t events)
+{
+    struct epoll_event event;
+
+    event.events = events;
+    event.data.ptr = connection;
+    if ( events == 0 )
+    {
+        if ( connection->watched )
+            (void) epoll_ctl(server->epollFd, EPOLL_CTL_DEL, connection->fd,
+                             &event);
+        connection->watched = 0;
+    }
+    else
+        connection->watched =
+            epoll_ctl(server->epollFd,
+                      connection->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                      connection->fd, &event) == 0;
+}
+
+/* Closes the connection and releases its memory. */
+static void closeConnection (Server * server, Connection * connection)
+{
+    (void) close(connection->fd);   /* also takes it out of the set */
+    if ( connection->previousOpen != NULL )
+        connection->previousOpen->nextOpen = connection->nextOpen;
+    else
+        server->open = connection->nextOpen;
+    if ( connection->nextOpen != NULL )
+        connection->nextOpen->previousOpen = connection->previousOpen;
+    free(connection->text);
+    replyFree(&connection->reply);
+    free(connection);
+}
+
+/*
+ * The work of each worker thread: take the next request, assemble it,
+ * and pass the connection back to the event thread, until the daemon
+ * stops.
+ */
+static void * workOnRequests (void * arg)
+{
+    WorkQueue *  queue = arg;
+    Connection * connection;
+    uint64_t     one = 1;
+
+    for ( ;; )
+    {
+        pthread_mutex_lock(&queue->lock);
+        while ( queue->pending == NULL && ! queue->stopping )
+            pthread_cond_wait(&queue->requestReady, &queue->lock);
+        if ( queue->stopping )
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return NULL;
+        }
+        connection = queue->pending;
+        queue->pending = connection->next;
+        pthread_mutex_unlock(&queue->lock);
+
+        connection->failed = ! assembleRequest(&connection->header,
+                                               connection->text,
+                                               &connection->reply);
+
+        pthread_mutex_lock(&queue->lock);
+        connection->next = queue->finished;
+        queue->finished = connection;
+        pthread_mutex_unlock(&queue->lock);
+        (void) write(queue->eventFd, &one, sizeof(one));
+    }
+}
+
+/*
+ * Prints the number of requests served and the median and 99th
+ * percentile of the latency of the most recent ones to stderr.
+ */
+static void printLatency (const Server * server)
+{
+    size_t   n = server->nbrServed < LATENCY_SAMPLES
+                 ? (size_t) server->nbrServed : LATENCY_SAMPLES;
+    double * sorted;
+
+    if ( n == 0 || (sorted = malloc(n * sizeof(double))) == NULL )
+    {
+        fprintf(stderr, "Served %lu requests.\n", server->nbrServed);
+        return;
+    }
+    memcpy(sorted, server->latencies, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compareLatencies);
+    fprintf(stderr, "Served %lu requests; latency p50 %.1f us, p99 %.1f us"
+            " (of the last %lu).\n", server->nbrServed,
+            sorted[(n * 50 + 99) / 100 - 1] * 1e6,
+            sorted[(n * 99 + 99) / 100 - 1] * 1e6, (unsigned long) n);
+    free(sorted);
+}
+
+static int compareLatencies (const void * a, const void * b)
+{
+    double first = *(const double *) a;
+    double second = *(const double *) b;
+
+    return first < second ? -1 : first > second;
+}
+
+/* Returns the time on the monotonic clock, in seconds. */
+static double now (void)
+{
+    struct timespec time;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
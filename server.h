@@ -0,0 +1,37 @@
+/*
+ * Server: the assembler as a daemon, serving requests on a socket
+ *
+ * "assembler --serve=SOCKET" runs serve, which listens on the Unix
+ * domain socket SOCKET for clients (see asmclient.c) and assembles the
+ * programs they send (see request.h), so that assembling a small program
+ * costs a round trip to a running process rather than starting one.
+ *
+ * One thread waits for events on all the connections with epoll: it
+ * accepts connections, reads requests, and writes replies, without ever
+ * blocking on one client.  Each complete request is handed to a pool of
+ * worker threads, which assemble requests in parallel, each with its own
+ * error and debugging state; a worker hands its reply back to the event
+ * thread through a queue and an eventfd.  A client may send any number
+ * of requests on one connection, one after another.
+ *
+ * The daemon keeps the latency of its most recent requests (from the
+ * first byte of a request to the last byte of its reply) and prints the
+ * number of requests served and their median (p50) and 99th percentile
+ * (p99) latency to stderr when it receives SIGUSR1, and when it stops
+ * (on SIGINT or SIGTERM), after removing the socket.
+ *
+ */
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+int serve (const char * socketPath, int nbrWorkers);
+        /* Serves requests on the Unix domain socket socketPath with
+         *      nbrWorkers worker threads (one per processor if
+         *      nbrWorkers <= 0), until SIGINT or SIGTERM.
+         * Returns 0 when it stops; 1 (after printing an error) if it
+         *      could not start, e.g. because another daemon is using
+         *      socketPath.
+         */
+
+#endif
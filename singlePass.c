@@ -0,0 +1,379 @@
+/**
+ * LabelTable singlePass (SourceFile * source, OutputFile * output)
+ *      @param  source  the assembly source code (see sourceFile.h)
+ *      @param  output  where the machine code is written (see outputFile.h)
+ *      @return a newly-created table containing labels found in the
+ *              input file, each with the address of the instruction
+ *              containing it (assuming the first line of input
+ *              corresponds to address 0)
+ *
+ * The singlePass function assembles the input while reading it only
+ * once.  Each line's label, if any, is added to the label table and
+ * each instruction is encoded as soon as it is read.
+ *
+ * A branch or jump to a label that has not been defined yet is encoded
+ * with a zero label field and recorded as a fixup; when the label is
+ * defined, every fixup waiting for it is patched.  Labels that are never
+ * defined are reported when the end of the input is reached.
+ *
+ * Data directives are assembled into a data segment as they are read,
+ * as by pass1 (see dataSegment.h).  The data segment follows the text
+ * segment, so its labels are only defined, and its data written, at the
+ * end of the input.
+ *
+ * The machine code and error messages for each instruction are kept in
+ * an output queue and written in source order: everything up to the
+ * first instruction that is still waiting for a label is written right
+ * away, and the rest is written as soon as those fixups are resolved.
+ * The output is therefore the same as the output of pass1 and pass2,
+ * with one exception: duplicate label errors are reported where the
+ * duplicate is found, rather than before all other output.  They are
+ * printed to stdout (in the ascii format, see tableMessagesTo) while the
+ * machine code is still being written, so once it is longer than one
+ * output block, a message can come after part of it.  (Holding them to
+ * the end would not help: two passes print them first.)
+ * (Errors that are being collected, see diagnostics.h, go straight to
+ * the collector instead, which sorts them by line.)
+ *
+ */
+
+#include "assembler.h"
+#include "assemblerUtil.h"
+
+/* One instruction in the output queue. */
+typedef struct {
+    uint32_t word;          /* the encoded instruction */
+    int      PC;            /* the address of the instruction */
+    int      hasWord;       /* 0 if the instruction produced only errors */
+    int      pending;       /* 1 while waiting for a label to be defined */
+    char *   errors;        /* error messages to report first, or NULL */
+} Record;
+
+/* A fixup and the queued instruction it patches. */
+typedef struct {
+    Fixup fixup;            /* label, line, PC, and kind */
+    int   record;           /* position of the instruction in the queue */
+    int   next;             /* next fixup waiting for the same label; -1 */
+} PendingFixup;
+
+/* The state of the single pass, shared by the helper functions below. */
+typedef struct {
+    LabelTable     waiting;     /* undefined label -> its first fixup */
+    Record *       records;     /* the output queue */
+    int            nbrRecords;
+    int            recordCapacity;
+    int            nbrFlushed;  /* records already written */
+    PendingFixup * fixups;
+    int            nbrFixups;
+    int            fixupCapacity;
+    int            nbrPending;  /* fixups not resolved yet */
+    OutputFile *   output;      /* where the machine code is written */
+} SinglePassState;
+
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+static int growArray(void ** array, int * capacity, size_t elementSize);
+static int addFixup(SinglePassState * state, Fixup * fixup, int record);
+static void resolveFixups(SinglePassState * state, Span label, int address);
+static void flushRecords(SinglePassState * state);
+
+LabelTable singlePass (SourceFile * source, OutputFile * output)
+  /* returns a copy of the label table that was constructed */
+{
+    LabelTable table;              /* the table of labels & addresses */
+    SinglePassState state;         /* output queue and fixups */
+    int    lineNum;                /* line number */
+    int    PC;                     /* program counter */
+    Span   inst;                   /* the current line */
+    Span   label;                  /* label at start of line, if any */
+    Span   instrName;              /* instruction name (e.g., "add") */
+    Span   operands;               /* rest of the instruction */
+    Span   rest;                   /* the line after a directive's name */
+    size_t offset = 0;             /* offset of next line in source */
+    int    column;                 /* column of the instruction name */
+    int    isData;                 /* 1 if the line is a directive */
+    int    size;                   /* bytes of text the line takes up */
+    uint32_t dataOffset;           /* offset of the line's data */
+    DataSegment data;              /* the data segment */
+    Fixup  fixup;                  /* forward reference, if any */
+    Instruction parsed;            /* the current instruction, parsed */
+    int    nbrLabels;
+    int    status;
+    int    i;
+
+    /* create a small label table to begin with */
+    tableInit (&table);
+    if ( tableResize (&table, 10) == 0)
+    {
+        /* error message already printed */
+        return table;
+    }
+    memset (&state, 0, sizeof(state));
+    tableInit (&state.waiting);
+    state.output = output;
+    dataInit (&data);
+
+    for (lineNum = 1, PC = 0; sourceNextLine (source, &offset, &inst);
+         lineNum++, PC += size)
+    {
+        /* Split the line into label, instruction name, and operands,
+         * ignoring any comment.
+         */
+        int hasInstruction = parseLine (inst, &label, &instrName, &operands);
+        column = hasInstruction ? (int) (instrName.text - inst.text) + 1 : 0;
+
+        /* Carry out a directive, as pass1 does. */
+        isData = hasInstruction && isDirective (instrName);
+        dataOffset = (uint32_t) data.size;
+        if ( isData )
+        {
+            rest.text = operands.text;
+            rest.length = (int) (inst.text + inst.length - operands.text);
+            if ( ! dataDirective (&data, instrName, rest, lineNum, column,
+                                  &dataOffset) )
+                break;
+        }
+
+        /* A label in the data segment is defined at the end of the
+         * input, once the address of the segment is known.
+         */
+        if ( label.length > 0 && data.inData )
+        {
+            if ( ! dataAddLabel (&data, label, dataOffset) )
+                break;
+        }
+
+        /* If the line has a label, add it to the table and patch the
+         * instructions that were waiting for it.
+         */
+        else if ( label.length > 0 )
+        {
+            nbrLabels = table.nbrLabels;
+            statsStart (STATS_LABELS);
+            status = addLabelN (&table, label.text, label.length, PC);
+            statsStop (STATS_LABELS);
+            if (status == 0)
+            {
+                /* error message already printed */
+                break;
+            }
+            if ( table.nbrLabels > nbrLabels && state.nbrPending > 0 )
+                resolveFixups (&state, label, PC);
+        }
+
+        /* Every line of the text segment takes up a word. */
+        size = ! data.inData && ! isData ? 4 : 0;
+
+        /* If empty line or line containing only a label (or a directive,
+         * or an instruction in the data segment), get next line
+         */
+        if ( ! hasInstruction || isData ||
+             ! checkSegment (&data, instrName, lineNum, column) )
+        {
+            flushRecords (&state);
+            continue;
+        }
+
+        // print current instruction
+        printDebug("\nLine #%d: %.*s, %.*s\n", lineNum, instrName.length,
+                   instrName.text, operands.length, operands.text);
+
+        /* Encode the instruction into a new record at the end of the queue. */
+        if ( state.nbrRecords >= state.recordCapacity &&
+             ! growArray ((void **) &state.records, &state.recordCapacity,
+                          sizeof(Record)) )
+            break;
+        Record * record = &state.records[state.nbrRecords];
+        parseInstruction(instrName, operands, lineNum, &parsed);
+        parsed.column = column;
+        parsed.address = PC;
+        hold_errors();
+        status = encodeInstruction(&parsed, table, &record->word, &fixup);
+        record->errors = release_errors();
+        record->hasWord = status != ASM_ERROR;
+        record->PC = PC;
+        record->pending = 0;
+        if ( status == ASM_FIXUP &&
+             ! addFixup (&state, &fixup, state.nbrRecords) )
+            break;
+        state.nbrRecords++;
+
+        flushRecords (&state);
+    }
+    STATS_COUNT(lines, lineNum - 1);
+
+    /* EOF: the data segment follows the text segment, so its labels can
+     * now be defined (patching the instructions waiting for them).
+     */
+    (void) dataPlace (&data, NULL, (uint32_t) PC);
+    for (i = 0; i < data.nbrLabels; i++)
+    {
+        label.text = data.names + data.labels[i].name;
+        label.length = data.labels[i].length;
+        nbrLabels = table.nbrLabels;
+        if (addLabelN (&table, label.text, label.length,
+                       (int) (data.address + data.labels[i].offset)) == 0)
+            break;
+        if ( table.nbrLabels > nbrLabels && state.nbrPending > 0 )
+            resolveFixups (&state, label,
+                           (int) (data.address + data.labels[i].offset));
+    }
+
+    /* Any label still awaited was never defined. */
+    for (i = 0; i < state.nbrFixups; i++)
+    {
+        PendingFixup * pending = &state.fixups[i];
+        Record * record = &state.records[pending->record];
+        if ( ! record->pending )
+            continue;
+        /* same message as assemblerI and assemblerJ */
+        hold_errors();
+        diagError(DIAG_UNDEFINED_LABEL, pending->fixup.lineNum,
+                  pending->fixup.column, pending->fixup.label,
+                  "\nError: Invalid label not contained in label table, at line %d\n");
+        record->errors = release_errors();
+        record->hasWord = 0;
+        record->pending = 0;
+    }
+    state.nbrPending = 0;
+    flushRecords (&state);
+    (void) dataWrite (&data, output);
+
+    free (state.records);
+    free (state.fixups);
+    tableFree (&state.waiting);
+    dataFree (&data);
+
+    /* EOF, but don't close the file here. */
+    return table;
+}
+
+static int growArray(void ** array, int * capacity, size_t elementSize)
+  /* Postcondition: *array has room for twice as many elements (or 64 if
+   *      it was empty), with its contents preserved.
+   * Returns 1 if everything went OK; 0 if memory allocation error.
+   */
+{
+    int    newCapacity = *capacity > 0 ? *capacity * 2 : 64;
+    void * newArray;
+
+    if ((newArray = realloc (*array, newCapacity * elementSize)) == NULL)
+    {
+        printError ("%s", ERROR_MEMORY);
+        return 0;
+    }
+    *array = newArray;
+    *capacity = newCapacity;
+    return 1;
+}
+
+static int addFixup(SinglePassState * state, Fixup * fixup, int record)
+  /* Postcondition: the fixup (with its own copy of the label) is waiting
+   *      for its label, and the record is held in the queue until then.
+   * Returns 1 if everything went OK; 0 if memory allocation error.
+   */
+{
+    PendingFixup * pending;
+    int            first;
+
+    if ( state->nbrFixups >= state->fixupCapacity &&
+         ! growArray ((void **) &state->fixups, &state->fixupCapacity,
+                      sizeof(PendingFixup)) )
+        return 0;
+
+    pending = &state->fixups[state->nbrFixups];
+    pending->fixup = *fixup;
+    pending->record = record;
+
+    /* Link the fixup into the list of fixups waiting for this label.
+     * The fixup keeps the waiting table's copy of the label, since the
+     * line it came from may not outlive it (see sourceOpenStream).
+     */
+    first = findLabelN (&state->waiting, fixup->label.text,
+                        fixup->label.length);
+    if ( first == -1 )
+    {
+        pending->next = -1;
+        if (addLabelN (&state->waiting, fixup->label.text,
+                       fixup->label.length, state->nbrFixups) == 0)
+            return 0;
+        pending->fixup.label.text =
+            state->waiting.entries[state->waiting.nbrLabels - 1].label;
+    }
+    else
+    {
+        pending->next = state->fixups[first].next;
+        state->fixups[first].next = state->nbrFixups;
+        pending->fixup.label.text = state->fixups[first].fixup.label.text;
+    }
+
+    state->records[record].pending = 1;
+    state->nbrFixups++;
+    state->nbrPending++;
+    return 1;
+}
+
+static void resolveFixups(SinglePassState * state, Span label, int address)
+  /* Postcondition: every instruction waiting for label has its label
+   *      field patched (or an error recorded) and is no longer pending.
+   */
+{
+    int      i;
+    uint32_t field;
+
+    for (i = findLabelN (&state->waiting, label.text, label.length); i != -1;
+         i = state->fixups[i].next)
+    {
+        PendingFixup * pending = &state->fixups[i];
+        Record * record = &state->records[pending->record];
+
+        hold_errors();
+        if ( ! encodeTarget (address, pending->fixup.PC, pending->fixup.isJump,
+                             pending->fixup.lineNum, pending->fixup.column,
+                             &field) )
+            record->hasWord = 0;
+        else if ( pending->fixup.badRegister )
+        {
+            /* same message as assemblerI */
+            diagError(DIAG_BAD_REGISTER, pending->fixup.lineNum,
+                      pending->fixup.column, DIAG_NO_ARGUMENT,
+                      "\nError: Invalid Register at line %d\n");
+            record->hasWord = 0;
+        }
+        else
+            record->word |= field;
+        record->errors = release_errors();
+        record->pending = 0;
+        state->nbrPending--;
+    }
+}
+
+static void flushRecords(SinglePassState * state)
+  /* Postcondition: all records before the first pending one have been
+   *      written (errors to stderr, machine code to the output).
+   */
+{
+    while ( state->nbrFlushed < state->nbrRecords &&
+            ! state->records[state->nbrFlushed].pending )
+    {
+        Record * record = &state->records[state->nbrFlushed++];
+        if ( record->errors )
+        {
+            printError ("%s", record->errors);
+            free (record->errors);
+        }
+        if ( record->hasWord )
+            (void) outputWord (state->output, (uint32_t) record->PC,
+                               record->word);
+    }
+
+    /* Once everything is written, no fixup can be pending, so the queue
+     * and the fixup list can start over.  (Labels left in the waiting
+     * table have all been defined, so they are never looked up again.)
+     */
+    if ( state->nbrFlushed == state->nbrRecords && state->nbrPending == 0 )
+    {
+        state->nbrRecords = state->nbrFlushed = 0;
+        state->nbrFixups = 0;
+    }
+}
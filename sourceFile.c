@@ -0,0 +1,414 @@
+/*
+ * Source File: functions to read an assembly source file
+ *
+ * This file provides the definitions of the functions declared in
+ * sourceFile.h.  A regular file is mapped into memory (read-only, so
+ * the text is shared with the page cache and never copied); anything
+ * else, such as a pipe, is read into one dynamically allocated buffer.
+ *
+ * A streamed source (sourceOpenStream) is read by a reader thread into
+ * a fixed set of STREAM_BLOCKS blocks, which circulate between two
+ * queues: the reader takes an empty block from one, fills it with one
+ * read, and passes it on through the other; sourceNextLine hands out
+ * lines from the filled blocks and gives each block back once all of
+ * its lines have been used.  A line that continues into the next block
+ * is copied into a separate buffer (carry), which is the only copying
+ * done.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sourceFile.h"
+#include "printFuncs.h"
+#include "scanner.h"
+#include "spscQueue.h"
+
+/* Number and size of the blocks of a streamed source. */
+#define STREAM_BLOCKS       8
+#define STREAM_BLOCK_SIZE   65536
+
+/* One block of a streamed source. */
+typedef struct {
+        char    data[STREAM_BLOCK_SIZE];
+        ssize_t length;         /* bytes read; 0 at EOF; -1 if error */
+} InputBlock;
+
+struct InputStream {
+        int          fd;            /* file descriptor being read */
+        pthread_t    reader;
+        SpscQueue    empty;         /* blocks for the reader to fill */
+        SpscQueue    filled;        /* blocks for sourceNextLine */
+        InputBlock * blocks;        /* all STREAM_BLOCKS blocks */
+        InputBlock * current;       /* block lines come from, or NULL */
+        size_t       position;      /* start of the next line in current */
+        char *       carry;         /* a line that crosses blocks */
+        size_t       carryLength;
+        size_t       carryCapacity;
+        int          atEnd;         /* 1 once the EOF block was seen */
+};
+
+static const char * ERROR_READ = "Error: cannot read the input file.\n";
+static const char * ERROR_MEMORY = "Error: cannot allocate space in memory.\n";
+
+static int readAll (SourceFile * source, FILE * fp);
+static void * readBlocks (void * stream);
+static int streamNextLine (InputStream * stream, Span * line);
+static int carryAppend (InputStream * stream, const char * text,
+                        size_t length);
+static void streamClose (InputStream * stream);
+
+int sourceOpen (SourceFile * source, FILE * fp)
+{
+    struct stat info;
+    void *      text;
+
+    source->text = NULL;
+    source->length = 0;
+    source->mapped = 0;
+    source->owned = 1;
+    source->stream = NULL;
+
+    /* Map a non-empty regular file; read anything else. */
+    if ( fstat(fileno(fp), &info) != 0 || ! S_ISREG(info.st_mode) ||
+         info.st_size == 0 )
+        return readAll(source, fp);
+
+    text = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE,
+                fileno(fp), 0);
+    if ( text == MAP_FAILED )
+        return readAll(source, fp);
+    (void) madvise(text, (size_t) info.st_size, MADV_SEQUENTIAL);
+
+    source->text = text;
+    source->length = (size_t) info.st_size;
+    source->mapped = 1;
+    return 1;
+}
+
+void sourceOpenText (SourceFile * source, const char * text, size_t length)
+{
+    source->text = text;
+    source->length = length;
+    source->mapped = 0;
+    source->owned = 0;
+    source->stream = NULL;
+}
+
+int sourceOpenStream (SourceFile * source, FILE * fp)
+{
+    InputStream * stream;
+    int           i;
+
+    source->text = NULL;
+    source->length = 0;
+    source->mapped = 0;
+    source->owned = 1;
+    source->stream = NULL;
+
+    if ( (stream = calloc(1, sizeof(InputStream))) == NULL ||
+         (stream->blocks = malloc(STREAM_BLOCKS * sizeof(InputBlock)))
+             == NULL ||
+         ! spscInit(&stream->empty, STREAM_BLOCKS) ||
+         ! spscInit(&stream->filled, STREAM_BLOCKS) )
+    {
+        if ( stream != NULL )
+        {
+            spscFree(&stream->empty);
+            free(stream->blocks);
+            free(stream);
+        }
+        printError("%s", ERROR_MEMORY);
+        return 0;
+    }
+
+    stream->fd = fileno(fp);
+    for ( i = 0; i < STREAM_BLOCKS; i++ )
+        (void) spscTryPush(&stream->empty, &stream->blocks[i]);
+
+    if ( pthread_create(&stream->reader, NULL, readBlocks, stream) != 0 )
+    {
+        spscFree(&stream->empty);
+        spscFree(&stream->filled);
+        free(stream->blocks);
+        free(stream);
+        printError("%s", ERROR_READ);
+        return 0;
+    }
+    source->stream = stream;
+    return 1;
+}
+
+int sourceNextLine (SourceFile * source, size_t * offset, Span * line)
+{
+    const char * start;
+    const char * newline;
+    size_t       remaining;
+
+    if ( source->stream != NULL )
+    {
+        if ( ! streamNextLine(source->stream, line) )
+            return 0;
+        *offset += (size_t) line->length + 1;
+        return 1;
+    }
+
+    if ( *offset >= source->length )
+        return 0;
+
+    start = source->text + *offset;
+    remaining = source->length - *offset;
+    newline = memchr(start, '\n', remaining);
+
+    line->text = start;
+    if ( newline == NULL )
+    {
+        /* last line, with no newline at the end */
+        line->length = (int) remaining;
+        *offset = source->length;
+    }
+    else
+    {
+        line->length = (int) (newline - start);
+        *offset += (size_t) line->length + 1;
+    }
+    return 1;
+}
+
+Span stripComment (Span line)
+{
+    const char * comment = memchr(line.text, '#', (size_t) line.length);
+
+    if ( comment != NULL )
+        line.length = (int) (comment - line.text);
+    return line;
+}
+
+int parseLine (Span line, Span * label, Span * instName, Span * operands)
+{
+    const char * end;
+    const char * tokEnd;
+    Span         tokens[2];             /* label (if any) and name */
+    int          nbrTokens, first = 0;
+
+    line = stripComment(line);
+    end = line.text + line.length;
+    nbrTokens = scanTokens(line, tokens, 2);
+
+    /* Skip label, if any */
+    label->text = nbrTokens > 0 ? tokens[0].text : end;
+    label->length = 0;
+    tokEnd = nbrTokens > 0 ? tokens[0].text + tokens[0].length : end;
+    if ( tokEnd < end && *tokEnd == ':' )
+    {
+        label->length = tokens[0].length;
+        first = 1;
+    }
+
+    /* Empty line or line containing only a label? */
+    if ( nbrTokens <= first )
+        return 0;
+
+    *instName = tokens[first];
+    tokEnd = instName->text + instName->length;
+    operands->text = tokEnd < end ? tokEnd + 1 : end;
+    operands->length = (int) (end - operands->text);
+    return 1;
+}
+
+void sourceClose (SourceFile * source)
+{
+    if ( source->stream != NULL )
+    {
+        streamClose(source->stream);
+        source->stream = NULL;
+    }
+    if ( source->text == NULL )
+        return;
+
+    if ( ! source->owned )
+        ;                       /* the caller's text (sourceOpenText) */
+    else if ( source->mapped )
+        (void) munmap((void *) source->text, source->length);
+    else
+        free((void *) source->text);
+    source->text = NULL;
+    source->length = 0;
+}
+
+static int readAll (SourceFile * source, FILE * fp)
+  /* Reads the rest of fp into a single dynamically allocated buffer.
+   * Returns 1 if everything went OK; 0 if the input could not be read.
+   */
+{
+    size_t capacity = BUFSIZ;
+    size_t length = 0;
+    size_t nbrRead;
+    char * buffer = NULL;
+    char * newBuffer;
+
+    do
+    {
+        if ( length == capacity || buffer == NULL )
+        {
+            capacity = buffer == NULL ? capacity : capacity * 2;
+            if ((newBuffer = realloc(buffer, capacity)) == NULL)
+            {
+                free(buffer);
+                printError("%s", ERROR_MEMORY);
+                return 0;
+            }
+            buffer = newBuffer;
+        }
+        nbrRead = fread(buffer + length, 1, capacity - length, fp);
+        length += nbrRead;
+    } while ( nbrRead > 0 );
+
+    if ( ferror(fp) )
+    {
+        free(buffer);
+        printError("%s", ERROR_READ);
+        return 0;
+    }
+
+    source->text = buffer;
+    source->length = length;
+    return 1;
+}
+
+static void * readBlocks (void * arg)
+  /* The reader thread: fills empty blocks with one read each and passes
+   * them on, in order, until it has passed on a block of length 0 (EOF)
+   * or -1 (read error).
+   */
+{
+    InputStream * stream = arg;
+    InputBlock *  block;
+
+    do
+    {
+        block = spscPop(&stream->empty);
+        do
+            block->length = read(stream->fd, block->data, STREAM_BLOCK_SIZE);
+        while ( block->length < 0 && errno == EINTR );
+        spscPush(&stream->filled, block);
+    } while ( block->length > 0 );
+
+    return NULL;
+}
+
+static int streamNextLine (InputStream * stream, Span * line)
+  /* Sets line to the next line of a streamed source (valid until the
+   * next call).  Returns 1 if there was a line; 0 at the end of input.
+   */
+{
+    const char * start;
+    const char * newline;
+    size_t       remaining;
+
+    stream->carryLength = 0;
+    for ( ;; )
+    {
+        /* Give back a block whose lines have all been handed out. */
+        if ( stream->current != NULL &&
+             stream->position == (size_t) stream->current->length )
+        {
+            spscPush(&stream->empty, stream->current);
+            stream->current = NULL;
+        }
+
+        if ( stream->current == NULL )
+        {
+            if ( stream->atEnd )
+                break;
+            stream->current = spscPop(&stream->filled);
+            stream->position = 0;
+            if ( stream->current->length <= 0 )
+            {
+                if ( stream->current->length < 0 )
+                    printError("%s", ERROR_READ);
+                stream->current = NULL;
+                stream->atEnd = 1;
+                break;
+            }
+        }
+
+        start = stream->current->data + stream->position;
+        remaining = (size_t) stream->current->length - stream->position;
+        newline = memchr(start, '\n', remaining);
+        if ( newline == NULL )
+        {
+            /* The line continues in the next block. */
+            if ( ! carryAppend(stream, start, remaining) )
+                return 0;
+            stream->position += remaining;
+            continue;
+        }
+
+        stream->position += (size_t) (newline - start) + 1;
+        if ( stream->carryLength == 0 )
+        {
+            line->text = start;
+            line->length = (int) (newline - start);
+            return 1;
+        }
+        if ( ! carryAppend(stream, start, (size_t) (newline - start)) )
+            return 0;
+        break;
+    }
+
+    /* A line that crossed blocks, or the last line (with no newline). */
+    if ( stream->carryLength == 0 )
+        return 0;
+    line->text = stream->carry;
+    line->length = (int) stream->carryLength;
+    return 1;
+}
+
+static int carryAppend (InputStream * stream, const char * text,
+                        size_t length)
+  /* Appends text to the line being carried over between blocks.
+   * Returns 1 if everything went OK; 0 if memory allocation error.
+   */
+{
+    size_t newCapacity;
+    char * newCarry;
+
+    if ( stream->carryLength + length > stream->carryCapacity )
+    {
+        newCapacity = stream->carryCapacity ? stream->carryCapacity : BUFSIZ;
+        while ( newCapacity < stream->carryLength + length )
+            newCapacity *= 2;
+        if ( (newCarry = realloc(stream->carry, newCapacity)) == NULL )
+        {
+            printError("%s", ERROR_MEMORY);
+            return 0;
+        }
+        stream->carry = newCarry;
+        stream->carryCapacity = newCapacity;
+    }
+    memcpy(stream->carry + stream->carryLength, text, length);
+    stream->carryLength += length;
+    return 1;
+}
+
+static void streamClose (InputStream * stream)
+  /* Stops the reader thread (if it has not reached the end of the input)
+   * and releases the memory of a streamed source.
+   */
+{
+    if ( ! stream->atEnd )
+        (void) pthread_cancel(stream->reader);
+    (void) pthread_join(stream->reader, NULL);
+    spscFree(&stream->empty);
+    spscFree(&stream->filled);
+    free(stream->blocks);
+    free(stream->carry);
+    free(stream);
+}
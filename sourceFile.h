@@ -0,0 +1,100 @@
+/*
+ * Source File: read-only access to a whole assembly source file
+ *
+ * A SourceFile holds the complete text of an assembly source file in
+ * memory.  A regular file is mapped read-only with mmap, so its text
+ * is never copied; other input (e.g., a pipe on stdin) is read into a
+ * single buffer.  Either way the text is never modified, and lines are
+ * handed out as spans (see getToken.h) pointing into it, so lines can
+ * be any length.  The text stays valid until sourceClose is called, so
+ * spans can be kept (e.g., in a fixup list) for the whole assembly.
+ *
+ * A source file can be read any number of times: pass1 and pass2 each
+ * start reading at offset 0.
+ *
+ * A source can also be text that is already in memory (sourceOpenText),
+ * which is used where it is, and stays the caller's.
+ *
+ * A source file opened with sourceOpenStream is instead read by a
+ * separate reader thread, in blocks, while the lines already read are
+ * being assembled.  The blocks are passed to the assembler through a
+ * bounded queue (see spscQueue.h), so only a few blocks are in memory at
+ * a time and a reader that gets ahead waits.  Such a source can be read
+ * only once, from the start, and each line is valid only until the next
+ * call to sourceNextLine, so it can be used only by singlePass, which
+ * copies anything it keeps.
+ *
+ */
+
+#ifndef _SOURCEFILE_H
+#define _SOURCEFILE_H
+
+#include <stdio.h>
+
+#include "getToken.h"
+
+/* The state of a source file read by a reader thread (see sourceFile.c). */
+typedef struct InputStream InputStream;
+
+typedef struct {
+        const char * text;      /* the whole file (not null-terminated) */
+        size_t       length;    /* number of characters in the file */
+        int          mapped;    /* 1 if text is mmapped; 0 if allocated */
+        int          owned;     /* 0 if text belongs to the caller */
+        InputStream * stream;   /* reader thread state, if streaming;
+                                 * otherwise NULL */
+} SourceFile;
+
+int sourceOpen (SourceFile * source, FILE * fp);
+        /* Postcondition: source holds the entire contents of fp, which
+         *      should be positioned at the start of the input.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the input could not be read.
+         */
+
+void sourceOpenText (SourceFile * source, const char * text, size_t length);
+        /* Postcondition: source holds the length characters of text
+         *      (which need not be null-terminated), without copying
+         *      them; text must stay valid until sourceClose is called,
+         *      which does not release it.
+         */
+
+int sourceOpenStream (SourceFile * source, FILE * fp);
+        /* Postcondition: a reader thread has started reading fp into
+         *      blocks, to be handed out by sourceNextLine as lines.
+         * Returns 1 if everything went OK; 0 (after printing an error)
+         *      if the reader could not be started.
+         */
+
+int sourceNextLine (SourceFile * source, size_t * offset, Span * line);
+        /* Postcondition: if *offset is before the end of the file, line
+         *      refers to the line starting there (not including its
+         *      newline), *offset is moved to the start of the next line,
+         *      and 1 is returned; otherwise 0 is returned.  (For a
+         *      streamed source, *offset is only advanced past the line;
+         *      lines always come in order.)
+         */
+
+Span stripComment (Span line);
+        /* Returns the part of line before its first '#' (all of line if
+         *      it has no comment).
+         */
+
+int parseLine (Span line, Span * label, Span * instName, Span * operands);
+        /* Splits a line of assembly source into its parts, ignoring any
+         *      comment: label is set to the label at the start of the
+         *      line (length 0 if there is none), instName to the
+         *      instruction name that follows it, and operands to the
+         *      rest of the line after the instruction name.
+         * Returns 1 if the line contains an instruction; 0 if it is
+         *      empty or contains only a label and/or a comment (in which
+         *      case instName and operands are not set).
+         */
+
+void sourceClose (SourceFile * source);
+        /* Postcondition: the memory holding the text has been released
+         *      (and the reader thread, if any, has been stopped); spans
+         *      into it are no longer valid.
+         */
+
+#endif
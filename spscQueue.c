@@ -0,0 +1,104 @@
+/*
+ * SPSC Queue: functions to pass items between two threads
+ *
+ * This file provides the definitions of the functions declared in
+ * spscQueue.h.  The producer publishes a slot by storing the new tail
+ * with release ordering after writing the slot, and the consumer reads
+ * the tail with acquire ordering before reading the slot (and the same
+ * in the other direction for the head), so each item is seen complete.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "spscQueue.h"
+
+/* Number of times a waiting thread yields before it starts sleeping. */
+#define YIELDS_BEFORE_SLEEP 64
+
+/* How long a waiting thread sleeps between checks, in nanoseconds. */
+#define WAIT_SLEEP_NS 50000
+
+static void waitBriefly (int * nbrWaits);
+
+int spscInit (SpscQueue * queue, unsigned capacity)
+{
+    unsigned size = 1;
+
+    while ( size < capacity )
+        size *= 2;
+    if ( (queue->slots = malloc (size * sizeof(void *))) == NULL )
+        return 0;
+    queue->capacity = size;
+    atomic_init (&queue->head, 0);
+    atomic_init (&queue->tail, 0);
+    return 1;
+}
+
+int spscTryPush (SpscQueue * queue, void * item)
+{
+    unsigned tail = atomic_load_explicit (&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit (&queue->head, memory_order_acquire);
+
+    if ( tail - head == queue->capacity )
+        return 0;
+    queue->slots[tail & (queue->capacity - 1)] = item;
+    atomic_store_explicit (&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int spscTryPop (SpscQueue * queue, void ** item)
+{
+    unsigned head = atomic_load_explicit (&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit (&queue->tail, memory_order_acquire);
+
+    if ( head == tail )
+        return 0;
+    *item = queue->slots[head & (queue->capacity - 1)];
+    atomic_store_explicit (&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+void spscPush (SpscQueue * queue, void * item)
+{
+    int nbrWaits = 0;
+
+    while ( ! spscTryPush (queue, item) )
+        waitBriefly (&nbrWaits);
+}
+
+void * spscPop (SpscQueue * queue)
+{
+    void * item;
+    int    nbrWaits = 0;
+
+    while ( ! spscTryPop (queue, &item) )
+        waitBriefly (&nbrWaits);
+    return item;
+}
+
+void spscFree (SpscQueue * queue)
+{
+    free (queue->slots);
+    queue->slots = NULL;
+    queue->capacity = 0;
+}
+
+/*
+ * Lets the other thread run: yields the processor for the first few
+ * waits, then sleeps, so a long wait (e.g., for a slow pipe) does not
+ * keep a processor busy.
+ */
+static void waitBriefly (int * nbrWaits)
+{
+    struct timespec delay = { 0, WAIT_SLEEP_NS };
+
+    if ( (*nbrWaits)++ < YIELDS_BEFORE_SLEEP )
+        (void) sched_yield ();
+    else
+        (void) nanosleep (&delay, NULL);
+}
@@ -0,0 +1,61 @@
+/*
+ * SPSC Queue: a bounded, lock-free, single-producer/single-consumer queue
+ *
+ * An SpscQueue passes pointers from one thread (the producer, which
+ * pushes) to one other thread (the consumer, which pops), in order.  It
+ * is a ring of a fixed number of slots indexed by two counters: only the
+ * producer writes the tail and only the consumer writes the head, so no
+ * locks are needed; C11 atomics order the accesses.
+ *
+ * The queue is bounded, so a producer that gets ahead of its consumer
+ * waits in spscPush until the consumer catches up (backpressure), and a
+ * consumer waits in spscPop until there is something to pop.  Waiting
+ * threads yield the processor, and sleep briefly if the wait is long.
+ *
+ * The assembler's pipelined mode links its reader, encoder, and writer
+ * stages with these queues (see sourceFile.h and outputFile.h).
+ *
+ */
+
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <stdatomic.h>
+
+typedef struct {
+        void **          slots;
+        unsigned         capacity;  /* number of slots (a power of 2) */
+        atomic_uint      head;      /* next slot to pop (consumer only) */
+        atomic_uint      tail;      /* next slot to push (producer only) */
+} SpscQueue;
+
+int spscInit (SpscQueue * queue, unsigned capacity);
+        /* Postcondition: queue is empty, with room for capacity items
+         *      (rounded up to a power of 2).
+         * Returns 1 if everything went OK; 0 if memory allocation error.
+         */
+
+int spscTryPush (SpscQueue * queue, void * item);
+        /* Adds item to the end of the queue, if there is room.
+         * Returns 1 if item was added; 0 if the queue is full.
+         */
+
+int spscTryPop (SpscQueue * queue, void ** item);
+        /* Removes the item at the front of the queue into *item, if
+         *      there is one.
+         * Returns 1 if an item was removed; 0 if the queue is empty.
+         */
+
+void spscPush (SpscQueue * queue, void * item);
+        /* Adds item to the end of the queue, waiting for room. */
+
+void * spscPop (SpscQueue * queue);
+        /* Removes and returns the item at the front of the queue,
+         *      waiting for one.
+         */
+
+void spscFree (SpscQueue * queue);
+        /* Postcondition: the memory holding the slots has been released.
+         */
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Stats: phase timing and hot-path counters for the --stats option
+ *
+ * This file provides the definitions of the functions declared in
+ * stats.h, and the report printed at exit.  Wall time is measured with
+ * the monotonic clock and CPU time with the process CPU clock, so the
+ * CPU time of a phase includes the work of any threads running during
+ * it (e.g., with -j).
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "printFuncs.h"
+#include "stats.h"
+
+/* Deepest nesting of phases. */
+#define MAX_NESTING 8
+
+_Thread_local StatsCounters STATS;
+
+static const char * PHASE_NAMES[STATS_NBR_PHASES] = {
+        "pass1",
+        "label table",
+        "single pass",
+        "pass2 encoding",
+        "output writing"
+};
+
+/* Internal state of the timers (main thread only). */
+static int    enabled = 0;
+static _Thread_local int timing = 0;        /* 1 on the thread timed */
+static double wallTime[STATS_NBR_PHASES];
+static double cpuTime[STATS_NBR_PHASES];
+static int    used[STATS_NBR_PHASES];       /* 1 if the phase has run */
+static int    running[MAX_NESTING];         /* running phase, then the
+                                             * paused ones */
+static int    depth = 0;                    /* number of phases in running */
+static double lastWall, lastCpu;            /* when time was last charged */
+static double startWall, startCpu;          /* when timing was enabled */
+
+/* Counts added by threads that have finished. */
+static StatsCounters   totals;
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void   chargeTime (void);
+static double seconds (clockid_t clock);
+static void   addCounters (StatsCounters * sum, const StatsCounters * counts);
+static void   printReport (void);
+
+void statsEnable (void)
+{
+    if ( enabled )
+        return;
+    enabled = timing = 1;
+    startWall = lastWall = seconds(CLOCK_MONOTONIC);
+    startCpu = lastCpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+    (void) atexit(printReport);
+}
+
+void statsStart (StatsPhase phase)
+{
+    if ( ! timing )
+        return;
+    chargeTime();
+    if ( depth < MAX_NESTING )
+        running[depth] = phase;
+    depth++;
+    used[phase] = 1;
+}
+
+void statsStop (StatsPhase phase)
+{
+    (void) phase;
+
+    if ( ! timing || depth == 0 )
+        return;
+    chargeTime();
+    depth--;
+}
+
+void statsMergeThread (void)
+{
+    pthread_mutex_lock(&totalsLock);
+    addCounters(&totals, &STATS);
+    pthread_mutex_unlock(&totalsLock);
+    STATS = (StatsCounters) { 0 };
+}
+
+/*
+ * Charges the time since it was last charged to the running phase.
+ */
+static void chargeTime (void)
+{
+    double wall = seconds(CLOCK_MONOTONIC);
+    double cpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+    if ( depth > 0 && depth <= MAX_NESTING )
+    {
+        wallTime[running[depth - 1]] += wall - lastWall;
+        cpuTime[running[depth - 1]] += cpu - lastCpu;
+    }
+    lastWall = wall;
+    lastCpu = cpu;
+}
+
+/* Returns the time on the given clock, in seconds. */
+static double seconds (clockid_t clock)
+{
+    struct timespec now;
+
+    if ( clock_gettime(clock, &now) != 0 )
+        return 0;
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Adds each of the counts to the same counter of sum. */
+static void addCounters (StatsCounters * sum, const StatsCounters * counts)
+{
+    int i;
+
+    sum->lines += counts->lines;
+    for ( i = 0; i < 3; i++ )
+        sum->instructions[i] += counts->instructions[i];
+    sum->findLabelCalls += counts->findLabelCalls;
+    sum->labelProbes += counts->labelProbes;
+    sum->getRegNumCalls += counts->getRegNumCalls;
+    sum->bytesWritten += counts->bytesWritten;
+    sum->errors += counts->errors;
+    sum->cacheHits += counts->cacheHits;
+    sum->cacheMisses += counts->cacheMisses;
+}
+
+/*
+ * Prints the report to stderr.  This is registered with atexit by
+ * statsEnable; phases still running (if the program is stopping early)
+ * are charged up to now.
+ */
+static void printReport (void)
+{
+    StatsCounters counts = totals;
+    int           phase;
+
+    chargeTime();
+    addCounters(&counts, &STATS);
+
+    fprintf(stderr, "\nStatistics:\n");
+    fprintf(stderr, "  %-16s %10s %10s\n", "phase", "wall (s)", "CPU (s)");
+    for ( phase = 0; phase < STATS_NBR_PHASES; phase++ )
+    {
+        if ( used[phase] )
+            fprintf(stderr, "  %-16s %10.4f %10.4f\n", PHASE_NAMES[phase],
+                    wallTime[phase], cpuTime[phase]);
+    }
+    fprintf(stderr, "  %-16s %10.4f %10.4f\n", "total",
+            lastWall - startWall, lastCpu - startCpu);
+
+    fprintf(stderr, "  %-16s %10lu\n", "lines", counts.lines);
+    fprintf(stderr, "  %-16s %10lu   (R %lu, I %lu, J %lu)\n", "instructions",
+            counts.instructions[0] + counts.instructions[1] +
+                counts.instructions[2],
+            counts.instructions[0], counts.instructions[1],
+            counts.instructions[2]);
+    fprintf(stderr, "  %-16s %10lu   (%lu probes, %.2f per call)\n",
+            "findLabel calls", counts.findLabelCalls, counts.labelProbes,
+            counts.findLabelCalls > 0
+                ? (double) counts.labelProbes / counts.findLabelCalls : 0.0);
+    fprintf(stderr, "  %-16s %10lu\n", "getRegNum calls",
+            counts.getRegNumCalls);
+    fprintf(stderr, "  %-16s %10lu\n", "bytes written", counts.bytesWritten);
+    fprintf(stderr, "  %-16s %10lu\n", "errors", counts.errors);
+    if ( counts.cacheHits + counts.cacheMisses > 0 )
+        fprintf(stderr, "  %-16s %10lu   (%lu misses)\n", "cache hits",
+                counts.cacheHits, counts.cacheMisses);
+}
@@ -0,0 +1,80 @@
+/*
+ * Stats: phase timing and hot-path counters for the --stats option
+ *
+ * The assembler keeps a few counters (lines read, instructions of each
+ * format, label lookups and the probes they made, register lookups,
+ * bytes of output written, errors found, cache hits and misses)
+ * whatever the options, because a counter is cheaper to bump than to
+ * test for: each one is a plain increment of a thread-local variable.
+ * Threads other than the main one add their counts to the totals with
+ * statsMergeThread before they finish.
+ *
+ * The time spent in each phase is only measured once statsEnable has
+ * been called (by the --stats option); until then statsStart and
+ * statsStop return at once.  Phases may be nested: starting a phase
+ * pauses the one that is running until the new one stops, so each phase
+ * is charged only for its own time.  Each start or stop reads the clocks,
+ * which takes a fraction of a microsecond, so a short phase that is
+ * timed very often (adding a label) is somewhat overstated.  Only the
+ * thread that called statsEnable (the main thread) is timed; on other
+ * threads statsStart and statsStop return at once, so functions that
+ * time their phases, like pass1, may also run on worker threads.
+ *
+ * The report is printed to stderr at exit, so it also appears when the
+ * program stops early (e.g., after too many errors).
+ *
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+/* The phases that are timed. */
+typedef enum {
+        STATS_PASS1,            /* pass1, not counting the label table */
+        STATS_LABELS,           /* adding labels to the label table */
+        STATS_SINGLE_PASS,      /* singlePass (--one-pass) */
+        STATS_PASS2,            /* encoding the instructions */
+        STATS_OUTPUT,           /* writing the machine code */
+        STATS_NBR_PHASES
+} StatsPhase;
+
+typedef struct {
+        unsigned long lines;            /* lines of source read */
+        unsigned long instructions[3];  /* by InstructionFormat */
+        unsigned long findLabelCalls;
+        unsigned long labelProbes;      /* slots examined by findLabel */
+        unsigned long getRegNumCalls;
+        unsigned long bytesWritten;     /* bytes of machine code output */
+        unsigned long errors;           /* errors found in the program */
+        unsigned long cacheHits;        /* outputs copied from the cache */
+        unsigned long cacheMisses;      /* outputs added to the cache */
+} StatsCounters;
+
+/* The counts of the calling thread. */
+extern _Thread_local StatsCounters STATS;
+
+/* Adds n to one of the calling thread's counters. */
+#define STATS_COUNT(counter, n)  ((void) (STATS.counter += (n)))
+
+void statsEnable (void);
+        /* Postcondition: phases are timed from now on, and the report
+         *      is printed to stderr when the program exits.
+         */
+
+void statsStart (StatsPhase phase);
+        /* Postcondition: if timing is on, phase is being timed and the
+         *      phase that was running (if any) is paused.
+         */
+
+void statsStop (StatsPhase phase);
+        /* Precondition: phase is the phase most recently started.
+         * Postcondition: if timing is on, phase is no longer being
+         *      timed and the paused phase (if any) resumes.
+         */
+
+void statsMergeThread (void);
+        /* Postcondition: the calling thread's counts have been added to
+         *      the totals in the report, and reset to 0.
+         */
+
+#endif
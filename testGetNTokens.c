@@ -12,9 +12,13 @@
  */
 
 #include "assembler.h"
+#include "scanner.h"
 
 void runHardCodedTests(void);
 void runTest(int testNum, int request);
+void runSpanTest(int testNum, int request);
+void runScannerTests(void);
+int sameTokens(Span text);
 
 int main (int argc, char * argv[])
 {
@@ -95,6 +99,12 @@ int main (int argc, char * argv[])
     /* Run additional hard-coded tests, based on sample assembler testfile. */
     printf("\nAdditional Hard-coded Tests:\n\n");
     runHardCodedTests();
+
+    /* Check that every way of scanning finds the tokens getSpanToken
+     * finds, on random text.
+     */
+    printf("\nScanner tests:\n\n");
+    runScannerTests();
 }
 
 /* Create testStrings and expectedTokens as static global variables
@@ -127,6 +137,15 @@ void runHardCodedTests (void)
     /* Run tests designed to be erroneous. */
     runTest(9, 5);
     runTest(10, 5);
+
+    /* Run the same tests with getNSpanTokens, which should find the
+     * same tokens without modifying the test strings.
+     */
+    printf("\nSame tests with getNSpanTokens:\n\n");
+    for ( i = 0; i < 9; i++ )
+        runSpanTest(i, expectedTokens[i]);
+    runSpanTest(9, 5);
+    runSpanTest(10, 5);
 }
 
 void runTest(int testNum, int request)
@@ -155,3 +174,98 @@ void runTest(int testNum, int request)
             printf("%s ", results[i]);
     printf("\n");
 }
+
+void runSpanTest(int testNum, int request)
+{
+    int i;
+    Span line;
+    Span results[6];
+
+    line.text = testStrings[testNum];
+    line.length = strlen(testStrings[testNum]);
+    line = stripComment(line);
+
+    int lineNum = testNum + 1;
+    printf ("Line %d: %.*s\n\t", lineNum, line.length, line.text);
+
+    int expected = expectedTokens[testNum];
+    if ( expected == request )
+        printf ("Expect %d space-separated tokens\n\tActual: ", expected);
+    else
+        printf ("Ask for %d tokens; Expect error written to stderr...\n",
+                request);
+
+    if ( ! getNSpanTokens(line, request, results) )
+        printError("Error on line %d: %.*s", lineNum, results[0].length,
+                   results[0].text);
+    else
+        for (i = 0; i < request; i++ )
+            printf("%.*s ", results[i].length, results[i].text);
+    printf("\n");
+}
+
+void runScannerTests (void)
+{
+    static const char * names[] = { "scalar", "SSE2", "AVX2" };
+    static const char characters[] = " \t\n\v\f\r,():#$a0\x80\xff";
+    ScanMethod chosen = scanInUse();
+    ScanMethod method;
+    char * text;
+    int i, j, length, failures;
+    Span span;
+
+    /* Lines of up to 200 characters, spanning several chunks. */
+    text = malloc(200);
+    for ( method = SCAN_SCALAR; method <= SCAN_AVX2; method++ )
+    {
+        if ( ! scanUse(method) )
+        {
+            printf("%s: not available on this processor\n", names[method]);
+            continue;
+        }
+        srand(1);
+        failures = 0;
+        for ( i = 0; i < 100000; i++ )
+        {
+            length = rand() % 201;
+            for ( j = 0; j < length; j++ )
+                text[j] = characters[rand() % (sizeof(characters) - 1)];
+            span.text = text + (200 - length);  /* ends at end of block */
+            memmove((char *) span.text, text, length);
+            span.length = length;
+            if ( ! sameTokens(span) )
+                failures++;
+        }
+        printf("%s: %s\n", names[method],
+               failures == 0 ? "same tokens as getSpanToken"
+                             : "DIFFERENT tokens from getSpanToken");
+    }
+    (void) scanUse(chosen);
+    free(text);
+}
+
+/* Returns 1 if scanTokens finds the tokens that calling getSpanToken
+ * again and again finds in text; 0 otherwise.
+ */
+int sameTokens (Span text)
+{
+    const char * end = text.text + text.length;
+    const char * tokBegin = text.text;
+    const char * tokEnd;
+    Span tokens[5];
+    int nbrTokens, i;
+
+    nbrTokens = scanTokens(text, tokens, 4);
+    for ( i = 0; i < 5; i++, tokBegin = tokEnd + 1 )
+    {
+        getSpanToken(&tokBegin, &tokEnd, end);
+        if ( tokBegin == end )
+            return nbrTokens == i;
+        if ( i < 4 && (tokens[i].text != tokBegin ||
+                       tokens[i].length != (int) (tokEnd - tokBegin)) )
+            return 0;
+        if ( tokEnd == end )
+            return nbrTokens == i + 1;
+    }
+    return nbrTokens == 5;
+}
@@ -0,0 +1,156 @@
+/*
+ * Test Driver to test the getRegNum function, which decodes register names.
+ *
+ * It includes the following tests:
+ *
+ *      Test 1). Every named register ("$zero" through "$ra") and every
+ *      numbered register ("$0" through "$31").
+ *      Standard Output should report that each register decoded to its
+ *      number.
+ *
+ *      Test 2). Names that are not registers (e.g. "$t10", "$32", "$01",
+ *      "t0", "$").
+ *      Standard Output should report that each one decoded to -1.
+ *
+ *      Test 3). A microbenchmark decoding the register operands of
+ *      testAllRegisters.txt, repeated BENCH_REPEATS times, with getRegNum
+ *      and with a linear search through the register names.
+ *      Standard Output should print the time taken by each.
+ *
+ * Creation Date: October, 17th, 2026
+ *
+ */
+
+#include <time.h>
+
+#include "assembler.h"
+
+/* Number of times the benchmark decodes the register operands. */
+#define BENCH_REPEATS 200000
+
+static const char * REG_NAMES[] =
+{
+        "$zero",
+        "$at",
+        "$v0","$v1",
+        "$a0","$a1","$a2","$a3",
+        "$t0", "$t1", "$t2", "$t3", "$t4",
+        "$t5", "$t6", "$t7",
+        "$s0", "$s1", "$s2", "$s3", "$s4",
+        "$s5", "$s6", "$s7",
+        "$t8", "$t9", "$k0", "$k1", "$gp",
+        "$sp", "$fp", "$ra"
+};
+
+/* The register operands of testAllRegisters.txt. */
+static const char * BENCH_OPERANDS[] =
+{
+        "$v0", "$v1", "$v0", "$a0", "$zero", "$v1", "$a1", "$a2",
+        "$a3", "$t0", "$t1", "$t2", "$t3", "$t4", "$s0", "$s1", "$s2",
+        "$s3", "$s4", "$s5", "$s6", "$s7", "$t8", "$t9", "$k0", "$k1",
+        "$k1", "$at", "$gp", "$sp", "$fp", "$ra", "$t5", "$t6", "$t7"
+};
+
+static int testRegister(const char * name, int expected);
+static int linearRegNum(Span reg);
+static Span toSpan(const char * string);
+
+int main(int argc, char * argv[])
+{
+    char     numbered[8];
+    int      failures = 0;
+    int      nbrOperands = sizeof(BENCH_OPERANDS) / sizeof(BENCH_OPERANDS[0]);
+    Span     operands[sizeof(BENCH_OPERANDS) / sizeof(BENCH_OPERANDS[0])];
+    clock_t  start;
+    long     sum;
+    int      i, j;
+
+    (void) process_arguments(argc, argv);
+
+    printf("\n===== Testing named and numbered registers =====\n");
+    for (i = 0; i < 32; i++)
+    {
+        failures += testRegister(REG_NAMES[i], i);
+        sprintf(numbered, "$%d", i);
+        failures += testRegister(numbered, i);
+    }
+
+    printf("\n===== Testing names that are not registers =====\n");
+    const char * badNames[] =
+    {
+        "$t10", "$t", "$32", "$99", "$01", "$00", "$-1", "$a4", "$v2",
+        "$s8", "$k2", "$zer", "$zeros", "$ZERO", "t0", "$", "", "$t0,",
+        "$gq", "$ax"
+    };
+    for (i = 0; i < (int) (sizeof(badNames) / sizeof(badNames[0])); i++)
+        failures += testRegister(badNames[i], -1);
+
+    printf("\n%s: %d failure(s)\n", failures == 0 ? "PASSED" : "FAILED",
+           failures);
+
+    printf("\n===== Benchmark: %d x %d register operands =====\n",
+           BENCH_REPEATS, nbrOperands);
+    for (i = 0; i < nbrOperands; i++)
+        operands[i] = toSpan(BENCH_OPERANDS[i]);
+
+    start = clock();
+    for (sum = 0, j = 0; j < BENCH_REPEATS; j++)
+        for (i = 0; i < nbrOperands; i++)
+            sum += getRegNum(operands[i]);
+    printf("\tgetRegNum:      %.3f seconds (checksum %ld)\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC, sum);
+
+    start = clock();
+    for (sum = 0, j = 0; j < BENCH_REPEATS; j++)
+        for (i = 0; i < nbrOperands; i++)
+            sum += linearRegNum(operands[i]);
+    printf("\tlinear search:  %.3f seconds (checksum %ld)\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC, sum);
+
+    return failures == 0 ? 0 : 1;
+}
+
+/*
+ * testRegister decodes a register name and reports whether getRegNum
+ * returned the expected number.  Returns 1 if it did not; 0 otherwise.
+ */
+static int testRegister(const char * name, int expected)
+{
+    int regNum = getRegNum(toSpan(name));
+
+    if ( regNum != expected )
+    {
+        printf("\tFAILED: '%s' decoded to %d, expected %d\n", name, regNum,
+               expected);
+        return 1;
+    }
+    printDebug("\t'%s' -> %d\n", name, regNum);
+    return 0;
+}
+
+/*
+ * linearRegNum is the register lookup the assembler used before
+ * getRegNum decoded names directly: a comparison with each name in turn.
+ * It is the baseline for the benchmark.
+ */
+static int linearRegNum(Span reg)
+{
+    int x;
+
+    for (x = 0; x < 32; x++)
+    {
+        if ( (int) strlen(REG_NAMES[x]) == reg.length &&
+             strncmp(reg.text, REG_NAMES[x], reg.length) == 0 )
+            return x;
+    }
+    return -1;
+}
+
+static Span toSpan(const char * string)
+{
+    Span span;
+
+    span.text = string;
+    span.length = (int) strlen(string);
+    return span;
+}
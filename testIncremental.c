@@ -0,0 +1,415 @@
+/*
+ * Test Driver to test incremental assembly (see incremental.h).
+ *
+ * It runs the assembler on a random program, then edits the program at
+ * random and runs it again after each edit, both in full and with
+ * --incremental, and compares the two.  The labels are drawn from a
+ * small set of names, so that the edits add and remove definitions of
+ * labels that are used elsewhere, define the same label twice, and move
+ * labels (with the lines that use them) up and down the program; some
+ * lines have errors, and some use labels that are not defined.
+ *
+ * It includes the following tests:
+ *
+ *      Test 1). NBR_EDITS random edits: inserting, deleting, or
+ *      replacing a few lines, moving a block of lines elsewhere, or
+ *      copying a line with a label (which defines the label twice).
+ *      Each assembly uses one of OPTIONS (with and without an error
+ *      limit, and in another output format).
+ *      Standard Output should report PASSED if the output, the error
+ *      messages, and the exit status of every incremental assembly were
+ *      the same as those of the full assembly.
+ *
+ *      Test 2). NBR_CORRUPTIONS assemblies with a few random bits of the
+ *      state file flipped beforehand.
+ *      Standard Output should report PASSED if every one of them was the
+ *      same as the full assembly (a damaged state must be ignored).
+ *
+ * When an assembly differs, the program that shows it is kept in the
+ * temporary directory, whose name is printed.
+ *
+ * USAGE:
+ *          testIncremental [ assembler [ seed ] ]
+ *      The assembler is ./assembler if none is given.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NBR_EDITS       300
+#define NBR_CORRUPTIONS 100
+
+/* Size of the program at the start, and the most it can grow to. */
+#define FIRST_LINES     1500
+#define MAX_LINES       4000
+#define LINE_LENGTH     64
+
+/* Labels are named L0 to L(NBR_LABELS - 1), and lines use labels up to
+ * NBR_LABELS + UNDEFINED_LABELS - 1 (so some are never defined).  One
+ * line in LABEL_CHANCE has a label.
+ */
+#define NBR_LABELS          60
+#define UNDEFINED_LABELS    4
+#define LABEL_CHANCE        6
+
+/* Chance (in percent) of a line with an error. */
+#define ERROR_CHANCE        2
+
+/* The options of each assembly, chosen at random. */
+static const char * OPTIONS[] = {
+        "--error-limit=0",
+        "",
+        "--error-limit=0 -f readmemh",
+        "--error-limit=3"
+};
+#define NBR_OPTIONS ((int) (sizeof(OPTIONS) / sizeof(OPTIONS[0])))
+
+static const char * REGISTERS[] = {
+        "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+        "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+        "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+        "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+static char lines[MAX_LINES][LINE_LENGTH];
+static int  nbrLines = 0;
+
+static char directory[] = "/tmp/testIncrementalXXXXXX";
+static char program[64], state[64];
+
+static int  sameAssembly (const char * assembler, const char * options);
+static int  runAssembler (const char * assembler, const char * options,
+                          const char * output);
+static int  sameFiles (const char * name1, const char * name2);
+static void writeProgram (void);
+static void editProgram (uint64_t * random);
+static void randomLine (char * line, uint64_t * random);
+static void insertLines (int at, int count);
+static void deleteLines (int at, int count);
+static void flipBits (const char * name, uint64_t * random);
+static uint64_t nextRandom (uint64_t * random);
+static unsigned randomBelow (uint64_t * random, unsigned limit);
+
+int main (int argc, char * argv[])
+{
+    const char * assembler = argc > 1 ? argv[1] : "./assembler";
+    uint64_t     random = 0x9E3779B97F4A7C15ULL;
+    int          i, failed = 0, failures = 0;
+
+    if ( argc > 2 )
+        random += strtoull(argv[2], NULL, 10) * 0xD1B54A32D192ED03ULL;
+    if ( mkdtemp(directory) == NULL )
+    {
+        fprintf(stderr, "Error: cannot create a temporary directory.\n");
+        return 1;
+    }
+    sprintf(program, "%s/program.txt", directory);
+    sprintf(state, "%s/program.state", directory);
+
+    for ( nbrLines = 0; nbrLines < FIRST_LINES; nbrLines++ )
+        randomLine(lines[nbrLines], &random);
+
+    /* Test 1: random edits. */
+    printf("Test 1: %d random edits\n", NBR_EDITS);
+    for ( i = 0; i <= NBR_EDITS && ! failed; i++ )
+    {
+        if ( i > 0 )
+            editProgram(&random);
+        writeProgram();
+        if ( ! sameAssembly(assembler,
+                            OPTIONS[randomBelow(&random, NBR_OPTIONS)]) )
+        {
+            printf("FAILED after edit %d (see %s)\n", i, program);
+            failed = 1;
+        }
+    }
+    if ( ! failed )
+        printf("PASSED\n");
+    failures += failed;
+
+    /* Test 2: damaged state files. */
+    printf("\nTest 2: %d damaged state files\n", NBR_CORRUPTIONS);
+    failed = 0;
+    for ( i = 0; i < NBR_CORRUPTIONS && ! failed; i++ )
+    {
+        /* Bring the state up to date, then damage it. */
+        if ( runAssembler(assembler, "--error-limit=0", NULL) < 0 )
+            failed = 1;
+        flipBits(state, &random);
+        if ( ! sameAssembly(assembler, "--error-limit=0") )
+        {
+            printf("FAILED with damaged state %d (see %s)\n", i, program);
+            failed = 1;
+        }
+    }
+    if ( ! failed )
+        printf("PASSED\n");
+    failures += failed;
+
+    if ( failures == 0 )
+    {
+        char command[128];
+
+        sprintf(command, "rm -rf %s", directory);
+        (void) system(command);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+/*
+ * Assembles the program in full and with --incremental, with the given
+ * options.
+ * Returns 1 if the output, the error messages, and the exit status are
+ * the same both times; 0 otherwise.
+ */
+static int sameAssembly (const char * assembler, const char * options)
+{
+    int full, incremental;
+
+    full = runAssembler(assembler, options, "full");
+    incremental = runAssembler(assembler, options, "incremental");
+    return full >= 0 && full == incremental &&
+           sameFiles("full.out", "incremental.out") &&
+           sameFiles("full.err", "incremental.err");
+}
+
+/*
+ * Runs the assembler on the program with the given options: with
+ * --incremental, unless output is "full".  Its standard output and
+ * standard error go to output.out and output.err in the temporary
+ * directory (or are discarded if output is NULL, as is the output of the
+ * assembly).
+ * Returns the exit status of the assembler, or -1 if it could not be
+ * run.
+ */
+static int runAssembler (const char * assembler, const char * options,
+                         const char * output)
+{
+    char command[1024];
+    int  status, length;
+
+    length = sprintf(command, "%s %s", assembler, options);
+    if ( output == NULL || strcmp(output, "full") != 0 )
+        length += sprintf(command + length, " --incremental=%s", state);
+    length += sprintf(command + length, " %s 0", program);
+    if ( output == NULL )
+        sprintf(command + length, " > /dev/null 2>&1");
+    else
+        sprintf(command + length, " > %s/%s.out 2> %s/%s.err",
+                directory, output, directory, output);
+
+    status = system(command);
+    if ( status == -1 || ! WIFEXITED(status) )
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+/*
+ * Returns 1 if the files of the given names in the temporary directory
+ * have the same contents; 0 otherwise.
+ */
+static int sameFiles (const char * name1, const char * name2)
+{
+    char   path[128];
+    FILE * fp1, * fp2;
+    int    c1, c2, same = 0;
+
+    sprintf(path, "%s/%s", directory, name1);
+    fp1 = fopen(path, "rb");
+    sprintf(path, "%s/%s", directory, name2);
+    fp2 = fopen(path, "rb");
+    if ( fp1 != NULL && fp2 != NULL )
+    {
+        do
+        {
+            c1 = getc(fp1);
+            c2 = getc(fp2);
+        }
+        while ( c1 == c2 && c1 != EOF );
+        same = c1 == c2;
+    }
+    if ( fp1 != NULL )
+        fclose(fp1);
+    if ( fp2 != NULL )
+        fclose(fp2);
+    return same;
+}
+
+/* Writes the lines of the program to its file. */
+static void writeProgram (void)
+{
+    FILE * fp;
+    int    i;
+
+    if ( (fp = fopen(program, "w")) == NULL )
+    {
+        fprintf(stderr, "Error: cannot write %s.\n", program);
+        exit(1);
+    }
+    for ( i = 0; i < nbrLines; i++ )
+        fprintf(fp, "%s\n", lines[i]);
+    fclose(fp);
+}
+
+/*
+ * Makes a random edit of the program: inserts, deletes, or replaces 1 to
+ * 5 lines, moves a block of up to 100 lines elsewhere, or copies a line
+ * with a label to another place.
+ */
+static void editProgram (uint64_t * random)
+{
+    static char block[100][LINE_LENGTH];
+    int kind = (int) randomBelow(random, 10);
+    int count = 1 + (int) randomBelow(random, 5);
+    int at = (int) randomBelow(random, (unsigned) nbrLines + 1);
+    int i, from;
+
+    if ( nbrLines + count > MAX_LINES )
+        kind = 3;                   /* delete lines rather than add them */
+    else if ( nbrLines < 100 )
+        kind = 0;                   /* and add them rather than delete them */
+
+    switch ( kind )
+    {
+        case 0: case 1: case 2:     /* insert */
+            insertLines(at, count);
+            for ( i = 0; i < count; i++ )
+                randomLine(lines[at + i], random);
+            break;
+        case 3: case 4:             /* delete */
+            deleteLines(at, count);
+            break;
+        case 5: case 6:             /* replace */
+            for ( i = at; i < at + count && i < nbrLines; i++ )
+                randomLine(lines[i], random);
+            break;
+        case 7: case 8:             /* move a block */
+            count = 1 + (int) randomBelow(random, 100);
+            if ( at + count > nbrLines )
+                count = nbrLines - at;
+            memcpy(block, lines[at], (size_t) count * LINE_LENGTH);
+            deleteLines(at, count);
+            at = (int) randomBelow(random, (unsigned) nbrLines + 1);
+            insertLines(at, count);
+            memcpy(lines[at], block, (size_t) count * LINE_LENGTH);
+            break;
+        default:                    /* copy a line with a label */
+            for ( from = at; from < nbrLines && strchr(lines[from], ':') ==
+                  NULL; from++ )
+                ;
+            if ( from == nbrLines )
+                break;
+            memcpy(block[0], lines[from], LINE_LENGTH);
+            at = (int) randomBelow(random, (unsigned) nbrLines + 1);
+            insertLines(at, 1);
+            memcpy(lines[at], block[0], LINE_LENGTH);
+            break;
+    }
+}
+
+/*
+ * Writes a random line of the program into line: an instruction (with a
+ * label, or an error, now and then), a comment, or a blank line.
+ */
+static void randomLine (char * line, uint64_t * random)
+{
+    unsigned kind = randomBelow(random, 100);
+    unsigned used = randomBelow(random, NBR_LABELS + UNDEFINED_LABELS);
+    int      length = 0;
+
+    if ( randomBelow(random, LABEL_CHANCE) == 0 )
+        length = sprintf(line, "L%u: ", randomBelow(random, NBR_LABELS));
+
+    if ( randomBelow(random, 100) < ERROR_CHANCE )
+        sprintf(line + length, "%s $t0, $t1, $t2",
+                randomBelow(random, 2) ? "bogus" : "add $bad,");
+    else if ( kind < 30 )
+        sprintf(line + length, "%s %s, %s, %s",
+                randomBelow(random, 2) ? "add" : "slt",
+                REGISTERS[randomBelow(random, 32)],
+                REGISTERS[randomBelow(random, 32)],
+                REGISTERS[randomBelow(random, 32)]);
+    else if ( kind < 45 )
+        sprintf(line + length, "addi %s, %s, %u",
+                REGISTERS[randomBelow(random, 32)],
+                REGISTERS[randomBelow(random, 32)],
+                randomBelow(random, 65536));
+    else if ( kind < 55 )
+        sprintf(line + length, "%s %s, %u(%s)",
+                randomBelow(random, 2) ? "lw" : "sw",
+                REGISTERS[randomBelow(random, 32)],
+                4 * randomBelow(random, 64),
+                REGISTERS[randomBelow(random, 32)]);
+    else if ( kind < 75 )
+        sprintf(line + length, "%s %s, %s, L%u",
+                randomBelow(random, 2) ? "beq" : "bne",
+                REGISTERS[randomBelow(random, 32)],
+                REGISTERS[randomBelow(random, 32)], used);
+    else if ( kind < 90 )
+        sprintf(line + length, "%s L%u",
+                randomBelow(random, 2) ? "j" : "jal", used);
+    else if ( kind < 95 )
+        sprintf(line + length, "# a comment");
+    else
+        line[length] = '\0';
+}
+
+/* Makes room for count lines at line at, moving the lines after it. */
+static void insertLines (int at, int count)
+{
+    memmove(lines[at + count], lines[at],
+            (size_t) (nbrLines - at) * LINE_LENGTH);
+    nbrLines += count;
+}
+
+/* Deletes up to count lines from line at on. */
+static void deleteLines (int at, int count)
+{
+    if ( at + count > nbrLines )
+        count = nbrLines - at;
+    memmove(lines[at], lines[at + count],
+            (size_t) (nbrLines - at - count) * LINE_LENGTH);
+    nbrLines -= count;
+}
+
+/* Flips one to three random bits of the file of the given name. */
+static void flipBits (const char * name, uint64_t * random)
+{
+    FILE * fp;
+    long   size, offset;
+    int    i, c;
+
+    if ( (fp = fopen(name, "r+b")) == NULL )
+        return;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    for ( i = 1 + (int) randomBelow(random, 3); i > 0 && size > 0; i-- )
+    {
+        offset = (long) (nextRandom(random) % (uint64_t) size);
+        fseek(fp, offset, SEEK_SET);
+        c = getc(fp);
+        fseek(fp, offset, SEEK_SET);
+        putc(c ^ (1 << randomBelow(random, 8)), fp);
+    }
+    fclose(fp);
+}
+
+/* Returns the next number of a pseudo-random (xorshift64) sequence. */
+static uint64_t nextRandom (uint64_t * random)
+{
+    *random ^= *random << 13;
+    *random ^= *random >> 7;
+    *random ^= *random << 17;
+    return *random;
+}
+
+/* Returns a pseudo-random number from 0 to limit - 1. */
+static unsigned randomBelow (uint64_t * random, unsigned limit)
+{
+    return (unsigned) ((nextRandom(random) >> 32) * limit >> 32);
+}
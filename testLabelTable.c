@@ -35,6 +35,25 @@
  *      Test 4). Testing the addLabel function with a label which already exists in the 
  *      label table. 
  *      Standard Output should print ERROR1 - duplicate label. 
+ *
+ * It includes the following scaling test for a large label table:
+ *      Test 1). Adding LARGE_TABLE_SIZE generated labels, then looking each of them
+ *      up and looking up as many labels that are not in the table.
+ *      Standard Output should print the time taken by each phase and report that
+ *      every lookup returned the expected address.
+ *
+ *      Test 2). The same, with the table's memory taken from an arena (see
+ *      arena.h) and released with it.
+ *      Standard Output should print the same, along with the memory the arena
+ *      holds.
+ *
+ *      Test 3). Resizing a table in an arena to 10, 600 and 1200 entries,
+ *      adding 1200 labels, resizing it to 2400, and looking each label up
+ *      (the entries grow past the size of a big allocation while the label
+ *      names are allocated after them, and must not be released with the
+ *      entries when they move).
+ *      Standard Output should report that every lookup returned the
+ *      expected address.
  *              
  *
  * Author:  Nikhil Sodemba
@@ -43,9 +62,16 @@
  * 
  */
 
+#include <time.h>
+
 #include "assembler.h"
 
+/* Number of labels used by the large table test. */
+#define LARGE_TABLE_SIZE 2000000
+
 static void testSearch(LabelTable * table, char * searchLabel);
+static void testLargeTable(int nbrLabels, Arena * arena);
+static void testArenaResize(void);
 
 int main(int argc, char * argv[])
 {
@@ -70,6 +96,8 @@ int main(int argc, char * argv[])
     testTable1.capacity = 5;
     testTable1.nbrLabels = 1;
     testTable1.entries = staticEntries;
+    testTable1.index = NULL;        /* no hashed index; searched linearly */
+    testTable1.indexCapacity = 0;
 
     /* Test printLabels and findLabel with static testTable1.
      *      DO NOT TEST tableInit, addLabel, or tableResize WITH STATIC TABLE!
@@ -158,6 +186,19 @@ int main(int argc, char * argv[])
     printf("\nTesting addLabel function, trying to add a label with already exists in label table..\n");
     addLabel(&testTable2, "TQ", 2008);
 
+    printf("\n===== Testing with large table =====\n");
+    testLargeTable(LARGE_TABLE_SIZE, NULL);
+
+    printf("\n===== Testing with large table in an arena =====\n");
+    {
+        Arena arena;
+
+        arenaInit(&arena, NULL);
+        testLargeTable(LARGE_TABLE_SIZE, &arena);
+    }
+
+    printf("\n===== Testing resizing a table in an arena =====\n");
+    testArenaResize();
 }
 
 /*
@@ -190,3 +231,113 @@ static void testSearch(LabelTable * table, char * searchLabel)
         }   
     }
 }
+
+/*
+ * testLargeTable adds nbrLabels generated labels to a new dynamic table,
+ * then looks up every one of them and the same number of labels that are
+ * not in the table, printing the time taken by each phase and the number
+ * of lookups that did not return the expected address, and releases the
+ * table.
+ *  @param  nbrLabels    the number of labels to add
+ *  @param  arena        the arena the table's memory comes from (NULL:
+ *                       malloc), which is released with the table
+ */
+static void testLargeTable(int nbrLabels, Arena * arena)
+{
+    LabelTable table;
+    char label[32];
+    clock_t start;
+    int errors = 0;
+    int i;
+
+    (void) arenaUse(arena);
+    tableInit(&table);
+    (void) arenaUse(NULL);
+
+    printf("\nAdding %d labels..\n", nbrLabels);
+    start = clock();
+    for (i = 0; i < nbrLabels; i++)
+    {
+        sprintf(label, "label_%d", i);
+        if (addLabel(&table, label, i * 4) == 0)
+        {
+            printf("\tError: could not add label %s.\n", label);
+            return;
+        }
+    }
+    printf("\tAdded %d labels in %.2f seconds.\n", table.nbrLabels,
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    printf("\nLooking up %d labels that are in the table..\n", nbrLabels);
+    start = clock();
+    for (i = 0; i < nbrLabels; i++)
+    {
+        sprintf(label, "label_%d", i);
+        if (findLabel(&table, label) != i * 4)
+            errors++;
+    }
+    printf("\tDone in %.2f seconds.\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    printf("\nLooking up %d labels that are not in the table..\n", nbrLabels);
+    start = clock();
+    for (i = 0; i < nbrLabels; i++)
+    {
+        sprintf(label, "missing_%d", i);
+        if (findLabel(&table, label) != -1)
+            errors++;
+    }
+    printf("\tDone in %.2f seconds.\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    printf("\nNumber of lookups with an unexpected result: %d\n", errors);
+
+    if (arena != NULL)
+        printf("\nThe arena holds %lu bytes.\n", (unsigned long) arena->size);
+    start = clock();
+    tableFree(&table);
+    if (arena != NULL)
+        arenaFree(arena);
+    printf("\nReleased the table in %.2f seconds.\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+}
+
+/*
+ * testArenaResize resizes a table whose memory comes from an arena to
+ * 10, 600 and 1200 entries, adds 1200 labels, resizes it to 2400
+ * entries, and looks each label up, printing the number of lookups that
+ * did not return the expected address.
+ */
+static void testArenaResize(void)
+{
+    LabelTable table;
+    Arena arena;
+    char label[32];
+    int errors = 0;
+    int i;
+
+    arenaInit(&arena, NULL);
+    (void) arenaUse(&arena);
+    tableInit(&table);
+    (void) arenaUse(NULL);
+
+    (void) tableResize(&table, 10);
+    (void) tableResize(&table, 600);
+    (void) tableResize(&table, 1200);
+    for (i = 0; i < 1200; i++)
+    {
+        sprintf(label, "label_%d", i);
+        (void) addLabel(&table, label, i * 4);
+    }
+    (void) tableResize(&table, 2400);
+    for (i = 0; i < 1200; i++)
+    {
+        sprintf(label, "label_%d", i);
+        if (findLabel(&table, label) != i * 4)
+            errors++;
+    }
+    printf("\nNumber of lookups with an unexpected result: %d\n", errors);
+
+    tableFree(&table);
+    arenaFree(&arena);
+}
@@ -0,0 +1,231 @@
+/*
+ * Test Driver to test the assembler library (see libassembler.h).
+ *
+ * It includes the following tests:
+ *
+ *      Test 1). Assembling the input once, in memory.
+ *      Standard Output should print the memory image (address and
+ *      machine word in hex for each word), the number of errors, and the
+ *      error messages, which should be the same as the assembler's for
+ *      the same input.
+ *
+ *      Test 2). Assembling the same input with one context per thread,
+ *      many times over, on NBR_THREADS threads at once.
+ *      Standard Output should report that every assembly produced the
+ *      same image and the same error messages as Test 1.
+ *
+ *      Test 3). Assembling with an error limit of 1.
+ *      Standard Output should print the number of errors found before
+ *      the assembly stopped (at most 2 if the input has errors).
+ *
+ *      Test 4). Assembling with an allocator of the test's own (see
+ *      assemblerSetAllocator), which counts the blocks it hands out.
+ *      Standard Output should report that the image and error messages
+ *      are the same as Test 1's, and that every block allocated was
+ *      released by assemblerFree.
+ *
+ * USAGE:
+ *          testLibAssembler [ filename ]
+ *      The input is read from filename, or from stdin if there is none.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libassembler.h"
+
+/* Size of the word buffer, and number of threads and assemblies each in
+ * Test 2.
+ */
+#define MAX_WORDS           (1 << 20)
+#define NBR_THREADS         8
+#define NBR_REPETITIONS     50
+
+/* The input and the results of Test 1, which every thread compares with. */
+typedef struct {
+        const char * text;
+        size_t       length;
+        uint32_t *   words;
+        size_t       nbrWords;
+        const char * errors;
+        int          mismatches;    /* assemblies that came out different */
+        pthread_mutex_t lock;       /* protects mismatches */
+} SharedTest;
+
+/* The blocks handed out by countingAllocate and not yet released. */
+typedef struct {
+        int allocated;
+        int released;
+} BlockCounts;
+
+static void * assembleRepeatedly (void * test);
+static void * countingAllocate (void * counts, size_t size);
+static void   countingRelease (void * counts, void * block);
+static char * readAll (FILE * fp, size_t * length);
+
+int main (int argc, char * argv[])
+{
+    FILE *      fptr = stdin;
+    Assembler * assembler;
+    SharedTest  test;
+    pthread_t   threads[NBR_THREADS];
+    uint32_t *  words;
+    size_t      i, nbrWords;
+    int         t;
+
+    if ( argc > 1 && (fptr = fopen(argv[1], "r")) == NULL )
+    {
+        fprintf(stderr, "Error: Cannot open file %s.\n", argv[1]);
+        return 1;
+    }
+    if ( (test.text = readAll(fptr, &test.length)) == NULL ||
+         (test.words = malloc(MAX_WORDS * sizeof(uint32_t))) == NULL ||
+         (words = malloc(MAX_WORDS * sizeof(uint32_t))) == NULL ||
+         (assembler = assemblerNew()) == NULL )
+    {
+        fprintf(stderr, "Error: cannot allocate space in memory.\n");
+        return 1;
+    }
+
+    printf("Test 1: assemble once\n");
+    (void) assembleText(assembler, test.text, test.length, test.words,
+                        MAX_WORDS, &test.nbrWords);
+    for ( i = 0; i < test.nbrWords; i++ )
+        printf("%08lx: %08lx\n", (unsigned long) i * 4,
+               (unsigned long) test.words[i]);
+    printf("%lu words, %d errors:%s\n", (unsigned long) test.nbrWords,
+           assemblerErrorCount(assembler), assemblerErrors(assembler));
+    test.errors = assemblerErrors(assembler);
+
+    printf("\nTest 2: %d threads, %d assemblies each\n", NBR_THREADS,
+           NBR_REPETITIONS);
+    test.mismatches = 0;
+    pthread_mutex_init(&test.lock, NULL);
+    for ( t = 0; t < NBR_THREADS; t++ )
+        if ( pthread_create(&threads[t], NULL, assembleRepeatedly, &test)
+             != 0 )
+        {
+            fprintf(stderr, "Error: cannot start a thread.\n");
+            return 1;
+        }
+    for ( t = 0; t < NBR_THREADS; t++ )
+        pthread_join(threads[t], NULL);
+    printf("%s: %d of %d assemblies were different\n",
+           test.mismatches == 0 ? "OK" : "FAILED", test.mismatches,
+           NBR_THREADS * NBR_REPETITIONS);
+
+    printf("\nTest 3: error limit of 1\n");
+    {
+        Assembler * limited = assemblerNew();
+
+        assemblerSetErrorLimit(limited, 1);
+        (void) assembleText(limited, test.text, test.length, words,
+                            MAX_WORDS, &nbrWords);
+        printf("stopped after %d errors\n", assemblerErrorCount(limited));
+        assemblerFree(limited);
+    }
+
+    printf("\nTest 4: the caller's allocator\n");
+    {
+        Assembler * counted = assemblerNew();
+        BlockCounts counts = { 0, 0 };
+        int         same;
+
+        assemblerSetAllocator(counted, countingAllocate, countingRelease,
+                              &counts);
+        (void) assembleText(counted, test.text, test.length, words,
+                            MAX_WORDS, &nbrWords);
+        same = nbrWords == test.nbrWords &&
+               memcmp(words, test.words, nbrWords * sizeof(uint32_t)) == 0
+               && strcmp(assemblerErrors(counted), test.errors) == 0;
+        assemblerFree(counted);
+        printf("%s: %s image; %d blocks allocated, %d released\n",
+               same && counts.allocated == counts.released ? "OK"
+                                                            : "FAILED",
+               same ? "same" : "different", counts.allocated,
+               counts.released);
+        if ( ! same || counts.allocated != counts.released )
+            test.mismatches++;
+    }
+
+    assemblerFree(assembler);
+    free(test.words);
+    free(words);
+    free((char *) test.text);
+    return test.mismatches == 0 ? 0 : 1;
+}
+
+/*
+ * The work of each thread in Test 2: assemble the input NBR_REPETITIONS
+ * times with a context of its own, comparing each result with Test 1's.
+ */
+static void * assembleRepeatedly (void * arg)
+{
+    SharedTest * test = arg;
+    Assembler *  assembler = assemblerNew();
+    uint32_t *   words = malloc(MAX_WORDS * sizeof(uint32_t));
+    size_t       nbrWords;
+    int          i, mismatches = 0;
+
+    if ( assembler == NULL || words == NULL )
+        mismatches = NBR_REPETITIONS;
+    for ( i = 0; i < NBR_REPETITIONS && mismatches == 0; i++ )
+    {
+        (void) assembleText(assembler, test->text, test->length, words,
+                            MAX_WORDS, &nbrWords);
+        if ( nbrWords != test->nbrWords ||
+             memcmp(words, test->words, nbrWords * sizeof(uint32_t)) != 0 ||
+             strcmp(assemblerErrors(assembler), test->errors) != 0 )
+            mismatches++;
+    }
+
+    pthread_mutex_lock(&test->lock);
+    test->mismatches += mismatches;
+    pthread_mutex_unlock(&test->lock);
+    assemblerFree(assembler);
+    free(words);
+    return NULL;
+}
+
+/*
+ * The allocator of Test 4: malloc and free, counting the blocks.
+ */
+static void * countingAllocate (void * counts, size_t size)
+{
+    ((BlockCounts *) counts)->allocated++;
+    return malloc(size);
+}
+
+static void countingRelease (void * counts, void * block)
+{
+    ((BlockCounts *) counts)->released++;
+    free(block);
+}
+
+/*
+ * Reads the rest of fp into a dynamically allocated buffer and sets
+ * *length to its size.  Returns the buffer; NULL if memory allocation
+ * error.
+ */
+static char * readAll (FILE * fp, size_t * length)
+{
+    size_t capacity = BUFSIZ;
+    char * text = malloc(capacity);
+    char * newText;
+
+    *length = 0;
+    while ( text != NULL )
+    {
+        *length += fread(text + *length, 1, capacity - *length, fp);
+        if ( *length < capacity )
+            return text;
+        if ( (newText = realloc(text, capacity * 2)) == NULL )
+            free(text);
+        text = newText;
+        capacity *= 2;
+    }
+    return NULL;
+}
@@ -0,0 +1,165 @@
+/*
+ * Test Driver to test the parseNumber function, which converts the text
+ * of a number (an immediate value or the value of a data directive).
+ *
+ * It includes the following tests:
+ *
+ *      Test 1). Decimal, hexadecimal, and character numbers, with and
+ *      without signs, including the largest magnitude (2^32 - 1) and
+ *      numbers long enough to be converted 8 digits at a time.
+ *      Standard Output should report that each one converted to its
+ *      value.
+ *
+ *      Test 2). Text that is not a number, or is too big (e.g. "12a",
+ *      "0x", "4294967296", "'ab'", "'\q'").
+ *      Standard Output should report that each one was rejected.
+ *
+ *      Test 3). Every multiple of 2147 up to 2147 * BENCH_COUNT (numbers
+ *      of every length up to 10 digits), printed with sprintf and
+ *      converted back.
+ *      Standard Output should report PASSED if all of them were
+ *      converted to their value.
+ *
+ *      Test 4). A microbenchmark converting a 10-digit number
+ *      BENCH_COUNT times with parseNumber and with strtoll.
+ *      Standard Output should print the time taken by each.
+ *
+ * Creation Date: October, 17th, 2026
+ *
+ */
+
+#include <time.h>
+
+#include "assembler.h"
+#include "number.h"
+
+/* Numbers converted by Tests 3 and 4. */
+#define BENCH_COUNT 2000000
+
+static int testNumber(const char * text, int expectedOk, int64_t expected);
+static Span toSpan(const char * string);
+
+int main(int argc, char * argv[])
+{
+    char     text[24];
+    int      failures = 0;
+    clock_t  start;
+    int64_t  value, sum;
+    long     i;
+
+    (void) process_arguments(argc, argv);
+
+    printf("\n===== Testing numbers =====\n");
+    failures += testNumber("0", 1, 0);
+    failures += testNumber("7", 1, 7);
+    failures += testNumber("-42", 1, -42);
+    failures += testNumber("+42", 1, 42);
+    failures += testNumber("32767", 1, 32767);
+    failures += testNumber("12345678", 1, 12345678);
+    failures += testNumber("123456789", 1, 123456789);
+    failures += testNumber("0000000000000001", 1, 1);
+    failures += testNumber("4294967295", 1, 4294967295LL);
+    failures += testNumber("-4294967295", 1, -4294967295LL);
+    failures += testNumber("-2147483648", 1, -2147483648LL);
+    failures += testNumber("0x0", 1, 0);
+    failures += testNumber("0x2A", 1, 42);
+    failures += testNumber("0X2a", 1, 42);
+    failures += testNumber("-0x10", 1, -16);
+    failures += testNumber("0xFFFFFFFF", 1, 4294967295LL);
+    failures += testNumber("0x00000000FFFFFFFF", 1, 4294967295LL);
+    failures += testNumber("'*'", 1, '*');
+    failures += testNumber("'#'", 1, '#');
+    failures += testNumber("'\\n'", 1, '\n');
+    failures += testNumber("'\\0'", 1, 0);
+    failures += testNumber("'\\''", 1, '\'');
+    failures += testNumber("'\\\\'", 1, '\\');
+
+    printf("\n===== Testing text that is not a number =====\n");
+    const char * badNumbers[] =
+    {
+        "", "-", "+", "12a", "a12", "1 2", "0x", "0xG", "-0x", "--1",
+        "1234567a", "12345678a", "1234567/", "12345678:", "4294967296",
+        "99999999999", "12345678901234567890", "0x100000000",
+        "0x123456789", "-4294967296", "''", "'ab'", "'\\q'", "'\\'", "'a",
+        "a'"
+    };
+    for (i = 0; i < (long) (sizeof(badNumbers) / sizeof(badNumbers[0])); i++)
+        failures += testNumber(badNumbers[i], 0, 0);
+
+    printf("\n===== Testing multiples of 2147 up to 2147 * %d =====\n",
+           BENCH_COUNT);
+    for (i = 0; i <= BENCH_COUNT; i++)
+    {
+        sprintf(text, "%ld", i * 2147);
+        if ( ! parseNumber(toSpan(text), &value) || value != i * 2147 )
+        {
+            printf("\tFAILED: '%s' converted to %lld\n", text,
+                   (long long) value);
+            failures++;
+            break;
+        }
+    }
+
+    printf("\n%s: %d failure(s)\n", failures == 0 ? "PASSED" : "FAILED",
+           failures);
+
+    printf("\n===== Benchmark: %d numbers =====\n", BENCH_COUNT);
+    sprintf(text, "%d", 1234567890);
+    start = clock();
+    for (sum = 0, i = 0; i < BENCH_COUNT; i++)
+    {
+        text[9] = (char) ('0' + i % 10);
+        (void) parseNumber(toSpan(text), &value);
+        sum += value;
+    }
+    printf("\tparseNumber:  %.3f seconds (checksum %lld)\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC, (long long) sum);
+
+    start = clock();
+    for (sum = 0, i = 0; i < BENCH_COUNT; i++)
+    {
+        text[9] = (char) ('0' + i % 10);
+        sum += strtoll(text, NULL, 10);
+    }
+    printf("\tstrtoll:      %.3f seconds (checksum %lld)\n",
+           (double) (clock() - start) / CLOCKS_PER_SEC, (long long) sum);
+
+    return failures == 0 ? 0 : 1;
+}
+
+/*
+ * testNumber converts text and reports whether parseNumber accepted it
+ * (if expectedOk) with the expected value, or rejected it.  Returns 1
+ * if it did not; 0 otherwise.
+ */
+static int testNumber(const char * text, int expectedOk, int64_t expected)
+{
+    int64_t value = 0;
+    int     ok = parseNumber(toSpan(text), &value);
+
+    if ( ok != expectedOk || (ok && value != expected) )
+    {
+        if ( expectedOk )
+            printf("\tFAILED: '%s' converted to %lld (ok %d), expected "
+                   "%lld\n", text, (long long) value, ok,
+                   (long long) expected);
+        else
+            printf("\tFAILED: '%s' was accepted as %lld\n", text,
+                   (long long) value);
+        return 1;
+    }
+    if ( ok )
+        printDebug("\t'%s' -> %lld\n", text, (long long) value);
+    else
+        printDebug("\t'%s' rejected\n", text);
+    return 0;
+}
+
+static Span toSpan(const char * string)
+{
+    Span span;
+
+    span.text = string;
+    span.length = (int) strlen(string);
+    return span;
+}
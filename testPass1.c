@@ -64,6 +64,7 @@
 int main (int argc, char * argv[])
 {
     FILE * fptr;               /* file pointer */
+    SourceFile source;         /* contents of the file */
     LabelTable table;
 
     /* Process command-line arguments (if any) -- input file name
@@ -75,21 +76,25 @@ int main (int argc, char * argv[])
         return 1;   /* Fatal error when processing arguments */
     }
 
-    /* Call pass1 to generate the label table. */
-    table = pass1 (fptr);
+    /* Read the input and call pass1 to generate the label table. */
+    if ( ! sourceOpen (&source, fptr) )
+    {
+        return 1;   /* Fatal error when reading the input */
+    }
+    table = pass1 (&source, NULL);      /* only the labels are tested */
 
     /* Print the label table if debugging is turned on. */
     if ( debug_is_on() )
         printLabels (&table);
 
-    /* If this were an assembler, we would now rewind the file pointer
-     * to be back at the beginning of the file and then call pass2,
-     * passing it the label table.
+    /* If this were an assembler, pass1 would also have been given a
+     * list to parse the instructions into, and we would now call pass2,
+     * passing it that list and the label table.
      *   E.g.:
-     *      rewind (fptr);
-     *      pass2(fptr, table);
+     *      pass2(&program, table, &output);
      */
 
+    sourceClose (&source);
     (void) fclose(fptr);
     return 0;
 }